@@ -0,0 +1,78 @@
+#ifndef BENCHUTIL_HPP
+#define BENCHUTIL_HPP
+
+#include "../include/stats/perfCounters.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/* prevents the optimizer from discarding a computed value */
+template <class T> inline void do_not_optimize(const T &value) { asm volatile("" : : "r,m"(value) : "memory"); }
+
+/**
+ * @brief One measured benchmark, emitted as a single JSON line.
+ *
+ * ns_per_item is the median over repetitions, ns_per_item_min the best one.
+ * perf holds the hardware counters per item, averaged over all repetitions,
+ * where the machine has them.
+ */
+struct BenchResult {
+	std::string name;
+	std::string scenario;
+	size_t items = 0;
+	size_t repetitions = 0;
+	double ns_per_item = 0;
+	double ns_per_item_min = 0;
+	PerfValues perf;
+	/* items counted into perf */
+	size_t perf_items = 0;
+};
+
+/**
+ * @brief Times `run` repetitions times, calling `setup` untimed before each one.
+ *
+ * `run` must process exactly `items` items per call.
+ */
+template <class Setup, class Run>
+BenchResult measure(const std::string &name, const std::string &scenario, size_t items, size_t repetitions,
+					Setup &&setup, Run &&run) {
+	std::vector<double> samples;
+	samples.reserve(repetitions);
+	PerfCounters counters;
+	PerfValues perf;
+	for (size_t r = 0; r < repetitions; ++r) {
+		setup();
+		PerfValues before = counters.read();
+		auto begin = std::chrono::steady_clock::now();
+		run();
+		auto end = std::chrono::steady_clock::now();
+		perf += counters.read() - before;
+		samples.push_back(std::chrono::duration<double, std::nano>(end - begin).count() / std::max<size_t>(items, 1));
+	}
+	std::sort(samples.begin(), samples.end());
+	return {name, scenario, items, repetitions, samples[samples.size() / 2], samples.front(),
+			perf, items * repetitions};
+}
+
+inline void write_json_line(std::ostream &out, const BenchResult &r, const std::string &label) {
+	out << "{\"bench\":\"" << r.name << "\",\"scenario\":\"" << r.scenario << "\",\"label\":\"" << label
+		<< "\",\"items\":" << r.items << ",\"repetitions\":" << r.repetitions << ",\"ns_per_item\":" << r.ns_per_item
+		<< ",\"ns_per_item_min\":" << r.ns_per_item_min
+		<< ",\"items_per_sec\":" << (r.ns_per_item > 0 ? 1e9 / r.ns_per_item : 0);
+	/* only what the counters measured, a missing key means the event isn't available */
+	for (size_t e = 0; e < PERF_EVENTS; ++e) {
+		if (r.perf.available[e])
+			out << ",\"" << perf_event_name(static_cast<PerfEvent>(e)) << "_per_item\":"
+				<< static_cast<double>(r.perf.count[e]) / static_cast<double>(std::max<size_t>(r.perf_items, 1));
+	}
+	if (r.perf.has(PerfEvent::INSTRUCTIONS) && r.perf[PerfEvent::CYCLES])
+		out << ",\"ipc\":"
+			<< static_cast<double>(r.perf[PerfEvent::INSTRUCTIONS]) / static_cast<double>(r.perf[PerfEvent::CYCLES]);
+	out << "}\n";
+}
+
+#endif // BENCHUTIL_HPP
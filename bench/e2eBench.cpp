@@ -0,0 +1,277 @@
+#include "../include/capture/pcapCapture.hpp"
+#include "../include/stats/protocolStats.hpp"
+#include "mixOptions.hpp"
+#include "synthetic.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sys/resource.h>
+
+namespace po = boost::program_options;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point begin) {
+	return std::chrono::duration<double>(Clock::now() - begin).count();
+}
+
+/* per-stage wall time of one pass over the input, in seconds */
+struct RunResult {
+	uint64_t packets = 0;
+	uint64_t bytes = 0;
+	double read = 0;
+	double pipeline = 0;
+	std::map<std::string, double> updates;
+	double snapshot = 0;
+	/* hardware counters of the pipeline pass, where available */
+	PerfValues perf;
+};
+
+struct ReadCounter {
+	uint64_t packets = 0;
+	uint64_t bytes = 0;
+};
+
+/* reads with an empty consumer, the floor the pipeline can reach */
+void count_packet(u_char *user, const struct pcap_pkthdr *header, const u_char *) {
+	auto *counter = reinterpret_cast<ReadCounter *>(user);
+	counter->packets++;
+	counter->bytes += header->len;
+}
+
+bool count_record(void *user, const CaptureRecord &record) {
+	auto *counter = static_cast<ReadCounter *>(user);
+	counter->packets++;
+	counter->bytes += record.len;
+	return true;
+}
+
+ReadCounter read_only(const std::string &path, OfflineReader reader) {
+	ReadCounter counter;
+	if (reader == OfflineReader::MMAP) {
+		MappedFile file(path);
+		CaptureParser parser;
+		read_mapped_capture(file, parser, &count_record, &counter);
+		return counter;
+	}
+
+	char errbuf[PCAP_ERRBUF_SIZE];
+	std::unique_ptr<pcap_t, decltype(&pcap_close)> handle(pcap_open_offline(path.c_str(), errbuf), &pcap_close);
+	if (!handle)
+		throw std::runtime_error(std::string("Couldn't open ") + path + ": " + errbuf);
+	pcap_loop(handle.get(), 0, &count_packet, reinterpret_cast<u_char *>(&counter));
+	return counter;
+}
+
+RunResult run_once(const std::string &path, OfflineReader reader) {
+	RunResult r;
+
+	auto begin = Clock::now();
+	ReadCounter counter = read_only(path, reader);
+	r.read = seconds_since(begin);
+	r.packets = counter.packets;
+	r.bytes = counter.bytes;
+
+	/* the same sequence main() runs for --offline, minus the UI */
+	Stats stats;
+	PcapCapture capture;
+	capture.set_capabilities("offline", 0, "", 10, &stats);
+	capture.set_offline_reader(reader);
+
+	PerfCounters counters;
+	begin = Clock::now();
+	capture.start_offline(path);
+	r.pipeline = seconds_since(begin);
+	r.perf = counters.read();
+
+	auto timed = [&](const std::string &name, auto &&fn) {
+		auto t = Clock::now();
+		fn();
+		r.updates[name] = seconds_since(t);
+	};
+	timed("update_packets", [&] { stats.update_packets(); });
+	timed("update_application_stats", [&] { stats.update_application_stats(); });
+	timed("update_transport_stats", [&] { stats.update_transport_stats(); });
+	timed("update_ip_stats", [&] { stats.update_ip_stats(); });
+	timed("update_pairs", [&] { stats.update_pairs(); });
+	timed("update_bandwidth", [&] { stats.update_bandwidth(); });
+
+	begin = Clock::now();
+	StatsSnapshot snapshot = stats.get_snapshot();
+	r.snapshot = seconds_since(begin);
+	return r;
+}
+
+using Metrics = std::map<std::string, double>;
+
+Metrics to_metrics(const RunResult &r) {
+	Metrics m;
+	double total = r.pipeline + r.snapshot;
+	for (const auto &[name, t] : r.updates)
+		total += t;
+
+	m["packets"] = static_cast<double>(r.packets);
+	m["bytes"] = static_cast<double>(r.bytes);
+	m["packets_per_sec"] = r.pipeline > 0 ? r.packets / r.pipeline : 0;
+	m["bytes_per_sec"] = r.pipeline > 0 ? r.bytes / r.pipeline : 0;
+	m["stage_read_sec"] = r.read;
+	m["stage_pipeline_sec"] = r.pipeline;
+	m["stage_decode_aggregate_sec"] = std::max(0.0, r.pipeline - r.read);
+	for (const auto &[name, t] : r.updates)
+		m["stage_" + name + "_sec"] = t;
+	m["stage_snapshot_sec"] = r.snapshot;
+	m["total_sec"] = total;
+	/* decode + aggregation per packet, left out where the counters aren't available */
+	for (size_t e = 0; e < PERF_EVENTS; ++e) {
+		if (r.perf.available[e] && r.packets)
+			m[std::string("pipeline_") + perf_event_name(static_cast<PerfEvent>(e)) + "_per_packet"] =
+				static_cast<double>(r.perf.count[e]) / static_cast<double>(r.packets);
+	}
+	if (r.perf.has(PerfEvent::INSTRUCTIONS) && r.perf[PerfEvent::CYCLES])
+		m["pipeline_ipc"] =
+			static_cast<double>(r.perf[PerfEvent::INSTRUCTIONS]) / static_cast<double>(r.perf[PerfEvent::CYCLES]);
+
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+	m["peak_rss_bytes"] = static_cast<double>(usage.ru_maxrss) * 1024.0;
+	return m;
+}
+
+void write_json(std::ostream &out, const Metrics &m, const std::string &label, const std::string &reader) {
+	out << "{\"bench\":\"e2e_offline\",\"label\":\"" << label << "\",\"reader\":\"" << reader << "\"";
+	for (const auto &[key, value] : m)
+		out << ",\"" << key << "\":" << std::fixed << value;
+	out << "}\n";
+}
+
+/* baseline files are plain `key value` lines, as written by --write-baseline */
+Metrics load_baseline(const std::string &path) {
+	Metrics m;
+	std::ifstream file(path);
+	std::string key;
+	double value;
+	while (file >> key >> value)
+		m[key] = value;
+	return m;
+}
+
+void save_baseline(const std::string &path, const Metrics &m) {
+	std::ofstream file(path);
+	if (!file.is_open())
+		throw std::runtime_error("Couldn't write baseline " + path);
+	for (const auto &key : {"packets_per_sec", "bytes_per_sec", "peak_rss_bytes"})
+		file << key << " " << std::fixed << m.at(key) << "\n";
+}
+
+/**
+ * @brief Compares throughput and memory against a baseline.
+ *
+ * @return number of metrics that regressed by more than tolerance
+ */
+int compare(const Metrics &current, const Metrics &baseline, double tolerance) {
+	int regressions = 0;
+	auto check = [&](const char *key, bool higher_is_better) {
+		auto it = baseline.find(key);
+		if (it == baseline.end() || it->second <= 0)
+			return;
+		double ratio = current.at(key) / it->second;
+		bool bad = higher_is_better ? ratio < 1.0 - tolerance : ratio > 1.0 + tolerance;
+		std::cerr << (bad ? "REGRESSION " : "ok         ") << key << ": " << current.at(key) << " vs baseline "
+				  << it->second << " (" << std::showpos << (ratio - 1.0) * 100.0 << std::noshowpos << "%)\n";
+		regressions += bad;
+	};
+	check("packets_per_sec", true);
+	check("bytes_per_sec", true);
+	check("peak_rss_bytes", false);
+	return regressions;
+}
+
+} // namespace
+
+/**
+ * End-to-end throughput of the --offline path without the UI.
+ *
+ * Either reads --input or generates a synthetic capture from the mix flags,
+ * runs it through PcapCapture and Stats exactly as main() does, and reports
+ * throughput, peak RSS and per-stage times as one JSON line. With
+ * --baseline the process exits non-zero when results regress or the
+ * baseline file doesn't exist.
+ */
+int main(int argc, char **argv) {
+	po::options_description desc("e2e benchmark options");
+	desc.add_options()("help,h", "Display this help message and exit")(
+		"input,i", po::value<std::string>(), "Existing pcap file to analyze (otherwise one is generated)")(
+		"packets,p", po::value<size_t>()->default_value(1000000), "Frames to generate when no --input is given")(
+		"repetitions,r", po::value<size_t>()->default_value(3), "Passes over the file, the fastest one is reported")(
+		"baseline,b", po::value<std::string>(), "Fail when results regress past this baseline file")(
+		"tolerance", po::value<double>()->default_value(0.10), "Allowed relative regression (0.10 = 10%)")(
+		"write-baseline", po::value<std::string>(), "Store the results as a new baseline file")(
+		"reader", po::value<std::string>()->default_value("mmap"), "Offline reader: mmap | libpcap")(
+		"label,l", po::value<std::string>()->default_value(""), "Free-form label stored with results")(
+		"out,o", po::value<std::string>(), "Also append the JSON line to this file");
+	add_mix_options(desc);
+
+	po::variables_map vm;
+	try {
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+		po::notify(vm);
+		if (vm.contains("help")) {
+			std::cout << desc << "\n";
+			return 0;
+		}
+
+		std::string path;
+		bool generated = !vm.contains("input");
+		if (generated) {
+			path = (std::filesystem::temp_directory_path() / "nta-e2e-bench.pcap").string();
+			write_synthetic_pcap(path, mix_from_options(vm), vm["packets"].as<size_t>());
+		} else {
+			path = vm["input"].as<std::string>();
+		}
+
+		if (PerfCounters probe; !probe.available())
+			std::cerr << "Hardware counters unavailable (" << probe.error() << "), reporting without them\n";
+
+		const auto &reader_name = vm["reader"].as<std::string>();
+		OfflineReader reader = parse_offline_reader(reader_name);
+		RunResult best;
+		for (size_t i = 0; i < std::max<size_t>(vm["repetitions"].as<size_t>(), 1); ++i) {
+			RunResult r = run_once(path, reader);
+			if (i == 0 || r.pipeline < best.pipeline)
+				best = r;
+		}
+		if (generated)
+			std::filesystem::remove(path);
+
+		Metrics metrics = to_metrics(best);
+		write_json(std::cout, metrics, vm["label"].as<std::string>(), reader_name);
+		if (vm.contains("out")) {
+			std::ofstream out(vm["out"].as<std::string>(), std::ios::app);
+			write_json(out, metrics, vm["label"].as<std::string>(), reader_name);
+		}
+
+		if (vm.contains("write-baseline"))
+			save_baseline(vm["write-baseline"].as<std::string>(), metrics);
+
+		if (vm.contains("baseline")) {
+			const auto &baseline_path = vm["baseline"].as<std::string>();
+			/* a missing baseline must not pass as "no regression", unless this run is recording one */
+			if (!std::filesystem::exists(baseline_path)) {
+				if (!vm.contains("write-baseline"))
+					throw std::runtime_error("No baseline at " + baseline_path + ", record one with --write-baseline");
+				std::cerr << "No baseline at " << baseline_path << ", skipping comparison\n";
+				return 0;
+			}
+			if (compare(metrics, load_baseline(baseline_path), vm["tolerance"].as<double>()) > 0)
+				return 2;
+		}
+	} catch (const std::exception &e) {
+		std::cerr << "e2e_bench: " << e.what() << "\n";
+		return 1;
+	}
+	return 0;
+}
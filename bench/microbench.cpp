@@ -0,0 +1,268 @@
+#include "../include/TUI/view.hpp"
+#include "../include/cli/displayFilter.hpp"
+#include "../include/packet/IP.hpp"
+#include "../include/stats/protocolStats.hpp"
+#include "benchUtil.hpp"
+#include "synthetic.hpp"
+
+#include <boost/program_options.hpp>
+#include <net/ethernet.h>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+
+namespace po = boost::program_options;
+
+namespace {
+
+constexpr size_t ETH_LEN = 14;
+/* packet time of the synthetic packets: BENCH_SECONDS from a fixed start, so every run has the same timeline */
+constexpr uint64_t BENCH_START_NS = 1700000000ull * 1000000000ull;
+constexpr uint64_t BENCH_SECONDS = 30;
+
+struct Scenario {
+	std::string name;
+	TrafficMix mix;
+};
+
+struct DecodedPacket {
+	Packet packet;
+	const uint8_t *payload;
+};
+
+/* mirrors PcapCapture::got_packet for Ethernet frames */
+std::optional<DecodedPacket> decode(const std::vector<uint8_t> &frame) {
+	uint16_t ether_type = static_cast<uint16_t>(frame[12] << 8 | frame[13]);
+	if (ether_type == ETHERTYPE_IP) {
+		IPv4 ip(frame.data() + ETH_LEN, frame.size() - ETH_LEN);
+		if (!ip.valid())
+			return std::nullopt;
+		DecodedPacket d{Packet(v4, ip.get_protocol(), ip.get_source(), ip.get_dest(), ip.get_src_port(),
+								ip.get_dest_port(), static_cast<uint32_t>(frame.size()), ip.get_payload_len(),
+								ip.get_payload_ptr()),
+						 ip.get_payload_ptr()};
+		d.packet.src_addr = ip.get_source_addr();
+		d.packet.dst_addr = ip.get_dest_addr();
+		return d;
+	}
+	if (ether_type == ETHERTYPE_IPV6) {
+		IPv6 ip(frame.data() + ETH_LEN, frame.size() - ETH_LEN);
+		if (!ip.valid())
+			return std::nullopt;
+		DecodedPacket d{Packet(v6, ip.get_protocol(), ip.get_source(), ip.get_dest(), ip.get_src_port(),
+								ip.get_dest_port(), static_cast<uint32_t>(frame.size()), ip.get_payload_len(),
+								ip.get_payload_ptr()),
+						 ip.get_payload_ptr()};
+		d.packet.src_addr = ip.get_source_addr();
+		d.packet.dst_addr = ip.get_dest_addr();
+		return d;
+	}
+	return std::nullopt;
+}
+
+class Runner {
+  private:
+	size_t repetitions;
+	std::string filter;
+	std::string label;
+	std::ostream &out;
+
+	bool enabled(const std::string &name) const { return filter.empty() || name.find(filter) != std::string::npos; }
+	void report(const BenchResult &r) {
+		write_json_line(out, r, label);
+		out.flush();
+	}
+
+  public:
+	Runner(size_t repetitions, std::string filter, std::string label, std::ostream &out)
+		: repetitions(repetitions), filter(std::move(filter)), label(std::move(label)), out(out) {}
+
+	void run(const Scenario &sc, size_t count);
+};
+
+void Runner::run(const Scenario &sc, size_t count) {
+	auto noop = [] {};
+	TrafficGenerator gen(sc.mix);
+	auto frames = gen.generate(count);
+
+	std::vector<const std::vector<uint8_t> *> v4_frames, v6_frames;
+	for (const auto &f : frames)
+		(f[12] == 0x86 ? v6_frames : v4_frames).push_back(&f);
+
+	if (enabled("parse_ipv4") && !v4_frames.empty()) {
+		report(measure("parse_ipv4", sc.name, v4_frames.size(), repetitions, noop, [&] {
+			for (const auto *f : v4_frames) {
+				IPv4 ip(f->data() + ETH_LEN, f->size() - ETH_LEN);
+				do_not_optimize(ip);
+			}
+		}));
+	}
+	if (enabled("parse_ipv6") && !v6_frames.empty()) {
+		report(measure("parse_ipv6", sc.name, v6_frames.size(), repetitions, noop, [&] {
+			for (const auto *f : v6_frames) {
+				IPv6 ip(f->data() + ETH_LEN, f->size() - ETH_LEN);
+				do_not_optimize(ip);
+			}
+		}));
+	}
+
+	std::vector<Packet> packets;
+	std::vector<const uint8_t *> payloads;
+	packets.reserve(frames.size());
+	for (const auto &f : frames) {
+		if (auto d = decode(f)) {
+			packets.push_back(d->packet);
+			payloads.push_back(d->payload);
+		}
+	}
+	for (size_t i = 0; i < packets.size(); ++i)
+		packets[i].ts_ns = BENCH_START_NS + i * BENCH_SECONDS * 1000000000ull / packets.size();
+
+	if (enabled("classify")) {
+		/* the constructor drops payload_ptr, restore it so signature matching is exercised */
+		for (size_t i = 0; i < packets.size(); ++i)
+			packets[i].payload_ptr = payloads[i];
+		report(measure("classify", sc.name, packets.size(), repetitions, noop, [&] {
+			for (const auto &p : packets)
+				do_not_optimize(p.get_application_protocol());
+		}));
+		for (auto &p : packets)
+			p.payload_ptr = nullptr;
+	}
+
+	if (enabled("display_filter")) {
+		DisplayFilter filter = DisplayFilter::compile("tcp and (port 443 or dst 10.0.0.0/8) and not app dns");
+		report(measure("display_filter", sc.name, packets.size(), repetitions, noop, [&] {
+			for (const auto &p : packets)
+				do_not_optimize(filter.match(p));
+		}));
+	}
+
+	std::unique_ptr<Stats> stats;
+	auto fresh_stats = [&] { stats = std::make_unique<Stats>(); };
+	if (enabled("add_packet")) {
+		report(measure("add_packet", sc.name, packets.size(), repetitions, fresh_stats, [&] {
+			for (const auto &p : packets)
+				stats->add_packet(p);
+		}));
+	}
+
+	/*
+	 * update_* and render work on a fully populated engine; the detectors
+	 * are tuned to fire on the synthetic traffic so their tables have rows
+	 */
+	fresh_stats();
+	auto networks = std::make_shared<PrefixTable>();
+	for (int i = 0; i < 256; ++i)
+		networks->insert("10." + std::to_string(i) + ".0.0/16", "net" + std::to_string(i));
+	networks->insert("fd00::/8", "net6");
+	networks->build();
+	stats->set_networks(networks);
+	AnomalyOptions anomaly;
+	anomaly.warmup = 2;
+	anomaly.threshold = 1.0;
+	anomaly.cooldown = 0;
+	anomaly.min_rate = {0, 0, 0, 0};
+	stats->enable_anomaly_detection(anomaly);
+	ScanOptions scans;
+	scans.window = std::chrono::seconds(1);
+	scans.port_threshold = 2;
+	scans.host_threshold = 2;
+	scans.cooldown = 0;
+	stats->enable_scan_detection(scans);
+	for (const auto &p : packets) {
+		stats->add_packet(p);
+		stats->push(p);
+	}
+
+	auto bench_update = [&](const std::string &name, auto &&fn) {
+		if (enabled(name))
+			report(measure(name, sc.name, 1, repetitions, noop, fn));
+	};
+	bench_update("update_transport_stats", [&] { stats->update_transport_stats(); });
+	bench_update("update_application_stats", [&] { stats->update_application_stats(); });
+	bench_update("update_ip_stats", [&] { stats->update_ip_stats(); });
+	bench_update("update_pairs", [&] { stats->update_pairs(); });
+	bench_update("update_ports", [&] { stats->update_ports(); });
+	bench_update("update_networks", [&] { stats->update_networks(); });
+	bench_update("update_packets", [&] { stats->update_packets(); });
+	bench_update("update_alerts", [&] { stats->update_alerts(); });
+	bench_update("update_scans", [&] { stats->update_scans(); });
+	bench_update("bandwidth_from_timeline", [&] { stats->bandwidth_from_timeline(); });
+
+	if (enabled("get_snapshot")) {
+		report(measure("get_snapshot", sc.name, 1, repetitions, noop, [&] { do_not_optimize(stats->get_snapshot()); }));
+	}
+
+	if (enabled("view_render")) {
+		stats->update_packets();
+		stats->update_application_stats();
+		stats->update_transport_stats();
+		stats->update_ip_stats();
+		stats->update_pairs();
+		stats->bandwidth_from_timeline();
+		StatsSnapshot snapshot = stats->get_snapshot();
+		View view;
+		report(measure("view_render", sc.name, 1, repetitions, noop, [&] {
+			do_not_optimize(view.render(snapshot, "bench0", "", DisplayStatus{}, false, std::chrono::seconds(0)));
+		}));
+	}
+}
+
+} // namespace
+
+/**
+ * Microbenchmarks for the parser, classifier and Stats hot paths.
+ *
+ * Each benchmark prints one JSON object per line so that runs from
+ * different commits can be diffed or loaded into a notebook.
+ */
+int main(int argc, char **argv) {
+	po::options_description desc("Microbenchmark options");
+	desc.add_options()("help,h", "Display this help message and exit")(
+		"packets,p", po::value<size_t>()->default_value(200000), "Synthetic packets per scenario")(
+		"repetitions,r", po::value<size_t>()->default_value(7), "Repetitions per benchmark (median is reported)")(
+		"filter,f", po::value<std::string>()->default_value(""), "Only run benchmarks whose name contains this")(
+		"scenario,s", po::value<std::string>()->default_value(""), "Only run this scenario (low | medium | high)")(
+		"label,l", po::value<std::string>()->default_value(""), "Free-form label stored with results, e.g. a commit")(
+		"out,o", po::value<std::string>(), "Write JSON lines to this file instead of stdout");
+
+	po::variables_map vm;
+	po::store(po::parse_command_line(argc, argv, desc), vm);
+	po::notify(vm);
+	if (vm.contains("help")) {
+		std::cout << desc << "\n";
+		return 0;
+	}
+
+	/* cardinality levels: few hot hosts, a typical LAN, and a scan-like spread */
+	std::vector<Scenario> scenarios(3);
+	scenarios[0].name = "low";
+	scenarios[0].mix.hosts = 16;
+	scenarios[0].mix.flows = 64;
+	scenarios[1].name = "medium";
+	scenarios[1].mix.hosts = 1024;
+	scenarios[1].mix.flows = 8192;
+	scenarios[2].name = "high";
+	scenarios[2].mix.hosts = 65536;
+	scenarios[2].mix.flows = 131072;
+
+	std::ofstream file;
+	if (vm.contains("out")) {
+		file.open(vm["out"].as<std::string>());
+		if (!file.is_open()) {
+			std::cerr << "Couldn't open " << vm["out"].as<std::string>() << "\n";
+			return 1;
+		}
+	}
+	std::ostream &out = file.is_open() ? file : std::cout;
+
+	Runner runner(vm["repetitions"].as<size_t>(), vm["filter"].as<std::string>(), vm["label"].as<std::string>(), out);
+	const auto &only = vm["scenario"].as<std::string>();
+	for (const auto &sc : scenarios) {
+		if (only.empty() || only == sc.name)
+			runner.run(sc, vm["packets"].as<size_t>());
+	}
+	return 0;
+}
@@ -0,0 +1,41 @@
+#ifndef MIXOPTIONS_HPP
+#define MIXOPTIONS_HPP
+
+#include "synthetic.hpp"
+#include <boost/program_options.hpp>
+
+/* command line flags shared by every tool that builds a TrafficMix */
+inline void add_mix_options(boost::program_options::options_description &desc) {
+	namespace po = boost::program_options;
+	TrafficMix d;
+	desc.add_options()("hosts", po::value<size_t>()->default_value(d.hosts), "Distinct addresses per IP family")(
+		"flows", po::value<size_t>()->default_value(d.flows), "Distinct flows (src/dst/proto/ports)")(
+		"v6-ratio", po::value<double>()->default_value(d.v6_ratio), "Fraction of IPv6 flows")(
+		"tcp-ratio", po::value<double>()->default_value(d.tcp_ratio), "Relative weight of TCP flows")(
+		"udp-ratio", po::value<double>()->default_value(d.udp_ratio), "Relative weight of UDP flows")(
+		"icmp-ratio", po::value<double>()->default_value(d.icmp_ratio), "Relative weight of ICMP flows")(
+		"signature-ratio", po::value<double>()->default_value(d.signature_ratio),
+		"Fraction of TCP/UDP flows with an HTTP/TLS/DNS payload signature")(
+		"sizes", po::value<std::string>()->default_value("imix"), "Frame size distribution: fixed | uniform | imix")(
+		"min-size", po::value<uint16_t>()->default_value(d.min_size), "Smallest frame in bytes")(
+		"max-size", po::value<uint16_t>()->default_value(d.max_size), "Largest frame in bytes")(
+		"seed", po::value<uint64_t>()->default_value(d.seed), "Generator seed");
+}
+
+inline TrafficMix mix_from_options(const boost::program_options::variables_map &vm) {
+	TrafficMix mix;
+	mix.hosts = vm["hosts"].as<size_t>();
+	mix.flows = vm["flows"].as<size_t>();
+	mix.v6_ratio = vm["v6-ratio"].as<double>();
+	mix.tcp_ratio = vm["tcp-ratio"].as<double>();
+	mix.udp_ratio = vm["udp-ratio"].as<double>();
+	mix.icmp_ratio = vm["icmp-ratio"].as<double>();
+	mix.signature_ratio = vm["signature-ratio"].as<double>();
+	mix.sizes = parse_size_distribution(vm["sizes"].as<std::string>());
+	mix.min_size = vm["min-size"].as<uint16_t>();
+	mix.max_size = vm["max-size"].as<uint16_t>();
+	mix.seed = vm["seed"].as<uint64_t>();
+	return mix;
+}
+
+#endif // MIXOPTIONS_HPP
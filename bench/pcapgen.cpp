@@ -0,0 +1,41 @@
+#include "mixOptions.hpp"
+#include "synthetic.hpp"
+
+#include <iostream>
+
+namespace po = boost::program_options;
+
+/**
+ * Writes a synthetic Ethernet pcap file with a configurable packet mix.
+ *
+ * Output is deterministic for a given set of flags, so files can be
+ * regenerated on any machine instead of being checked in.
+ */
+int main(int argc, char **argv) {
+	po::options_description desc("pcapgen options");
+	desc.add_options()("help,h", "Display this help message and exit")(
+		"out,o", po::value<std::string>()->required(), "Output pcap file")(
+		"packets,p", po::value<size_t>()->default_value(1000000), "Number of frames to write")(
+		"pps", po::value<double>()->default_value(100000.0), "Packet rate used to space timestamps");
+	add_mix_options(desc);
+
+	po::variables_map vm;
+	try {
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+		if (vm.contains("help")) {
+			std::cout << desc << "\n";
+			return 0;
+		}
+		po::notify(vm);
+
+		size_t packets = vm["packets"].as<size_t>();
+		uint64_t bytes = write_synthetic_pcap(vm["out"].as<std::string>(), mix_from_options(vm), packets,
+											  vm["pps"].as<double>());
+		std::cout << "wrote " << packets << " packets (" << bytes << " bytes) to " << vm["out"].as<std::string>()
+				  << "\n";
+	} catch (const std::exception &e) {
+		std::cerr << "pcapgen: " << e.what() << "\n";
+		return 1;
+	}
+	return 0;
+}
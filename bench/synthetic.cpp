@@ -0,0 +1,214 @@
+#include "synthetic.hpp"
+#include "../include/capture/pcapFormat.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <netinet/in.h>
+#include <stdexcept>
+
+namespace {
+
+constexpr size_t ETH_LEN = 14;
+constexpr size_t IPV4_LEN = 20;
+constexpr size_t IPV6_LEN = 40;
+constexpr size_t TCP_LEN = 20;
+constexpr size_t UDP_LEN = 8;
+constexpr size_t ICMP_LEN = 8;
+
+void put16(uint8_t *p, uint16_t v) {
+	p[0] = static_cast<uint8_t>(v >> 8);
+	p[1] = static_cast<uint8_t>(v);
+}
+
+void put32(uint8_t *p, uint32_t v) {
+	put16(p, static_cast<uint16_t>(v >> 16));
+	put16(p + 2, static_cast<uint16_t>(v));
+}
+
+/* 10.0.0.0/8 for v4 hosts, fd00::/8 for v6 hosts */
+void write_v4_addr(uint8_t *p, uint32_t host) { put32(p, 0x0A000000u + (host % 0xFFFFFEu) + 1); }
+
+void write_v6_addr(uint8_t *p, uint32_t host) {
+	memset(p, 0, 16);
+	p[0] = 0xfd;
+	put32(p + 12, host + 1);
+}
+
+} // namespace
+
+SizeDistribution parse_size_distribution(const std::string &name) {
+	if (name == "fixed")
+		return SizeDistribution::FIXED;
+	if (name == "uniform")
+		return SizeDistribution::UNIFORM;
+	if (name == "imix")
+		return SizeDistribution::IMIX;
+	throw std::invalid_argument("Unknown size distribution: '" + name + "' (expected fixed | uniform | imix)");
+}
+
+TrafficGenerator::TrafficGenerator(const TrafficMix &mix) : mix(mix), rng(mix.seed) {
+	if (mix.hosts == 0 || mix.flows == 0)
+		throw std::invalid_argument("Traffic mix needs at least one host and one flow");
+
+	std::uniform_real_distribution<double> unit(0.0, 1.0);
+	std::uniform_int_distribution<uint32_t> host(0, static_cast<uint32_t>(mix.hosts - 1));
+	std::uniform_int_distribution<uint16_t> ephemeral(32768, 60999);
+
+	const double proto_total = mix.tcp_ratio + mix.udp_ratio + mix.icmp_ratio;
+	static constexpr uint16_t tcp_ports[] = {21, 22, 25, 80, 443, 8080};
+	static constexpr uint16_t udp_ports[] = {53, 123, 443, 5353};
+
+	flows.reserve(mix.flows);
+	for (size_t i = 0; i < mix.flows; ++i) {
+		Flow f{};
+		f.v6 = unit(rng) < mix.v6_ratio;
+		f.src_host = host(rng);
+		f.dst_host = host(rng);
+		f.src_port = ephemeral(rng);
+
+		double p = unit(rng) * proto_total;
+		if (p < mix.tcp_ratio)
+			f.proto = IPPROTO_TCP;
+		else if (p < mix.tcp_ratio + mix.udp_ratio)
+			f.proto = IPPROTO_UDP;
+		else
+			f.proto = f.v6 ? uint8_t{IPPROTO_ICMPV6} : uint8_t{IPPROTO_ICMP};
+
+		f.signature = f.proto != IPPROTO_ICMP && f.proto != IPPROTO_ICMPV6 && unit(rng) < mix.signature_ratio;
+		if (f.proto == IPPROTO_TCP)
+			f.dst_port = f.signature ? (unit(rng) < 0.5 ? 80 : 443) : tcp_ports[rng() % std::size(tcp_ports)];
+		else if (f.proto == IPPROTO_UDP)
+			f.dst_port = f.signature ? 53 : udp_ports[rng() % std::size(udp_ports)];
+		flows.push_back(f);
+	}
+}
+
+uint16_t TrafficGenerator::next_size() {
+	switch (mix.sizes) {
+	case SizeDistribution::FIXED:
+		return mix.max_size;
+	case SizeDistribution::UNIFORM:
+		return std::uniform_int_distribution<uint16_t>(mix.min_size, mix.max_size)(rng);
+	case SizeDistribution::IMIX: {
+		uint64_t r = rng() % 12;
+		uint16_t size = r < 7 ? 64 : (r < 11 ? 576 : 1500);
+		return std::clamp(size, mix.min_size, mix.max_size);
+	}
+	}
+	return mix.max_size;
+}
+
+void TrafficGenerator::write_payload(const Flow &flow, uint8_t *payload, size_t len) {
+	memset(payload, 0xab, len);
+	if (!flow.signature)
+		return;
+
+	if (flow.proto == IPPROTO_TCP && flow.dst_port == 80) {
+		static constexpr char request[] = "GET / HTTP/1.1\r\n";
+		memcpy(payload, request, std::min(len, sizeof(request) - 1));
+	} else if (flow.proto == IPPROTO_TCP && len >= 3) {
+		/* TLS handshake record header */
+		payload[0] = 0x16;
+		payload[1] = 0x03;
+		payload[2] = 0x01;
+	} else if (flow.proto == IPPROTO_UDP && len >= 12) {
+		/* DNS header: one question, recursion desired */
+		memset(payload, 0, 12);
+		put16(payload, static_cast<uint16_t>(rng()));
+		put16(payload + 2, 0x0100);
+		put16(payload + 4, 1);
+	}
+}
+
+void TrafficGenerator::next(std::vector<uint8_t> &out) {
+	const Flow &flow = flows[rng() % flows.size()];
+
+	size_t ip_len = flow.v6 ? IPV6_LEN : IPV4_LEN;
+	size_t l4_len = flow.proto == IPPROTO_TCP ? TCP_LEN : (flow.proto == IPPROTO_UDP ? UDP_LEN : ICMP_LEN);
+	size_t headers = ETH_LEN + ip_len + l4_len;
+	size_t frame_len = std::max<size_t>(next_size(), headers);
+
+	out.assign(frame_len, 0);
+	uint8_t *p = out.data();
+
+	/* Ethernet */
+	static constexpr uint8_t dst_mac[] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+	static constexpr uint8_t src_mac[] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x02};
+	memcpy(p, dst_mac, 6);
+	memcpy(p + 6, src_mac, 6);
+	put16(p + 12, flow.v6 ? 0x86dd : 0x0800);
+
+	uint8_t *ip = p + ETH_LEN;
+	if (flow.v6) {
+		ip[0] = 0x60;
+		put16(ip + 4, static_cast<uint16_t>(frame_len - ETH_LEN - IPV6_LEN));
+		ip[6] = flow.proto;
+		ip[7] = 64;
+		write_v6_addr(ip + 8, flow.src_host);
+		write_v6_addr(ip + 24, flow.dst_host);
+	} else {
+		ip[0] = 0x45;
+		put16(ip + 2, static_cast<uint16_t>(frame_len - ETH_LEN));
+		ip[8] = 64;
+		ip[9] = flow.proto;
+		write_v4_addr(ip + 12, flow.src_host);
+		write_v4_addr(ip + 16, flow.dst_host);
+	}
+
+	uint8_t *l4 = ip + ip_len;
+	if (flow.proto == IPPROTO_TCP) {
+		put16(l4, flow.src_port);
+		put16(l4 + 2, flow.dst_port);
+		put32(l4 + 4, static_cast<uint32_t>(rng()));
+		l4[12] = 5 << 4;
+		l4[13] = 0x18; // PSH | ACK
+		put16(l4 + 14, 65535);
+	} else if (flow.proto == IPPROTO_UDP) {
+		put16(l4, flow.src_port);
+		put16(l4 + 2, flow.dst_port);
+		put16(l4 + 4, static_cast<uint16_t>(frame_len - ETH_LEN - ip_len));
+	} else {
+		l4[0] = flow.v6 ? 128 : 8; // echo request
+	}
+
+	write_payload(flow, l4 + l4_len, frame_len - headers);
+}
+
+std::vector<std::vector<uint8_t>> TrafficGenerator::generate(size_t count) {
+	std::vector<std::vector<uint8_t>> frames(count);
+	for (auto &frame : frames)
+		next(frame);
+	return frames;
+}
+
+uint64_t write_synthetic_pcap(const std::string &path, const TrafficMix &mix, size_t count, double pps) {
+	std::unique_ptr<FILE, decltype(&fclose)> file(fopen(path.c_str(), "wb"), &fclose);
+	if (!file)
+		throw std::runtime_error("Couldn't create " + path);
+	setvbuf(file.get(), nullptr, _IOFBF, 1 << 20);
+
+	SavefileHeader header = make_savefile_header(1 /* DLT_EN10MB */, 65535, true);
+	fwrite(&header, sizeof(header), 1, file.get());
+
+	TrafficGenerator gen(mix);
+	std::vector<uint8_t> frame;
+	const uint64_t start_ns = 1700000000ull * 1000000000ull;
+	const double step_ns = pps > 0 ? 1e9 / pps : 0;
+	uint64_t bytes = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		gen.next(frame);
+		uint64_t ts = start_ns + static_cast<uint64_t>(i * step_ns);
+		SavefileRecord rec{static_cast<uint32_t>(ts / 1000000000ull), static_cast<uint32_t>(ts % 1000000000ull),
+						   static_cast<uint32_t>(frame.size()), static_cast<uint32_t>(frame.size())};
+		fwrite(&rec, sizeof(rec), 1, file.get());
+		fwrite(frame.data(), 1, frame.size(), file.get());
+		bytes += frame.size();
+	}
+	if (ferror(file.get()))
+		throw std::runtime_error("Write error on " + path);
+	return bytes;
+}
@@ -0,0 +1,90 @@
+#ifndef SYNTHETIC_HPP
+#define SYNTHETIC_HPP
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+/* frame size model used by the generator */
+enum class SizeDistribution {
+	FIXED,	 // every frame is max_size bytes
+	UNIFORM, // uniform in [min_size, max_size]
+	IMIX,	 // classic 7:4:1 mix of 64 / 576 / 1500 byte frames
+};
+
+/**
+ * @brief Describes a synthetic packet mix.
+ *
+ * Cardinality is controlled separately for addresses (hosts),
+ * 5-tuples (flows) and transport protocols (ratios), so a benchmark
+ * can stress hash tables independently of the classifier.
+ */
+struct TrafficMix {
+	/* distinct addresses per IP family */
+	size_t hosts = 256;
+	/* distinct flows, each flow is a fixed src/dst/proto/ports tuple */
+	size_t flows = 1024;
+
+	double v6_ratio = 0.2;
+	double tcp_ratio = 0.7;
+	double udp_ratio = 0.25;
+	double icmp_ratio = 0.05;
+
+	/* fraction of TCP/UDP payloads starting with an HTTP/TLS/DNS signature */
+	double signature_ratio = 0.3;
+
+	SizeDistribution sizes = SizeDistribution::IMIX;
+	uint16_t min_size = 64;
+	uint16_t max_size = 1514;
+
+	uint64_t seed = 42;
+};
+
+SizeDistribution parse_size_distribution(const std::string &name);
+
+/**
+ * @brief Deterministic generator of raw Ethernet frames.
+ *
+ * Frames carry a valid Ethernet/IPv4|IPv6/TCP|UDP|ICMP header chain
+ * that the analyzer parsers accept. Checksums are left zeroed.
+ */
+class TrafficGenerator {
+  private:
+	struct Flow {
+		bool v6;
+		uint8_t proto;
+		uint32_t src_host;
+		uint32_t dst_host;
+		uint16_t src_port;
+		uint16_t dst_port;
+		bool signature;
+	};
+
+	TrafficMix mix;
+	std::mt19937_64 rng;
+	std::vector<Flow> flows;
+
+	uint16_t next_size();
+	void write_payload(const Flow &flow, uint8_t *payload, size_t len);
+
+  public:
+	explicit TrafficGenerator(const TrafficMix &mix);
+
+	/* writes the next frame into out (resized to the frame length) */
+	void next(std::vector<uint8_t> &out);
+	/* generates count frames in one go */
+	std::vector<std::vector<uint8_t>> generate(size_t count);
+};
+
+/**
+ * @brief Writes count generated frames to a classic Ethernet pcap file.
+ *
+ * Timestamps start at a fixed epoch and are spaced 1/pps apart so that
+ * repeated runs produce byte-identical files.
+ *
+ * @return total number of frame bytes written
+ */
+uint64_t write_synthetic_pcap(const std::string &path, const TrafficMix &mix, size_t count, double pps = 100000.0);
+
+#endif // SYNTHETIC_HPP
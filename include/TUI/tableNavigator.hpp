@@ -0,0 +1,37 @@
+#ifndef TABLENAVIGATOR_HPP
+#define TABLENAVIGATOR_HPP
+
+#include "../stats/protocolStats.hpp"
+#include <ftxui/component/event.hpp>
+#include <mutex>
+
+/**
+ * @brief Sort order and scroll position of the snapshot tables.
+ *
+ * Keys act on the focused table: Tab / Shift-Tab move the focus, 's'
+ * cycles the sort column, 'o' flips the order, arrows scroll one row,
+ * PageUp / PageDown one window, Home / End jump to either end. The views
+ * are handed to the Stats::update_* calls, which only build the visible
+ * window. Called from the UI and the update thread, hence the lock.
+ */
+class TableNavigator {
+  public:
+	/* initial --sort / --order for every table, throws std::invalid_argument for unknown names */
+	TableNavigator(const std::string &sort, const std::string &order, size_t page);
+
+	/* false if e isn't a table key */
+	bool handle(const ftxui::Event &e);
+	TableView view(SnapshotTable table) const;
+	SnapshotTable focus() const;
+	/* row and column counts of the last frame, to clamp scrolling and skip tables that aren't shown */
+	void update(const StatsSnapshot &data);
+
+  private:
+	mutable std::mutex mtx;
+	std::array<TableView, SNAPSHOT_TABLES> views;
+	std::array<size_t, SNAPSHOT_TABLES> totals{};
+	std::array<size_t, SNAPSHOT_TABLES> columns{};
+	size_t focused = static_cast<size_t>(SnapshotTable::IPS);
+};
+
+#endif // TABLENAVIGATOR_HPP
@@ -3,21 +3,52 @@
 #include "../stats/protocolStats.hpp"
 #include <ftxui/dom/elements.hpp>
 
+/* state of the display filter line in the header */
+struct DisplayStatus {
+	/* active expression, empty when every packet is shown */
+	std::string expression;
+	/* set while the user types a new expression */
+	bool editing = false;
+	std::string input;
+	/* why the last expression was rejected */
+	std::string error;
+};
+
 class View {
   public:
+	/* table the navigation keys act on, highlighted in its title */
+	void set_focus(SnapshotTable table) { focus = table; }
+	/* toggles the pipeline latency panel */
+	void show_latency(bool on) { latency_visible = on; }
+
 	ftxui::Element render(const StatsSnapshot &data, const std::string &interface, const std::string &filter,
-						  bool capture_finished, std::chrono::seconds timer);
+						  const DisplayStatus &display, bool capture_finished, std::chrono::seconds timer);
 
   private:
-	ftxui::Element render_header(const StatsSnapshot &data, const std::string &interface, const std::string &filter);
+	ftxui::Element render_header(const StatsSnapshot &data, const std::string &interface, const std::string &filter,
+								 const DisplayStatus &display);
+	ftxui::Element render_display_filter(const DisplayStatus &display);
 	ftxui::Element render_stats(const StatsSnapshot &data);
 
+	SnapshotTable focus = SnapshotTable::IPS;
+	bool latency_visible = false;
+	/* one window of a snapshot table, titled with its position and sort order */
+	ftxui::Element render_table(const std::string &title, std::vector<std::vector<std::string>> rows,
+								const StatsSnapshot &data, SnapshotTable table);
+
 	ftxui::Element render_transport(const StatsSnapshot &data);
 	ftxui::Element render_application(const StatsSnapshot &data);
 	ftxui::Element render_ip(const StatsSnapshot &data);
+	ftxui::Element render_ports(const StatsSnapshot &data);
+	ftxui::Element render_networks(const StatsSnapshot &data);
+	ftxui::Element render_interfaces(const StatsSnapshot &data);
 	ftxui::Element render_pairs(const StatsSnapshot &data);
 	ftxui::Element render_bandwidth(const StatsSnapshot &data);
 	ftxui::Element render_packets(const StatsSnapshot &data);
+	ftxui::Element render_alerts(const StatsSnapshot &data);
+	ftxui::Element render_scans(const StatsSnapshot &data);
+	ftxui::Element render_latency(const StatsSnapshot &data);
+	ftxui::Element render_perf(const StatsSnapshot &data);
 
 	ftxui::Element render_footer(bool capture_finished, std::chrono::seconds timer);
 };
@@ -0,0 +1,137 @@
+#ifndef CAPTUREFILE_HPP
+#define CAPTUREFILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * One captured frame as found in a capture file.
+ *
+ * data points into the caller's buffer (usually a file mapping),
+ * nothing is copied. The timestamp is normalized to nanoseconds.
+ */
+struct CaptureRecord {
+	uint64_t ts_ns;
+	uint32_t caplen;
+	uint32_t len;
+	int linktype;
+	const uint8_t *data;
+	/* start of the enclosing pcap record / pcapng block */
+	const uint8_t *block;
+};
+
+/**
+ * @brief Incremental in-place parser for pcap and pcapng streams.
+ *
+ * Works on whatever contiguous bytes it is given and never copies
+ * packet data: every complete record is reported with a pointer into
+ * the input. Incomplete trailing blocks are left unconsumed so the
+ * caller can extend the buffer and call parse() again.
+ *
+ * Supports:
+ *  - classic pcap, both byte orders, micro- and nanosecond magic
+ *  - pcapng sections of either byte order, multiple interfaces,
+ *    if_tsresol / if_tsoffset, enhanced, simple and obsolete packet blocks
+ */
+class CaptureParser {
+  public:
+	/* return false to stop parsing after this record */
+	using Handler = bool (*)(void *user, const CaptureRecord &record);
+
+	/* true if data starts with a pcap or pcapng magic number */
+	static bool recognizes(const uint8_t *data, size_t len);
+
+	/**
+	 * Parses complete blocks from data.
+	 *
+	 * @return bytes consumed; stops early at an incomplete block or when
+	 *         the handler asks to stop (see stopped()).
+	 * Throws std::runtime_error on malformed input.
+	 */
+	size_t parse(const uint8_t *data, size_t len, Handler handler, void *user);
+
+	/* size of the block starting at data, 0 while its header is incomplete */
+	size_t next_block_size(const uint8_t *data, size_t len) const;
+
+	bool stopped() const { return stop; }
+	uint64_t records() const { return delivered; }
+	/* file headers, section and interface blocks seen so far */
+	uint64_t context_blocks() const { return contexts; }
+
+  private:
+	enum class Format { UNKNOWN, PCAP, PCAPNG };
+
+	struct Interface {
+		int linktype;
+		/* timestamp units: 10^-exp or 2^-exp seconds */
+		bool binary_resol;
+		uint8_t resol_exp;
+		int64_t offset_sec;
+	};
+
+	Format format = Format::UNKNOWN;
+	bool swapped = false;
+	bool nanosecond = false;
+	int linktype = 0;
+	std::vector<Interface> interfaces;
+	bool stop = false;
+	uint64_t delivered = 0;
+	uint64_t contexts = 0;
+
+	uint16_t rd16(const uint8_t *p) const;
+	uint32_t rd32(const uint8_t *p) const;
+
+	void parse_pcap_header(const uint8_t *block);
+	void parse_section_header(const uint8_t *block);
+	void parse_interface(const uint8_t *block, size_t size);
+	bool parse_pcapng_block(const uint8_t *block, size_t size, CaptureRecord &record);
+	uint64_t to_ns(const Interface &itf, uint64_t ts) const;
+};
+
+/**
+ * @brief Read-only memory mapping of a capture file.
+ *
+ * Mapped with sequential-access hints. Pages already consumed can be
+ * dropped with release_before() so files larger than RAM stream
+ * through without pinning the page cache.
+ */
+class MappedFile {
+  private:
+	int fd = -1;
+	const uint8_t *base = nullptr;
+	size_t length = 0;
+	/* pages below this offset were already dropped */
+	mutable size_t released = 0;
+
+  public:
+	explicit MappedFile(const std::string &path);
+	~MappedFile();
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	const uint8_t *data() const { return base; }
+	size_t size() const { return length; }
+
+	/* hint the kernel to read ahead [offset, offset + len) */
+	void prefetch(size_t offset, size_t len) const;
+	/* drop the mapped pages before offset */
+	void release_before(size_t offset) const;
+};
+
+/**
+ * @brief Feeds every record of a mapped capture file to handler.
+ *
+ * Walks [begin, end) of the mapping in fixed windows, prefetching the
+ * next one and releasing the consumed one. begin must be a block
+ * boundary and the parser must already know the file's format unless
+ * begin is 0.
+ *
+ * @return offset reached, less than end if the file is truncated
+ *         or the handler stopped early
+ */
+uint64_t read_mapped_capture(const MappedFile &file, CaptureParser &parser, CaptureParser::Handler handler,
+							 void *user, size_t begin = 0, size_t end = SIZE_MAX);
+
+#endif // CAPTUREFILE_HPP
@@ -0,0 +1,102 @@
+#ifndef CAPTUREWRITER_HPP
+#define CAPTUREWRITER_HPP
+
+#include "../util/boundedQueue.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <pcap/pcap.h>
+#include <string>
+#include <thread>
+
+struct CaptureWriterOptions {
+	/* output file; with rotation files are numbered, dump.pcap -> dump-000000.pcap, dump-000001.pcap... */
+	std::string path;
+	/* start a new file before this size is exceeded, 0 = never */
+	uint64_t rotate_bytes = 0;
+	/* start a new file after this much packet time, 0 = never */
+	std::chrono::seconds rotate_age{0};
+	/* keep only the newest files, older ones are deleted, 0 = keep all */
+	size_t max_files = 0;
+	/* size of one write buffer, rounded up to the page size */
+	size_t buffer_bytes = 4u << 20;
+	/* buffers in flight between the capture and the writer thread */
+	size_t buffers = 8;
+};
+
+/**
+ * @brief Writes captured frames to (rotating) pcap files.
+ *
+ * write() runs on the capture thread and only copies the frame into the
+ * current page-aligned buffer. Full buffers, buffers holding more than a
+ * second of packet time and the last one on close() are handed to a
+ * writer thread which issues one large write() per buffer. If every
+ * buffer is still waiting for the disk the frame is dropped and counted,
+ * so the capture loop never waits on I/O.
+ *
+ * Rotation is decided on the capture side, on packet boundaries, and
+ * travels with the buffer that starts the new file. A change of link
+ * type also starts a new file since a savefile has only one.
+ */
+class CaptureWriter {
+  private:
+	struct Buffer {
+		std::unique_ptr<uint8_t, decltype(&std::free)> data{nullptr, &std::free};
+		size_t size = 0;
+		/* the writer starts a new file before writing this buffer */
+		bool new_file = false;
+		int linktype = -1;
+	};
+
+	CaptureWriterOptions opts;
+	size_t capacity = 0;
+
+	BoundedQueue<Buffer> ready;
+	BoundedQueue<Buffer> spare;
+	std::thread writer;
+
+	/* capture thread state */
+	Buffer current;
+	uint64_t buffer_start_ns = 0;
+	uint64_t file_bytes = 0;
+	uint64_t file_start_ns = 0;
+	int file_linktype = -1;
+	std::atomic<uint64_t> dropped_packets{0};
+	std::atomic<uint64_t> written_packets{0};
+
+	/* writer thread state */
+	int fd = -1;
+	bool header_written = false;
+	uint64_t file_index = 0;
+	std::deque<std::string> kept_files;
+	std::atomic<uint64_t> failed_bytes{0};
+
+	std::string file_name(uint64_t index) const;
+	void open_file();
+	void write_all(const uint8_t *data, size_t size);
+	bool rotating() const { return opts.rotate_bytes || opts.rotate_age.count(); }
+	void seal();
+	void run();
+
+  public:
+	/* allocates the buffers and creates the first file, throws std::runtime_error on failure */
+	explicit CaptureWriter(CaptureWriterOptions options);
+	~CaptureWriter();
+	CaptureWriter(const CaptureWriter &) = delete;
+	CaptureWriter &operator=(const CaptureWriter &) = delete;
+
+	/* capture thread only; ts_ns replaces header->ts, files are written with nanosecond timestamps */
+	void write(int linktype, uint64_t ts_ns, const struct pcap_pkthdr *header, const u_char *data);
+	/* hands over the last buffer, waits for the writer thread and closes the file */
+	void close();
+
+	uint64_t written() const { return written_packets; }
+	uint64_t dropped() const { return dropped_packets; }
+	/* bytes lost to failed writes */
+	uint64_t failed() const { return failed_bytes; }
+};
+
+#endif // CAPTUREWRITER_HPP
@@ -0,0 +1,83 @@
+#ifndef COMPRESSEDCAPTURE_HPP
+#define COMPRESSEDCAPTURE_HPP
+
+#include "../util/boundedQueue.hpp"
+#include "captureFile.hpp"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class Compression { NONE, GZIP, ZSTD };
+
+/* detects gzip / zstd from the first bytes of a file */
+Compression detect_compression(const uint8_t *data, size_t len);
+
+/**
+ * @brief Decompresses a .pcap.gz / .pcap.zst capture on background threads.
+ *
+ * The compressed file is memory-mapped and decompressed into fixed-size
+ * chunks that are handed to the parsing thread through a bounded queue,
+ * so decompression and analysis overlap while memory stays bounded.
+ *
+ * zstd files made of several independent frames with a known content
+ * size (zstd -T, pzstd) are decompressed frame-parallel; results are
+ * still delivered in file order.
+ *
+ * Usage:
+ *  while (auto chunk = stream.next()) { ...; stream.recycle(std::move(*chunk)); }
+ */
+class CompressedCapture {
+  public:
+	using Chunk = std::vector<uint8_t>;
+
+	CompressedCapture(const std::string &path, Compression compression, unsigned threads);
+	~CompressedCapture();
+	CompressedCapture(const CompressedCapture &) = delete;
+	CompressedCapture &operator=(const CompressedCapture &) = delete;
+
+	/* next decompressed chunk in file order, std::nullopt at end of input */
+	std::optional<Chunk> next();
+	/* returns a consumed chunk so its storage can be reused */
+	void recycle(Chunk &&chunk);
+	/* stops the decompression threads early */
+	void cancel();
+
+	/* non-empty if decompression failed */
+	std::string error();
+
+  private:
+	MappedFile file;
+	Compression compression;
+	unsigned threads;
+
+	BoundedQueue<Chunk> ready;
+	BoundedQueue<Chunk> spare;
+	std::atomic<bool> cancelled{false};
+	std::mutex error_mtx;
+	std::string error_msg;
+	std::thread producer;
+
+	Chunk take_spare();
+	void fail(const std::string &msg);
+
+	void run();
+	void run_gzip();
+	void run_zstd();
+	void run_zstd_parallel(const std::vector<std::pair<size_t, size_t>> &frames);
+};
+
+/**
+ * @brief Feeds every record of a compressed capture to handler.
+ *
+ * Records are parsed in place inside the decompressed chunks; only a
+ * record straddling two chunks is reassembled in a small carry buffer.
+ *
+ * @return decompressed bytes consumed
+ */
+uint64_t read_compressed_capture(CompressedCapture &stream, CaptureParser &parser, CaptureParser::Handler handler,
+								 void *user);
+
+#endif // COMPRESSEDCAPTURE_HPP
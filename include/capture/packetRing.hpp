@@ -0,0 +1,91 @@
+#ifndef PACKETRING_HPP
+#define PACKETRING_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <pcap/pcap.h>
+#include <string>
+#include <thread>
+
+struct PacketRingOptions {
+	/* slab size, the ring never holds more than this (headers included) */
+	size_t bytes = 64u << 20;
+	/* frames older than this (packet time) relative to the newest one are not kept */
+	std::chrono::seconds window{30};
+	/* dumps are written to <prefix>-YYYYMMDD-HHMMSS-N.pcap */
+	std::string dump_prefix = "nta-ring";
+};
+
+/**
+ * @brief Pre-trigger ring of the most recent raw frames, dumped to pcap on demand.
+ *
+ * Frames are copied into one slab allocated (and touched) up front, as
+ * pcap records laid out back to back; a record that doesn't fit before
+ * the end of the slab starts over at its beginning. The oldest records
+ * are evicted when space is needed or when they fall out of the time
+ * window. write() never allocates and never takes a lock.
+ *
+ * Positions are 64-bit logical offsets that only grow. The capture
+ * thread publishes head (oldest record) before overwriting anything and
+ * tail (end of the newest record) after writing it, so a dump can copy
+ * [head, tail) while capture goes on and then re-read head: everything
+ * at or after the new head was not overwritten during the copy. Only
+ * that part is written out.
+ *
+ * Dumps run on their own thread, requested with request_dump() (TUI key,
+ * automatic triggers) or SIGUSR1 once install_signal_trigger() was called.
+ */
+class PacketRing {
+  public:
+	/* allocates the slab, throws std::runtime_error if it can't */
+	explicit PacketRing(PacketRingOptions options);
+	~PacketRing();
+	PacketRing(const PacketRing &) = delete;
+	PacketRing &operator=(const PacketRing &) = delete;
+
+	/* capture thread only; ts_ns replaces header->ts, dumps have nanosecond timestamps */
+	void write(int linktype, uint64_t ts_ns, const struct pcap_pkthdr *header, const u_char *data);
+	/* asks the dump thread to save the ring, safe from any thread */
+	void request_dump();
+	/* finishes a pending dump and stops the dump thread */
+	void close();
+
+	/* makes SIGUSR1 request a dump */
+	static void install_signal_trigger();
+
+	uint64_t dumps() const { return dump_count; }
+	/* path of the newest dump, empty if there was none */
+	std::string last_dump();
+
+  private:
+	PacketRingOptions opts;
+	size_t capacity = 0;
+	std::unique_ptr<uint8_t[]> slab;
+
+	/* logical positions, the physical offset is position % capacity */
+	std::atomic<uint64_t> head{0};
+	std::atomic<uint64_t> tail{0};
+	std::atomic<int> linktype{-1};
+	/* capture thread copies of head / tail */
+	uint64_t write_head = 0;
+	uint64_t write_tail = 0;
+
+	std::thread dumper;
+	std::mutex mtx;
+	std::condition_variable wake;
+	bool dump_requested = false;
+	bool stopping = false;
+	std::atomic<uint64_t> dump_count{0};
+	std::string last_path;
+
+	/* position following the record (or wrap filler) at pos, whose bytes start at record */
+	uint64_t next_record(uint64_t pos, const uint8_t *record) const;
+	void run();
+	void dump();
+};
+
+#endif // PACKETRING_HPP
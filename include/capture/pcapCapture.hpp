@@ -3,6 +3,7 @@
 
 #include <deque>
 #include <memory>
+#include <mutex>
 #include <pcap/pcap.h>
 #include <queue>
 #include <thread>
@@ -19,15 +20,26 @@
 #define SNAP_LEN 1518
 
 #include "../../include/stats/protocolStats.hpp"
+#include "../cli/displayFilter.hpp"
+#include "../export/flowExporter.hpp"
 #include "../packet/IP.hpp"
+#include "captureFile.hpp"
+#include "captureWriter.hpp"
+#include "compressedCapture.hpp"
+#include "packetRing.hpp"
+#include "replay.hpp"
+#include "timeIndex.hpp"
 #include "../packet/packet.hpp"
 
 /**
  * Packet capture engine based on libpcap
  *
  * Supports:
- *  - Live capture from network interface
- *  - Offline capture from .pcap file
+ *  - Live capture from network interface, or from several at once
+ *    (one capture thread and Stats shard per interface)
+ *  - Offline capture from .pcap / .pcapng file (memory-mapped or libpcap),
+ *    optionally gzip / zstd compressed
+ *  - Paced replay of a capture file through the live path
  *  - BPF filtering
  *  - Separate capture thread (for live mode)
  *
@@ -36,9 +48,19 @@
  *  set_capabilities()-> configure capture parameters
  *  start()           -> start live capture (threaded)
  *  start_offline()   -> process file synchronously
+ *  start_offline_files() -> process many files in parallel, merged
+ *  start_replay()    -> replay a file in real time (threaded)
  *  stop()            -> stop capture and cleanup
  */
 
+/* backend used by start_offline() */
+enum class OfflineReader {
+	MMAP,	 // zero-copy mapped reader, pcap and pcapng
+	LIBPCAP, // pcap_open_offline, kept as fallback and for comparison
+};
+
+OfflineReader parse_offline_reader(const std::string &name);
+
 class PcapCapture {
   private:
 	/* libpcap error buffer */
@@ -51,6 +73,14 @@ class PcapCapture {
 	/* Active pcap handle */
 	std::unique_ptr<pcap_t, decltype(&pcap_close)> handle{nullptr, &pcap_close};
 	void datalink_type(int type);
+	/* DLT_* of the frames currently being decoded */
+	int datalink = -1;
+	/*
+	 * nanoseconds per unit of pcap_pkthdr::ts.tv_usec: 1 for nanosecond
+	 * handles and the mapped reader (which passes the parsed timestamp
+	 * on in full), 1000 where libpcap only has microseconds
+	 */
+	uint32_t ts_scale = 1000;
 	uint16_t offset = 0;
 	std::function<uint16_t(const u_char *)> get_ether_type;
 
@@ -66,6 +96,23 @@ class PcapCapture {
 
 	/* Selected network interface */
 	std::string interface;
+
+	/*
+	 * "-i eth0,eth1": one child capture per interface, each with its own
+	 * handle, thread, datalink decoder and Stats shard, so the capture
+	 * threads share no lock. collect() drains the shards into stats.
+	 * The shards are declared first so the children go away before them.
+	 */
+	std::vector<std::unique_ptr<Stats>> link_stats;
+	std::vector<std::unique_ptr<PcapCapture>> links;
+	std::chrono::steady_clock::time_point last_collect;
+	void start_links(const std::vector<std::string> &names);
+
+	/* drops of a live handle (pcap_stats), refreshed by the capture thread once per second of packet time */
+	bool live = false;
+	time_t drops_sec = 0;
+	std::atomic<uint64_t> dropped{0};
+	void update_drops(time_t sec);
 	/**
 	 * Static wrapper required by C-style libpcap callback.
 	 *
@@ -77,26 +124,86 @@ class PcapCapture {
 	// packet processing logic
 	void got_packet(const struct pcap_pkthdr *header, const u_char *packet);
 
+	/* mapped offline reader */
+	OfflineReader offline_reader = OfflineReader::MMAP;
+	int linktype = -1;
+	uint64_t offline_count = 0;
+	/* records outside this range are skipped by the mapped reader */
+	TimeRange range;
+	static bool record_callback(void *user, const CaptureRecord &record);
+	/* paced replay feeding the capture thread instead of a handle */
+	Replayer *replayer = nullptr;
+	bool read_mapped(const std::string &fpath);
+	void start_offline_range(const std::string &fpath, const TimeRange &range, const TimeIndex *index);
+
+	/* optional flow exporter fed with the 5-tuple of every IP packet */
+	FlowExporter *flow_exporter = nullptr;
+	/* flow table of this capture's thread, opened with its first IP packet, released by the destructor */
+	FlowExporter::Source *flow_source = nullptr;
+	void export_flow(IP_class &ip, IPVersion version, uint64_t ts_ns, uint32_t len);
+
+	/* optional pcap writer, gets every frame before it is decoded */
+	CaptureWriter *capture_writer = nullptr;
+	/* optional pre-trigger ring, also fed every frame */
+	PacketRing *packet_ring = nullptr;
+
+	/*
+	 * optional display filter: matching packets are also counted in
+	 * display_stats. set_display() stores the pair under display_mtx and
+	 * bumps display_generation, the capture thread only takes the lock
+	 * when the generation it has seen is behind.
+	 */
+	std::mutex display_mtx;
+	std::shared_ptr<const DisplayFilter> pending_filter;
+	std::shared_ptr<Stats> pending_stats;
+	std::atomic<uint64_t> display_generation{0};
+	uint64_t display_seen = 0;
+	std::shared_ptr<const DisplayFilter> display_filter;
+	std::shared_ptr<Stats> display_stats;
+	/* with several interfaces: the shard of pending_stats each link counts into, drained by collect() */
+	std::vector<std::shared_ptr<Stats>> display_shards;
+	/* a fresh display shard configured like pending_stats, null without a display filter; display_mtx held */
+	std::shared_ptr<Stats> display_shard() const;
+	/* hands a decoded packet to stats and, if it matches, to display_stats */
+	void count(const Packet &packet);
+
 	/* Separate thread used for live capture */
 	std::thread thread;
 	std::atomic<bool> running{false};
-	void stop();
 	Stats *stats;
 
   public:
 	~PcapCapture();
 	void print_interfaces();
 
-	bool isRunning() { return running; }
-	void setRunning(bool running) { this->running = running; }
+	/* stops and joins every capture thread; after it no frame reaches the writer, ring or exporter */
+	void stop();
+	/* with several interfaces: while any of them still captures */
+	bool isRunning();
+	void setRunning(bool running);
 	/* Pointer to statistics engine */
 
 	void set_capabilities(const std::string &interface, int num_packets, const std::string &filter_exp,
 						  int packets_limit, Stats *stats);
+	void set_offline_reader(OfflineReader reader) { offline_reader = reader; }
+	void set_flow_exporter(FlowExporter *exporter) { flow_exporter = exporter; }
+	void set_capture_writer(CaptureWriter *writer) { capture_writer = writer; }
+	void set_packet_ring(PacketRing *ring) { packet_ring = ring; }
+	/* replaces the display filter and its Stats (both null to turn it off), safe while capturing */
+	void set_display(std::shared_ptr<const DisplayFilter> filter, std::shared_ptr<Stats> stats);
 	void initialize();
 
+	/* captures on interface, or on each of a comma-separated list in parallel */
 	void start();
+	/* live capture from a paced replay instead of an interface; replayer must outlive the capture */
+	void start_replay(Replayer &replayer);
+	/* moves the counters of the per-interface shards into the Stats, at most every 100 ms unless forced */
+	void collect(bool force = false);
 	void start_offline(const std::string &fpath);
+	/* analyzes time ranges of one file (overlaps merged), seeking via its sidecar index, ranges in parallel */
+	void start_offline_ranges(const std::string &fpath, const std::vector<TimeRange> &ranges);
+	/* analyzes several files on a pool of jobs workers, each with its own Stats, and merges the results */
+	void start_offline_files(const std::vector<std::string> &files, const std::vector<TimeRange> &ranges, unsigned jobs);
 };
 
 #endif // PCAPCAPTURE_HPP
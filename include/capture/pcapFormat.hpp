@@ -0,0 +1,43 @@
+#ifndef PCAPFORMAT_HPP
+#define PCAPFORMAT_HPP
+
+#include <cstdint>
+
+/**
+ * On-disk layout of classic libpcap savefiles (see pcap-savefile(5)).
+ *
+ * Kept independent of libpcap so that files can be produced and
+ * parsed without going through pcap_dump / pcap_open_offline.
+ * All fields are in the byte order of the host that wrote the file,
+ * which is detected from the magic number.
+ */
+
+constexpr uint32_t SAVEFILE_MAGIC_USEC = 0xa1b2c3d4;
+constexpr uint32_t SAVEFILE_MAGIC_NSEC = 0xa1b23c4d;
+
+struct SavefileHeader {
+	uint32_t magic;
+	uint16_t version_major;
+	uint16_t version_minor;
+	int32_t thiszone;
+	uint32_t sigfigs;
+	uint32_t snaplen;
+	uint32_t linktype;
+};
+
+struct SavefileRecord {
+	uint32_t ts_sec;
+	/* microseconds or nanoseconds depending on the file magic */
+	uint32_t ts_frac;
+	uint32_t caplen;
+	uint32_t len;
+};
+
+static_assert(sizeof(SavefileHeader) == 24);
+static_assert(sizeof(SavefileRecord) == 16);
+
+inline SavefileHeader make_savefile_header(uint32_t linktype, uint32_t snaplen, bool nanosecond) {
+	return {nanosecond ? SAVEFILE_MAGIC_NSEC : SAVEFILE_MAGIC_USEC, 2, 4, 0, 0, snaplen, linktype};
+}
+
+#endif // PCAPFORMAT_HPP
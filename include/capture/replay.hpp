@@ -0,0 +1,137 @@
+#ifndef REPLAY_HPP
+#define REPLAY_HPP
+
+#include "captureFile.hpp"
+#include "compressedCapture.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+struct ReplayOptions {
+	/* pcap / pcapng file, optionally gzip / zstd compressed */
+	std::string path;
+	/* multiple of the original timing, 0 = as fast as possible */
+	double speed = 1.0;
+	/* fixed packet rate instead of the file's timing, 0 = off */
+	uint64_t pps = 0;
+	/* frames between the pacer and the capture thread, rounded up to a power of two */
+	size_t queue = 8192;
+	/* passes over the file, 0 = until stopped */
+	uint64_t loops = 1;
+};
+
+/* a frame handed to the capture thread, valid until release() */
+struct ReplayFrame {
+	/* system time the frame was sent at, nanoseconds */
+	uint64_t ts_ns;
+	uint32_t caplen;
+	uint32_t len;
+	int linktype;
+	/* same snap length as a live handle (SNAP_LEN) */
+	static constexpr size_t SNAPLEN = 1518;
+	std::array<uint8_t, SNAPLEN> data;
+};
+
+/**
+ * @brief Replays a capture file through the live capture path.
+ *
+ * A pacer thread sends every record when it is due: at the file's own
+ * timing scaled by speed, at a fixed rate, or as fast as it can. It
+ * sleeps on the monotonic clock until shortly before a frame is due and
+ * spins the rest, which keeps the jitter in the microseconds. Frames are
+ * stamped with the system time they are sent at, so the live statistics
+ * see them exactly as traffic arriving now.
+ *
+ * Sent frames are copied into a single-producer / single-consumer ring
+ * the capture thread drains, the stand-in for a kernel capture buffer:
+ * when it is full the frame is dropped and counted, the pacer never
+ * waits. The highest rate of a whole second without a drop is kept as
+ * the rate the pipeline sustains.
+ */
+class Replayer {
+  public:
+	/* maps the file, throws std::runtime_error if it can't be replayed, std::invalid_argument for bad options */
+	explicit Replayer(ReplayOptions options);
+	~Replayer();
+	Replayer(const Replayer &) = delete;
+	Replayer &operator=(const Replayer &) = delete;
+
+	/* starts the pacer thread */
+	void start();
+	/* asks the pacer to stop, pop() returns null from then on; safe from any thread */
+	void stop();
+
+	/* capture thread: next frame, waits for it; null once the replay is over */
+	const ReplayFrame *pop();
+	/* capture thread: hands the slot of the last popped frame back */
+	void release();
+
+	const ReplayOptions &options() const { return opts; }
+	uint64_t sent() const { return sent_frames.load(std::memory_order_relaxed); }
+	uint64_t dropped() const { return dropped_frames.load(std::memory_order_relaxed); }
+	/* frames sent during the last whole second */
+	uint64_t current_pps() const { return last_pps.load(std::memory_order_relaxed); }
+	/* highest frames / bytes per second of a whole second without drops */
+	uint64_t max_clean_pps() const { return clean_pps.load(std::memory_order_relaxed); }
+	uint64_t max_clean_bytes() const { return clean_bytes.load(std::memory_order_relaxed); }
+	/* how late frames were sent, mean and max in nanoseconds */
+	uint64_t mean_lateness_ns() const;
+	uint64_t max_lateness_ns() const { return max_late.load(std::memory_order_relaxed); }
+	/* why the replay ended early, empty if it didn't */
+	std::string error() const;
+
+  private:
+	ReplayOptions opts;
+	std::unique_ptr<MappedFile> file;
+	Compression compression = Compression::NONE;
+
+	/* power-of-two ring of frames, positions only grow */
+	std::unique_ptr<ReplayFrame[]> slots;
+	size_t mask = 0;
+	alignas(64) std::atomic<uint64_t> head{0};
+	alignas(64) std::atomic<uint64_t> tail{0};
+	std::atomic<bool> finished{false};
+	std::atomic<bool> stopping{false};
+
+	std::thread pacer;
+	std::chrono::steady_clock::time_point start_time;
+	uint64_t start_epoch_ns = 0;
+
+	/* pacing state, pacer thread only */
+	uint64_t scheduled = 0;
+	uint64_t first_ts = 0;
+	uint64_t last_ts = 0;
+	uint64_t loop_base = 0;
+	bool have_first = false;
+	uint64_t second = 0;
+	uint64_t second_sent = 0;
+	uint64_t second_bytes = 0;
+	uint64_t second_dropped = 0;
+	uint64_t sent_bytes = 0;
+
+	std::atomic<uint64_t> sent_frames{0};
+	std::atomic<uint64_t> dropped_frames{0};
+	std::atomic<uint64_t> last_pps{0};
+	std::atomic<uint64_t> clean_pps{0};
+	std::atomic<uint64_t> clean_bytes{0};
+	std::atomic<uint64_t> late_sum{0};
+	std::atomic<uint64_t> max_late{0};
+	/* set by the pacer thread before finished */
+	std::string failure;
+
+	void run();
+	static bool on_record(void *user, const CaptureRecord &record);
+	/* when record is due, nanoseconds after start_time */
+	uint64_t due(const CaptureRecord &record);
+	void send(const CaptureRecord &record);
+	/* sleeps, then spins until due; false if stop() came first */
+	bool wait_until(std::chrono::steady_clock::time_point due);
+	/* closes the per-second counters of every second before the one elapsed_ns falls in */
+	void account(uint64_t elapsed_ns);
+};
+
+#endif // REPLAY_HPP
@@ -0,0 +1,88 @@
+#ifndef TIMEINDEX_HPP
+#define TIMEINDEX_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* half-open packet time range [from_ns, to_ns) */
+struct TimeRange {
+	uint64_t from_ns = 0;
+	uint64_t to_ns = UINT64_MAX;
+
+	bool contains(uint64_t ts) const { return ts >= from_ns && ts < to_ns; }
+};
+
+/**
+ * @brief Parses one time bound given on the command line.
+ *
+ * Accepted forms:
+ *  - 1700000000.5          seconds since the epoch
+ *  - 2024-05-01T12:30:00   UTC date and time
+ *  - +300                  seconds after capture_start_ns
+ */
+uint64_t parse_time_bound(const std::string &str, uint64_t capture_start_ns);
+
+/* parses "FROM,TO" where either bound may be empty (open-ended) */
+TimeRange parse_time_range(const std::string &spec, uint64_t capture_start_ns);
+
+/* sorts ranges and merges the overlapping ones, so no packet falls into two of them */
+std::vector<TimeRange> coalesce_ranges(std::vector<TimeRange> ranges);
+
+/* timestamp of the first record of a pcap/pcapng file (gzip / zstd ones too), 0 if it has none */
+uint64_t first_capture_timestamp(const std::string &capture);
+
+/* one index entry covering `packets` consecutive records */
+struct TimeIndexBlock {
+	uint64_t min_ts_ns;
+	uint64_t max_ts_ns;
+	/* file offset of the first record of the block */
+	uint64_t offset;
+	uint32_t packets;
+	uint32_t reserved;
+};
+
+static_assert(sizeof(TimeIndexBlock) == 32);
+
+/**
+ * @brief Sidecar index mapping packet timestamps to file offsets.
+ *
+ * Stored next to the capture as <capture>.ntaidx: a fixed header
+ * followed by one 32-byte entry per block of records. Each entry keeps
+ * the min/max timestamp of its block, so captures with slightly
+ * out-of-order timestamps are still seeked correctly.
+ *
+ * The index remembers size and mtime of the capture and is ignored
+ * once the capture changes. Only uncompressed pcap files and pcapng
+ * files whose section / interface blocks all precede the first packet
+ * can be indexed.
+ */
+class TimeIndex {
+  public:
+	static constexpr uint32_t DEFAULT_BLOCK_PACKETS = 4096;
+
+	/* bytes before this offset (file header, pcapng SHB/IDBs) must be parsed before seeking */
+	uint64_t data_offset = 0;
+	uint64_t file_size = 0;
+	int64_t file_mtime_ns = 0;
+	uint32_t block_packets = DEFAULT_BLOCK_PACKETS;
+	std::vector<TimeIndexBlock> blocks;
+
+	static std::string sidecar_path(const std::string &capture);
+
+	/* scans the capture once, throws std::runtime_error if it can't be indexed */
+	static TimeIndex build(const std::string &capture, uint32_t block_packets = DEFAULT_BLOCK_PACKETS);
+	void save(const std::string &path) const;
+	/* std::nullopt if the index is missing, corrupt or stale */
+	static std::optional<TimeIndex> load(const std::string &path, const std::string &capture);
+
+	uint64_t first_ts() const;
+	uint64_t packets() const;
+
+	/* merged byte spans [begin, end) whose blocks may hold packets of range */
+	std::vector<std::pair<uint64_t, uint64_t>> spans(const TimeRange &range) const;
+};
+
+#endif // TIMEINDEX_HPP
@@ -0,0 +1,90 @@
+#ifndef DISPLAYFILTER_HPP
+#define DISPLAYFILTER_HPP
+
+#include "../packet/packet.hpp"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief User-space display filter over the decoded packet fields.
+ *
+ * Unlike --filter, which becomes a BPF program when the pcap handle is
+ * opened, a display filter is evaluated on every decoded Packet and can
+ * be replaced while the capture keeps running. The expression is parsed
+ * once into a flat postfix program of field tests and and / or / not
+ * with short-circuit jumps; match() runs it over a 64-bit stack of
+ * results, without allocations or virtual calls; addresses are compared
+ * in the binary form the decoder left in the packet.
+ *
+ *   expr  := and { ("or" | "||") and }
+ *   and   := unary { ("and" | "&&") unary }
+ *   unary := ("not" | "!") unary | "(" expr ")" | term
+ *   term  := tcp | udp | icmp | icmp6 | igmp | ip | ip6 | proto NAME
+ *          | http | https | dns | ftp | ssh | smtp | quic | ntp | app NAME
+ *          | [src | dst] host ADDR[/LEN]      ("net" works like "host")
+ *          | [src | dst] port N[-M]           ("sport" / "dport" too)
+ *          | src ADDR[/LEN] | dst ADDR[/LEN]
+ *          | len (< | <= | > | >= | == | !=) N
+ *          | syn | ack | fin | rst | psh | urg
+ *
+ * e.g. "tcp and port 443 and not dst 10.0.0.0/8"
+ */
+class DisplayFilter {
+  public:
+	/* throws std::invalid_argument naming the offending token */
+	static DisplayFilter compile(const std::string &expression);
+
+	bool match(const Packet &packet) const;
+	const std::string &expression() const { return text; }
+
+  private:
+	enum class Op : uint8_t {
+		VERSION,
+		TRANSPORT,
+		APPLICATION,
+		SRC_NET,
+		DST_NET,
+		ANY_NET,
+		SRC_PORT,
+		DST_PORT,
+		ANY_PORT,
+		LEN_LT,
+		LEN_LE,
+		LEN_GT,
+		LEN_GE,
+		LEN_EQ,
+		LEN_NE,
+		FLAGS,
+		AND,
+		OR,
+		NOT,
+		JUMP_IF_FALSE,
+		JUMP_IF_TRUE,
+	};
+
+	/* one step of the program; a and b are a value, a range, an index into nets or a jump target */
+	struct Insn {
+		Op op;
+		uint32_t a = 0;
+		uint32_t b = 0;
+	};
+
+	struct Net {
+		std::array<uint8_t, 16> addr;
+		uint8_t len;
+		bool v6;
+	};
+
+	/* results are kept as bits of one register, deeper expressions are rejected */
+	static constexpr size_t MAX_DEPTH = 64;
+
+	std::string text;
+	std::vector<Insn> program;
+	std::vector<Net> nets;
+
+	class Parser;
+};
+
+#endif // DISPLAYFILTER_HPP
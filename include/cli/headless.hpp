@@ -0,0 +1,37 @@
+#ifndef HEADLESS_HPP
+#define HEADLESS_HPP
+
+#include "../capture/pcapCapture.hpp"
+#include <chrono>
+#include <climits>
+#include <functional>
+#include <string>
+
+struct HeadlessOptions {
+	/* time between two summary lines */
+	std::chrono::milliseconds interval{1000};
+	/* summary destination, empty or "-" for stdout */
+	std::string output;
+	/* stop after this long (the --time limit) */
+	std::chrono::seconds time_limit{INT_MAX};
+	/* number of top talkers listed per line */
+	size_t top = 5;
+	/* called once per interval before the summary line, may be empty */
+	std::function<void()> on_tick;
+};
+
+/**
+ * @brief Runs the capture without FTXUI and prints periodic summaries.
+ *
+ * Writes one compact JSON line per interval until the capture ends
+ * (--count reached, offline file done), the time limit passes or
+ * SIGINT / SIGTERM arrives, then a final line. None of the UI snapshot
+ * tables are built in this mode.
+ *
+ * The capture must already be started (live) or finished (offline).
+ *
+ * @return process exit code
+ */
+int run_headless(PcapCapture &capture, Stats &stats, const HeadlessOptions &opts);
+
+#endif // HEADLESS_HPP
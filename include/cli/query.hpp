@@ -0,0 +1,18 @@
+#ifndef QUERY_HPP
+#define QUERY_HPP
+
+/**
+ * @brief Entry point of the `query` subcommand.
+ *
+ * Answers questions about one or more columnar archives written with
+ * --archive, e.g. the top sources by bytes between two times, without
+ * loading them: files are mapped, blocks outside the time range are
+ * skipped by their min/max metadata and only the needed columns are read.
+ *
+ * argv[0] is "query".
+ *
+ * @return process exit code
+ */
+int run_query(int argc, char **argv);
+
+#endif // QUERY_HPP
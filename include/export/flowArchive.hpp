@@ -0,0 +1,187 @@
+#ifndef FLOWARCHIVE_HPP
+#define FLOWARCHIVE_HPP
+
+#include "../capture/captureFile.hpp"
+#include "../stats/protocolStats.hpp"
+#include "../util/boundedQueue.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Columnar archive layout (.ntac), native little-endian:
+ *
+ *   ArchiveFileHeader
+ *   { ArchiveBlockHeader, payload padded to 8 bytes }...
+ *
+ * DICTIONARY payload: uint32 first_id, uint32 count, then count
+ *   entries of uint16 length + address bytes. Ids are dense and
+ *   assigned in order of first appearance; a dictionary block always
+ *   precedes the first block referencing its ids.
+ * INTERVALS payload: columns ts (int64 ns), duration (uint64 ns),
+ *   packets (uint64), bytes (uint64), one row per recorded interval.
+ * FLOWS payload: columns ts (int64 ns), src (uint32 id), dst (uint32 id),
+ *   packets (uint32), bytes (uint64), one row per pair active in an
+ *   interval holding the delta of that interval.
+ *
+ * Every column starts on an 8-byte boundary so a mapped file can be
+ * read in place.
+ */
+
+enum class ArchiveBlockKind : uint16_t { DICTIONARY = 1, INTERVALS = 2, FLOWS = 3 };
+
+struct ArchiveFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t block_rows;
+	int64_t created_ns;
+	uint64_t reserved;
+};
+
+struct ArchiveBlockHeader {
+	uint16_t kind;
+	uint16_t reserved;
+	uint32_t rows;
+	/* payload size including padding, the next header follows it */
+	uint64_t payload_bytes;
+	/* block metadata used to skip blocks, zero for dictionaries */
+	int64_t min_ts;
+	int64_t max_ts;
+	uint64_t min_bytes;
+	uint64_t max_bytes;
+};
+
+static_assert(sizeof(ArchiveFileHeader) == 32);
+static_assert(sizeof(ArchiveBlockHeader) == 48);
+
+struct ArchiveOptions {
+	std::string path;
+	/* time between two recorded intervals */
+	std::chrono::milliseconds interval{10000};
+	/* rows per intervals / flows block */
+	uint32_t block_rows = 65536;
+};
+
+/**
+ * @brief Appends per-interval aggregates and flow deltas to a columnar archive.
+ *
+ * record() only copies the pair counters (into recycled storage) and
+ * queues them; delta computation, dictionary encoding and block writes
+ * happen on the writer thread. Samples are dropped and counted if the
+ * writer falls behind. Buffered rows are written as blocks when a block
+ * fills up, every few minutes of samples and on close().
+ */
+class ArchiveWriter {
+  private:
+	struct Sample {
+		int64_t ts = 0;
+		trafficStats totals;
+		std::vector<PairCounter> pairs;
+	};
+
+	Stats &stats;
+	ArchiveOptions opts;
+
+	BoundedQueue<Sample> ready;
+	BoundedQueue<Sample> spare;
+	std::thread writer;
+	std::chrono::steady_clock::time_point next_record;
+	std::atomic<uint64_t> dropped_samples{0};
+
+	/* writer thread state */
+	FILE *file = nullptr;
+	int64_t last_ts = 0;
+	trafficStats last_totals;
+	std::unordered_map<std::string, uint32_t> ids;
+	std::vector<const std::string *> new_entries;
+	/* last cumulative counters per (src id << 32 | dst id) */
+	std::unordered_map<uint64_t, protocolStats> last_pairs;
+	size_t unflushed_samples = 0;
+
+	std::vector<int64_t> iv_ts;
+	std::vector<uint64_t> iv_duration, iv_packets, iv_bytes;
+	std::vector<int64_t> fl_ts;
+	std::vector<uint32_t> fl_src, fl_dst, fl_packets;
+	std::vector<uint64_t> fl_bytes;
+
+	uint32_t id_of(const std::string &address);
+	void consume(const Sample &sample);
+	void flush();
+	void write_block(ArchiveBlockKind kind, uint32_t rows, const std::string &payload, int64_t min_ts, int64_t max_ts,
+					 uint64_t min_bytes, uint64_t max_bytes);
+	void run();
+
+  public:
+	/* creates (truncates) the archive, throws std::runtime_error on failure */
+	ArchiveWriter(Stats &stats, ArchiveOptions options);
+	~ArchiveWriter();
+	ArchiveWriter(const ArchiveWriter &) = delete;
+	ArchiveWriter &operator=(const ArchiveWriter &) = delete;
+
+	/* records if at least one interval passed since the previous record */
+	void tick();
+	/* records unconditionally */
+	void record();
+	/* writes everything buffered and stops the writer thread */
+	void close();
+
+	uint64_t dropped() const { return dropped_samples; }
+};
+
+/* column pointers into a mapped FLOWS block */
+struct FlowColumns {
+	const int64_t *ts;
+	const uint32_t *src;
+	const uint32_t *dst;
+	const uint32_t *packets;
+	const uint64_t *bytes;
+};
+
+/* column pointers into a mapped INTERVALS block */
+struct IntervalColumns {
+	const int64_t *ts;
+	const uint64_t *duration;
+	const uint64_t *packets;
+	const uint64_t *bytes;
+};
+
+/**
+ * @brief Read-only view of a mapped archive.
+ *
+ * Opening only walks the block headers; columns are accessed in place
+ * and addresses are decoded on demand, so a query touches just the
+ * blocks and columns it needs.
+ */
+class ArchiveReader {
+  public:
+	struct Block {
+		const ArchiveBlockHeader *header;
+		const uint8_t *payload;
+	};
+
+	/* throws std::runtime_error if the file is not an archive; a truncated tail is ignored */
+	explicit ArchiveReader(const std::string &path);
+
+	const std::vector<Block> &blocks() const { return block_list; }
+	/* number of dictionary ids */
+	uint32_t addresses() const { return address_count; }
+	/* decodes one dictionary id */
+	std::string address(uint32_t id) const;
+	/* earliest recorded timestamp, 0 for an empty archive */
+	int64_t first_ts() const;
+
+	static FlowColumns flows(const Block &block);
+	static IntervalColumns intervals(const Block &block);
+
+  private:
+	MappedFile file;
+	std::vector<Block> block_list;
+	std::vector<Block> dictionaries;
+	uint32_t address_count = 0;
+};
+
+#endif // FLOWARCHIVE_HPP
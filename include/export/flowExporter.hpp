@@ -0,0 +1,172 @@
+#ifndef FLOWEXPORTER_HPP
+#define FLOWEXPORTER_HPP
+
+#include "../packet/packet.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+enum class FlowProtocol { IPFIX, NETFLOW_V9 };
+
+FlowProtocol parse_flow_protocol(const std::string &name);
+
+struct FlowExportOptions {
+	/* collector as host:port or [v6-address]:port */
+	std::string collector;
+	FlowProtocol protocol = FlowProtocol::IPFIX;
+	/* a flow idle this long (packet time) is exported and forgotten */
+	std::chrono::seconds idle_timeout{15};
+	/* a long-lived flow is exported every active_timeout (packet time) */
+	std::chrono::seconds active_timeout{60};
+	/* path MTU towards the collector, messages are filled up to it */
+	size_t mtu = 1500;
+	/* templates are resent at least this often (wall clock) */
+	std::chrono::seconds template_refresh{60};
+	/* flows tracked at once, packets of new flows beyond it are not exported */
+	size_t max_flows = 1u << 18;
+	uint32_t observation_domain = 1;
+};
+
+/* 5-tuple identifying a flow, zero padded so it can be hashed as bytes */
+struct FlowKey {
+	std::array<uint8_t, 16> src{};
+	std::array<uint8_t, 16> dst{};
+	uint16_t src_port = 0;
+	uint16_t dst_port = 0;
+	uint8_t protocol = 0;
+	uint8_t version = 0;
+	uint16_t reserved = 0;
+
+	bool operator==(const FlowKey &other) const = default;
+};
+
+struct FlowKeyHash {
+	size_t operator()(const FlowKey &key) const;
+};
+
+/* one exported flow record */
+struct FlowRecord {
+	FlowKey key;
+	uint64_t first_ns;
+	uint64_t last_ns;
+	uint64_t packets;
+	uint64_t bytes;
+	/* IPFIX flowEndReason: 1 idle, 2 active, 4 forced end, 5 lack of resources */
+	uint8_t end_reason;
+};
+
+/* IANA protocol number of a decoded transport protocol */
+uint8_t iana_protocol(TransportProtocol protocol);
+
+/**
+ * @brief Builds flows from captured 5-tuples and exports them as IPFIX or NetFlow v9.
+ *
+ * Every capture thread counts into its own Source, a flow table with
+ * its own packet clock, so threads never share a lock with each other
+ * and parallel offline workers don't idle out each other's flows. An
+ * exporter thread expires idle and active-timeout flows once a second,
+ * measured in each source's packet time so offline files export the
+ * same records as the live capture did. Records are packed into messages up
+ * to the MTU and sent over UDP; the templates lead the first message
+ * and are refreshed every template_refresh. close() exports whatever is
+ * still in the table.
+ */
+class FlowExporter {
+  public:
+	/* resolves the collector and creates the socket, throws std::runtime_error on failure */
+	explicit FlowExporter(FlowExportOptions options);
+	~FlowExporter();
+	FlowExporter(const FlowExporter &) = delete;
+	FlowExporter &operator=(const FlowExporter &) = delete;
+
+	class Source;
+	/* a new flow table for the calling capture thread, valid until release() */
+	Source *open_source();
+	/* the source's thread is done: its flows are exported with the next expiry and the source is freed */
+	void release(Source *source);
+	/* stops the exporter thread and exports every remaining flow */
+	void close();
+
+	uint64_t exported() const { return exported_records; }
+	uint64_t untracked() const { return untracked_packets; }
+
+  private:
+	struct FlowCounters {
+		uint64_t first_ns;
+		uint64_t last_ns;
+		uint64_t packets;
+		uint64_t bytes;
+	};
+
+	FlowExportOptions opts;
+	int fd = -1;
+	size_t max_message = 0;
+
+	/* guards the list and the finished flags, never taken by add() */
+	std::mutex sources_mtx;
+	std::vector<std::unique_ptr<Source>> sources;
+	/* flows tracked over all sources, checked against max_flows */
+	std::atomic<size_t> tracked_flows{0};
+
+	std::thread thread;
+	std::mutex wake_mtx;
+	std::condition_variable wake;
+	bool stopping = false;
+
+	/* exporter thread state */
+	std::vector<FlowRecord> expired;
+	std::vector<uint8_t> message;
+	bool message_has_templates = false;
+	/* earliest first packet of any source, NetFlow v9 uptime counts from here */
+	uint64_t uptime_base_ns = 0;
+	uint32_t sequence = 0;
+	std::chrono::steady_clock::time_point last_templates;
+	bool templates_sent = false;
+	std::atomic<uint64_t> exported_records{0};
+	std::atomic<uint64_t> untracked_packets{0};
+
+	void run();
+	void expire(bool all);
+	/* moves the timed out flows of one source into expired (all of them if all), returns its packet clock */
+	uint64_t expire_source(Source &source, bool all);
+	void send_records(const std::vector<FlowRecord> &records, uint64_t clock_ns);
+	void begin_message();
+	void finish_message(uint16_t records, uint64_t clock_ns);
+	void append_templates();
+	size_t template_size() const;
+};
+
+/**
+ * @brief Flow table of one capture thread.
+ *
+ * add() is called on that thread only: a hash lookup under a lock that
+ * only the exporter thread shares, once a second, no allocation unless
+ * the flow is new and no I/O.
+ */
+class FlowExporter::Source {
+  public:
+	void add(const FlowKey &key, uint64_t ts_ns, uint32_t bytes);
+
+  private:
+	friend class FlowExporter;
+	explicit Source(FlowExporter &owner) : owner(owner) {}
+
+	FlowExporter &owner;
+	std::mutex mtx;
+	std::unordered_map<FlowKey, FlowCounters, FlowKeyHash> flows;
+	/* newest packet timestamp of this source, the clock its timeouts are measured on */
+	uint64_t now_ns = 0;
+	/* first packet timestamp */
+	uint64_t boot_ns = 0;
+	/* set by release(), under sources_mtx */
+	bool finished = false;
+};
+
+#endif // FLOWEXPORTER_HPP
@@ -0,0 +1,42 @@
+#ifndef METRICSSERVER_HPP
+#define METRICSSERVER_HPP
+
+#include "../stats/protocolStats.hpp"
+#include <atomic>
+#include <string>
+#include <thread>
+
+/* renders a metrics snapshot in the OpenMetrics text exposition format */
+std::string format_openmetrics(const MetricsSnapshot &m);
+
+/**
+ * @brief Minimal embedded HTTP endpoint serving GET /metrics.
+ *
+ * Runs on its own thread and answers every scrape from the snapshot
+ * last published with Stats::publish_metrics(), so a scrape never takes
+ * the Stats lock. Connections are served one at a time with short
+ * timeouts; this is meant for a Prometheus scraper, not for browsers.
+ */
+class MetricsServer {
+  private:
+	Stats &stats;
+	int listen_fd = -1;
+	std::atomic<bool> running{false};
+	std::thread thread;
+
+	void serve();
+	void handle(int fd);
+
+  public:
+	/* binds immediately, throws std::runtime_error if the address is unavailable */
+	MetricsServer(Stats &stats, const std::string &address, uint16_t port);
+	~MetricsServer();
+	MetricsServer(const MetricsServer &) = delete;
+	MetricsServer &operator=(const MetricsServer &) = delete;
+
+	/* actual port, useful when 0 was requested */
+	uint16_t port() const;
+	void stop();
+};
+
+#endif // METRICSSERVER_HPP
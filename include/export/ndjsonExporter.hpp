@@ -0,0 +1,75 @@
+#ifndef NDJSONEXPORTER_HPP
+#define NDJSONEXPORTER_HPP
+
+#include "../stats/protocolStats.hpp"
+#include "../util/boundedQueue.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+struct NdjsonOptions {
+	std::string path;
+	/* minimum time between two records */
+	std::chrono::milliseconds interval{1000};
+	/* rotate once the current file reaches this size, 0 = never */
+	uint64_t rotate_bytes = 0;
+	/* rotate once the current file is this old, 0 = never */
+	std::chrono::seconds rotate_age{0};
+};
+
+/**
+ * @brief Streams the statistics to a newline-delimited JSON file.
+ *
+ * record() copies the counters into a recycled NdjsonRecord and hands
+ * it to a dedicated I/O thread, which formats one line per stats section;
+ * it never blocks on the disk. If the writer falls behind the record is
+ * dropped and counted instead, its alerts go out with the next one.
+ * The I/O thread appends, flushes after every record and rotates the
+ * file by size or age; rotated files are renamed to <path>.1, <path>.2...
+ * and always end on a complete line.
+ */
+class NdjsonExporter {
+  private:
+	NdjsonOptions opts;
+	Stats &stats;
+
+	BoundedQueue<NdjsonRecord> ready;
+	BoundedQueue<NdjsonRecord> spare;
+	std::thread writer;
+
+	std::chrono::steady_clock::time_point next_record;
+	uint64_t seq = 0;
+	std::atomic<uint64_t> dropped_records{0};
+
+	/* I/O thread state */
+	FILE *file = nullptr;
+	uint64_t file_bytes = 0;
+	std::chrono::steady_clock::time_point file_opened;
+	unsigned rotations = 0;
+	/* text of the record being written */
+	std::string line;
+
+	void run();
+	void open_file();
+	void rotate();
+
+  public:
+	/* opens the file right away, throws std::runtime_error if it can't be created */
+	NdjsonExporter(Stats &stats, NdjsonOptions options);
+	~NdjsonExporter();
+	NdjsonExporter(const NdjsonExporter &) = delete;
+	NdjsonExporter &operator=(const NdjsonExporter &) = delete;
+
+	/* records if at least one interval passed since the previous record */
+	void tick();
+	/* records unconditionally */
+	void record();
+	/* flushes everything queued and stops the I/O thread */
+	void close();
+
+	uint64_t dropped() const { return dropped_records; }
+};
+
+#endif // NDJSONEXPORTER_HPP
@@ -3,6 +3,7 @@
 #include "packet.hpp"
 #include <netinet/igmp.h>
 #include <netinet/ip.h>
+#include <array>
 #include <netinet/ip6.h>
 #include <string>
 
@@ -16,21 +17,43 @@ class IP_class {
 	virtual void handle_igmp() = 0;
 
 	uint16_t payload_len = 0;
+	/* TCP flags byte (FIN 0x01, SYN 0x02, RST 0x04, PSH 0x08, ACK 0x10...), 0 for other protocols */
+	uint8_t tcp_flags = 0;
 	TransportProtocol protocol = TransportProtocol::UNKNOWN;
 	std::string src;
 	std::string dst;
+	/* raw addresses in network byte order, IPv4 uses the first 4 bytes */
+	std::array<uint8_t, 16> src_addr{};
+	std::array<uint8_t, 16> dst_addr{};
+
+	/* end of the captured bytes, nothing at or past it is read */
+	const uint8_t *end = nullptr;
+	/* false if the IP header is malformed or wasn't captured in full */
+	bool header_ok = false;
+	/* at least n captured bytes start at p */
+	bool captured(const uint8_t *p, size_t n) const { return p <= end && static_cast<size_t>(end - p) >= n; }
+	/* keeps the payload for the classifier only if the bytes it looks at were captured */
+	void set_payload(const uint8_t *p) { payload_ptr = captured(p, PAYLOAD_PEEK) ? p : nullptr; }
 
   public:
 	std::string get_source();
 	std::string get_dest();
+	const std::array<uint8_t, 16> &get_source_addr() const { return src_addr; }
+	const std::array<uint8_t, 16> &get_dest_addr() const { return dst_addr; }
 	// getters
 	/*virtual std::string get_source() = 0;
 	virtual std::string get_dest() = 0;*/
 	virtual uint16_t get_src_port() = 0;
 	virtual uint16_t get_dest_port() = 0;
 
+	/* bytes of payload Packet::get_application_protocol() may read */
+	static constexpr size_t PAYLOAD_PEEK = 4;
+
+	/* false for a truncated or malformed IP header: the packet must be skipped, nothing else was decoded */
+	bool valid() const { return header_ok; }
 	TransportProtocol get_protocol() const;
 	uint16_t get_payload_len() const;
+	uint8_t get_tcp_flags() const { return tcp_flags; }
 
 	const uint8_t *payload_ptr = nullptr;
 	const uint8_t *get_payload_ptr() const { return payload_ptr; }
@@ -56,7 +79,8 @@ class IPv4 : public IP_class {
 	uint16_t get_src_port() override;
 	uint16_t get_dest_port() override;
 
-	explicit IPv4(const u_char *data);
+	/* decodes the caplen captured bytes at data, see valid() */
+	IPv4(const u_char *data, size_t caplen);
 };
 
 /*** ipv6 ***/
@@ -75,13 +99,14 @@ class IPv6 : public IP_class {
 	in6_addr ip_source;
 	in6_addr ip_dest;
 
-	uint16_t src_port;
-	uint16_t dest_port;
+	uint16_t src_port = 0;
+	uint16_t dest_port = 0;
 
 	const uint8_t *ptr = nullptr;
 
   public:
-	explicit IPv6(const u_char *data);
+	/* decodes the caplen captured bytes at data, see valid() */
+	IPv6(const u_char *data, size_t caplen);
 
 	uint16_t get_src_port() override;
 	uint16_t get_dest_port() override;
@@ -1,5 +1,6 @@
 #ifndef PACKET_HPP
 #define PACKET_HPP
+#include <array>
 #include <cstdint>
 #include <string>
 #include <utility>
@@ -37,6 +38,9 @@ struct Packet {
 	std::string src;
 	// dest address
 	std::string dst;
+	/* src / dst in network byte order as the IP header has them, IPv4 uses the first 4 bytes */
+	std::array<uint8_t, 16> src_addr{};
+	std::array<uint8_t, 16> dst_addr{};
 	uint16_t src_port;
 	uint16_t dst_port;
 
@@ -45,6 +49,11 @@ struct Packet {
 
 	const uint8_t *payload_ptr;
 
+	/* capture timestamp in nanoseconds since the epoch, 0 if unknown */
+	uint64_t ts_ns = 0;
+	/* TCP flags byte, 0 for other protocols */
+	uint8_t tcp_flags = 0;
+
 	Packet(IPVersion version, TransportProtocol protocol, std::string src, std::string dst, uint16_t src_port,
 		   uint16_t dst_port, uint32_t total_len, uint16_t payload, const uint8_t *payload_ptr)
 		: ip_version(version), transport_protocol(protocol), src(std::move(src)), dst(std::move(dst)),
@@ -53,7 +62,7 @@ struct Packet {
 		this->payload_ptr = nullptr;
 	}
 
-  private:
-	ApplicationProtocol get_application_protocol();
+	/* port and payload-signature classifier, payload_ptr is only valid during construction */
+	ApplicationProtocol get_application_protocol() const;
 };
 #endif // PACKET_HPP
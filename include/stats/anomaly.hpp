@@ -0,0 +1,173 @@
+#ifndef ANOMALY_HPP
+#define ANOMALY_HPP
+
+#include "../packet/packet.hpp"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+enum class AnomalyScope : uint8_t { GLOBAL, HOST, PORT };
+enum class AnomalyMetric : uint8_t { BYTES, PACKETS, NEW_PEERS, SYN };
+
+std::string anomaly_scope_to_str(AnomalyScope scope);
+std::string anomaly_metric_to_str(AnomalyMetric metric);
+
+struct AnomalyOptions {
+	/* length of one measurement interval, in packet time */
+	std::chrono::milliseconds interval{1000};
+	/* EWMA weight of the newest interval */
+	double alpha = 0.1;
+	/* an interval more than this many standard deviations above its baseline is flagged */
+	double threshold = 4.0;
+	/* intervals before the global baselines are trusted */
+	uint32_t warmup = 10;
+	/* the same key and metric isn't flagged again for this many intervals */
+	uint32_t cooldown = 30;
+	/* candidate keys tracked per scope and metric and interval */
+	size_t top_k = 32;
+	/* alerts kept for the UI and exports */
+	size_t history = 256;
+	/* per-second floors by metric (bytes, packets, new peers, syn) below which nothing is flagged */
+	std::array<double, 4> min_rate{1 << 20, 1000, 50, 100};
+};
+
+struct AnomalyAlert {
+	/* end of the flagged interval, packet time */
+	uint64_t ts_ns = 0;
+	AnomalyScope scope = AnomalyScope::GLOBAL;
+	AnomalyMetric metric = AnomalyMetric::BYTES;
+	/* host address, port number or "*" for global rates */
+	std::string key;
+	double value = 0;
+	/* EWMA mean and standard deviation before the interval */
+	double mean = 0;
+	double stddev = 0;
+};
+
+/**
+ * @brief Online spike detection on global, per-host and per-port rates.
+ *
+ * Counts bytes, packets, new peers and SYNs per interval of packet time
+ * and compares every interval against an EWMA mean / variance baseline.
+ *
+ * Per-key state is bounded: interval counts go into count-min sketches
+ * whose cells also carry their own EWMA mean and variance, so any key,
+ * including one never seen before, has a baseline (the row with the
+ * smallest mean, collisions only inflate it). Only the keys of a small
+ * top-K table per metric are tested when an interval closes. New peers
+ * are (src, dst) pairs absent from two generations of a Bloom filter.
+ *
+ * add() is O(1) per packet; closing an interval walks the fixed-size
+ * sketches once. Not thread-safe, Stats calls it under its lock.
+ */
+class AnomalyDetector {
+  public:
+	explicit AnomalyDetector(AnomalyOptions options);
+
+	void add(const Packet &packet);
+
+	const AnomalyOptions &options() const { return opts; }
+	/* newest last, at most options().history */
+	const std::deque<AnomalyAlert> &alerts() const { return recent; }
+	uint64_t alert_count() const { return total_alerts; }
+	/* takes over the alerts of another detector (parallel workers), keeping timestamp order */
+	void merge_alerts(const AnomalyDetector &other);
+	/* takes over alerts moved out of another detector with take_alerts() */
+	void merge_alerts(const std::deque<AnomalyAlert> &alerts, uint64_t count);
+	/* moves the alerts and their count into alerts / count, leaving this detector as clear_alerts() does */
+	void take_alerts(std::deque<AnomalyAlert> &alerts, uint64_t &count) {
+		alerts.clear();
+		alerts.swap(recent);
+		count = total_alerts;
+		total_alerts = 0;
+	}
+	/* forgets the alerts (once merged elsewhere), the baselines and cooldowns are kept */
+	void clear_alerts() {
+		recent.clear();
+		total_alerts = 0;
+	}
+
+  private:
+	static constexpr size_t DEPTH = 4;
+	static constexpr unsigned WIDTH_BITS = 10;
+	static constexpr size_t WIDTH = size_t(1) << WIDTH_BITS;
+	static constexpr size_t FILTER_BITS = size_t(1) << 20;
+
+	struct Ewma {
+		double mean = 0;
+		double var = 0;
+		void fold(double x, double alpha);
+	};
+
+	/* count-min sketch of the current interval plus per-cell EWMA baselines */
+	struct RateSketch {
+		std::vector<uint32_t> counts = std::vector<uint32_t>(DEPTH * WIDTH);
+		std::vector<Ewma> baseline = std::vector<Ewma>(DEPTH * WIDTH);
+		/* returns the new estimate of the key */
+		uint32_t add(uint64_t hash, uint32_t amount);
+		uint32_t estimate(uint64_t hash) const;
+		/* baseline of the row with the smallest mean */
+		const Ewma &baseline_of(uint64_t hash) const;
+		void close_interval(double alpha);
+		static size_t cell(size_t row, uint64_t hash);
+	};
+
+	/* the keys with the largest estimates this interval */
+	struct TopKeys {
+		struct Slot {
+			uint64_t hash;
+			uint32_t estimate;
+			std::string key;
+		};
+		std::vector<Slot> slots;
+		std::unordered_map<uint64_t, uint32_t> index;
+		uint32_t min_estimate = 0;
+		void offer(uint64_t hash, uint32_t estimate, std::string_view key, size_t k);
+		void clear();
+	};
+
+	/* one detector per scope and metric */
+	struct Track {
+		AnomalyScope scope;
+		AnomalyMetric metric;
+		RateSketch sketch;
+		TopKeys top;
+	};
+
+	/* two-generation Bloom filter of recently seen (src, dst) pairs */
+	struct PeerFilter {
+		std::vector<uint64_t> current = std::vector<uint64_t>(FILTER_BITS / 64);
+		std::vector<uint64_t> previous = std::vector<uint64_t>(FILTER_BITS / 64);
+		/* inserts the pair, returns true if it wasn't seen in either generation */
+		bool insert(uint64_t hash);
+		void rotate();
+	};
+
+	AnomalyOptions opts;
+	uint64_t interval_ns = 0;
+	uint64_t interval_end = 0;
+	uint32_t intervals = 0;
+
+	/* HOST: bytes, packets, new peers, syn; PORT: bytes, packets, syn */
+	std::vector<Track> tracks;
+	std::array<uint64_t, 4> global_counts{};
+	std::array<Ewma, 4> global_baseline{};
+	PeerFilter peers;
+
+	std::deque<AnomalyAlert> recent;
+	uint64_t total_alerts = 0;
+	/* end of the interval each scope / metric / key was last flagged in, until its cooldown is over */
+	std::unordered_map<uint64_t, uint64_t> flagged;
+
+	void count(Track &track, uint64_t hash, uint32_t amount, std::string_view key);
+	void close_interval();
+	/* records an alert if value is a spike against baseline */
+	void test(AnomalyScope scope, AnomalyMetric metric, const std::string &key, double value, const Ewma &baseline);
+};
+
+#endif // ANOMALY_HPP
@@ -0,0 +1,128 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include "../util/boundedQueue.hpp"
+#include "protocolStats.hpp"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+/*
+ * Checkpoint layout (.ntackpt), native little-endian, every section
+ * padded to 8 bytes:
+ *
+ *   CheckpointHeader
+ *   CheckpointTotals
+ *   transport  n_transport x {uint32 protocol, uint32 packets, uint32 bytes}
+ *   application n_application x same
+ *   strings    (n_strings + 1) x uint32 offsets, then string_bytes chars
+ *   ips        n_ips x IPStats, entry i belongs to string i
+ *   pairs      n_pairs x {uint32 src, uint32 dst, uint32 packets, uint32 bytes}, in key order
+ *   bandwidth  n_bandwidth x BandwidthPoint
+ *   timeline   n_timeline x {uint64 second, uint32 packets, uint32 bytes}, in time order
+ *   ports      n_ports x {uint8 protocol, uint8 pad, uint16 port, uint32 pad, uint64 packets_to, bytes_to,
+ *              packets_from, bytes_from}, only ports with traffic
+ *   networks   n_networks x {uint32 label string, uint32 pad, IPStats}, "(other)" for unmatched addresses
+ *
+ * Protocols are stored as their enum values; the version is bumped
+ * whenever those enums or the layout change.
+ */
+
+struct CheckpointHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t n_ports;
+	int64_t created_ns;
+	/* bytes following the header, a shorter file is truncated */
+	uint64_t payload_bytes;
+	uint64_t n_transport;
+	uint64_t n_application;
+	uint64_t n_strings;
+	uint64_t string_bytes;
+	uint64_t n_ips;
+	uint64_t n_pairs;
+	uint64_t n_bandwidth;
+	uint64_t n_timeline;
+	uint64_t n_networks;
+};
+
+struct CheckpointTotals {
+	uint64_t total_packets;
+	uint64_t total_bytes;
+	double bandwidth;
+	double max_bandwidth;
+};
+
+static_assert(sizeof(CheckpointHeader) == 104);
+static_assert(sizeof(CheckpointTotals) == 32);
+
+/* raw counters of one checkpoint, copied by Stats::copy_checkpoint() and serialized without the lock */
+struct CheckpointState {
+	CheckpointTotals totals{};
+	/* protocol enum values and their counters */
+	std::vector<std::pair<uint32_t, protocolStats>> transport;
+	std::vector<std::pair<uint32_t, protocolStats>> application;
+	std::vector<std::pair<std::string, IPStats>> ips;
+	/* in key order */
+	std::vector<PairCounter> pairs;
+	std::vector<BandwidthPoint> bandwidth;
+	/* in time order */
+	std::vector<std::pair<uint64_t, protocolStats>> timeline;
+	std::vector<PortTable::Entry> ports;
+	/* indexed like Stats::network_stats, null unless a prefix file was loaded */
+	std::shared_ptr<const PrefixTable> networks;
+	std::vector<IPStats> network_stats;
+};
+
+/* serializes state into out (the layout above) */
+void serialize_checkpoint(const CheckpointState &state, std::string &out);
+
+/*
+ * Loads path into stats if it exists. Returns false if there is no
+ * checkpoint yet; a file that exists but can't be used throws
+ * std::runtime_error rather than being silently replaced later.
+ */
+bool restore_checkpoint(Stats &stats, const std::string &path);
+
+/* writes a serialized checkpoint to path.tmp, syncs it and renames it over path */
+void write_checkpoint_file(const std::string &path, const std::string &data);
+
+/**
+ * @brief Saves Stats checkpoints periodically and on shutdown.
+ *
+ * tick() copies the counters under the Stats lock and hands them to a
+ * writer thread, which builds the string table and writes the file, so
+ * the update loop never waits on either. A checkpoint still being written makes the next one wait for
+ * the following interval. close() writes a final checkpoint synchronously.
+ */
+class Checkpointer {
+  private:
+	Stats &stats;
+	std::string path;
+	std::chrono::seconds interval;
+
+	BoundedQueue<CheckpointState> ready;
+	/* the last written state, reused by the next tick() */
+	BoundedQueue<CheckpointState> spare;
+	std::thread writer;
+	std::chrono::steady_clock::time_point next_save;
+	/* set while the writer thread owns a checkpoint */
+	std::atomic<bool> writing{false};
+	bool closed = false;
+
+	void run();
+
+  public:
+	/* interval 0 saves only on close() */
+	Checkpointer(Stats &stats, std::string path, std::chrono::seconds interval);
+	~Checkpointer();
+	Checkpointer(const Checkpointer &) = delete;
+	Checkpointer &operator=(const Checkpointer &) = delete;
+
+	void tick();
+	/* stops the writer thread and saves the final state */
+	void close();
+};
+
+#endif // CHECKPOINT_HPP
@@ -0,0 +1,103 @@
+#ifndef LATENCY_HPP
+#define LATENCY_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* instrumented stages of the pipeline */
+enum class LatencyStage : uint8_t {
+	PARSE,	   // got_packet(): link header, IP / transport parse, Packet view
+	LOCK_WAIT, // add_packet(): waiting for the Stats mutex
+	UPDATE,	   // one refresh of the update_* snapshot tables
+	SNAPSHOT,  // get_snapshot() copy
+	RENDER,	   // View::render()
+};
+constexpr size_t LATENCY_STAGES = 5;
+
+const char *latency_stage_name(LatencyStage stage);
+
+/* percentiles of one stage, nanoseconds */
+struct StageLatency {
+	std::string stage;
+	uint64_t count = 0;
+	double p50 = 0;
+	double p99 = 0;
+	double p999 = 0;
+	double max = 0;
+};
+
+/**
+ * @brief Per-stage latency histograms, off until enabled.
+ *
+ * A stage is timed with the cycle counter (rdtsc on x86, the virtual
+ * counter on arm64, the steady clock elsewhere) and counted into a
+ * histogram of the calling thread: log buckets with 16 linear steps per
+ * power of two, so every recorded value is within ~6% of its bucket. The
+ * thread never shares a cache line or takes a lock to record, histograms
+ * of threads that end are folded into a retired total. report() sums all
+ * of them and converts ticks to nanoseconds against the steady clock.
+ */
+class Latency {
+  public:
+	static constexpr unsigned SUB_BITS = 4;
+	static constexpr size_t SUB = size_t(1) << SUB_BITS;
+	/* values below SUB get a bucket each, then SUB buckets per power of two up to 2^63 */
+	static constexpr size_t BUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+	static void set_enabled(bool on);
+	static bool enabled() { return active.load(std::memory_order_relaxed); }
+
+	static uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#elif defined(__aarch64__)
+		uint64_t v;
+		asm volatile("mrs %0, cntvct_el0" : "=r"(v));
+		return v;
+#else
+		return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+	}
+
+	/* start of a timed stage, 0 when disabled */
+	static uint64_t start() { return enabled() ? ticks() : 0; }
+	/* ends a stage begun with start() */
+	static void stop(LatencyStage stage, uint64_t begin) {
+		if (begin)
+			record(stage, ticks() - begin);
+	}
+	static void record(LatencyStage stage, uint64_t elapsed_ticks);
+
+	static size_t bucket(uint64_t v);
+	/* smallest value counted into bucket b */
+	static uint64_t bucket_floor(size_t b);
+
+	/* every stage recorded so far, in LatencyStage order */
+	static std::vector<StageLatency> report();
+
+  private:
+	static inline std::atomic<bool> active{false};
+};
+
+/* times the enclosing scope as one sample of stage */
+class LatencyScope {
+  public:
+	explicit LatencyScope(LatencyStage stage) : stage(stage), begin(Latency::start()) {}
+	~LatencyScope() { Latency::stop(stage, begin); }
+	LatencyScope(const LatencyScope &) = delete;
+	LatencyScope &operator=(const LatencyScope &) = delete;
+
+  private:
+	LatencyStage stage;
+	uint64_t begin;
+};
+
+#endif // LATENCY_HPP
@@ -0,0 +1,116 @@
+#ifndef PERFCOUNTERS_HPP
+#define PERFCOUNTERS_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* hardware events counted per thread */
+enum class PerfEvent : uint8_t {
+	CYCLES,
+	INSTRUCTIONS,
+	LLC_MISSES,	  // last level cache read misses (generic cache misses where the CPU has no LL event)
+	BRANCH_MISSES,
+};
+constexpr size_t PERF_EVENTS = 4;
+
+const char *perf_event_name(PerfEvent event);
+
+struct PerfValues {
+	std::array<uint64_t, PERF_EVENTS> count{};
+	/* false where the CPU / kernel doesn't offer the event */
+	std::array<bool, PERF_EVENTS> available{};
+
+	uint64_t operator[](PerfEvent e) const { return count[static_cast<size_t>(e)]; }
+	bool has(PerfEvent e) const { return available[static_cast<size_t>(e)]; }
+	PerfValues &operator+=(const PerfValues &other);
+	/* counts since an earlier read() of the same counters */
+	PerfValues operator-(const PerfValues &earlier) const;
+};
+
+/**
+ * @brief Hardware counters of the calling thread (perf_event_open).
+ *
+ * The events are opened as one group led by the cycle counter, user
+ * space only, so they are scheduled together and the ratios between
+ * them hold even when the kernel multiplexes the PMU; read() scales the
+ * counts by the time the group actually ran. Opening never throws: in a
+ * container without CAP_PERFMON, above perf_event_paranoid 2 or in a VM
+ * without a virtual PMU available() is false and error() says why. The
+ * counters keep counting the opening thread, read() works from any.
+ */
+class PerfCounters {
+  public:
+	PerfCounters();
+	~PerfCounters();
+	PerfCounters(const PerfCounters &) = delete;
+	PerfCounters &operator=(const PerfCounters &) = delete;
+
+	bool available() const { return leader >= 0; }
+	const std::string &error() const { return failure; }
+	/* counts since the counters were opened */
+	PerfValues read() const;
+
+  private:
+	int leader = -1;
+	std::array<int, PERF_EVENTS> fds;
+	/* events in the order the group reports them */
+	std::array<PerfEvent, PERF_EVENTS> order{};
+	size_t opened = 0;
+	std::string failure;
+};
+
+/* threads whose counters are reported */
+enum class PerfRole : uint8_t {
+	CAPTURE,	 // capture threads: decode and add_packet
+	AGGREGATION, // the UI / headless loop: update_* tables, exports
+};
+constexpr size_t PERF_ROLES = 2;
+
+const char *perf_role_name(PerfRole role);
+
+/* what all threads of one role counted */
+struct PerfTotals {
+	std::string role;
+	unsigned threads = 0;
+	PerfValues values;
+};
+
+/**
+ * @brief Process-wide counters of the capture and aggregation threads, off until enabled.
+ *
+ * Each thread that does a role's work holds a Scope; counters of scopes
+ * that ended are kept in a per-role total, so short-lived offline
+ * workers still count.
+ */
+class PerfMonitor {
+  public:
+	static void set_enabled(bool on) { active.store(on, std::memory_order_relaxed); }
+	static bool enabled() { return active.load(std::memory_order_relaxed); }
+
+	/* every role that had a thread counting, in PerfRole order */
+	static std::vector<PerfTotals> report();
+	/* why the counters couldn't be opened, empty if they could */
+	static std::string error();
+
+	/* counts the calling thread for role while it exists; does nothing unless enabled */
+	class Scope {
+	  public:
+		explicit Scope(PerfRole role);
+		~Scope();
+		Scope(const Scope &) = delete;
+		Scope &operator=(const Scope &) = delete;
+
+	  private:
+		PerfRole role;
+		std::unique_ptr<PerfCounters> counters;
+	};
+
+  private:
+	static inline std::atomic<bool> active{false};
+};
+
+#endif // PERFCOUNTERS_HPP
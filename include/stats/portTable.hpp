@@ -0,0 +1,61 @@
+#ifndef PORTTABLE_HPP
+#define PORTTABLE_HPP
+
+#include "../packet/packet.hpp"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Per-port packet and byte counters of TCP and UDP, by direction.
+ *
+ * Every (protocol, direction) has flat 65536-entry arrays indexed by the
+ * port number itself, so add() is four increments without any hashing.
+ * "to" counts packets whose destination port it is (requests to a
+ * service), "from" those whose source port it is (its answers).
+ *
+ * The arrays are cache-line aligned and laid out back to back, merge()
+ * is one straight loop over all of them that the compiler vectorizes.
+ * About 4 MiB; Stats allocates it on the first TCP / UDP packet.
+ */
+class PortTable {
+  public:
+	static constexpr size_t PORTS = 65536;
+
+	struct Entry {
+		TransportProtocol protocol;
+		uint16_t port;
+		uint64_t packets_to, bytes_to;
+		uint64_t packets_from, bytes_from;
+		uint64_t bytes() const { return bytes_to + bytes_from; }
+	};
+
+	/* ignores protocols other than TCP and UDP */
+	void add(TransportProtocol protocol, uint16_t src_port, uint16_t dst_port, uint32_t len);
+	/* sums the counters of other into this table */
+	void merge(const PortTable &other);
+	/* zeroes every counter in place */
+	void clear();
+	/* the k ports with the most bytes (both directions), descending; one pass with a k-sized heap */
+	std::vector<Entry> top(size_t k) const;
+	/* every port with traffic, in (protocol, port) order */
+	std::vector<Entry> entries() const;
+	/* adds the counters of one entry (checkpoint restore) */
+	void add_entry(const Entry &e);
+
+  private:
+	/* TCP to, TCP from, UDP to, UDP from */
+	static constexpr size_t ARRAYS = 4;
+
+	struct alignas(64) Counters {
+		std::array<uint64_t, PORTS> packets;
+		std::array<uint64_t, PORTS> bytes;
+	};
+
+	std::array<Counters, ARRAYS> counters{};
+
+	static int base_of(TransportProtocol protocol);
+	Entry entry(size_t base, uint16_t port) const;
+};
+
+#endif // PORTTABLE_HPP
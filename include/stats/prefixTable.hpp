@@ -0,0 +1,115 @@
+#ifndef PREFIXTABLE_HPP
+#define PREFIXTABLE_HPP
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Longest-prefix match of IPv4 / IPv6 addresses to network labels.
+ *
+ * A multibit trie per address family with prefix expansion: a direct
+ * 65536-entry root for the first 16 bits, then 8-bit strides (16-8-8
+ * for IPv4). The trie is first built expanded, every 256-entry chunk
+ * holding either the label of the longest prefix covering an entry or a
+ * child, then compiled poptrie style: a node keeps a 256-bit child
+ * bitmap and a 256-bit bitmap of where runs of equal leaves start, and
+ * popcounts turn a position into an index of the packed children /
+ * leaves. That's ~90 bytes per node instead of 1 KiB, so the hot part of
+ * a full routing table stays in cache.
+ *
+ * A lookup is one root read plus one node per further byte of the
+ * prefix length, no prefix comparisons. Built once at startup, immutable
+ * afterwards and shared by every Stats.
+ */
+class PrefixTable {
+  public:
+	static constexpr uint32_t NONE = UINT32_MAX;
+
+	/*
+	 * Loads "prefix label" lines (e.g. "10.1.0.0/16 office" or
+	 * "2001:db8::/32 AS64500 Example"); the label is the rest of the
+	 * line, '#' starts a comment. A bare address is a host prefix.
+	 * Throws std::runtime_error naming the line of a malformed entry.
+	 */
+	static PrefixTable load(const std::string &path);
+
+	/* adds a prefix (throws std::invalid_argument if it isn't one); build() must follow before any lookup */
+	void insert(std::string_view prefix, std::string_view label);
+	void build();
+
+	/* label id of the longest prefix containing address, NONE if there is none or it isn't an address */
+	uint32_t lookup(const std::string &address) const;
+	/* same for a raw address in network byte order (IPv4 in the first 4 bytes), nothing to parse */
+	uint32_t lookup(const uint8_t *addr, bool ipv6) const { return ipv6 ? v6.lookup(addr) : v4.lookup(addr); }
+
+	const std::string &label(uint32_t id) const { return labels[id]; }
+	size_t label_count() const { return labels.size(); }
+	/* id of a label by name, NONE if unknown */
+	uint32_t find_label(std::string_view name) const;
+	size_t prefix_count() const { return prefixes; }
+
+	/* parses a packet address into out (IPv4 uses the first 4 bytes), returns 4, 6 or 0 if it isn't one */
+	static int parse_address(const std::string &address, uint8_t *out);
+	/* parses "addr[/len]" into out, len and the family; throws std::invalid_argument if it isn't a prefix */
+	static void parse_prefix(std::string_view prefix, uint8_t *out, uint8_t &len, bool &v6);
+
+  private:
+	/* root entries: 0 = no match, CHILD | node index, else label id + 1 */
+	static constexpr uint32_t CHILD = 0x80000000u;
+	static constexpr size_t ROOT_BITS = 16;
+	static constexpr size_t CHUNK = 256;
+
+	struct Pending {
+		std::array<uint8_t, 16> addr;
+		uint8_t len;
+		bool v6;
+		uint32_t label;
+	};
+
+	/* expanded trie, only alive during build() */
+	struct Expanded {
+		std::vector<uint32_t> root = std::vector<uint32_t>(size_t(1) << ROOT_BITS);
+		/* 256-entry chunks back to back, entries encoded like the root */
+		std::vector<uint32_t> chunks;
+		void insert(const uint8_t *addr, unsigned len, uint32_t value);
+		/* sets every entry of a chunk and its descendants */
+		void fill(uint32_t chunk, uint32_t value);
+	};
+
+	/* one compiled 256-entry chunk */
+	struct Node {
+		/* set for entries that continue in a child */
+		std::array<uint64_t, 4> child;
+		/* set for leaf entries whose value differs from the previous leaf */
+		std::array<uint64_t, 4> run;
+		uint32_t child_base;
+		uint32_t leaf_base;
+		/* bits set in the preceding words */
+		std::array<uint16_t, 4> children_before;
+		std::array<uint16_t, 4> runs_before;
+	};
+
+	struct Trie {
+		std::vector<uint32_t> root = std::vector<uint32_t>(size_t(1) << ROOT_BITS);
+		std::vector<Node> nodes;
+		/* label id + 1, 0 = no match */
+		std::vector<uint32_t> leaves;
+		void compile(const Expanded &expanded);
+		/* compiles expanded chunk into nodes[index], its children go to the end of nodes */
+		void compile_node(const Expanded &expanded, uint32_t chunk, uint32_t index);
+		uint32_t lookup(const uint8_t *addr) const;
+	};
+
+	Trie v4;
+	Trie v6;
+	std::vector<std::string> labels;
+	std::unordered_map<std::string, uint32_t> label_ids;
+	std::vector<Pending> pending;
+	size_t prefixes = 0;
+};
+
+#endif // PREFIXTABLE_HPP
@@ -2,10 +2,21 @@
 #define PROTOCOLSTATS_HPP
 
 #include "../packet/packet.hpp"
+#include "anomaly.hpp"
+#include "latency.hpp"
+#include "perfCounters.hpp"
+#include "portTable.hpp"
+#include "prefixTable.hpp"
+#include "scanDetector.hpp"
 #include "ftxui/dom/elements.hpp"
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <filesystem>
+#include <deque>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <queue>
 #include <unordered_map>
 
@@ -27,17 +38,83 @@ struct IPStats {
 	uint32_t packets_received = 0;
 };
 
+/* totals of one capture interface when several are captured at once */
+struct InterfaceStats {
+	std::string name;
+	uint64_t packets = 0;
+	uint64_t bytes = 0;
+	/* packets the kernel / driver dropped, as reported by pcap_stats() */
+	uint64_t dropped = 0;
+	/* bytes in the last complete second of packet time */
+	double bandwidth = 0;
+};
+
+/* cumulative counters of one src -> dst pair */
+struct PairCounter {
+	std::string src;
+	std::string dst;
+	protocolStats stats;
+};
+
 struct BandwidthPoint {
 	double timestamp;
 	double bytes_per_sec;
 };
 
+/* snapshot tables that can be sorted and paged */
+enum class SnapshotTable {
+	TRANSPORT,
+	APPLICATION,
+	IPS,
+	PAIRS,
+	PORTS,
+	NETWORKS,
+};
+constexpr size_t SNAPSHOT_TABLES = 6;
+
+/* sort column, direction and visible window of one snapshot table */
+struct TableView {
+	size_t column = 0;
+	bool descending = true;
+	/* first row of the window and rows per window */
+	size_t offset = 0;
+	size_t page = 10;
+};
+
+/* what a snapshot table holds: rows [view.offset, view.offset + view.page) of total, in view order */
+struct TablePage {
+	/* offset clamped to the last full window */
+	TableView view;
+	size_t total = 0;
+	size_t columns = 0;
+};
+
+/* column of table that --sort key ("bytes", "packets" or "ip") selects, throws std::invalid_argument otherwise */
+size_t sort_column(SnapshotTable table, const std::string &key);
+
 struct StatsSnapshot {
 	std::vector<std::vector<std::string>> transport_rows;
 	std::vector<std::vector<std::string>> app_rows;
 	std::vector<std::vector<std::string>> rows;
 	std::vector<std::vector<std::string>> pairs_rows;
 	std::vector<std::vector<std::string>> packets_rows;
+	std::vector<std::vector<std::string>> port_rows;
+	/* empty unless a prefix file was loaded */
+	std::vector<std::vector<std::string>> network_rows;
+	/* newest alerts first, empty unless anomaly detection is enabled */
+	std::vector<std::vector<std::string>> alert_rows;
+	/* newest scan / flood findings first, empty unless scan detection is enabled */
+	std::vector<std::vector<std::string>> scan_rows;
+	/* one row per interface, empty unless several interfaces are captured */
+	std::vector<std::vector<std::string>> interface_rows;
+	/* p50 / p99 / p999 per pipeline stage, empty unless latency recording is on */
+	std::vector<std::vector<std::string>> latency_rows;
+	/* hardware counters per packet of the capture / aggregation threads, empty unless --perf */
+	std::vector<std::vector<std::string>> perf_rows;
+	/* why --perf has no counters to show */
+	std::string perf_error;
+	/* window and sort order of the tables above, indexed by SnapshotTable */
+	std::array<TablePage, SNAPSHOT_TABLES> pages;
 
 	uint32_t total_p = 0, total_b = 0;
 	// bandwidth
@@ -46,6 +123,79 @@ struct StatsSnapshot {
 	double max_bandwidth = 0;
 };
 
+/**
+ * @brief Numeric counters published for external scrapers.
+ *
+ * Immutable once published; readers hold a shared_ptr and never touch
+ * Stats::mtx.
+ */
+struct MetricsSnapshot {
+	struct Counter {
+		std::string name;
+		uint64_t packets;
+		uint64_t bytes;
+	};
+	struct Talker {
+		std::string ip;
+		IPStats stats;
+	};
+
+	double timestamp = 0;
+	uint64_t total_packets = 0;
+	uint64_t total_bytes = 0;
+	double bandwidth = 0;
+	double max_bandwidth = 0;
+	uint64_t alerts = 0;
+	uint64_t scan_alerts = 0;
+	std::vector<Counter> transport;
+	std::vector<Counter> application;
+	/* sorted by bytes sent, descending */
+	std::vector<Talker> top_talkers;
+	/* empty unless several interfaces are captured */
+	std::vector<InterfaceStats> interfaces;
+	/* empty unless latency recording is on */
+	std::vector<StageLatency> latency;
+};
+
+/**
+ * @brief Raw counters of one NDJSON record.
+ *
+ * Stats::copy_ndjson() fills it while holding the lock, format_ndjson()
+ * turns it into text on the exporter's I/O thread. Reused between
+ * records so the vectors and strings keep their capacity.
+ */
+struct NdjsonRecord {
+	uint64_t seq = 0;
+	double timestamp = 0;
+	uint32_t total_p = 0, total_b = 0;
+	double bandwidth = 0;
+	double max_bandwidth = 0;
+	std::vector<InterfaceStats> interfaces;
+	std::vector<StageLatency> latency;
+	std::vector<std::pair<TransportProtocol, protocolStats>> transport;
+	std::vector<std::pair<ApplicationProtocol, protocolStats>> application;
+	std::vector<std::pair<std::string, IPStats>> ips;
+	std::vector<PairCounter> pairs;
+	/* the top ports, only written when has_ports */
+	bool has_ports = false;
+	std::vector<PortTable::Entry> ports;
+	/* null unless a prefix file was loaded; indexed like Stats::network_stats */
+	std::shared_ptr<const PrefixTable> networks;
+	std::vector<IPStats> network_stats;
+	/* alerts / findings raised since the last record that was queued */
+	std::vector<AnomalyAlert> alerts;
+	std::vector<ScanAlert> scans;
+	/* alert_count() of each detector when the record was copied */
+	uint64_t alert_total = 0;
+	uint64_t scan_total = 0;
+};
+
+/* appends one NDJSON line per section of rec (summary, interfaces, transport, ... scans) to out */
+void format_ndjson(const NdjsonRecord &rec, std::string &out);
+
+/* defined in checkpoint.hpp */
+struct CheckpointState;
+
 /**
  * @brief Thread-safe statistics engine.
  *
@@ -62,23 +212,76 @@ class Stats {
   private:
 	std::mutex mtx;
 
-	uint32_t last_b = 0;
-
-	std::chrono::steady_clock::time_point last_tick;
-
 	std::unordered_map<TransportProtocol, protocolStats> transport_map;
 	std::unordered_map<ApplicationProtocol, protocolStats> application_map;
 	std::unordered_map<std::string, IPStats> ip_map;
 
 	std::map<std::pair<std::string, std::string>, protocolStats> pairs;
 
+	/* traffic per second of packet time (epoch seconds), mergeable across files and runs */
+	std::map<uint64_t, protocolStats> timeline;
+	/* slot of the last second seen, packets mostly arrive in time order */
+	uint64_t timeline_sec = UINT64_MAX;
+	protocolStats *timeline_slot = nullptr;
+	/* set once the bandwidth history was derived from the timeline */
+	bool packet_time_bandwidth = false;
+	/* next second of packet time update_bandwidth() appends to the history, 0 before its first call */
+	uint64_t history_sec = 0;
+
+	/* TCP / UDP counters per port, allocated with the first such packet */
+	std::unique_ptr<PortTable> ports;
+
+	/* optional address -> network label mapping and the counters per label */
+	std::shared_ptr<const PrefixTable> networks;
+	/* index 0 collects unmatched addresses, label i is at i + 1 */
+	std::vector<IPStats> network_stats;
+
 	std::deque<Packet> packets;
 	int limit_packets = 10;
 
 	StatsSnapshot snapshot;
 
+	std::atomic<std::shared_ptr<const MetricsSnapshot>> published_metrics;
+
+	/* optional spike detection fed by add_packet() */
+	std::unique_ptr<AnomalyDetector> anomaly;
+	/* alerts already in a queued NDJSON record, see ndjson_queued() */
+	uint64_t ndjson_alerts = 0;
+
+	/* optional port-scan / SYN-flood detection fed by add_packet() */
+	std::unique_ptr<ScanDetector> scans;
+	/* findings already in a queued NDJSON record */
+	uint64_t ndjson_scans = 0;
+
+	/* per-interface totals, filled by drain() */
+	std::vector<InterfaceStats> interfaces;
+	/* bytes per second of packet time of each interface, until update_bandwidth() has used them */
+	std::vector<std::map<uint64_t, uint64_t>> interface_timelines;
+
+	/* what drain() swaps out of a shard: its counters in an engine of their own and the detectors' alerts */
+	struct Drained {
+		std::unique_ptr<Stats> counters;
+		std::deque<AnomalyAlert> alerts;
+		uint64_t alert_total = 0;
+		std::deque<ScanAlert> scans;
+		uint64_t scan_total = 0;
+	};
+	/* reused by every drain() of this shard, one at a time */
+	Drained drained;
+	std::mutex drain_mtx;
+
+	/* merge() with both locks held */
+	void merge_locked(Stats &other);
+	/* resets every counter, keeping options, detector state and the prefix table */
+	void clear_locked();
+	/* swaps the counters with the zeroed ones of out.counters and moves the alerts into out, shard lock held */
+	void take_locked(Drained &out);
+
   public:
 	void push(const Packet &p) {
+		/* the recent packets list only feeds the UI, a zero limit disables it */
+		if (limit_packets <= 0)
+			return;
 		std::lock_guard<std::mutex> lock(mtx);
 		if (packets.size() > static_cast<long unsigned int>(limit_packets)) {
 			packets.pop_front();
@@ -87,22 +290,90 @@ class Stats {
 	}
 
 	StatsSnapshot get_snapshot() {
+		LatencyScope scope(LatencyStage::SNAPSHOT);
 		std::lock_guard<std::mutex> lock(mtx);
 		return snapshot;
 	}
+	/* last bandwidth sample in bytes per second */
+	double current_bandwidth() {
+		std::lock_guard<std::mutex> lock(mtx);
+		return snapshot.bandwidth;
+	}
+	/* appends the seconds of packet time that are complete by the system clock to the bandwidth history */
 	void update_bandwidth();
+	/* replaces the bandwidth history with one point per second of packet time (offline / merged results) */
+	void bandwidth_from_timeline();
 	double smooth_value(size_t i, size_t start);
-	double smooth_bandwidth = 0.0;
 
 	void set_packets_limit(int limit) { limit_packets = limit; }
+	int get_packets_limit() const { return limit_packets; }
 
 	void add_packet(const Packet &packet);
 
-	void update_transport_stats();
-	void update_application_stats();
-	void update_ip_stats(size_t limit);
-	void update_pairs(size_t limit = 10);
+	/* rebuild one window of a table, sorted by view, see select_page() */
+	void update_transport_stats(const TableView &view = {});
+	void update_application_stats(const TableView &view = {});
+	void update_ip_stats(const TableView &view = {});
+	void update_pairs(const TableView &view = {});
+	void update_ports(const TableView &view = {});
+	void update_networks(const TableView &view = {});
 	void update_packets();
+	void update_alerts(size_t limit = 10);
+	void update_scans(size_t limit = 10);
+	void update_interfaces();
+	/* the latency histograms are process-wide, every engine shows the same rows */
+	void update_latency();
+	/* hardware counters per packet counted by this engine */
+	void update_perf();
+
+	void enable_anomaly_detection(const AnomalyOptions &options);
+	/* options of the detector, null when detection is off */
+	const AnomalyOptions *anomaly_options() const { return anomaly ? &anomaly->options() : nullptr; }
+	/* attributes every packet's source and destination to a network of table */
+	void set_networks(std::shared_ptr<const PrefixTable> table);
+	const std::shared_ptr<const PrefixTable> &network_table() const { return networks; }
+
+	void enable_scan_detection(const ScanOptions &options);
+	const ScanOptions *scan_options() const { return scans ? &scans->options() : nullptr; }
+	/* anomaly alerts and scan findings raised so far */
+	uint64_t alert_count() {
+		std::lock_guard<std::mutex> lock(mtx);
+		return (anomaly ? anomaly->alert_count() : 0) + (scans ? scans->alert_count() : 0);
+	}
+
+	/* one-line JSON summary built straight from the counters, no snapshot tables involved */
+	std::string summary_json(size_t top);
+
+	/* copies the counters of the next NDJSON record into rec (reusing its storage), format with format_ndjson() */
+	void copy_ndjson(NdjsonRecord &rec, uint64_t seq);
+	/* a record with these alert_total / scan_total was queued, later records only carry newer alerts */
+	void ndjson_queued(uint64_t alert_total, uint64_t scan_total);
+
+	/* copies every pair counter into out (reusing its storage), returns the traffic totals */
+	trafficStats copy_pairs(std::vector<PairCounter> &out);
+
+	/* copies the counters into a new MetricsSnapshot and publishes it */
+	void publish_metrics(size_t top);
+	/* last published metrics, lock-free, may be null before the first publish */
+	std::shared_ptr<const MetricsSnapshot> metrics() const { return published_metrics.load(); }
+
+	/* copies the full counter state into state (reusing its storage), see checkpoint.hpp */
+	void copy_checkpoint(CheckpointState &state);
+	/* serializes the full counter state into out (checkpoint format, see checkpoint.hpp) */
+	void save_checkpoint(std::string &out);
+	/* replaces the counter state with a serialized checkpoint, throws std::runtime_error if it is invalid */
+	void load_checkpoint(const uint8_t *data, size_t len);
+
+	/* adds all counters of other into this engine (e.g. partial results of parallel workers) */
+	void merge(Stats &other);
+
+	/* names the capture interfaces whose shards are drained into this engine */
+	void set_interfaces(const std::vector<std::string> &names);
+	/*
+	 * merges the shard of interface link into this engine and empties it,
+	 * crediting its traffic and the kernel drop count to that interface
+	 */
+	void drain(Stats &shard, size_t link, uint64_t dropped);
 
 	void export_csv(const std::string &filename);
 	void export_json(const std::string &filename);
@@ -0,0 +1,136 @@
+#ifndef SCANDETECTOR_HPP
+#define SCANDETECTOR_HPP
+
+#include "../packet/packet.hpp"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+enum class ScanKind : uint8_t { PORT_SCAN, HOST_SWEEP, SYN_FLOOD };
+
+std::string scan_kind_to_str(ScanKind kind);
+
+struct ScanOptions {
+	/* counters are evaluated and reset every window of packet time */
+	std::chrono::seconds window{10};
+	/* distinct destination ports of one source that make a port scan */
+	uint32_t port_threshold = 100;
+	/* distinct destination hosts of one source that make a host sweep */
+	uint32_t host_threshold = 50;
+	/* SYNs to one destination per window that may be a flood */
+	uint32_t flood_syns = 5000;
+	/* ...if at least this share of them stays half-open */
+	double flood_half_open = 0.8;
+	/* windows before the same finding is reported again */
+	uint32_t cooldown = 6;
+	/* findings kept for the UI and exports */
+	size_t history = 256;
+};
+
+struct ScanAlert {
+	/* end of the window, packet time */
+	uint64_t ts_ns = 0;
+	ScanKind kind = ScanKind::PORT_SCAN;
+	/* scanning source, or flooded destination */
+	std::string key;
+	uint32_t syns = 0;
+	/* estimated distinct ports / hosts / sources */
+	uint32_t distinct = 0;
+	/* share of SYNs that got no SYN-ACK (scans) or no completing ACK (floods) */
+	double half_open = 0;
+};
+
+/**
+ * @brief Port-scan, host-sweep and SYN-flood detection in constant memory.
+ *
+ * Sources and destinations of TCP SYNs live in two fixed 2-way set
+ * associative tables; a new key evicts the less active entry of its
+ * set, so an attack with millions of (spoofed) addresses only churns
+ * the tables. Every entry counts SYNs and their answers and estimates
+ * distinct ports, hosts or sources with a 64-register HyperLogLog
+ * (about 13% error), enough to tell 5 ports from 500.
+ *
+ * Sources: SYNs sent, SYN-ACKs received, distinct destination ports and
+ * hosts. Destinations: SYNs received, bare ACKs received (completed
+ * handshakes, roughly), distinct sources. Nothing is allocated after
+ * construction. Not thread-safe, Stats calls it under its lock.
+ */
+class ScanDetector {
+  public:
+	explicit ScanDetector(ScanOptions options);
+
+	void add(const Packet &packet);
+
+	const ScanOptions &options() const { return opts; }
+	/* newest last, at most options().history */
+	const std::deque<ScanAlert> &alerts() const { return recent; }
+	uint64_t alert_count() const { return total_alerts; }
+	/* takes over the findings of another detector (parallel workers), keeping timestamp order */
+	void merge_alerts(const ScanDetector &other);
+	/* takes over findings moved out of another detector with take_alerts() */
+	void merge_alerts(const std::deque<ScanAlert> &alerts, uint64_t count);
+	/* moves the findings and their count into alerts / count, leaving this detector as clear_alerts() does */
+	void take_alerts(std::deque<ScanAlert> &alerts, uint64_t &count) {
+		alerts.clear();
+		alerts.swap(recent);
+		count = total_alerts;
+		total_alerts = 0;
+	}
+	/* forgets the findings (once merged elsewhere), the per-source state is kept */
+	void clear_alerts() {
+		recent.clear();
+		total_alerts = 0;
+	}
+
+  private:
+	static constexpr size_t SLOTS = 4096;
+	static constexpr size_t KEY_LEN = 46;
+
+	struct Hll {
+		std::array<uint8_t, 64> registers{};
+		void add(uint64_t hash);
+		uint32_t estimate() const;
+	};
+
+	struct SourceEntry {
+		uint64_t hash = 0;
+		char key[KEY_LEN] = {};
+		uint32_t syns = 0;
+		uint32_t synacks = 0;
+		Hll ports;
+		Hll hosts;
+		/* window of the last port scan / host sweep report, 0 = never */
+		std::array<uint32_t, 2> reported{};
+	};
+
+	struct DestEntry {
+		uint64_t hash = 0;
+		char key[KEY_LEN] = {};
+		uint32_t syns = 0;
+		uint32_t acks = 0;
+		Hll sources;
+		uint32_t reported = 0;
+	};
+
+	ScanOptions opts;
+	uint64_t window_ns = 0;
+	uint64_t window_end = 0;
+	uint32_t window = 1;
+
+	std::vector<SourceEntry> sources;
+	std::vector<DestEntry> destinations;
+
+	std::deque<ScanAlert> recent;
+	uint64_t total_alerts = 0;
+
+	/* entry of hash, or (admit) a fresh one replacing the less active entry of its set */
+	template <class Entry> static Entry *lookup(std::vector<Entry> &table, uint64_t hash, const std::string &key,
+												bool admit);
+	void close_window();
+	void report(ScanKind kind, const char *key, uint32_t syns, uint32_t distinct, double half_open);
+};
+
+#endif // SCANDETECTOR_HPP
@@ -0,0 +1,93 @@
+#ifndef BOUNDEDQUEUE_HPP
+#define BOUNDEDQUEUE_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+/**
+ * @brief Fixed-capacity MPMC queue used to hand buffers between threads.
+ *
+ * push() blocks while the queue is full, which gives producers natural
+ * backpressure. try_push() never blocks and is meant for threads that
+ * must not wait (e.g. the capture thread). close() wakes everybody up;
+ * pop() keeps draining what is left and then returns std::nullopt.
+ */
+template <class T> class BoundedQueue {
+  private:
+	std::mutex mtx;
+	std::condition_variable not_empty;
+	std::condition_variable not_full;
+	std::deque<T> items;
+	size_t capacity;
+	bool closed = false;
+
+  public:
+	explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+	bool push(T item) {
+		std::unique_lock<std::mutex> lock(mtx);
+		not_full.wait(lock, [this] { return closed || items.size() < capacity; });
+		if (closed)
+			return false;
+		items.push_back(std::move(item));
+		not_empty.notify_one();
+		return true;
+	}
+
+	bool try_push(T item) {
+		std::lock_guard<std::mutex> lock(mtx);
+		if (closed || items.size() >= capacity)
+			return false;
+		items.push_back(std::move(item));
+		not_empty.notify_one();
+		return true;
+	}
+
+	std::optional<T> pop() {
+		std::unique_lock<std::mutex> lock(mtx);
+		not_empty.wait(lock, [this] { return closed || !items.empty(); });
+		if (items.empty())
+			return std::nullopt;
+		T item = std::move(items.front());
+		items.pop_front();
+		not_full.notify_one();
+		return item;
+	}
+
+	template <class Rep, class Period> std::optional<T> pop_for(std::chrono::duration<Rep, Period> timeout) {
+		std::unique_lock<std::mutex> lock(mtx);
+		if (!not_empty.wait_for(lock, timeout, [this] { return closed || !items.empty(); }) || items.empty())
+			return std::nullopt;
+		T item = std::move(items.front());
+		items.pop_front();
+		not_full.notify_one();
+		return item;
+	}
+
+	std::optional<T> try_pop() {
+		std::lock_guard<std::mutex> lock(mtx);
+		if (items.empty())
+			return std::nullopt;
+		T item = std::move(items.front());
+		items.pop_front();
+		not_full.notify_one();
+		return item;
+	}
+
+	void close() {
+		std::lock_guard<std::mutex> lock(mtx);
+		closed = true;
+		not_empty.notify_all();
+		not_full.notify_all();
+	}
+
+	bool is_closed() {
+		std::lock_guard<std::mutex> lock(mtx);
+		return closed;
+	}
+};
+
+#endif // BOUNDEDQUEUE_HPP
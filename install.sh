@@ -24,13 +24,13 @@ install_just() {
 install_deps() {
     echo "==> Installing build dependencies..."
     if command -v apt &>/dev/null; then
-        sudo apt install -y libboost-program-options-dev libpcap-dev cmake ninja-build g++ clang-tidy clang-format
+        sudo apt install -y libboost-program-options-dev libpcap-dev zlib1g-dev libzstd-dev cmake ninja-build g++ clang-tidy clang-format
     elif command -v dnf &>/dev/null; then
-        sudo dnf install -y boost-devel libpcap-devel cmake ninja-build gcc-c++ clang-tools-extra
+        sudo dnf install -y boost-devel libpcap-devel zlib-devel libzstd-devel cmake ninja-build gcc-c++ clang-tools-extra
     elif command -v pacman &>/dev/null; then
-        sudo pacman -S --needed boost libpcap cmake ninja gcc clang
+        sudo pacman -S --needed boost libpcap zlib zstd cmake ninja gcc clang
     else
-        echo "Unsupported package manager. Install manually: boost, libpcap, cmake, ninja, g++, clang-tidy, clang-format"
+        echo "Unsupported package manager. Install manually: boost, libpcap, zlib, zstd, cmake, ninja, g++, clang-tidy, clang-format"
         exit 1
     fi
     echo "==> Dependencies ready."
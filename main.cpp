@@ -4,15 +4,81 @@
 #include <ftxui/component/component.hpp>
 #include <ftxui/component/component_options.hpp>
 #include <ftxui/component/screen_interactive.hpp>
+#include <glob.h>
 #include <iostream>
 #include <pcap/pcap.h>
 
+#include "include/TUI/tableNavigator.hpp"
 #include "include/TUI/view.hpp"
 #include "include/cli/argsParse.hpp"
+#include "include/cli/displayFilter.hpp"
+#include "include/cli/headless.hpp"
+#include "include/cli/query.hpp"
+#include "include/export/flowArchive.hpp"
+#include "include/export/metricsServer.hpp"
+#include "include/export/ndjsonExporter.hpp"
+#include "include/stats/checkpoint.hpp"
+
+/* collects --from/--to and --range, "+N" bounds are relative to the first packet of the capture */
+static std::vector<TimeRange> time_ranges(const po::variables_map &vm, const std::string &path) {
+	std::vector<std::string> specs;
+	if (vm.contains("from") || vm.contains("to")) {
+		specs.push_back((vm.contains("from") ? vm["from"].as<std::string>() : "") + "," +
+						(vm.contains("to") ? vm["to"].as<std::string>() : ""));
+	}
+	if (vm.contains("range")) {
+		for (const auto &r : vm["range"].as<std::vector<std::string>>())
+			specs.push_back(r);
+	}
+
+	uint64_t start = 0;
+	for (const auto &spec : specs) {
+		if (spec.find('+') != std::string::npos) {
+			start = first_capture_timestamp(path);
+			if (!start)
+				throw std::invalid_argument("Relative time bounds need a first packet, " + path + " has none");
+			break;
+		}
+	}
+
+	std::vector<TimeRange> ranges;
+	for (const auto &spec : specs)
+		ranges.push_back(parse_time_range(spec, start));
+	/* overlapping windows would count the packets they share twice */
+	return coalesce_ranges(std::move(ranges));
+}
+
+/* expands --offline arguments with glob(3), plain paths are kept as given; throws if a pattern matches nothing */
+static std::vector<std::string> offline_files(const std::vector<std::string> &args) {
+	std::vector<std::string> files;
+	for (const auto &arg : args) {
+		if (arg.find_first_of("*?[") == std::string::npos) {
+			files.push_back(arg);
+			continue;
+		}
+		glob_t g{};
+		int rc = glob(arg.c_str(), 0, nullptr, &g);
+		if (rc == 0)
+			files.insert(files.end(), g.gl_pathv, g.gl_pathv + g.gl_pathc);
+		globfree(&g);
+		if (rc != 0)
+			throw std::invalid_argument("No files match " + arg);
+	}
+	return files;
+}
 
 int main(int argc, char **argv) {
+	/* subcommands that don't capture anything */
+	if (argc > 1 && std::string(argv[1]) == "query")
+		return run_query(argc - 1, argv + 1);
+
 	/* initialize stats */
 	Stats stats;
+	/* declared before the capture so the capture thread is joined before these go away */
+	std::unique_ptr<FlowExporter> flow_exporter;
+	std::unique_ptr<CaptureWriter> capture_writer;
+	std::unique_ptr<PacketRing> packet_ring;
+	std::unique_ptr<Replayer> replayer;
 	/* initialize capture */
 	PcapCapture capture;
 	capture.initialize();
@@ -48,29 +114,350 @@ int main(int argc, char **argv) {
 	/* converting the filter to a pcap readable string */
 	std::string expression = get_bpf_filter(filters);
 
-	bool isOffline = parser.vm.contains("offline");
+	/* merged checkpoints are a finished result, like an offline file */
+	bool isOffline = parser.vm.contains("offline") || parser.vm.contains("merge");
+	bool headless = parser.vm.contains("headless");
+	if (isOffline && parser.vm.contains("replay"))
+		throw std::invalid_argument("--replay can't be combined with --offline / --merge");
+	/* recording can also be switched on later from the UI, the panel shows it */
+	std::atomic<bool> latency_panel = parser.vm.contains("latency");
+	if (latency_panel)
+		Latency::set_enabled(true);
+	/* hardware counters are optional, without them the run goes on and the panel says why */
+	if (parser.vm.contains("perf")) {
+		PerfMonitor::set_enabled(true);
+		PerfCounters probe;
+		if (!probe.available())
+			fprintf(stderr, "Hardware counters unavailable: %s\n", probe.error().c_str());
+	}
+
+	/* set the flags to capture engine, the recent packets list is UI-only */
+	capture.set_capabilities(interface, count, expression, headless ? 0 : limit, &stats);
+	capture.set_offline_reader(parse_offline_reader(parser.vm["reader"].as<std::string>()));
+
+	/* traffic per network of a prefix -> label file (site map, ASN dump) */
+	if (parser.vm.contains("networks"))
+		stats.set_networks(
+			std::make_shared<const PrefixTable>(PrefixTable::load(parser.vm["networks"].as<std::string>())));
 
-	/* set the flags to capture engine */
-	capture.set_capabilities(interface, count, expression, limit, &stats);
+	/* online spike detection, alerts go to the UI panel and every export */
+	if (parser.vm.contains("anomaly")) {
+		AnomalyOptions opts;
+		opts.threshold = parser.vm["anomaly-threshold"].as<double>();
+		opts.interval = std::chrono::milliseconds(
+			std::max<int64_t>(10, static_cast<int64_t>(parser.vm["anomaly-interval"].as<double>() * 1000)));
+		stats.enable_anomaly_detection(opts);
+	}
+
+	/* port scans, host sweeps and SYN floods, reported next to the anomaly alerts */
+	if (parser.vm.contains("scan-detect")) {
+		ScanOptions opts;
+		opts.window = std::chrono::seconds(std::max(1, parser.vm["scan-window"].as<int>()));
+		opts.port_threshold = parser.vm["scan-ports"].as<uint32_t>();
+		opts.host_threshold = parser.vm["scan-hosts"].as<uint32_t>();
+		opts.flood_syns = parser.vm["syn-flood"].as<uint32_t>();
+		stats.enable_scan_detection(opts);
+	}
+
+	/*
+	 * display filter: matching packets are also counted in a second Stats,
+	 * which the UI shows instead of the full one. Changing the expression
+	 * starts a fresh Stats, the full counters and every export go on.
+	 */
+	std::mutex display_mtx;
+	DisplayStatus display;
+	std::shared_ptr<Stats> display_stats;
+	auto apply_display = [&](const std::string &expression) {
+		std::shared_ptr<const DisplayFilter> filter;
+		std::shared_ptr<Stats> shown;
+		if (expression.find_first_not_of(" \t") != std::string::npos) {
+			filter = std::make_shared<const DisplayFilter>(DisplayFilter::compile(expression));
+			shown = std::make_shared<Stats>();
+			shown->set_packets_limit(limit);
+			shown->set_networks(stats.network_table());
+		}
+		capture.set_display(filter, shown);
+		std::lock_guard<std::mutex> lock(display_mtx);
+		display_stats = shown;
+		display.expression = filter ? expression : "";
+	};
+	/* only the UI has something to narrow */
+	if (parser.vm.contains("display-filter") && !headless)
+		apply_display(parser.vm["display-filter"].as<std::string>());
+
+	/* IPFIX / NetFlow v9 export of the flows seen by the capture */
+	if (parser.vm.contains("flow-export")) {
+		FlowExportOptions opts;
+		opts.collector = parser.vm["flow-export"].as<std::string>();
+		opts.protocol = parse_flow_protocol(parser.vm["flow-protocol"].as<std::string>());
+		opts.idle_timeout = std::chrono::seconds(parser.vm["flow-idle-timeout"].as<int>());
+		opts.active_timeout = std::chrono::seconds(parser.vm["flow-active-timeout"].as<int>());
+		opts.mtu = parser.vm["flow-mtu"].as<size_t>();
+		opts.template_refresh = std::chrono::seconds(parser.vm["flow-template-refresh"].as<int>());
+		flow_exporter = std::make_unique<FlowExporter>(opts);
+		capture.set_flow_exporter(flow_exporter.get());
+	}
+
+	/* frames saved to (rotating) pcap files by a writer thread, fed from the capture loop */
+	if (parser.vm.contains("write")) {
+		CaptureWriterOptions opts;
+		opts.path = parser.vm["write"].as<std::string>();
+		opts.rotate_bytes = parser.vm["write-rotate-mb"].as<uint64_t>() << 20;
+		opts.rotate_age = std::chrono::seconds(parser.vm["write-rotate-sec"].as<int>());
+		opts.max_files = parser.vm["write-files"].as<size_t>();
+		opts.buffer_bytes = parser.vm["write-buffer-mb"].as<size_t>() << 20;
+		capture_writer = std::make_unique<CaptureWriter>(opts);
+		capture.set_capture_writer(capture_writer.get());
+	}
+
+	/* last seconds of traffic kept in memory, dumped on demand ('d', SIGUSR1) or on a bandwidth spike */
+	double ring_trigger = parser.vm["ring-trigger-mbps"].as<double>() * 1e6 / 8;
+	std::chrono::steady_clock::time_point next_auto_dump;
+	uint64_t ring_alerts = 0;
+	if (size_t ring_mb = parser.vm["ring-mb"].as<size_t>()) {
+		PacketRingOptions opts;
+		opts.bytes = ring_mb << 20;
+		opts.window = std::chrono::seconds(parser.vm["ring-sec"].as<int>());
+		opts.dump_prefix = parser.vm["ring-prefix"].as<std::string>();
+		packet_ring = std::make_unique<PacketRing>(opts);
+		capture.set_packet_ring(packet_ring.get());
+		PacketRing::install_signal_trigger();
+	}
+
+	/* optional scrape endpoint, served from counters published by the UI / headless loop */
+	std::unique_ptr<MetricsServer> metrics_server;
+	size_t metrics_top = parser.vm["metrics-top"].as<size_t>();
+	if (uint16_t port = parser.vm["metrics-port"].as<uint16_t>()) {
+		metrics_server = std::make_unique<MetricsServer>(stats, parser.vm["metrics-bind"].as<std::string>(), port);
+		stats.publish_metrics(metrics_top);
+	}
+
+	/* optional NDJSON stream, written by its own I/O thread */
+	std::unique_ptr<NdjsonExporter> ndjson;
+	if (parser.vm.contains("ndjson")) {
+		NdjsonOptions opts;
+		opts.path = parser.vm["ndjson"].as<std::string>();
+		opts.interval = std::chrono::milliseconds(
+			std::max<int64_t>(10, static_cast<int64_t>(parser.vm["ndjson-interval"].as<double>() * 1000)));
+		opts.rotate_bytes = parser.vm["ndjson-rotate-mb"].as<uint64_t>() << 20;
+		opts.rotate_age = std::chrono::seconds(parser.vm["ndjson-rotate-sec"].as<int>());
+		ndjson = std::make_unique<NdjsonExporter>(stats, opts);
+	}
+
+	/* optional columnar archive of per-interval totals and flow deltas */
+	std::unique_ptr<ArchiveWriter> archive;
+	if (parser.vm.contains("archive")) {
+		ArchiveOptions opts;
+		opts.path = parser.vm["archive"].as<std::string>();
+		opts.interval = std::chrono::milliseconds(
+			std::max<int64_t>(10, static_cast<int64_t>(parser.vm["archive-interval"].as<double>() * 1000)));
+		archive = std::make_unique<ArchiveWriter>(stats, opts);
+	}
+
+	/* counters survive restarts: restore the last checkpoint, then keep it up to date */
+	std::unique_ptr<Checkpointer> checkpointer;
+	if (parser.vm.contains("checkpoint")) {
+		std::string path = parser.vm["checkpoint"].as<std::string>();
+		if (restore_checkpoint(stats, path))
+			fprintf(stderr, "Restored statistics from %s\n", path.c_str());
+		checkpointer = std::make_unique<Checkpointer>(
+			stats, path, std::chrono::seconds(parser.vm["checkpoint-interval"].as<int>()));
+	}
+
+	/* called by the UI / headless loop after every statistics refresh */
+	auto export_tick = [&] {
+		if (metrics_server)
+			stats.publish_metrics(metrics_top);
+		if (ndjson)
+			ndjson->tick();
+		if (archive)
+			archive->tick();
+		if (checkpointer)
+			checkpointer->tick();
+		/* one automatic dump per ring window, a sustained spike would otherwise dump over and over */
+		bool new_alerts = false;
+		if (packet_ring && stats.alert_count() > ring_alerts) {
+			ring_alerts = stats.alert_count();
+			new_alerts = true;
+		}
+		if (packet_ring && (new_alerts || (ring_trigger > 0 && stats.current_bandwidth() >= ring_trigger)) &&
+			std::chrono::steady_clock::now() >= next_auto_dump) {
+			packet_ring->request_dump();
+			next_auto_dump = std::chrono::steady_clock::now() + std::chrono::seconds(parser.vm["ring-sec"].as<int>());
+		}
+	};
+
+	/* sort order and window of the UI tables; --limit, when given, is also their page size */
+	TableNavigator tables(parser.vm["sort"].as<std::string>(), parser.vm["order"].as<std::string>(),
+						  parser.vm["limit"].defaulted() ? 10 : static_cast<size_t>(std::max(1, limit)));
+
+	/* recomputes the snapshot tables the UI renders, only their visible windows */
+	auto refresh = [&tables](Stats &s) {
+		s.update_latency();
+		s.update_perf();
+		LatencyScope scope(LatencyStage::UPDATE);
+		s.update_packets();
+		s.update_application_stats(tables.view(SnapshotTable::APPLICATION));
+		s.update_transport_stats(tables.view(SnapshotTable::TRANSPORT));
+		s.update_ip_stats(tables.view(SnapshotTable::IPS));
+		s.update_pairs(tables.view(SnapshotTable::PAIRS));
+		s.update_ports(tables.view(SnapshotTable::PORTS));
+		s.update_networks(tables.view(SnapshotTable::NETWORKS));
+		s.update_alerts();
+		s.update_scans();
+		s.update_bandwidth();
+		s.update_interfaces();
+	};
 
 	std::atomic<bool> capture_finished = false;
 	std::atomic<bool> ui_running = true;
 	/* if we capture packets offline, we read the file in full, then print the result */
 	if (isOffline) {
+		std::vector<std::string> files;
+		if (parser.vm.contains("offline"))
+			files = offline_files(parser.vm["offline"].as<std::vector<std::string>>());
+
+		if (parser.vm.contains("build-index")) {
+			for (const auto &path : files) {
+				TimeIndex index = TimeIndex::build(path);
+				index.save(TimeIndex::sidecar_path(path));
+				std::cout << "Indexed " << index.packets() << " packets in " << index.blocks.size() << " blocks -> "
+						  << TimeIndex::sidecar_path(path) << "\n";
+			}
+			return 0;
+		}
 
-		capture.start_offline(parser.vm["offline"].as<std::string>());
+		/* "+N" bounds are taken relative to the first file */
+		std::vector<TimeRange> ranges = files.empty() ? std::vector<TimeRange>{} : time_ranges(parser.vm, files.front());
+		/* parallel workers would interleave their frames */
+		if ((capture_writer || packet_ring || display_stats) && (files.size() > 1 || ranges.size() > 1))
+			throw std::invalid_argument(
+				"--write / --ring-mb / --display-filter need a single offline file and time range");
+		if (files.size() > 1)
+			capture.start_offline_files(files, ranges, parser.vm["jobs"].as<unsigned>());
+		else if (files.size() == 1 && ranges.empty())
+			capture.start_offline(files.front());
+		else if (files.size() == 1)
+			capture.start_offline_ranges(files.front(), ranges);
+
+		/* results of earlier runs are folded in with the same merge as parallel files */
+		if (parser.vm.contains("merge")) {
+			for (const auto &path : parser.vm["merge"].as<std::vector<std::string>>()) {
+				Stats saved;
+				saved.set_networks(stats.network_table());
+				if (!restore_checkpoint(saved, path))
+					throw std::runtime_error("No such checkpoint: " + path);
+				stats.merge(saved);
+			}
+		}
+		/* the bandwidth graph follows packet time, not how long reading took */
+		stats.bandwidth_from_timeline();
 
 		/* full recalculation of statistics after file processing */
-		stats.update_packets();
-		stats.update_application_stats();
-		stats.update_transport_stats();
-		stats.update_ip_stats(10);
-		stats.update_pairs();
-		stats.update_bandwidth();
-	}
-	/* otherwise start live capture */
+		if (!headless) {
+			PerfMonitor::Scope perf(PerfRole::AGGREGATION);
+			refresh(stats);
+			if (display_stats) {
+				display_stats->bandwidth_from_timeline();
+				refresh(*display_stats);
+			}
+		}
+		if (metrics_server)
+			stats.publish_metrics(metrics_top);
+		if (ndjson)
+			ndjson->record();
+		if (archive)
+			archive->record();
+	}
+	/* otherwise start live capture, "-i eth0,eth1" captures on each interface in parallel */
 	else {
-		capture.start();
+		/* the writer and the ring expect the frames of one link type, in order */
+		if ((capture_writer || packet_ring) && interface.find(',') != std::string::npos)
+			throw std::invalid_argument("--write / --ring-mb need a single interface");
+		/* a replayed file goes through the capture thread like a live interface */
+		if (parser.vm.contains("replay")) {
+			ReplayOptions opts;
+			opts.path = parser.vm["replay"].as<std::string>();
+			opts.speed = parser.vm["replay-speed"].as<double>();
+			opts.pps = parser.vm["replay-pps"].as<uint64_t>();
+			opts.queue = parser.vm["replay-queue"].as<size_t>();
+			opts.loops = parser.vm["replay-loops"].as<uint64_t>();
+			replayer = std::make_unique<Replayer>(opts);
+			capture.start_replay(*replayer);
+		} else {
+			capture.start();
+		}
+	}
+
+	auto export_results = [&] {
+		/* no capture thread may still be inside the writer, ring or flow exporter when they are closed */
+		capture.stop();
+		/* whatever the interface shards counted since the last refresh */
+		capture.collect(true);
+		/* final record of a live capture, offline files were recorded once after reading */
+		if (ndjson) {
+			if (!isOffline)
+				ndjson->record();
+			ndjson->close();
+			if (ndjson->dropped())
+				fprintf(stderr, "NDJSON export: %lu records dropped, disk too slow\n",
+						static_cast<unsigned long>(ndjson->dropped()));
+		}
+		if (archive) {
+			if (!isOffline)
+				archive->record();
+			archive->close();
+		}
+		/* flows still open are exported with end reason "forced end" */
+		if (flow_exporter) {
+			flow_exporter->close();
+			if (flow_exporter->untracked())
+				fprintf(stderr, "Flow export: %lu packets not exported, flow table full\n",
+						static_cast<unsigned long>(flow_exporter->untracked()));
+		}
+		if (capture_writer) {
+			capture_writer->close();
+			fprintf(stderr, "Saved %lu packets to %s", static_cast<unsigned long>(capture_writer->written()),
+					parser.vm["write"].as<std::string>().c_str());
+			if (capture_writer->dropped())
+				fprintf(stderr, ", %lu dropped (disk too slow)", static_cast<unsigned long>(capture_writer->dropped()));
+			fprintf(stderr, "\n");
+		}
+		if (packet_ring) {
+			packet_ring->close();
+			if (packet_ring->dumps())
+				fprintf(stderr, "Dumped the packet ring %lu times, last to %s\n",
+						static_cast<unsigned long>(packet_ring->dumps()), packet_ring->last_dump().c_str());
+		}
+		/* how fast the pipeline kept up with the replay */
+		if (replayer) {
+			fprintf(stderr, "Replayed %lu packets, %lu dropped; highest rate without drops %lu pkt/s, %.2f Mbit/s; "
+							"sent late by %.1f us on average, %.1f us at most\n",
+					static_cast<unsigned long>(replayer->sent()), static_cast<unsigned long>(replayer->dropped()),
+					static_cast<unsigned long>(replayer->max_clean_pps()), replayer->max_clean_bytes() * 8 / 1e6,
+					replayer->mean_lateness_ns() / 1e3, replayer->max_lateness_ns() / 1e3);
+			if (!replayer->error().empty())
+				fprintf(stderr, "Replay stopped early: %s\n", replayer->error().c_str());
+		}
+		if (checkpointer)
+			checkpointer->close();
+		if (parser.vm.contains("csv"))
+			stats.export_csv(parser.vm["csv"].as<std::string>());
+		if (parser.vm.contains("json"))
+			stats.export_json(parser.vm["json"].as<std::string>());
+	};
+
+	/* no TTY needed: periodic summaries instead of the UI */
+	if (headless) {
+		HeadlessOptions opts;
+		opts.interval =
+			std::chrono::milliseconds(std::max<int64_t>(10, static_cast<int64_t>(parser.vm["interval"].as<double>() * 1000)));
+		opts.output = parser.vm["output"].as<std::string>();
+		opts.time_limit = std::chrono::seconds(time);
+		opts.on_tick = export_tick;
+		int rc = run_headless(capture, stats, opts);
+		export_results();
+		return rc;
 	}
 
 	/* UI */
@@ -83,9 +470,57 @@ int main(int argc, char **argv) {
 	View view;
 	std::mutex render_mtx;
 	std::mutex event_mtx;
-	ftxui::Element current_render = isOffline
-										? view.render(stats.get_snapshot(), interface, filterString, true, timer.load())
-										: ftxui::text("Starting capture...");
+
+	/* what the header shows as the capture source */
+	auto source = [&]() -> std::string {
+		if (!replayer)
+			return interface;
+		return std::format("replay {} ({} pkt/s, {} dropped)", replayer->options().path, replayer->current_pps(),
+						   replayer->dropped());
+	};
+
+	/* the display filter's counters when there is one; alerts and interface totals always come from the full capture */
+	auto shown_frame = [&](bool finished) {
+		std::shared_ptr<Stats> shown;
+		DisplayStatus status;
+		{
+			std::lock_guard<std::mutex> lock(display_mtx);
+			shown = display_stats;
+			status = display;
+		}
+		StatsSnapshot data = stats.get_snapshot();
+		if (shown) {
+			StatsSnapshot filtered = shown->get_snapshot();
+			filtered.alert_rows = std::move(data.alert_rows);
+			filtered.scan_rows = std::move(data.scan_rows);
+			filtered.interface_rows = std::move(data.interface_rows);
+			/* per packet of the whole capture, not of the filtered part */
+			filtered.perf_rows = std::move(data.perf_rows);
+			filtered.perf_error = std::move(data.perf_error);
+			data = std::move(filtered);
+		}
+		tables.update(data);
+		view.set_focus(tables.focus());
+		view.show_latency(latency_panel);
+		return view.render(data, source(), filterString, status, finished, timer.load());
+	};
+
+	ftxui::Element current_render = isOffline ? shown_frame(true) : ftxui::text("Starting capture...");
+
+	/* the live loop redraws by itself, an offline result only after a key changed something */
+	auto redraw_offline = [&] {
+		if (!isOffline)
+			return;
+		refresh(stats);
+		{
+			std::lock_guard<std::mutex> lock(display_mtx);
+			if (display_stats)
+				refresh(*display_stats);
+		}
+		ftxui::Element frame = shown_frame(true);
+		std::lock_guard<std::mutex> lock(render_mtx);
+		current_render = frame;
+	};
 
 	std::mutex screen_mtx;
 
@@ -95,6 +530,70 @@ int main(int argc, char **argv) {
 	});
 
 	component |= ftxui::CatchEvent([&](ftxui::Event e) {
+		/* while a display filter is typed, keys go to its input line */
+		bool editing;
+		{
+			std::lock_guard<std::mutex> lock(display_mtx);
+			editing = display.editing;
+		}
+		if (editing) {
+			std::string input;
+			{
+				std::lock_guard<std::mutex> lock(display_mtx);
+				if (e == ftxui::Event::Escape) {
+					display.editing = false;
+					display.error.clear();
+				} else if (e == ftxui::Event::Backspace) {
+					if (!display.input.empty())
+						display.input.pop_back();
+				} else if (e.is_character()) {
+					display.input += e.character();
+				}
+				input = display.input;
+			}
+			if (e == ftxui::Event::Return) {
+				std::string error;
+				if (isOffline) {
+					error = "The display filter of an offline file is set with --display-filter";
+				} else {
+					try {
+						apply_display(input);
+					} catch (const std::invalid_argument &ex) {
+						error = ex.what();
+					}
+				}
+				std::lock_guard<std::mutex> lock(display_mtx);
+				display.editing = !error.empty();
+				display.error = error;
+			}
+			redraw_offline();
+			return true;
+		}
+		if (e == ftxui::Event::Character('/')) {
+			{
+				std::lock_guard<std::mutex> lock(display_mtx);
+				display.editing = true;
+				display.input = display.expression;
+				display.error.clear();
+			}
+			redraw_offline();
+			return true;
+		}
+		if (tables.handle(e)) {
+			redraw_offline();
+			return true;
+		}
+		if (e == ftxui::Event::Character('l')) {
+			latency_panel = !latency_panel;
+			if (latency_panel)
+				Latency::set_enabled(true);
+			redraw_offline();
+			return true;
+		}
+		if (e == ftxui::Event::Character('d') && packet_ring) {
+			packet_ring->request_dump();
+			return true;
+		}
 		if (e == ftxui::Event::Character('q') || e == ftxui::Event::Escape) {
 			ui_running = false;
 			screen.Exit();
@@ -105,6 +604,7 @@ int main(int argc, char **argv) {
 	std::thread application_thread;
 	if (!isOffline) {
 		application_thread = std::thread([&] {
+			PerfMonitor::Scope perf(PerfRole::AGGREGATION);
 			while (!capture_finished && ui_running) {
 
 				auto now = std::chrono::steady_clock::now();
@@ -114,15 +614,20 @@ int main(int argc, char **argv) {
 					capture_finished = true;
 				}
 
-				stats.update_packets();
-				stats.update_application_stats();
-				stats.update_transport_stats();
-				stats.update_ip_stats(10);
-				stats.update_pairs();
-				stats.update_bandwidth();
+				capture.collect();
+				refresh(stats);
+				{
+					std::shared_ptr<Stats> shown;
+					{
+						std::lock_guard<std::mutex> lock(display_mtx);
+						shown = display_stats;
+					}
+					if (shown)
+						refresh(*shown);
+				}
+				export_tick();
 
-				ftxui::Element new_frame =
-					view.render(stats.get_snapshot(), interface, filterString, capture_finished, timer.load());
+				ftxui::Element new_frame = shown_frame(capture_finished);
 				{
 					std::lock_guard<std::mutex> lock(render_mtx);
 					current_render = new_frame;
@@ -145,10 +650,7 @@ int main(int argc, char **argv) {
 		application_thread.join();
 
 	// Export stats if needed
-	if (parser.vm.contains("csv"))
-		stats.export_csv(parser.vm["csv"].as<std::string>());
-	if (parser.vm.contains("json"))
-		stats.export_json(parser.vm["json"].as<std::string>());
+	export_results();
 
 	return 0;
 }
@@ -0,0 +1,70 @@
+#include "../../include/TUI/tableNavigator.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+TableNavigator::TableNavigator(const std::string &sort, const std::string &order, size_t page) {
+	if (order != "asc" && order != "desc")
+		throw std::invalid_argument("Unknown sort order: '" + order + "' (expected asc | desc)");
+	for (size_t t = 0; t < SNAPSHOT_TABLES; ++t)
+		views[t] = {sort_column(static_cast<SnapshotTable>(t), sort), order == "desc", 0, page};
+}
+
+bool TableNavigator::handle(const ftxui::Event &e) {
+	using ftxui::Event;
+	std::lock_guard<std::mutex> lock(mtx);
+
+	if (e == Event::Tab || e == Event::TabReverse) {
+		/* tables without columns weren't rendered (e.g. networks without --networks) */
+		size_t step = e == Event::Tab ? 1 : SNAPSHOT_TABLES - 1;
+		for (size_t i = 0; i < SNAPSHOT_TABLES; ++i) {
+			focused = (focused + step) % SNAPSHOT_TABLES;
+			if (columns[focused])
+				break;
+		}
+		return true;
+	}
+
+	TableView &v = views[focused];
+	size_t rows = totals[focused];
+	if (e == Event::Character('s')) {
+		v.column = columns[focused] ? (v.column + 1) % columns[focused] : 0;
+		v.offset = 0;
+	} else if (e == Event::Character('o')) {
+		v.descending = !v.descending;
+		v.offset = 0;
+	} else if (e == Event::ArrowDown) {
+		++v.offset;
+	} else if (e == Event::ArrowUp) {
+		v.offset -= v.offset > 0;
+	} else if (e == Event::PageDown) {
+		v.offset += v.page;
+	} else if (e == Event::PageUp) {
+		v.offset -= std::min(v.offset, v.page);
+	} else if (e == Event::Home) {
+		v.offset = 0;
+	} else if (e == Event::End) {
+		v.offset = rows;
+	} else {
+		return false;
+	}
+	v.offset = std::min(v.offset, rows > v.page ? rows - v.page : 0);
+	return true;
+}
+
+TableView TableNavigator::view(SnapshotTable table) const {
+	std::lock_guard<std::mutex> lock(mtx);
+	return views[static_cast<size_t>(table)];
+}
+
+SnapshotTable TableNavigator::focus() const {
+	std::lock_guard<std::mutex> lock(mtx);
+	return static_cast<SnapshotTable>(focused);
+}
+
+void TableNavigator::update(const StatsSnapshot &data) {
+	std::lock_guard<std::mutex> lock(mtx);
+	for (size_t t = 0; t < SNAPSHOT_TABLES; ++t) {
+		totals[t] = data.pages[t].total;
+		columns[t] = data.pages[t].columns;
+	}
+}
@@ -3,8 +3,9 @@
 
 using namespace ftxui;
 ftxui::Element View::render(const StatsSnapshot &data, const std::string &interface, const std::string &filter,
-							bool capture_finished, std::chrono::seconds timer) {
-	auto header = render_header(data, interface, filter);
+							const DisplayStatus &display, bool capture_finished, std::chrono::seconds timer) {
+	LatencyScope scope(LatencyStage::RENDER);
+	auto header = render_header(data, interface, filter, display);
 
 	auto transport_section = hbox({
 								 render_transport(data) | flex,
@@ -15,16 +16,41 @@ ftxui::Element View::render(const StatsSnapshot &data, const std::string &interf
 							 }) |
 							 border;
 
-	auto ip_section = hbox({render_ip(data) | border | size(HEIGHT, LESS_THAN, 10) | frame | vscroll_indicator,
+	/* the tables only hold their visible window, see TableNavigator */
+	auto ip_section = hbox({render_ip(data) | border,
+
+							render_ports(data) | border,
 
 							render_bandwidth(data) | border | flex});
 
-	auto left_panel = vbox({
-						  transport_section,
-						  separator(),
-						  ip_section,
-					  }) |
-					  flex_grow;
+	/* only with several interfaces / --networks / --anomaly / --scan-detect / --perf, latency on 'l' */
+	Elements left = {transport_section, separator(), ip_section};
+	if (!data.interface_rows.empty()) {
+		left.push_back(separator());
+		left.push_back(render_interfaces(data) | border);
+	}
+	if (!data.network_rows.empty()) {
+		left.push_back(separator());
+		left.push_back(render_networks(data) | border);
+	}
+	if (!data.alert_rows.empty()) {
+		left.push_back(separator());
+		left.push_back(render_alerts(data) | border);
+	}
+	if (!data.scan_rows.empty()) {
+		left.push_back(separator());
+		left.push_back(render_scans(data) | border);
+	}
+	if (!data.perf_rows.empty() || !data.perf_error.empty()) {
+		left.push_back(separator());
+		left.push_back(render_perf(data) | border);
+	}
+	if (latency_visible) {
+		left.push_back(separator());
+		left.push_back(render_latency(data) | border);
+	}
+
+	auto left_panel = vbox(std::move(left)) | flex_grow;
 
 	auto right_panel = render_packets(data) | border | size(WIDTH, EQUAL, 100) | frame | vscroll_indicator;
 
@@ -54,12 +80,14 @@ ftxui::Element View::render(const StatsSnapshot &data, const std::string &interf
  *  - Active filter
  *  - Traffic summary
  */
-ftxui::Element View::render_header(const StatsSnapshot &data, const std::string &interface, const std::string &filter) {
+ftxui::Element View::render_header(const StatsSnapshot &data, const std::string &interface, const std::string &filter,
+								  const DisplayStatus &display) {
 	return hbox({
 			   vbox({
 				   text("Network Traffic Analyzer") | bold,
 				   text("Interface: " + interface),
 				   text("Filter: " + filter),
+				   render_display_filter(display),
 			   }) | flex,
 			   separator(),
 			   render_stats(data) | flex,
@@ -67,6 +95,19 @@ ftxui::Element View::render_header(const StatsSnapshot &data, const std::string
 		   border;
 }
 
+ftxui::Element View::render_display_filter(const DisplayStatus &display) {
+	Element line;
+	if (display.editing)
+		line = text("Display: " + display.input + "_") | color(Color::Yellow);
+	else if (!display.expression.empty())
+		line = text("Display: " + display.expression + " (matching packets only)") | color(Color::Green);
+	else
+		line = text("Display: all packets, press '/' to filter") | dim;
+	if (display.error.empty())
+		return line;
+	return vbox({line, text(display.error) | color(Color::Red)});
+}
+
 ftxui::Element View::render_stats(const StatsSnapshot &data) {
 	return vbox({text("=== Traffic summary ===") | bold, text("Total packets: " + std::to_string(data.total_p)),
 				 text(std::format("Total bytes  : {:.2f} MB", data.total_b / (1024.0 * 1024.0)))}) |
@@ -77,56 +118,57 @@ ftxui::Element View::render_footer(bool capture_finished, std::chrono::seconds t
 	return Element({capture_finished
 						? text("Capture finished (" + std::format("{}", timer) + "). Press 'q' or Esc to exit.") |
 							  bold | color(Color::Yellow) | center
-						: text("time: " + std::format("{}", timer) + ". Press 'q' or Esc to exit.") | center |
-							  size(HEIGHT, EQUAL, 1)});
+						: text("time: " + std::format("{}", timer) +
+							   ". Tab / s / o / arrows: tables, '/' filter, 'l' latency, 'q' or Esc to exit.") |
+							  center | size(HEIGHT, EQUAL, 1)});
+}
+/**
+ * @brief Renders the window of a table that Stats selected.
+ *
+ * The sort column's header gets an arrow, the title the rows shown out of
+ * the total when there are more than fit, and the focused table an
+ * inverted title.
+ */
+ftxui::Element View::render_table(const std::string &title, std::vector<std::vector<std::string>> rows,
+								  const StatsSnapshot &data, SnapshotTable table) {
+	const TablePage &page = data.pages[static_cast<size_t>(table)];
+	if (!rows.empty() && page.view.column < rows[0].size())
+		rows[0][page.view.column] += page.view.descending ? " ▼" : " ▲";
+	size_t shown = rows.empty() ? 0 : rows.size() - 1;
+
+	Table t(std::move(rows));
+	t.SelectAll().Border(LIGHT);
+
+	t.SelectRow(0).Decorate(bold);
+	t.SelectRow(0).SeparatorVertical(LIGHT);
+	t.SelectRow(0).Border(DOUBLE);
+
+	std::string heading = "=== " + title + " ===";
+	if (shown < page.total)
+		heading += std::format(" {}-{} of {}", page.view.offset + 1, page.view.offset + shown, page.total);
+	Element label = text(heading) | bold;
+	if (table == focus)
+		label = label | inverted;
+	return vbox({label, t.Render()}) | flex;
 }
-ftxui::Element View::render_transport(const StatsSnapshot &data) {
-	Table table(data.transport_rows);
-	table.SelectAll().Border(LIGHT);
-
-	table.SelectRow(0).Decorate(bold);
-	table.SelectRow(0).SeparatorVertical(LIGHT);
-	table.SelectRow(0).Decorate(bold);
-	table.SelectRow(0).Border(DOUBLE);
 
-	return vbox({text("=== Transport protocols === ") | bold, table.Render()}) | flex;
+ftxui::Element View::render_transport(const StatsSnapshot &data) {
+	return render_table("Transport protocols", data.transport_rows, data, SnapshotTable::TRANSPORT);
 }
 ftxui::Element View::render_application(const StatsSnapshot &data) {
-	Table table(data.app_rows);
-	table.SelectAll().Border(LIGHT);
-
-	table.SelectRow(0).Decorate(bold);
-	table.SelectRow(0).SeparatorVertical(LIGHT);
-	table.SelectRow(0).Decorate(bold);
-	table.SelectRow(0).Border(DOUBLE);
-
-	return vbox({text("=== Application protocols ===") | bold, table.Render()}) | flex;
+	return render_table("Application protocols", data.app_rows, data, SnapshotTable::APPLICATION);
 }
 ftxui::Element View::render_ip(const StatsSnapshot &data) {
-
-	Table table(data.rows);
-	table.SelectAll().Border(LIGHT);
-
-	table.SelectRow(0).Decorate(bold);
-	table.SelectRow(0).SeparatorVertical(LIGHT);
-	table.SelectRow(0).Decorate(bold);
-	table.SelectRow(0).Border(DOUBLE);
-
-	return vbox({text("=== Top IP addresses ===") | bold,
-
-				 table.Render()}) |
-		   flex;
+	return render_table("Top IP addresses", data.rows, data, SnapshotTable::IPS);
+}
+ftxui::Element View::render_ports(const StatsSnapshot &data) {
+	return render_table("Top ports", data.port_rows, data, SnapshotTable::PORTS);
+}
+ftxui::Element View::render_networks(const StatsSnapshot &data) {
+	return render_table("Top networks", data.network_rows, data, SnapshotTable::NETWORKS);
 }
 ftxui::Element View::render_pairs(const StatsSnapshot &data) {
-	Table table(data.pairs_rows);
-	table.SelectAll().Border(LIGHT);
-
-	table.SelectRow(0).Decorate(bold);
-	table.SelectRow(0).SeparatorVertical(LIGHT);
-	table.SelectRow(0).Decorate(bold);
-	table.SelectRow(0).Border(DOUBLE);
-
-	return vbox({text("=== Top communication pairs ===") | bold, table.Render()}) | flex;
+	return render_table("Top communication pairs", data.pairs_rows, data, SnapshotTable::PAIRS);
 }
 /**
  * @brief Renders bandwidth graph.
@@ -185,4 +227,95 @@ ftxui::Element View::render_packets(const StatsSnapshot &data) {
 
 				 table.Render() | flex}) |
 		   flex;
-}
\ No newline at end of file
+}
+/**
+ * @brief Renders the newest anomaly alerts.
+ *
+ * Spikes are shown in red, with the EWMA baseline they were measured against.
+ */
+ftxui::Element View::render_alerts(const StatsSnapshot &data) {
+	if (data.alert_rows.size() < 2)
+		return vbox({text("=== Alerts ===") | bold, text("No anomalies detected") | dim});
+
+	Table table(data.alert_rows);
+	table.SelectAll().Border(LIGHT);
+
+	table.SelectRow(0).Decorate(bold);
+	table.SelectRow(0).SeparatorVertical(LIGHT);
+	table.SelectRow(0).Border(DOUBLE);
+	table.SelectRows(1, -1).Decorate(color(Color::Red));
+
+	return vbox({text("=== Alerts ===") | bold | color(Color::Red), table.Render()}) | flex;
+}
+/**
+ * @brief Renders the totals of every captured interface.
+ *
+ * Drops are highlighted, they mean the totals above are incomplete.
+ */
+ftxui::Element View::render_interfaces(const StatsSnapshot &data) {
+	Table table(data.interface_rows);
+	table.SelectAll().Border(LIGHT);
+
+	table.SelectRow(0).Decorate(bold);
+	table.SelectRow(0).SeparatorVertical(LIGHT);
+	table.SelectRow(0).Border(DOUBLE);
+	for (size_t i = 1; i < data.interface_rows.size(); ++i) {
+		if (data.interface_rows[i].back() != "0")
+			table.SelectCell(4, static_cast<int>(i)).Decorate(color(Color::Red));
+	}
+
+	return vbox({text("=== Interfaces ===") | bold, table.Render()}) | flex;
+}
+/**
+ * @brief Renders the newest port scans, host sweeps and SYN floods.
+ */
+ftxui::Element View::render_scans(const StatsSnapshot &data) {
+	if (data.scan_rows.size() < 2)
+		return vbox({text("=== Scans ===") | bold, text("No scans or floods detected") | dim});
+
+	Table table(data.scan_rows);
+	table.SelectAll().Border(LIGHT);
+
+	table.SelectRow(0).Decorate(bold);
+	table.SelectRow(0).SeparatorVertical(LIGHT);
+	table.SelectRow(0).Border(DOUBLE);
+	table.SelectRows(1, -1).Decorate(color(Color::Red));
+
+	return vbox({text("=== Scans ===") | bold | color(Color::Red), table.Render()}) | flex;
+}
+/**
+ * @brief Renders the latency percentiles of the pipeline stages.
+ *
+ * Cumulative since recording was switched on; the render row measures
+ * building the element tree, not the terminal output.
+ */
+ftxui::Element View::render_latency(const StatsSnapshot &data) {
+	if (data.latency_rows.size() < 2)
+		return vbox({text("=== Pipeline latency ===") | bold, text("No samples yet") | dim});
+
+	Table table(data.latency_rows);
+	table.SelectAll().Border(LIGHT);
+
+	table.SelectRow(0).Decorate(bold);
+	table.SelectRow(0).SeparatorVertical(LIGHT);
+	table.SelectRow(0).Border(DOUBLE);
+
+	return vbox({text("=== Pipeline latency ===") | bold, table.Render()}) | flex;
+}
+/**
+ * @brief Renders the hardware counters per packet of the capture and aggregation threads.
+ */
+ftxui::Element View::render_perf(const StatsSnapshot &data) {
+	if (data.perf_rows.size() < 2)
+		return vbox({text("=== Hardware counters ===") | bold,
+					 text("Unavailable: " + data.perf_error) | dim});
+
+	Table table(data.perf_rows);
+	table.SelectAll().Border(LIGHT);
+
+	table.SelectRow(0).Decorate(bold);
+	table.SelectRow(0).SeparatorVertical(LIGHT);
+	table.SelectRow(0).Border(DOUBLE);
+
+	return vbox({text("=== Hardware counters ===") | bold, table.Render()}) | flex;
+}
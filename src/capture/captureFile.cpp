@@ -0,0 +1,321 @@
+#include "../../include/capture/captureFile.hpp"
+#include "../../include/capture/pcapFormat.hpp"
+
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t PCAPNG_SHB = 0x0A0D0D0A;
+constexpr uint32_t PCAPNG_IDB = 0x00000001;
+constexpr uint32_t PCAPNG_PB = 0x00000002;
+constexpr uint32_t PCAPNG_SPB = 0x00000003;
+constexpr uint32_t PCAPNG_EPB = 0x00000006;
+constexpr uint32_t PCAPNG_BYTE_ORDER = 0x1A2B3C4D;
+
+constexpr uint16_t OPT_ENDOFOPT = 0;
+constexpr uint16_t OPT_IF_TSRESOL = 9;
+constexpr uint16_t OPT_IF_TSOFFSET = 14;
+
+/* larger blocks are treated as corruption rather than allocated/skipped */
+constexpr size_t MAX_BLOCK = 16u << 20;
+
+/* window walked per parse() call on mapped files */
+constexpr size_t MAP_WINDOW = 64u << 20;
+
+uint32_t raw32(const uint8_t *p) {
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+} // namespace
+
+bool CaptureParser::recognizes(const uint8_t *data, size_t len) {
+	if (len < 4)
+		return false;
+	uint32_t magic = raw32(data);
+	return magic == SAVEFILE_MAGIC_USEC || magic == SAVEFILE_MAGIC_NSEC ||
+		   magic == __builtin_bswap32(SAVEFILE_MAGIC_USEC) || magic == __builtin_bswap32(SAVEFILE_MAGIC_NSEC) ||
+		   magic == PCAPNG_SHB;
+}
+
+uint16_t CaptureParser::rd16(const uint8_t *p) const {
+	uint16_t v;
+	memcpy(&v, p, sizeof(v));
+	return swapped ? __builtin_bswap16(v) : v;
+}
+
+uint32_t CaptureParser::rd32(const uint8_t *p) const {
+	uint32_t v = raw32(p);
+	return swapped ? __builtin_bswap32(v) : v;
+}
+
+size_t CaptureParser::next_block_size(const uint8_t *data, size_t len) const {
+	if (len < 4)
+		return 0;
+
+	uint32_t type = raw32(data);
+	/* a section header may switch byte order, its length is only known after the byte-order magic */
+	if (type == PCAPNG_SHB && (format != Format::PCAP)) {
+		if (len < 12)
+			return 0;
+		uint32_t length = raw32(data + 4);
+		if (raw32(data + 8) != PCAPNG_BYTE_ORDER)
+			length = __builtin_bswap32(length);
+		if (length < 28 || length % 4 || length > MAX_BLOCK)
+			throw std::runtime_error("Malformed pcapng section header");
+		return length;
+	}
+
+	switch (format) {
+	case Format::UNKNOWN:
+		if (!recognizes(data, len))
+			throw std::runtime_error("Not a pcap or pcapng file");
+		return sizeof(SavefileHeader);
+
+	case Format::PCAP: {
+		if (len < sizeof(SavefileRecord))
+			return 0;
+		uint32_t caplen = rd32(data + 8);
+		if (caplen > MAX_BLOCK)
+			throw std::runtime_error("Malformed pcap record (caplen " + std::to_string(caplen) + ")");
+		return sizeof(SavefileRecord) + caplen;
+	}
+
+	case Format::PCAPNG: {
+		if (len < 8)
+			return 0;
+		uint32_t length = rd32(data + 4);
+		if (length < 12 || length % 4 || length > MAX_BLOCK)
+			throw std::runtime_error("Malformed pcapng block (length " + std::to_string(length) + ")");
+		return length;
+	}
+	}
+	return 0;
+}
+
+void CaptureParser::parse_pcap_header(const uint8_t *block) {
+	uint32_t magic = raw32(block);
+	swapped = magic == __builtin_bswap32(SAVEFILE_MAGIC_USEC) || magic == __builtin_bswap32(SAVEFILE_MAGIC_NSEC);
+	nanosecond = rd32(block) == SAVEFILE_MAGIC_NSEC;
+	/* the upper bits of the linktype field carry FCS flags */
+	linktype = static_cast<int>(rd32(block + 20) & 0x0FFFFFFF);
+	format = Format::PCAP;
+	++contexts;
+}
+
+void CaptureParser::parse_section_header(const uint8_t *block) {
+	swapped = raw32(block + 8) != PCAPNG_BYTE_ORDER;
+	if (rd16(block + 12) != 1)
+		throw std::runtime_error("Unsupported pcapng major version");
+	interfaces.clear();
+	format = Format::PCAPNG;
+	++contexts;
+}
+
+void CaptureParser::parse_interface(const uint8_t *block, size_t size) {
+	Interface itf{rd16(block + 8), false, 6, 0};
+
+	/* options follow the 16 fixed bytes and end before the trailing length */
+	size_t pos = 16, end = size - 4;
+	while (pos + 4 <= end) {
+		uint16_t code = rd16(block + pos);
+		uint16_t len = rd16(block + pos + 2);
+		const uint8_t *value = block + pos + 4;
+		if (code == OPT_ENDOFOPT || pos + 4 + len > end)
+			break;
+		if (code == OPT_IF_TSRESOL && len >= 1) {
+			itf.binary_resol = value[0] & 0x80;
+			itf.resol_exp = value[0] & 0x7f;
+		} else if (code == OPT_IF_TSOFFSET && len >= 8) {
+			uint64_t off;
+			memcpy(&off, value, sizeof(off));
+			itf.offset_sec = static_cast<int64_t>(swapped ? __builtin_bswap64(off) : off);
+		}
+		pos += 4 + ((len + 3u) & ~3u);
+	}
+	interfaces.push_back(itf);
+}
+
+uint64_t CaptureParser::to_ns(const Interface &itf, uint64_t ts) const {
+	unsigned __int128 ns = ts;
+	if (itf.binary_resol) {
+		ns = (ns * 1000000000u) >> itf.resol_exp;
+	} else if (itf.resol_exp <= 9) {
+		for (int i = itf.resol_exp; i < 9; ++i)
+			ns *= 10;
+	} else {
+		for (int i = 9; i < itf.resol_exp; ++i)
+			ns /= 10;
+	}
+	return static_cast<uint64_t>(ns) + static_cast<uint64_t>(itf.offset_sec * 1000000000ll);
+}
+
+bool CaptureParser::parse_pcapng_block(const uint8_t *block, size_t size, CaptureRecord &record) {
+	uint32_t type = rd32(block);
+	switch (type) {
+	case PCAPNG_IDB:
+		if (size < 20)
+			throw std::runtime_error("Malformed pcapng interface block");
+		parse_interface(block, size);
+		++contexts;
+		return false;
+
+	case PCAPNG_EPB:
+	case PCAPNG_PB: {
+		if (size < 32)
+			throw std::runtime_error("Malformed pcapng packet block");
+		uint32_t if_id = type == PCAPNG_EPB ? rd32(block + 8) : rd16(block + 8);
+		if (if_id >= interfaces.size())
+			throw std::runtime_error("pcapng packet references unknown interface");
+		const Interface &itf = interfaces[if_id];
+		uint64_t ts = (static_cast<uint64_t>(rd32(block + 12)) << 32) | rd32(block + 16);
+		record.caplen = rd32(block + 20);
+		record.len = rd32(block + 24);
+		if (record.caplen > size - 32)
+			throw std::runtime_error("Malformed pcapng packet block (caplen)");
+		record.ts_ns = to_ns(itf, ts);
+		record.linktype = itf.linktype;
+		record.data = block + 28;
+		return true;
+	}
+
+	case PCAPNG_SPB: {
+		if (size < 16 || interfaces.empty())
+			throw std::runtime_error("Malformed pcapng simple packet block");
+		record.len = rd32(block + 8);
+		record.caplen = std::min<uint32_t>(record.len, static_cast<uint32_t>(size - 16));
+		/* simple packet blocks carry no timestamp */
+		record.ts_ns = 0;
+		record.linktype = interfaces[0].linktype;
+		record.data = block + 12;
+		return true;
+	}
+
+	default:
+		/* name resolution, statistics, custom blocks ... */
+		return false;
+	}
+}
+
+size_t CaptureParser::parse(const uint8_t *data, size_t len, Handler handler, void *user) {
+	size_t pos = 0;
+	stop = false;
+	CaptureRecord record{};
+
+	while (pos < len) {
+		const uint8_t *block = data + pos;
+		size_t size = next_block_size(block, len - pos);
+		if (size == 0 || size > len - pos)
+			break;
+
+		bool emitted = false;
+		if (format != Format::PCAP && raw32(block) == PCAPNG_SHB) {
+			parse_section_header(block);
+		} else if (format == Format::UNKNOWN) {
+			parse_pcap_header(block);
+		} else if (format == Format::PCAP) {
+			uint32_t frac = rd32(block + 4);
+			record.ts_ns = rd32(block) * 1000000000ull + (nanosecond ? frac : frac * 1000ull);
+			record.caplen = rd32(block + 8);
+			record.len = rd32(block + 12);
+			record.linktype = linktype;
+			record.data = block + sizeof(SavefileRecord);
+			emitted = true;
+		} else {
+			emitted = parse_pcapng_block(block, size, record);
+		}
+
+		pos += size;
+		if (emitted) {
+			record.block = block;
+			++delivered;
+			if (!handler(user, record)) {
+				stop = true;
+				break;
+			}
+		}
+	}
+	return pos;
+}
+
+MappedFile::MappedFile(const std::string &path) {
+	fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw std::runtime_error("Couldn't open " + path + ": " + strerror(errno));
+
+	struct stat st {};
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+		close(fd);
+		throw std::runtime_error(path + " is not a regular file");
+	}
+	length = static_cast<size_t>(st.st_size);
+	if (length == 0)
+		return;
+
+	void *p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED) {
+		close(fd);
+		throw std::runtime_error("Couldn't map " + path + ": " + strerror(errno));
+	}
+	base = static_cast<const uint8_t *>(p);
+	madvise(p, length, MADV_SEQUENTIAL);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+MappedFile::~MappedFile() {
+	if (base)
+		munmap(const_cast<uint8_t *>(base), length);
+	if (fd >= 0)
+		close(fd);
+}
+
+void MappedFile::prefetch(size_t offset, size_t len) const {
+	if (!base || offset >= length)
+		return;
+	size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t start = offset & ~(page - 1);
+	madvise(const_cast<uint8_t *>(base) + start, std::min(len + (offset - start), length - start), MADV_WILLNEED);
+}
+
+void MappedFile::release_before(size_t offset) const {
+	if (!base)
+		return;
+	size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t end = std::min(offset, length) & ~(page - 1);
+	if (end > released) {
+		madvise(const_cast<uint8_t *>(base) + released, end - released, MADV_DONTNEED);
+		released = end;
+	}
+}
+
+uint64_t read_mapped_capture(const MappedFile &file, CaptureParser &parser, CaptureParser::Handler handler,
+							 void *user, size_t begin, size_t end) {
+	end = std::min(end, file.size());
+	size_t pos = begin;
+	while (pos < end) {
+		size_t window = std::min(MAP_WINDOW, end - pos);
+		file.prefetch(pos + window, std::min(MAP_WINDOW, end - pos - window));
+
+		size_t consumed = parser.parse(file.data() + pos, window, handler, user);
+		pos += consumed;
+		if (parser.stopped())
+			break;
+		/* nothing fit into the window: the file is truncated or one block spans the window end */
+		if (consumed == 0) {
+			size_t need = parser.next_block_size(file.data() + pos, end - pos);
+			if (need == 0 || need > end - pos)
+				break;
+			pos += parser.parse(file.data() + pos, need, handler, user);
+			if (parser.stopped())
+				break;
+		}
+		file.release_before(pos);
+	}
+	return pos;
+}
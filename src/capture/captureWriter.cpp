@@ -0,0 +1,174 @@
+#include "../../include/capture/captureWriter.hpp"
+#include "../../include/capture/pcapFormat.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace {
+
+constexpr size_t PAGE_SIZE_BYTES = 4096;
+/*
+ * a buffer is handed to the writer once the next packet is this much packet
+ * time after its first one; a link that goes silent keeps its last buffer
+ * in memory until more traffic arrives or the writer is closed
+ */
+constexpr uint64_t FLUSH_NS = 1000000000ull;
+/* snaplen advertised in the file header, large enough for any frame libpcap hands us */
+constexpr uint32_t FILE_SNAPLEN = 262144;
+
+} // namespace
+
+CaptureWriter::CaptureWriter(CaptureWriterOptions options)
+	: opts(std::move(options)), ready(std::max<size_t>(opts.buffers, 2)), spare(std::max<size_t>(opts.buffers, 2)) {
+	capacity = (std::max<size_t>(opts.buffer_bytes, 64 * 1024) + PAGE_SIZE_BYTES - 1) / PAGE_SIZE_BYTES * PAGE_SIZE_BYTES;
+	for (size_t i = 0; i < std::max<size_t>(opts.buffers, 2); ++i) {
+		Buffer buf;
+		buf.data.reset(static_cast<uint8_t *>(std::aligned_alloc(PAGE_SIZE_BYTES, capacity)));
+		if (!buf.data)
+			throw std::runtime_error("Couldn't allocate capture write buffers");
+		spare.push(std::move(buf));
+	}
+
+	std::string name = file_name(0);
+	fd = ::open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		throw std::runtime_error("Couldn't open " + name + " for writing: " + strerror(errno));
+	kept_files.push_back(name);
+
+	writer = std::thread([this] { run(); });
+}
+
+CaptureWriter::~CaptureWriter() { close(); }
+
+void CaptureWriter::close() {
+	seal();
+	ready.close();
+	if (writer.joinable())
+		writer.join();
+	if (fd >= 0) {
+		::close(fd);
+		fd = -1;
+	}
+}
+
+std::string CaptureWriter::file_name(uint64_t index) const {
+	if (!rotating() && index == 0)
+		return opts.path;
+
+	/* the number goes before the extension so rotated files still open by type */
+	size_t slash = opts.path.find_last_of('/');
+	size_t dot = opts.path.find_last_of('.');
+	if (dot == std::string::npos || dot == 0 || (slash != std::string::npos && dot < slash + 2))
+		dot = opts.path.size();
+	char number[24];
+	snprintf(number, sizeof(number), "-%06lu", static_cast<unsigned long>(index));
+	return opts.path.substr(0, dot) + number + opts.path.substr(dot);
+}
+
+void CaptureWriter::seal() {
+	if (!current.data)
+		return;
+	/* there are never more buffers than the queue holds, so this can't fail */
+	ready.try_push(std::move(current));
+	current = Buffer{};
+}
+
+void CaptureWriter::write(int linktype, uint64_t ts_ns, const struct pcap_pkthdr *header, const u_char *data) {
+	size_t record = sizeof(SavefileRecord) + header->caplen;
+	if (record > capacity) {
+		++dropped_packets;
+		return;
+	}
+	bool new_file =
+		linktype != file_linktype ||
+		(opts.rotate_bytes && file_bytes > sizeof(SavefileHeader) && file_bytes + record > opts.rotate_bytes) ||
+		(opts.rotate_age.count() &&
+		 ts_ns >= file_start_ns + static_cast<uint64_t>(opts.rotate_age.count()) * 1000000000ull);
+
+	if (new_file || !current.data || current.size + record > capacity || ts_ns >= buffer_start_ns + FLUSH_NS) {
+		seal();
+		auto buf = spare.try_pop();
+		if (!buf) {
+			/* every buffer is queued for the disk, losing the frame beats stalling the capture */
+			++dropped_packets;
+			return;
+		}
+		current = std::move(*buf);
+		current.size = 0;
+		current.new_file = new_file;
+		current.linktype = linktype;
+		buffer_start_ns = ts_ns;
+	}
+	if (new_file) {
+		file_bytes = sizeof(SavefileHeader);
+		file_start_ns = ts_ns;
+		file_linktype = linktype;
+	}
+
+	SavefileRecord rec{static_cast<uint32_t>(ts_ns / 1000000000ull), static_cast<uint32_t>(ts_ns % 1000000000ull),
+					   header->caplen, header->len};
+	uint8_t *out = current.data.get() + current.size;
+	memcpy(out, &rec, sizeof(rec));
+	memcpy(out + sizeof(rec), data, header->caplen);
+	current.size += record;
+	file_bytes += record;
+	++written_packets;
+}
+
+void CaptureWriter::open_file() {
+	if (fd >= 0)
+		::close(fd);
+	header_written = false;
+
+	std::string name = file_name(++file_index);
+	fd = ::open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "Couldn't open %s for writing: %s\n", name.c_str(), strerror(errno));
+		return;
+	}
+	kept_files.push_back(name);
+	while (opts.max_files && kept_files.size() > opts.max_files) {
+		unlink(kept_files.front().c_str());
+		kept_files.pop_front();
+	}
+}
+
+void CaptureWriter::write_all(const uint8_t *data, size_t size) {
+	while (size > 0) {
+		ssize_t n = ::write(fd, data, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			fprintf(stderr, "Write to %s failed: %s\n", kept_files.back().c_str(), strerror(errno));
+			failed_bytes += size;
+			return;
+		}
+		data += n;
+		size -= static_cast<size_t>(n);
+	}
+}
+
+void CaptureWriter::run() {
+	while (auto buf = ready.pop()) {
+		/* the first file is created up front and only needs its header */
+		if (buf->new_file && (header_written || fd < 0))
+			open_file();
+
+		if (fd >= 0) {
+			if (!header_written) {
+				SavefileHeader h = make_savefile_header(static_cast<uint32_t>(buf->linktype), FILE_SNAPLEN, true);
+				write_all(reinterpret_cast<const uint8_t *>(&h), sizeof(h));
+				header_written = true;
+			}
+			write_all(buf->data.get(), buf->size);
+		} else {
+			failed_bytes += buf->size;
+		}
+		spare.try_push(std::move(*buf));
+	}
+}
@@ -0,0 +1,323 @@
+#include "../../include/capture/compressedCapture.hpp"
+
+#include <condition_variable>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef NTA_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef NTA_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+/* decompressed bytes per chunk handed to the parser */
+constexpr size_t CHUNK_SIZE = 1u << 20;
+/* chunks queued between decompression and parsing */
+constexpr size_t QUEUE_DEPTH = 8;
+/* zstd frames bigger than this are streamed instead of decompressed whole */
+constexpr size_t MAX_PARALLEL_FRAME = 64u << 20;
+/* compressed input fed per inflate() call, zlib counts in 32-bit */
+constexpr size_t GZIP_INPUT_SLICE = 1u << 30;
+
+} // namespace
+
+Compression detect_compression(const uint8_t *data, size_t len) {
+	if (len >= 2 && data[0] == 0x1f && data[1] == 0x8b)
+		return Compression::GZIP;
+	if (len >= 4 && data[0] == 0x28 && data[1] == 0xb5 && data[2] == 0x2f && data[3] == 0xfd)
+		return Compression::ZSTD;
+	return Compression::NONE;
+}
+
+CompressedCapture::CompressedCapture(const std::string &path, Compression compression, unsigned threads)
+	: file(path), compression(compression), threads(std::max(threads, 1u)), ready(QUEUE_DEPTH),
+	  spare(QUEUE_DEPTH + 2) {
+	producer = std::thread([this] { run(); });
+}
+
+CompressedCapture::~CompressedCapture() {
+	cancel();
+	if (producer.joinable())
+		producer.join();
+}
+
+std::optional<CompressedCapture::Chunk> CompressedCapture::next() { return ready.pop(); }
+
+void CompressedCapture::recycle(Chunk &&chunk) { spare.try_push(std::move(chunk)); }
+
+void CompressedCapture::cancel() {
+	cancelled = true;
+	ready.close();
+}
+
+std::string CompressedCapture::error() {
+	std::lock_guard<std::mutex> lock(error_mtx);
+	return error_msg;
+}
+
+void CompressedCapture::fail(const std::string &msg) {
+	{
+		std::lock_guard<std::mutex> lock(error_mtx);
+		error_msg = msg;
+	}
+	ready.close();
+}
+
+CompressedCapture::Chunk CompressedCapture::take_spare() {
+	Chunk chunk = spare.try_pop().value_or(Chunk{});
+	chunk.resize(CHUNK_SIZE);
+	return chunk;
+}
+
+void CompressedCapture::run() {
+	try {
+		if (compression == Compression::GZIP)
+			run_gzip();
+		else if (compression == Compression::ZSTD)
+			run_zstd();
+		else
+			fail("input is not compressed");
+	} catch (const std::exception &e) {
+		fail(e.what());
+	}
+	ready.close();
+}
+
+void CompressedCapture::run_gzip() {
+#ifdef NTA_HAVE_ZLIB
+	z_stream zs{};
+	/* 15 window bits + 32: accept both gzip and zlib headers */
+	if (inflateInit2(&zs, 15 + 32) != Z_OK)
+		throw std::runtime_error("inflateInit2 failed");
+
+	size_t in_pos = 0;
+	Chunk out = take_spare();
+	size_t out_pos = 0;
+
+	while (!cancelled) {
+		if (zs.avail_in == 0) {
+			if (in_pos >= file.size())
+				break;
+			size_t slice = std::min(GZIP_INPUT_SLICE, file.size() - in_pos);
+			zs.next_in = const_cast<Bytef *>(file.data() + in_pos);
+			zs.avail_in = static_cast<uInt>(slice);
+			in_pos += slice;
+		}
+		zs.next_out = out.data() + out_pos;
+		zs.avail_out = static_cast<uInt>(out.size() - out_pos);
+
+		int ret = inflate(&zs, Z_NO_FLUSH);
+		out_pos = out.size() - zs.avail_out;
+
+		if (ret == Z_STREAM_END) {
+			/* concatenated gzip members are one logical stream */
+			if (zs.avail_in == 0 && in_pos >= file.size())
+				break;
+			inflateReset(&zs);
+		} else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+			inflateEnd(&zs);
+			throw std::runtime_error(std::string("gzip: ") + (zs.msg ? zs.msg : "corrupt input"));
+		}
+
+		if (out_pos == out.size()) {
+			if (!ready.push(std::move(out)))
+				break;
+			out = take_spare();
+			out_pos = 0;
+			file.release_before(in_pos - zs.avail_in);
+		}
+	}
+	inflateEnd(&zs);
+
+	if (out_pos && !cancelled) {
+		out.resize(out_pos);
+		ready.push(std::move(out));
+	}
+#else
+	fail("built without gzip support (zlib not found)");
+#endif
+}
+
+void CompressedCapture::run_zstd() {
+#ifdef NTA_HAVE_ZSTD
+	/* split the input into frames; parallel decoding needs every frame size up front */
+	std::vector<std::pair<size_t, size_t>> frames;
+	bool sized = true;
+	for (size_t pos = 0; pos < file.size();) {
+		size_t len = ZSTD_findFrameCompressedSize(file.data() + pos, file.size() - pos);
+		if (ZSTD_isError(len))
+			throw std::runtime_error(std::string("zstd: ") + ZSTD_getErrorName(len));
+		unsigned long long content = ZSTD_getFrameContentSize(file.data() + pos, file.size() - pos);
+		if (content == ZSTD_CONTENTSIZE_UNKNOWN || content == ZSTD_CONTENTSIZE_ERROR || content > MAX_PARALLEL_FRAME)
+			sized = false;
+		frames.emplace_back(pos, len);
+		pos += len;
+	}
+
+	if (threads > 1 && frames.size() > 1 && sized) {
+		run_zstd_parallel(frames);
+		return;
+	}
+
+	std::unique_ptr<ZSTD_DStream, decltype(&ZSTD_freeDStream)> ds(ZSTD_createDStream(), &ZSTD_freeDStream);
+	ZSTD_inBuffer in{file.data(), file.size(), 0};
+	Chunk out = take_spare();
+	ZSTD_outBuffer ob{out.data(), out.size(), 0};
+
+	while (!cancelled && in.pos < in.size) {
+		size_t ret = ZSTD_decompressStream(ds.get(), &ob, &in);
+		if (ZSTD_isError(ret))
+			throw std::runtime_error(std::string("zstd: ") + ZSTD_getErrorName(ret));
+		if (ob.pos == ob.size) {
+			if (!ready.push(std::move(out)))
+				return;
+			out = take_spare();
+			ob = {out.data(), out.size(), 0};
+			file.release_before(in.pos);
+		}
+	}
+	/* flush whatever the decoder still holds */
+	while (!cancelled) {
+		size_t before = ob.pos;
+		size_t ret = ZSTD_decompressStream(ds.get(), &ob, &in);
+		if (ZSTD_isError(ret) || ob.pos == before)
+			break;
+		if (ob.pos == ob.size) {
+			if (!ready.push(std::move(out)))
+				return;
+			out = take_spare();
+			ob = {out.data(), out.size(), 0};
+		}
+	}
+	if (ob.pos && !cancelled) {
+		out.resize(ob.pos);
+		ready.push(std::move(out));
+	}
+#else
+	fail("built without zstd support (libzstd not found)");
+#endif
+}
+
+/**
+ * Independent frames are decoded by a worker pool; this thread acts as
+ * the sequencer and publishes frames strictly in file order. Workers stay
+ * at most 2 * threads frames ahead of the consumer to bound memory.
+ */
+void CompressedCapture::run_zstd_parallel(const std::vector<std::pair<size_t, size_t>> &frames) {
+#ifdef NTA_HAVE_ZSTD
+	const size_t window = threads * 2;
+	std::mutex mtx;
+	std::condition_variable cv;
+	std::vector<std::optional<Chunk>> done(frames.size());
+	size_t delivered = 0;
+	std::atomic<size_t> next_frame{0};
+	std::string worker_error;
+
+	auto worker = [&] {
+		std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> dctx(ZSTD_createDCtx(), &ZSTD_freeDCtx);
+		while (true) {
+			size_t i = next_frame++;
+			if (i >= frames.size())
+				return;
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				cv.wait(lock, [&] { return cancelled || !worker_error.empty() || i < delivered + window; });
+				if (cancelled || !worker_error.empty())
+					return;
+			}
+			const uint8_t *src = file.data() + frames[i].first;
+			Chunk out = spare.try_pop().value_or(Chunk{});
+			out.resize(static_cast<size_t>(ZSTD_getFrameContentSize(src, frames[i].second)));
+			size_t n = ZSTD_decompressDCtx(dctx.get(), out.data(), out.size(), src, frames[i].second);
+
+			std::lock_guard<std::mutex> lock(mtx);
+			if (ZSTD_isError(n)) {
+				worker_error = std::string("zstd: ") + ZSTD_getErrorName(n);
+			} else {
+				out.resize(n);
+				done[i] = std::move(out);
+			}
+			cv.notify_all();
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (unsigned t = 0; t < std::min<size_t>(threads, frames.size()); ++t)
+		pool.emplace_back(worker);
+
+	for (size_t i = 0; i < frames.size(); ++i) {
+		Chunk chunk;
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			cv.wait(lock, [&] { return cancelled || !worker_error.empty() || done[i].has_value(); });
+			if (cancelled || !worker_error.empty())
+				break;
+			chunk = std::move(*done[i]);
+			done[i].reset();
+			++delivered;
+			cv.notify_all();
+		}
+		if (!chunk.empty() && !ready.push(std::move(chunk)))
+			break;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		if (worker_error.empty() && delivered < frames.size())
+			cancelled = true;
+		cv.notify_all();
+	}
+	for (auto &t : pool)
+		t.join();
+	if (!worker_error.empty())
+		fail(worker_error);
+#else
+	(void)frames;
+#endif
+}
+
+uint64_t read_compressed_capture(CompressedCapture &stream, CaptureParser &parser, CaptureParser::Handler handler,
+								 void *user) {
+	uint64_t consumed = 0;
+	std::vector<uint8_t> carry;
+
+	while (auto chunk = stream.next()) {
+		const uint8_t *p = chunk->data();
+		size_t n = chunk->size();
+
+		/* finish the block left over from the previous chunk first */
+		while (!carry.empty() && n > 0) {
+			size_t need = parser.next_block_size(carry.data(), carry.size());
+			size_t take = need ? std::min(n, need - carry.size()) : std::min<size_t>(n, 8);
+			carry.insert(carry.end(), p, p + take);
+			p += take;
+			n -= take;
+
+			need = parser.next_block_size(carry.data(), carry.size());
+			if (need && need <= carry.size()) {
+				size_t used = parser.parse(carry.data(), carry.size(), handler, user);
+				consumed += used;
+				carry.erase(carry.begin(), carry.begin() + static_cast<std::ptrdiff_t>(used));
+				if (parser.stopped()) {
+					stream.cancel();
+					return consumed;
+				}
+			}
+		}
+
+		if (carry.empty()) {
+			size_t used = parser.parse(p, n, handler, user);
+			consumed += used;
+			if (parser.stopped()) {
+				stream.cancel();
+				return consumed;
+			}
+			carry.assign(p + used, p + n);
+		}
+		stream.recycle(std::move(*chunk));
+	}
+	return consumed;
+}
@@ -0,0 +1,229 @@
+#include "../../include/capture/packetRing.hpp"
+#include "../../include/capture/pcapFormat.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+/* caplen of the filler record written when the next record doesn't fit before the end of the slab */
+constexpr uint32_t WRAP_MARK = UINT32_MAX;
+constexpr uint32_t FILE_SNAPLEN = 262144;
+
+volatile sig_atomic_t signal_dump = 0;
+
+void on_dump_signal(int) { signal_dump = 1; }
+
+size_t align8(size_t n) { return (n + 7) & ~size_t(7); }
+
+uint64_t record_ns(const SavefileRecord &r) {
+	return static_cast<uint64_t>(r.ts_sec) * 1000000000ull + r.ts_frac;
+}
+
+} // namespace
+
+PacketRing::PacketRing(PacketRingOptions options) : opts(std::move(options)) {
+	capacity = (std::max<size_t>(opts.bytes, 64 * 1024) + 4095) / 4096 * 4096;
+	slab.reset(new (std::nothrow) uint8_t[capacity]);
+	if (!slab)
+		throw std::runtime_error("Couldn't allocate the packet ring");
+	/* touch every page now rather than on the capture thread */
+	memset(slab.get(), 0, capacity);
+	dumper = std::thread([this] { run(); });
+}
+
+PacketRing::~PacketRing() { close(); }
+
+void PacketRing::install_signal_trigger() {
+	struct sigaction sa {};
+	sa.sa_handler = on_dump_signal;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	sigaction(SIGUSR1, &sa, nullptr);
+}
+
+void PacketRing::close() {
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		stopping = true;
+	}
+	wake.notify_all();
+	if (dumper.joinable())
+		dumper.join();
+}
+
+void PacketRing::request_dump() {
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		dump_requested = true;
+	}
+	wake.notify_all();
+}
+
+std::string PacketRing::last_dump() {
+	std::lock_guard<std::mutex> lock(mtx);
+	return last_path;
+}
+
+uint64_t PacketRing::next_record(uint64_t pos, const uint8_t *record) const {
+	size_t left = capacity - pos % capacity;
+	if (left < sizeof(SavefileRecord))
+		return pos + left;
+	SavefileRecord r;
+	memcpy(&r, record, sizeof(r));
+	if (r.caplen == WRAP_MARK)
+		return pos + left;
+	return pos + align8(sizeof(SavefileRecord) + r.caplen);
+}
+
+void PacketRing::write(int type, uint64_t ts_ns, const struct pcap_pkthdr *header, const u_char *data) {
+	size_t need = align8(sizeof(SavefileRecord) + header->caplen);
+	if (need > capacity)
+		return;
+	if (type != linktype.load(std::memory_order_relaxed))
+		linktype.store(type, std::memory_order_relaxed);
+
+	uint64_t window_ns = static_cast<uint64_t>(opts.window.count()) * 1000000000ull;
+
+	size_t left = capacity - write_tail % capacity;
+	uint64_t start = left < need ? write_tail + left : write_tail;
+	uint64_t end = start + need;
+
+	/* evict until the new record fits and the oldest one is inside the window */
+	uint64_t h = write_head;
+	while (h < write_tail) {
+		const uint8_t *rec = slab.get() + h % capacity;
+		if (end - h <= capacity && capacity - h % capacity >= sizeof(SavefileRecord)) {
+			SavefileRecord r;
+			memcpy(&r, rec, sizeof(r));
+			if (r.caplen != WRAP_MARK && record_ns(r) + window_ns >= ts_ns)
+				break;
+		}
+		h = next_record(h, rec);
+	}
+	if (h >= write_tail)
+		h = start;
+	if (h != write_head) {
+		write_head = h;
+		head.store(h, std::memory_order_relaxed);
+		/* the new head must be visible before the space it frees is overwritten */
+		std::atomic_thread_fence(std::memory_order_release);
+	}
+
+	if (start != write_tail && left >= sizeof(SavefileRecord)) {
+		SavefileRecord mark{0, 0, WRAP_MARK, 0};
+		memcpy(slab.get() + write_tail % capacity, &mark, sizeof(mark));
+	}
+	SavefileRecord rec{static_cast<uint32_t>(ts_ns / 1000000000ull), static_cast<uint32_t>(ts_ns % 1000000000ull),
+					   header->caplen, header->len};
+	uint8_t *out = slab.get() + start % capacity;
+	memcpy(out, &rec, sizeof(rec));
+	memcpy(out + sizeof(rec), data, header->caplen);
+
+	write_tail = end;
+	tail.store(end, std::memory_order_release);
+}
+
+/**
+ * @brief Writes the frames currently in the ring to a new pcap file.
+ *
+ * Copies [head, tail) without stopping the capture thread, then keeps
+ * only the records at or after the head observed once the copy is done;
+ * anything before it may have been overwritten meanwhile.
+ */
+void PacketRing::dump() {
+	int type = linktype.load(std::memory_order_relaxed);
+	if (type < 0)
+		return;
+
+	uint64_t h1 = head.load(std::memory_order_acquire);
+	uint64_t t = tail.load(std::memory_order_acquire);
+	/* the ring may have moved on between the two loads; the head read after the copy is past this anyway */
+	if (t - h1 > capacity)
+		h1 = t - capacity;
+	std::vector<uint8_t> copy(t - h1);
+	size_t phys = h1 % capacity;
+	size_t first = std::min<size_t>(copy.size(), capacity - phys);
+	memcpy(copy.data(), slab.get() + phys, first);
+	memcpy(copy.data() + first, slab.get(), copy.size() - first);
+	std::atomic_thread_fence(std::memory_order_acquire);
+	uint64_t h2 = head.load(std::memory_order_relaxed);
+
+	/* offsets of intact records in the copy */
+	std::vector<size_t> records;
+	uint64_t newest = 0;
+	for (uint64_t pos = std::max(h1, h2); pos < t;) {
+		const uint8_t *rec = copy.data() + (pos - h1);
+		const auto *r = reinterpret_cast<const SavefileRecord *>(rec);
+		bool is_record = capacity - pos % capacity >= sizeof(SavefileRecord) && r->caplen != WRAP_MARK;
+		uint64_t next = next_record(pos, rec);
+		if (next > t)
+			break;
+		if (is_record) {
+			records.push_back(pos - h1);
+			newest = std::max(newest, record_ns(*r));
+		}
+		pos = next;
+	}
+
+	char stamp[32];
+	time_t now = time(nullptr);
+	struct tm utc {};
+	gmtime_r(&now, &utc);
+	strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &utc);
+	std::string path = opts.dump_prefix + "-" + stamp + "-" + std::to_string(dump_count.load()) + ".pcap";
+
+	FILE *file = fopen(path.c_str(), "wb");
+	if (!file) {
+		fprintf(stderr, "Couldn't open %s for writing: %s\n", path.c_str(), strerror(errno));
+		return;
+	}
+	SavefileHeader fh = make_savefile_header(static_cast<uint32_t>(type), FILE_SNAPLEN, true);
+	bool ok = fwrite(&fh, sizeof(fh), 1, file) == 1;
+	uint64_t window_ns = static_cast<uint64_t>(opts.window.count()) * 1000000000ull;
+	for (size_t off : records) {
+		const auto *rec = reinterpret_cast<const SavefileRecord *>(copy.data() + off);
+		if (record_ns(*rec) + window_ns < newest)
+			continue;
+		ok = ok && fwrite(rec, sizeof(SavefileRecord) + rec->caplen, 1, file) == 1;
+	}
+	ok = fclose(file) == 0 && ok;
+	if (!ok) {
+		fprintf(stderr, "Write to %s failed: %s\n", path.c_str(), strerror(errno));
+		return;
+	}
+
+	++dump_count;
+	std::lock_guard<std::mutex> lock(mtx);
+	last_path = path;
+}
+
+void PacketRing::run() {
+	std::unique_lock<std::mutex> lock(mtx);
+	while (!stopping) {
+		/* the signal handler can't notify, so poll its flag */
+		wake.wait_for(lock, std::chrono::milliseconds(100), [this] { return stopping || dump_requested; });
+		if (signal_dump) {
+			signal_dump = 0;
+			dump_requested = true;
+		}
+		if (!dump_requested)
+			continue;
+		dump_requested = false;
+		lock.unlock();
+		dump();
+		lock.lock();
+	}
+	if (dump_requested) {
+		dump_requested = false;
+		lock.unlock();
+		dump();
+	}
+}
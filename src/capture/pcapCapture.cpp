@@ -1,5 +1,28 @@
 #include "../../include/capture/pcapCapture.hpp"
 #include "../../include/stats/protocolStats.hpp"
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+
+/* how often collect() drains the per-interface shards */
+static constexpr std::chrono::milliseconds COLLECT_INTERVAL{100};
+
+/* splits "eth0,eth1" into interface names, throws on an empty or repeated one */
+static std::vector<std::string> split_interfaces(const std::string &list) {
+	std::vector<std::string> names;
+	std::stringstream in(list);
+	std::string name;
+	while (std::getline(in, name, ',')) {
+		name.erase(0, name.find_first_not_of(" \t"));
+		name.erase(name.find_last_not_of(" \t") + 1);
+		if (name.empty())
+			throw std::invalid_argument("Empty interface name in '" + list + "'");
+		if (std::find(names.begin(), names.end(), name) != names.end())
+			throw std::invalid_argument("Interface " + name + " given twice");
+		names.push_back(name);
+	}
+	return names;
+}
 
 /* get a list of all available network interfaces */
 void PcapCapture::initialize() {
@@ -11,6 +34,7 @@ void PcapCapture::initialize() {
 }
 
 void PcapCapture::datalink_type(int type) {
+	datalink = type;
 	switch (type) {
 
 	case DLT_EN10MB: {
@@ -46,8 +70,16 @@ void PcapCapture::datalink_type(int type) {
  *  2. Open device in promiscuous mode
  *  3. Compile and apply BPF filter (if provided)
  *  4. Start pcap_loop in a separate thread
+ *
+ * A comma-separated interface list starts one such capture per
+ * interface instead, see start_links().
  */
 void PcapCapture::start() {
+	if (interface.find(',') != std::string::npos) {
+		start_links(split_interfaces(interface));
+		return;
+	}
+
 	// getting the netmask of the interface
 	if (pcap_lookupnet(interface.c_str(), &net, &mask, errbuf) == -1) {
 		fprintf(stderr, "Couldn't get netmask for device %s: %s\n", interface.c_str(), errbuf);
@@ -55,11 +87,21 @@ void PcapCapture::start() {
 		mask = 0;
 	}
 
-	/* open capture device */
-	handle.reset(pcap_open_live(interface.c_str(), SNAP_LEN, 1, 1000, errbuf));
+	/* open capture device, asking for nanosecond timestamps where the platform has them */
+	handle.reset(pcap_create(interface.c_str(), errbuf));
 	if (handle == nullptr) {
 		throw std::runtime_error("Couldn't open device " + interface + ": " + errbuf);
 	}
+	pcap_set_snaplen(handle.get(), SNAP_LEN);
+	pcap_set_promisc(handle.get(), 1);
+	pcap_set_timeout(handle.get(), 1000);
+	pcap_set_tstamp_precision(handle.get(), PCAP_TSTAMP_PRECISION_NANO);
+	if (pcap_activate(handle.get()) < 0) {
+		std::string error = pcap_geterr(handle.get());
+		handle.reset();
+		throw std::runtime_error("Couldn't open device " + interface + ": " + error);
+	}
+	ts_scale = pcap_get_tstamp_precision(handle.get()) == PCAP_TSTAMP_PRECISION_NANO ? 1 : 1000;
 
 	datalink_type(pcap_datalink(handle.get()));
 
@@ -76,8 +118,10 @@ void PcapCapture::start() {
 	}
 
 	/* start a separate thread */
+	live = true;
 	running = true;
 	thread = std::thread([this]() {
+		PerfMonitor::Scope perf(PerfRole::CAPTURE);
 		if (pcap_loop(handle.get(), num_packets, &PcapCapture::callback, reinterpret_cast<u_char *>(this)) < 0) {
 			// fprintf(stderr, "Error in pcap_loop: %s\n", pcap_geterr(handle));
 			// pcap_close(handle);
@@ -86,9 +130,154 @@ void PcapCapture::start() {
 		running = false;
 	});
 }
-PcapCapture::~PcapCapture() { stop(); }
+/**
+ * @brief Starts one capture per interface, all counted into this capture's Stats.
+ *
+ * Every interface gets a child PcapCapture with its own handle, thread
+ * and datalink decoder (an Ethernet NIC next to a tunnel no longer needs
+ * the "any" device and its SLL headers), and its own Stats shard with
+ * the detectors and prefix table of the main one. The capture threads
+ * only ever lock their own shard; collect() merges them from the UI /
+ * headless loop. The same goes for the display filter's Stats, every
+ * link counts into a shard of its own, and each thread counts flows into
+ * its own flow table.
+ */
+void PcapCapture::start_links(const std::vector<std::string> &names) {
+	stats->set_interfaces(names);
+	{
+		std::lock_guard<std::mutex> lock(display_mtx);
+		if (pending_stats)
+			pending_stats->set_interfaces(names);
+	}
+	for (const auto &name : names) {
+		link_stats.push_back(std::make_unique<Stats>());
+		Stats *shard = link_stats.back().get();
+		if (const AnomalyOptions *opts = stats->anomaly_options())
+			shard->enable_anomaly_detection(*opts);
+		if (const ScanOptions *opts = stats->scan_options())
+			shard->enable_scan_detection(*opts);
+		shard->set_networks(stats->network_table());
+
+		links.push_back(std::make_unique<PcapCapture>());
+		PcapCapture &link = *links.back();
+		link.set_capabilities(name, num_packets, filter_exp, stats->get_packets_limit(), shard);
+		link.set_flow_exporter(flow_exporter);
+		{
+			std::lock_guard<std::mutex> lock(display_mtx);
+			display_shards.push_back(display_shard());
+			link.set_display(pending_filter, display_shards.back());
+		}
+		link.start();
+	}
+	last_collect = std::chrono::steady_clock::now();
+	running = true;
+}
+
+void PcapCapture::collect(bool force) {
+	if (links.empty())
+		return;
+	auto now = std::chrono::steady_clock::now();
+	if (!force && now - last_collect < COLLECT_INTERVAL)
+		return;
+	last_collect = now;
+	for (size_t i = 0; i < links.size(); ++i)
+		stats->drain(*link_stats[i], i, links[i]->dropped.load(std::memory_order_relaxed));
+
+	std::lock_guard<std::mutex> lock(display_mtx);
+	for (size_t i = 0; i < display_shards.size(); ++i) {
+		if (display_shards[i])
+			pending_stats->drain(*display_shards[i], i, links[i]->dropped.load(std::memory_order_relaxed));
+	}
+}
+
+std::shared_ptr<Stats> PcapCapture::display_shard() const {
+	if (!pending_stats)
+		return nullptr;
+	auto shard = std::make_shared<Stats>();
+	shard->set_packets_limit(pending_stats->get_packets_limit());
+	if (const AnomalyOptions *opts = pending_stats->anomaly_options())
+		shard->enable_anomaly_detection(*opts);
+	if (const ScanOptions *opts = pending_stats->scan_options())
+		shard->enable_scan_detection(*opts);
+	shard->set_networks(pending_stats->network_table());
+	return shard;
+}
+
+bool PcapCapture::isRunning() {
+	if (links.empty())
+		return running;
+	return std::any_of(links.begin(), links.end(), [](const auto &link) { return link->isRunning(); });
+}
+
+void PcapCapture::setRunning(bool running) {
+	this->running = running;
+	for (auto &link : links)
+		link->setRunning(running);
+}
+
+/**
+ * @brief Captures the frames of a paced replay on the capture thread.
+ *
+ * The thread pops the frames the replayer sends and runs them through
+ * got_packet() like frames off a live handle; the replayer's timestamps
+ * are nanoseconds. BPF filters don't apply, there is no handle to
+ * attach them to.
+ */
+void PcapCapture::start_replay(Replayer &replayer) {
+	this->replayer = &replayer;
+	ts_scale = 1;
+	linktype = -1;
+	offline_count = 0;
+	running = true;
+	replayer.start();
+	thread = std::thread([this]() {
+		PerfMonitor::Scope perf(PerfRole::CAPTURE);
+		while (const ReplayFrame *frame = this->replayer->pop()) {
+			if (!isRunning())
+				break;
+			if (frame->linktype != linktype) {
+				try {
+					datalink_type(frame->linktype);
+				} catch (const std::runtime_error &e) {
+					fprintf(stderr, "Error replaying %s: %s\n", this->replayer->options().path.c_str(), e.what());
+					break;
+				}
+				linktype = frame->linktype;
+			}
+
+			pcap_pkthdr header{};
+			header.ts.tv_sec = static_cast<time_t>(frame->ts_ns / 1000000000ull);
+			header.ts.tv_usec = static_cast<suseconds_t>(frame->ts_ns % 1000000000ull);
+			header.caplen = frame->caplen;
+			header.len = frame->len;
+			got_packet(&header, frame->data.data());
+			this->replayer->release();
+
+			if (num_packets > 0 && ++offline_count >= static_cast<uint64_t>(num_packets))
+				break;
+		}
+		this->replayer->stop();
+		running = false;
+	});
+}
+
+PcapCapture::~PcapCapture() {
+	stop();
+	if (flow_source)
+		flow_exporter->release(flow_source);
+}
 void PcapCapture::stop() {
+	/* each child stops and joins its own thread, the objects stay for a last collect() */
+	for (auto &link : links)
+		link->stop();
 	pcap_freecode(&fp);
+	if (replayer) {
+		running = false;
+		replayer->stop();
+		if (thread.joinable())
+			thread.join();
+		replayer = nullptr;
+	}
 	if (!handle)
 		return;
 
@@ -152,32 +341,122 @@ void PcapCapture::callback(u_char *user, const struct pcap_pkthdr *header, const
 void PcapCapture::got_packet(const struct pcap_pkthdr *header, const u_char *packet) {
 	if (!running)
 		return;
+	if (live && header->ts.tv_sec != drops_sec)
+		update_drops(header->ts.tv_sec);
+	uint64_t ts_ns = static_cast<uint64_t>(header->ts.tv_sec) * 1000000000ull +
+					 static_cast<uint64_t>(header->ts.tv_usec) * ts_scale;
+	if (capture_writer)
+		capture_writer->write(datalink, ts_ns, header, packet);
+	if (packet_ring)
+		packet_ring->write(datalink, ts_ns, header, packet);
 
+	/* decoding up to the Packet view, the Stats update is timed as lock wait on its own */
+	uint64_t parse_begin = Latency::start();
+	/* a record cut short (snaplen, damaged file) is only decoded as far as it was captured */
+	if (header->caplen < offset)
+		return;
+	size_t ip_caplen = header->caplen - offset;
 	// --- Ethernet header ---
 	// const auto* ethernet = reinterpret_cast<const ether_header*>(packet + offset);
 	uint16_t ether_type = get_ether_type(packet);
 
 	/* if we have a ipv4 type */
 	if (ether_type == ETHERTYPE_IP) {
-		IPv4 ip(packet + offset);
+		IPv4 ip(packet + offset, ip_caplen);
+		if (!ip.valid())
+			return;
 		TransportProtocol prot = ip.get_protocol();
 
 		Packet packetView(v4, prot, ip.get_source(), ip.get_dest(), ip.get_src_port(), ip.get_dest_port(), header->len,
 						  ip.get_payload_len(), ip.get_payload_ptr());
-		stats->add_packet(packetView);
-		stats->push(packetView);
+		packetView.src_addr = ip.get_source_addr();
+		packetView.dst_addr = ip.get_dest_addr();
+		packetView.ts_ns = ts_ns;
+		packetView.tcp_flags = ip.get_tcp_flags();
+		Latency::stop(LatencyStage::PARSE, parse_begin);
+		count(packetView);
+		if (flow_exporter)
+			export_flow(ip, v4, packetView.ts_ns, header->len);
 	}
 	/* ipv6 type */
 	else if (ether_type == ETHERTYPE_IPV6) {
-		IPv6 ip(packet + offset);
+		IPv6 ip(packet + offset, ip_caplen);
+		if (!ip.valid())
+			return;
 		TransportProtocol prot = ip.get_protocol();
 		Packet packetView(v6, prot, ip.get_source(), ip.get_dest(), ip.get_src_port(), ip.get_dest_port(), header->len,
 						  ip.get_payload_len(), ip.get_payload_ptr());
-		stats->add_packet(packetView);
-		stats->push(packetView);
+		packetView.src_addr = ip.get_source_addr();
+		packetView.dst_addr = ip.get_dest_addr();
+		packetView.ts_ns = ts_ns;
+		packetView.tcp_flags = ip.get_tcp_flags();
+		Latency::stop(LatencyStage::PARSE, parse_begin);
+		count(packetView);
+		if (flow_exporter)
+			export_flow(ip, v6, packetView.ts_ns, header->len);
 	}
 }
 
+void PcapCapture::update_drops(time_t sec) {
+	drops_sec = sec;
+	pcap_stat ps{};
+	if (pcap_stats(handle.get(), &ps) == 0)
+		dropped.store(uint64_t(ps.ps_drop) + ps.ps_ifdrop, std::memory_order_relaxed);
+}
+
+void PcapCapture::count(const Packet &packet) {
+	stats->add_packet(packet);
+	stats->push(packet);
+
+	if (display_generation.load(std::memory_order_acquire) != display_seen) {
+		std::lock_guard<std::mutex> lock(display_mtx);
+		display_filter = pending_filter;
+		display_stats = pending_stats;
+		display_seen = display_generation.load(std::memory_order_relaxed);
+	}
+	if (display_filter && display_filter->match(packet)) {
+		display_stats->add_packet(packet);
+		display_stats->push(packet);
+	}
+}
+
+/**
+ * @brief Swaps the display filter without stopping the capture.
+ *
+ * The capture thread picks the new pair up with its next packet; the
+ * previous Stats stays alive as long as the caller holds on to it.
+ */
+void PcapCapture::set_display(std::shared_ptr<const DisplayFilter> filter, std::shared_ptr<Stats> stats) {
+	std::lock_guard<std::mutex> lock(display_mtx);
+	pending_filter = std::move(filter);
+	pending_stats = std::move(stats);
+	/* with several interfaces each link gets a new shard, whatever the old ones still hold goes with the old Stats */
+	if (pending_stats && !links.empty()) {
+		std::vector<std::string> names;
+		for (const auto &link : links)
+			names.push_back(link->interface);
+		pending_stats->set_interfaces(names);
+	}
+	for (size_t i = 0; i < links.size(); ++i) {
+		display_shards[i] = display_shard();
+		links[i]->set_display(pending_filter, display_shards[i]);
+	}
+	display_generation.fetch_add(1, std::memory_order_release);
+}
+
+void PcapCapture::export_flow(IP_class &ip, IPVersion version, uint64_t ts_ns, uint32_t len) {
+	FlowKey key;
+	key.src = ip.get_source_addr();
+	key.dst = ip.get_dest_addr();
+	key.src_port = ip.get_src_port();
+	key.dst_port = ip.get_dest_port();
+	key.protocol = iana_protocol(ip.get_protocol());
+	key.version = version == v6 ? 6 : 4;
+	if (!flow_source)
+		flow_source = flow_exporter->open_source();
+	flow_source->add(key, ts_ns, len);
+}
+
 void PcapCapture::set_capabilities(const std::string &interface, int num_packets, const std::string &filter_exp,
 								   const int packets_limit, Stats *stats) {
 	this->interface = interface;
@@ -186,22 +465,117 @@ void PcapCapture::set_capabilities(const std::string &interface, int num_packets
 	this->stats = stats;
 	this->stats->set_packets_limit(packets_limit);
 }
+OfflineReader parse_offline_reader(const std::string &name) {
+	if (name == "mmap")
+		return OfflineReader::MMAP;
+	if (name == "libpcap")
+		return OfflineReader::LIBPCAP;
+	throw std::invalid_argument("Unknown offline reader: '" + name + "' (expected mmap | libpcap)");
+}
+
+/**
+ * @brief Forwards one record of a mapped capture file to got_packet().
+ *
+ * pcapng files may mix link types per interface, so the datalink
+ * decoder is switched whenever the record's link type changes.
+ *
+ * @return false once the packet limit is reached or capture was stopped
+ */
+bool PcapCapture::record_callback(void *user, const CaptureRecord &record) {
+	auto *self = static_cast<PcapCapture *>(user);
+	if (!self->isRunning())
+		return false;
+	if (!self->range.contains(record.ts_ns))
+		return true;
+
+	if (record.linktype != self->linktype) {
+		self->datalink_type(record.linktype);
+		self->linktype = record.linktype;
+	}
+
+	pcap_pkthdr header{};
+	header.ts.tv_sec = static_cast<time_t>(record.ts_ns / 1000000000ull);
+	/* the parsed timestamp is kept in full, see ts_scale */
+	header.ts.tv_usec = static_cast<suseconds_t>(record.ts_ns % 1000000000ull);
+	header.caplen = record.caplen;
+	header.len = record.len;
+	self->got_packet(&header, record.data);
+
+	return self->num_packets <= 0 || ++self->offline_count < static_cast<uint64_t>(self->num_packets);
+}
+
 /**
- * @brief Processes packets from an offline .pcap file.
+ * @brief Reads a capture file through a read-only mapping.
+ *
+ * Records are parsed in place and handed to the decoder without
+ * copying. Pages behind the read position are released as the file
+ * is consumed, so captures larger than RAM are fine.
+ *
+ * gzip / zstd compressed captures are always read here, whatever the
+ * selected reader: they are decompressed on background threads and
+ * parsed straight out of the decompressed chunks.
+ *
+ * @return false if the file can't be mapped or isn't (compressed)
+ *         pcap/pcapng, so the caller can fall back to libpcap
+ */
+bool PcapCapture::read_mapped(const std::string &fpath) {
+	std::unique_ptr<MappedFile> file;
+	try {
+		file = std::make_unique<MappedFile>(fpath);
+	} catch (const std::runtime_error &) {
+		return false;
+	}
+	Compression compression = detect_compression(file->data(), file->size());
+	if (compression == Compression::NONE &&
+		(offline_reader == OfflineReader::LIBPCAP || !CaptureParser::recognizes(file->data(), file->size())))
+		return false;
+
+	CaptureParser parser;
+	linktype = -1;
+	offline_count = 0;
+	ts_scale = 1;
+	running = true;
+	try {
+		if (compression == Compression::NONE) {
+			read_mapped_capture(*file, parser, &PcapCapture::record_callback, this);
+		} else {
+			file.reset();
+			CompressedCapture stream(fpath, compression, std::max(2u, std::thread::hardware_concurrency()) - 1);
+			read_compressed_capture(stream, parser, &PcapCapture::record_callback, this);
+			if (!stream.error().empty())
+				fprintf(stderr, "Error decompressing offline file %s: %s\n", fpath.c_str(), stream.error().c_str());
+		}
+	} catch (const std::runtime_error &e) {
+		fprintf(stderr, "Error reading offline file %s: %s\n", fpath.c_str(), e.what());
+	}
+	running = false;
+	return true;
+}
+
+/**
+ * @brief Processes packets from an offline .pcap / .pcapng file.
  *
  * Differences from live mode:
  *  - Runs synchronously
  *  - No additional thread is created
  *  - Blocks until entire file is processed
  *
+ * Uses the mapped reader by default and falls back to libpcap for
+ * inputs it can't map (pipes, exotic formats).
+ *
  * Used for post-capture analysis and exporting results.
  */
 void PcapCapture::start_offline(const std::string &fpath) {
-	handle.reset(pcap_open_offline(fpath.c_str(), errbuf));
+	PerfMonitor::Scope perf(PerfRole::CAPTURE);
+	if (offline_reader == OfflineReader::MMAP && read_mapped(fpath))
+		return;
+
+	handle.reset(pcap_open_offline_with_tstamp_precision(fpath.c_str(), PCAP_TSTAMP_PRECISION_NANO, errbuf));
 	if (handle == nullptr) {
 		fprintf(stderr, "Error opening offline file: %s\n", errbuf);
 		return;
 	}
+	ts_scale = 1;
 	datalink_type(pcap_datalink(handle.get()));
 
 	running = true;
@@ -209,4 +583,137 @@ void PcapCapture::start_offline(const std::string &fpath) {
 	pcap_loop(handle.get(), num_packets, &PcapCapture::callback, reinterpret_cast<u_char *>(this));
 
 	running = false;
-}
\ No newline at end of file
+}
+/**
+ * @brief Processes the packets of one time range.
+ *
+ * With an index only the blocks overlapping the range are parsed,
+ * after replaying the file header / pcapng interface blocks so the
+ * parser knows the format. Without one the whole file is scanned and
+ * filtered by timestamp.
+ */
+void PcapCapture::start_offline_range(const std::string &fpath, const TimeRange &range, const TimeIndex *index) {
+	this->range = range;
+	if (!index) {
+		offline_reader = OfflineReader::MMAP;
+		start_offline(fpath);
+		this->range = {};
+		return;
+	}
+
+	PerfMonitor::Scope perf(PerfRole::CAPTURE);
+	MappedFile file(fpath);
+	CaptureParser parser;
+	ts_scale = 1;
+	parser.parse(file.data(), index->data_offset, &PcapCapture::record_callback, this);
+
+	linktype = -1;
+	offline_count = 0;
+	running = true;
+	try {
+		for (const auto &[begin, end] : index->spans(range)) {
+			read_mapped_capture(file, parser, &PcapCapture::record_callback, this, begin, end);
+			if (parser.stopped())
+				break;
+		}
+	} catch (const std::runtime_error &e) {
+		fprintf(stderr, "Error reading offline file %s: %s\n", fpath.c_str(), e.what());
+	}
+	running = false;
+	this->range = {};
+}
+
+/**
+ * @brief Processes several time ranges of an offline file.
+ *
+ * A single range runs on the calling thread. Several ranges each get
+ * their own PcapCapture and Stats on a worker thread; the partial
+ * results are merged into this capture's Stats afterwards; overlapping
+ * ranges are coalesced first so no packet is counted twice.
+ */
+void PcapCapture::start_offline_ranges(const std::string &fpath, const std::vector<TimeRange> &requested) {
+	std::vector<TimeRange> ranges = coalesce_ranges(requested);
+	std::optional<TimeIndex> index = TimeIndex::load(TimeIndex::sidecar_path(fpath), fpath);
+	if (!index)
+		fprintf(stderr, "No up-to-date index for %s, scanning the whole file (see --build-index)\n", fpath.c_str());
+	const TimeIndex *idx = index ? &*index : nullptr;
+
+	if (ranges.size() == 1) {
+		start_offline_range(fpath, ranges.front(), idx);
+		return;
+	}
+
+	std::vector<std::unique_ptr<Stats>> partial;
+	std::vector<std::thread> workers;
+	for (const auto &r : ranges) {
+		partial.push_back(std::make_unique<Stats>());
+		Stats *part = partial.back().get();
+		if (const AnomalyOptions *opts = stats->anomaly_options())
+			part->enable_anomaly_detection(*opts);
+		if (const ScanOptions *opts = stats->scan_options())
+			part->enable_scan_detection(*opts);
+		part->set_networks(stats->network_table());
+		workers.emplace_back([this, &fpath, r, idx, part] {
+			PcapCapture worker;
+			worker.set_capabilities(interface, num_packets, filter_exp, stats->get_packets_limit(), part);
+			worker.set_flow_exporter(flow_exporter);
+			try {
+				worker.start_offline_range(fpath, r, idx);
+			} catch (const std::exception &e) {
+				fprintf(stderr, "Error analyzing range of %s: %s\n", fpath.c_str(), e.what());
+			}
+		});
+	}
+	for (auto &w : workers)
+		w.join();
+	for (auto &part : partial)
+		stats->merge(*part);
+}
+
+/**
+ * @brief Processes several offline files in parallel.
+ *
+ * Up to jobs workers take the next unprocessed file, each analyzing it
+ * with its own PcapCapture and Stats (time ranges and the packet count
+ * apply per file). Worker results are merged into this capture's Stats
+ * once all files are done; since counters are summed and the timeline
+ * is keyed by packet time, the order files finish in doesn't matter.
+ */
+void PcapCapture::start_offline_files(const std::vector<std::string> &files, const std::vector<TimeRange> &ranges,
+									  unsigned jobs) {
+	jobs = std::clamp<unsigned>(jobs, 1, static_cast<unsigned>(files.size()));
+	std::atomic<size_t> next_file{0};
+	std::vector<std::unique_ptr<Stats>> partial;
+	std::vector<std::thread> workers;
+	running = true;
+	for (unsigned j = 0; j < jobs; ++j) {
+		partial.push_back(std::make_unique<Stats>());
+		Stats *part = partial.back().get();
+		if (const AnomalyOptions *opts = stats->anomaly_options())
+			part->enable_anomaly_detection(*opts);
+		if (const ScanOptions *opts = stats->scan_options())
+			part->enable_scan_detection(*opts);
+		part->set_networks(stats->network_table());
+		workers.emplace_back([this, &files, &ranges, &next_file, part] {
+			for (size_t i = next_file++; i < files.size(); i = next_file++) {
+				PcapCapture worker;
+				worker.set_capabilities(interface, num_packets, filter_exp, stats->get_packets_limit(), part);
+				worker.set_offline_reader(offline_reader);
+				worker.set_flow_exporter(flow_exporter);
+				try {
+					if (ranges.empty())
+						worker.start_offline(files[i]);
+					else
+						worker.start_offline_ranges(files[i], ranges);
+				} catch (const std::exception &e) {
+					fprintf(stderr, "Error analyzing %s: %s\n", files[i].c_str(), e.what());
+				}
+			}
+		});
+	}
+	for (auto &w : workers)
+		w.join();
+	for (auto &part : partial)
+		stats->merge(*part);
+	running = false;
+}
@@ -0,0 +1,223 @@
+#include "../../include/capture/replay.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+
+namespace {
+
+/* a kernel wakeup is late by tens of microseconds, the last stretch before a frame is due is spun */
+constexpr std::chrono::microseconds SPIN{100};
+/* longest single sleep, so stop() is noticed during long gaps of the file */
+constexpr std::chrono::milliseconds MAX_SLEEP{100};
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	asm volatile("yield");
+#endif
+}
+
+} // namespace
+
+Replayer::Replayer(ReplayOptions options) : opts(std::move(options)) {
+	if (opts.speed < 0)
+		throw std::invalid_argument("Replay speed must not be negative");
+	if (!opts.queue)
+		throw std::invalid_argument("Replay queue must hold at least one frame");
+
+	file = std::make_unique<MappedFile>(opts.path);
+	compression = detect_compression(file->data(), file->size());
+	if (compression == Compression::NONE && !CaptureParser::recognizes(file->data(), file->size()))
+		throw std::runtime_error(opts.path + " is not a pcap / pcapng capture");
+	/* the decompressor maps the file itself */
+	if (compression != Compression::NONE)
+		file.reset();
+
+	size_t n = std::bit_ceil(opts.queue);
+	mask = n - 1;
+	/* allocated and touched up front, like a capture buffer */
+	slots = std::make_unique<ReplayFrame[]>(n);
+}
+
+Replayer::~Replayer() {
+	stop();
+	if (pacer.joinable())
+		pacer.join();
+}
+
+void Replayer::start() {
+	start_time = std::chrono::steady_clock::now();
+	start_epoch_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+											   std::chrono::system_clock::now().time_since_epoch())
+											   .count());
+	pacer = std::thread([this] { run(); });
+}
+
+void Replayer::stop() { stopping.store(true, std::memory_order_relaxed); }
+
+/**
+ * @brief Sends the file loops times (or until stopped).
+ *
+ * Every pass continues the timeline of the previous one, one average
+ * packet gap after its last record, so looping a short file reads as
+ * continuous traffic.
+ */
+void Replayer::run() {
+	try {
+		for (uint64_t loop = 0; (!opts.loops || loop < opts.loops) && !stopping.load(std::memory_order_relaxed);
+			 ++loop) {
+			CaptureParser parser;
+			have_first = false;
+			if (compression == Compression::NONE) {
+				read_mapped_capture(*file, parser, &Replayer::on_record, this);
+			} else {
+				CompressedCapture stream(opts.path, compression, std::max(2u, std::thread::hardware_concurrency()) - 1);
+				read_compressed_capture(stream, parser, &Replayer::on_record, this);
+				if (!stream.error().empty())
+					throw std::runtime_error(stream.error());
+			}
+			if (!parser.records())
+				break;
+			uint64_t span = last_ts - first_ts;
+			uint64_t gap = std::max<uint64_t>(span / std::max<uint64_t>(parser.records() - 1, 1), 1000000);
+			loop_base += span + gap;
+		}
+	} catch (const std::exception &e) {
+		failure = e.what();
+	}
+
+	uint64_t elapsed = static_cast<uint64_t>((std::chrono::steady_clock::now() - start_time).count());
+	account(elapsed);
+	/* shorter than a second: the average rate is all there is */
+	if (!clean_pps.load(std::memory_order_relaxed) && !dropped() && elapsed) {
+		clean_pps.store(sent() * 1000000000ull / elapsed, std::memory_order_relaxed);
+		clean_bytes.store(sent_bytes * 1000000000ull / elapsed, std::memory_order_relaxed);
+	}
+	finished.store(true, std::memory_order_release);
+}
+
+bool Replayer::on_record(void *user, const CaptureRecord &record) {
+	auto *self = static_cast<Replayer *>(user);
+	self->send(record);
+	return !self->stopping.load(std::memory_order_relaxed);
+}
+
+uint64_t Replayer::due(const CaptureRecord &record) {
+	if (opts.pps)
+		return scheduled * 1000000000ull / opts.pps;
+	if (!have_first) {
+		first_ts = record.ts_ns;
+		have_first = true;
+	}
+	last_ts = std::max(last_ts, record.ts_ns);
+	if (opts.speed == 0)
+		return 0;
+	/* out-of-order records go out right away */
+	uint64_t offset = loop_base + (record.ts_ns > first_ts ? record.ts_ns - first_ts : 0);
+	return static_cast<uint64_t>(static_cast<double>(offset) / opts.speed);
+}
+
+bool Replayer::wait_until(std::chrono::steady_clock::time_point due) {
+	using namespace std::chrono;
+	for (auto now = steady_clock::now(); due - now > SPIN; now = steady_clock::now()) {
+		if (stopping.load(std::memory_order_relaxed))
+			return false;
+		/* steady_clock is CLOCK_MONOTONIC, an absolute deadline doesn't drift with the loop */
+		auto wake = std::min(due - SPIN, now + MAX_SLEEP).time_since_epoch();
+		timespec ts{static_cast<time_t>(duration_cast<seconds>(wake).count()),
+					static_cast<long>(duration_cast<nanoseconds>(wake % seconds(1)).count())};
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+			;
+	}
+	while (steady_clock::now() < due)
+		cpu_relax();
+	return true;
+}
+
+void Replayer::send(const CaptureRecord &record) {
+	uint64_t due_ns = due(record);
+	if (!wait_until(start_time + std::chrono::nanoseconds(due_ns)))
+		return;
+	uint64_t elapsed = static_cast<uint64_t>((std::chrono::steady_clock::now() - start_time).count());
+	/* as fast as possible, nothing is ever late */
+	bool paced = opts.pps || opts.speed > 0;
+	uint64_t late = paced && elapsed > due_ns ? elapsed - due_ns : 0;
+	late_sum.fetch_add(late, std::memory_order_relaxed);
+	if (late > max_late.load(std::memory_order_relaxed))
+		max_late.store(late, std::memory_order_relaxed);
+	account(elapsed);
+	++scheduled;
+
+	uint64_t t = tail.load(std::memory_order_relaxed);
+	if (t - head.load(std::memory_order_acquire) > mask) {
+		/* the capture thread is behind, like a full kernel buffer */
+		dropped_frames.fetch_add(1, std::memory_order_relaxed);
+		++second_dropped;
+		return;
+	}
+	ReplayFrame &frame = slots[t & mask];
+	frame.ts_ns = start_epoch_ns + elapsed;
+	frame.caplen = std::min<uint32_t>(record.caplen, ReplayFrame::SNAPLEN);
+	frame.len = record.len;
+	frame.linktype = record.linktype;
+	memcpy(frame.data.data(), record.data, frame.caplen);
+	tail.store(t + 1, std::memory_order_release);
+
+	sent_frames.fetch_add(1, std::memory_order_relaxed);
+	sent_bytes += record.len;
+	++second_sent;
+	second_bytes += record.len;
+}
+
+void Replayer::account(uint64_t elapsed_ns) {
+	uint64_t sec = elapsed_ns / 1000000000ull;
+	if (sec == second)
+		return;
+	/* idle seconds in between sent nothing, trivially without drops */
+	last_pps.store(sec == second + 1 ? second_sent : 0, std::memory_order_relaxed);
+	if (!second_dropped) {
+		if (second_sent > clean_pps.load(std::memory_order_relaxed))
+			clean_pps.store(second_sent, std::memory_order_relaxed);
+		if (second_bytes > clean_bytes.load(std::memory_order_relaxed))
+			clean_bytes.store(second_bytes, std::memory_order_relaxed);
+	}
+	second = sec;
+	second_sent = 0;
+	second_bytes = 0;
+	second_dropped = 0;
+}
+
+const ReplayFrame *Replayer::pop() {
+	uint64_t h = head.load(std::memory_order_relaxed);
+	for (unsigned spins = 0; tail.load(std::memory_order_acquire) == h; ++spins) {
+		if (stopping.load(std::memory_order_relaxed))
+			return nullptr;
+		if (finished.load(std::memory_order_acquire)) {
+			/* a last frame may have been published before finished */
+			if (tail.load(std::memory_order_acquire) == h)
+				return nullptr;
+			break;
+		}
+		if (spins < 256)
+			cpu_relax();
+		else
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+	}
+	if (stopping.load(std::memory_order_relaxed))
+		return nullptr;
+	return &slots[h & mask];
+}
+
+void Replayer::release() { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+uint64_t Replayer::mean_lateness_ns() const {
+	uint64_t n = sent() + dropped();
+	return n ? late_sum.load(std::memory_order_relaxed) / n : 0;
+}
+
+std::string Replayer::error() const { return finished.load(std::memory_order_acquire) ? failure : std::string(); }
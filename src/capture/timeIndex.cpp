@@ -0,0 +1,259 @@
+#include "../../include/capture/timeIndex.hpp"
+#include "../../include/capture/captureFile.hpp"
+#include "../../include/capture/compressedCapture.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+namespace {
+
+constexpr char INDEX_MAGIC[8] = {'N', 'T', 'A', 'I', 'D', 'X', '\r', '\n'};
+constexpr uint32_t INDEX_VERSION = 1;
+
+struct IndexHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t block_packets;
+	uint64_t file_size;
+	int64_t file_mtime_ns;
+	uint64_t data_offset;
+	uint64_t blocks;
+};
+
+static_assert(sizeof(IndexHeader) == 48);
+
+struct FileStamp {
+	uint64_t size;
+	int64_t mtime_ns;
+};
+
+FileStamp stamp_of(const std::string &path) {
+	struct stat st {};
+	if (stat(path.c_str(), &st) < 0)
+		throw std::runtime_error("Couldn't stat " + path);
+	return {static_cast<uint64_t>(st.st_size), st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec};
+}
+
+struct BuildState {
+	TimeIndex *index;
+	const uint8_t *base;
+	uint64_t contexts_at_first = 0;
+	const CaptureParser *parser;
+};
+
+bool index_record(void *user, const CaptureRecord &record) {
+	auto *st = static_cast<BuildState *>(user);
+	TimeIndex &idx = *st->index;
+	uint64_t offset = static_cast<uint64_t>(record.block - st->base);
+
+	if (idx.blocks.empty()) {
+		idx.data_offset = offset;
+		st->contexts_at_first = st->parser->context_blocks();
+	}
+	if (idx.blocks.empty() || idx.blocks.back().packets >= idx.block_packets)
+		idx.blocks.push_back({record.ts_ns, record.ts_ns, offset, 0, 0});
+
+	TimeIndexBlock &b = idx.blocks.back();
+	b.min_ts_ns = std::min(b.min_ts_ns, record.ts_ns);
+	b.max_ts_ns = std::max(b.max_ts_ns, record.ts_ns);
+	b.packets++;
+	return true;
+}
+
+bool first_record(void *user, const CaptureRecord &record) {
+	*static_cast<uint64_t *>(user) = record.ts_ns;
+	return false;
+}
+
+/* text as a number of seconds, all of it, non-negative and within the nanosecond range */
+uint64_t seconds_ns(const std::string &text, const std::string &bound) {
+	size_t used = 0;
+	double sec = -1;
+	try {
+		sec = std::stod(text, &used);
+	} catch (const std::logic_error &) {
+	}
+	if (used != text.size() || !(sec >= 0) || sec * 1e9 >= static_cast<double>(UINT64_MAX))
+		throw std::invalid_argument("Invalid time '" + bound + "'");
+	return static_cast<uint64_t>(std::llround(sec * 1e9));
+}
+
+} // namespace
+
+uint64_t parse_time_bound(const std::string &str, uint64_t capture_start_ns) {
+	if (str.empty())
+		throw std::invalid_argument("Empty time bound");
+
+	if (str[0] == '+')
+		return capture_start_ns + seconds_ns(str.substr(1), str);
+
+	if (str.find('-') != std::string::npos) {
+		std::tm tm{};
+		const char *end = strptime(str.c_str(), "%Y-%m-%dT%H:%M:%S", &tm);
+		if (!end)
+			end = strptime(str.c_str(), "%Y-%m-%d %H:%M:%S", &tm);
+		if (!end || *end)
+			throw std::invalid_argument("Invalid time '" + str + "' (expected YYYY-MM-DDTHH:MM:SS)");
+		return static_cast<uint64_t>(timegm(&tm)) * 1000000000ull;
+	}
+
+	return seconds_ns(str, str);
+}
+
+TimeRange parse_time_range(const std::string &spec, uint64_t capture_start_ns) {
+	auto comma = spec.find(',');
+	if (comma == std::string::npos)
+		throw std::invalid_argument("Invalid range '" + spec + "' (expected FROM,TO)");
+	TimeRange range;
+	std::string from = spec.substr(0, comma), to = spec.substr(comma + 1);
+	if (!from.empty())
+		range.from_ns = parse_time_bound(from, capture_start_ns);
+	if (!to.empty())
+		range.to_ns = parse_time_bound(to, capture_start_ns);
+	if (range.from_ns >= range.to_ns)
+		throw std::invalid_argument("Empty range '" + spec + "'");
+	return range;
+}
+
+std::vector<TimeRange> coalesce_ranges(std::vector<TimeRange> ranges) {
+	std::sort(ranges.begin(), ranges.end(),
+			  [](const TimeRange &a, const TimeRange &b) { return a.from_ns < b.from_ns; });
+	std::vector<TimeRange> out;
+	for (const TimeRange &r : ranges) {
+		if (!out.empty() && r.from_ns < out.back().to_ns)
+			out.back().to_ns = std::max(out.back().to_ns, r.to_ns);
+		else
+			out.push_back(r);
+	}
+	return out;
+}
+
+uint64_t first_capture_timestamp(const std::string &capture) {
+	uint64_t ts = 0;
+	CaptureParser parser;
+	Compression compression;
+	{
+		MappedFile file(capture);
+		compression = detect_compression(file.data(), file.size());
+		if (compression == Compression::NONE) {
+			if (CaptureParser::recognizes(file.data(), file.size()))
+				parser.parse(file.data(), file.size(), &first_record, &ts);
+			return ts;
+		}
+	}
+	/* the parser stops at the first record, which cancels the decompression after its first chunks */
+	CompressedCapture stream(capture, compression, 1);
+	read_compressed_capture(stream, parser, &first_record, &ts);
+	std::string error = stream.error();
+	if (!ts && !error.empty())
+		throw std::runtime_error(capture + ": " + error);
+	return ts;
+}
+
+std::string TimeIndex::sidecar_path(const std::string &capture) { return capture + ".ntaidx"; }
+
+TimeIndex TimeIndex::build(const std::string &capture, uint32_t block_packets) {
+	MappedFile file(capture);
+	if (detect_compression(file.data(), file.size()) != Compression::NONE)
+		throw std::runtime_error("Compressed captures can't be indexed, decompress " + capture + " first");
+	if (!CaptureParser::recognizes(file.data(), file.size()))
+		throw std::runtime_error(capture + " is not a pcap or pcapng file");
+
+	TimeIndex idx;
+	FileStamp stamp = stamp_of(capture);
+	idx.file_size = stamp.size;
+	idx.file_mtime_ns = stamp.mtime_ns;
+	idx.block_packets = std::max<uint32_t>(block_packets, 1);
+
+	CaptureParser parser;
+	BuildState st{&idx, file.data(), 0, &parser};
+	read_mapped_capture(file, parser, &index_record, &st);
+
+	/* seeking relies on the context before data_offset being the only one */
+	if (!idx.blocks.empty() && parser.context_blocks() != st.contexts_at_first)
+		throw std::runtime_error(capture + " has section or interface blocks after its first packet, can't index");
+	return idx;
+}
+
+void TimeIndex::save(const std::string &path) const {
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		throw std::runtime_error("Couldn't create " + path);
+
+	IndexHeader h{};
+	memcpy(h.magic, INDEX_MAGIC, sizeof(h.magic));
+	h.version = INDEX_VERSION;
+	h.block_packets = block_packets;
+	h.file_size = file_size;
+	h.file_mtime_ns = file_mtime_ns;
+	h.data_offset = data_offset;
+	h.blocks = blocks.size();
+
+	file.write(reinterpret_cast<const char *>(&h), sizeof(h));
+	file.write(reinterpret_cast<const char *>(blocks.data()),
+			   static_cast<std::streamsize>(blocks.size() * sizeof(TimeIndexBlock)));
+	if (!file)
+		throw std::runtime_error("Write error on " + path);
+}
+
+std::optional<TimeIndex> TimeIndex::load(const std::string &path, const std::string &capture) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+		return std::nullopt;
+
+	IndexHeader h{};
+	if (!file.read(reinterpret_cast<char *>(&h), sizeof(h)) || memcmp(h.magic, INDEX_MAGIC, sizeof(h.magic)) ||
+		h.version != INDEX_VERSION)
+		return std::nullopt;
+
+	FileStamp stamp = stamp_of(capture);
+	if (stamp.size != h.file_size || stamp.mtime_ns != h.file_mtime_ns)
+		return std::nullopt;
+
+	TimeIndex idx;
+	idx.data_offset = h.data_offset;
+	idx.file_size = h.file_size;
+	idx.file_mtime_ns = h.file_mtime_ns;
+	idx.block_packets = h.block_packets;
+	if (h.blocks > h.file_size)
+		return std::nullopt;
+	idx.blocks.resize(h.blocks);
+	if (!file.read(reinterpret_cast<char *>(idx.blocks.data()),
+				   static_cast<std::streamsize>(h.blocks * sizeof(TimeIndexBlock))))
+		return std::nullopt;
+	return idx;
+}
+
+uint64_t TimeIndex::first_ts() const {
+	uint64_t ts = UINT64_MAX;
+	for (const auto &b : blocks)
+		ts = std::min(ts, b.min_ts_ns);
+	return blocks.empty() ? 0 : ts;
+}
+
+uint64_t TimeIndex::packets() const {
+	uint64_t n = 0;
+	for (const auto &b : blocks)
+		n += b.packets;
+	return n;
+}
+
+std::vector<std::pair<uint64_t, uint64_t>> TimeIndex::spans(const TimeRange &range) const {
+	std::vector<std::pair<uint64_t, uint64_t>> out;
+	for (size_t i = 0; i < blocks.size(); ++i) {
+		const auto &b = blocks[i];
+		if (b.max_ts_ns < range.from_ns || b.min_ts_ns >= range.to_ns)
+			continue;
+		uint64_t end = i + 1 < blocks.size() ? blocks[i + 1].offset : file_size;
+		if (!out.empty() && out.back().second == b.offset)
+			out.back().second = end;
+		else
+			out.emplace_back(b.offset, end);
+	}
+	return out;
+}
@@ -1,16 +1,55 @@
 #include "../../include/cli/argsParse.hpp"
+#include <algorithm>
 #include <iostream>
+#include <thread>
 
 argsParser::argsParser(int argc, char **argv) {
 	desc.add_options()("help,h", "Display this help message and exit")("interfaces, interfaces",
 																	   "Display all possible interfaces")(
 		"interface,i", po::value<std::string>()->default_value("wlan0"),
-		"Network interface to capture packets from (e.g. eth0, wlan0, any)")
+		"Network interface to capture packets from (e.g. eth0, wlan0, any), or a comma-separated list "
+		"(eth0,eth1) captured in parallel with per-interface totals")
 
 		("count,c", po::value<int>()->default_value(0), "Number of packets to capture (0 = unlimited)")(
 			"time, t", po::value<int>()->default_value(INT_MAX), "Working time (in seconds)")
 
-			("offline,r", po::value<std::string>(), "Read packets from an offline pcap file")
+			("offline,r", po::value<std::vector<std::string>>()->multitoken()->composing(),
+			 "Read packets from offline pcap / pcapng files or globs (quote them), merged into one report")
+
+				("jobs,j", po::value<unsigned>()->default_value(std::max(1u, std::thread::hardware_concurrency())),
+				 "Offline: files analyzed in parallel")
+
+				("merge", po::value<std::vector<std::string>>()->multitoken()->composing(),
+				 "Merge saved --checkpoint result files of separate runs into one report")
+
+				("reader", po::value<std::string>()->default_value("mmap"),
+				 "Offline file reader: mmap (zero-copy, pcap + pcapng) | libpcap")
+
+				("build-index", "Write a <file>.ntaidx time index for every --offline file and exit")
+
+				("from", po::value<std::string>(),
+				 "Offline: skip packets before this time (epoch seconds, YYYY-MM-DDTHH:MM:SS UTC, or +seconds "
+				 "from capture start)")
+
+				("to", po::value<std::string>(), "Offline: skip packets from this time on (same formats as --from)")
+
+				("range", po::value<std::vector<std::string>>()->composing(),
+				 "Offline: analyze FROM,TO (can be used multiple times, disjoint ranges run in parallel)")
+
+				("replay", po::value<std::string>(),
+				 "Replay a pcap / pcapng file (optionally compressed) through the live capture path in real time")
+
+				("replay-speed", po::value<double>()->default_value(1.0),
+				 "Replay: multiple of the file's own timing (0 = as fast as possible)")
+
+				("replay-pps", po::value<uint64_t>()->default_value(0),
+				 "Replay: send at a fixed packet rate instead of the file's timing (0 = off)")
+
+				("replay-queue", po::value<size_t>()->default_value(8192),
+				 "Replay: frames buffered for the capture thread, more are dropped and counted")
+
+				("replay-loops", po::value<uint64_t>()->default_value(1),
+				 "Replay: passes over the file (0 = until stopped)")
 
 				("filter,f", po::value<std::vector<std::string>>()->composing(),
 				 "Traffic filter (can be used multiple times)\n"
@@ -19,13 +58,120 @@ argsParser::argsParser(int argc, char **argv) {
 				 "  dst:<ip>       Destination IP address\n"
 				 "  port:<number>  Source or destination port")
 
-					("sort,s", po::value<std::string>()->default_value("bytes"), "Sort field: bytes | packets | ip")
+				("display-filter", po::value<std::string>(),
+				 "Show only packets matching an expression in the UI, changeable live with '/' (capture and exports "
+				 "keep counting everything), e.g. \"tcp and port 443 and not dst 10.0.0.0/8\"")
+
+					("sort,s", po::value<std::string>()->default_value("bytes"),
+					 "Initial sort field of the UI tables: bytes | packets | ip")
+
+						("order,o", po::value<std::string>()->default_value("desc"), "Initial sort order: asc | desc")
+
+							("limit,n", po::value<int>()->default_value(43),
+								 "Recent packets shown; when given, also the rows per page of the UI tables (default 10)")
+
+								("headless", "Run without the terminal UI and print a JSON summary line every --interval")
+
+				("interval", po::value<double>()->default_value(1.0), "Headless summary interval (in seconds)")
+
+				("output", po::value<std::string>()->default_value("-"), "Headless summary file (- = stdout)")
+
+				("latency", "Record p50 / p99 / p99.9 latency of the pipeline stages (parse, lock wait, update, "
+							"snapshot, render) for the exports and the UI panel ('l')")
+
+				("perf", "Count cycles, instructions, LLC and branch misses of the capture and aggregation threads "
+						 "(perf_event_open), shown per packet in the UI and the headless summary")
+
+				("metrics-port", po::value<uint16_t>()->default_value(0),
+				 "Serve OpenMetrics counters on http://<bind>:<port>/metrics (0 = off)")
+
+				("metrics-bind", po::value<std::string>()->default_value("127.0.0.1"), "Metrics endpoint bind address")
+
+				("metrics-top", po::value<size_t>()->default_value(10), "Top talkers exposed on the metrics endpoint")
+
+				("ndjson", po::value<std::string>(), "Stream statistics to a newline-delimited JSON file while capturing")
+
+				("ndjson-interval", po::value<double>()->default_value(1.0), "NDJSON record interval (in seconds)")
+
+				("ndjson-rotate-mb", po::value<uint64_t>()->default_value(0), "Rotate the NDJSON file at this size (0 = off)")
+
+				("ndjson-rotate-sec", po::value<int>()->default_value(0), "Rotate the NDJSON file at this age (0 = off)")
+
+				("archive", po::value<std::string>(),
+				 "Record per-interval totals and flow deltas to a columnar archive (see the query subcommand)")
+
+				("archive-interval", po::value<double>()->default_value(10.0), "Archive interval (in seconds)")
+
+				("flow-export", po::value<std::string>(), "Export flows over UDP to a collector (host:port or [v6]:port)")
+
+				("flow-protocol", po::value<std::string>()->default_value("ipfix"), "Flow export format: ipfix | v9")
+
+				("flow-active-timeout", po::value<int>()->default_value(60),
+				 "Export long-lived flows every N seconds of packet time")
+
+				("flow-idle-timeout", po::value<int>()->default_value(15), "Expire flows idle for N seconds of packet time")
+
+				("flow-mtu", po::value<size_t>()->default_value(1500), "Path MTU towards the collector")
+
+				("flow-template-refresh", po::value<int>()->default_value(60), "Resend flow templates every N seconds")
+
+				("write,w", po::value<std::string>(), "Save captured frames to a pcap file while analyzing")
+
+				("write-rotate-mb", po::value<uint64_t>()->default_value(0),
+				 "Start a new numbered pcap file at this size (0 = off)")
+
+				("write-rotate-sec", po::value<int>()->default_value(0),
+				 "Start a new numbered pcap file every N seconds of packet time (0 = off)")
+
+				("write-files", po::value<size_t>()->default_value(0), "Keep only the newest N pcap files (0 = all)")
+
+				("write-buffer-mb", po::value<size_t>()->default_value(4),
+				 "Size of each of the 8 pcap write buffers (frames are dropped, never waited for, when all are full)")
+
+				("anomaly", "Flag spikes in bytes, packets, new peers and SYNs per host, per port and overall")
+
+				("anomaly-threshold", po::value<double>()->default_value(4.0),
+				 "Standard deviations above the EWMA baseline that count as a spike")
+
+				("anomaly-interval", po::value<double>()->default_value(1.0),
+				 "Anomaly measurement interval (in seconds of packet time)")
+
+				("networks", po::value<std::string>(),
+				 "Group traffic by the networks of a prefix file (lines of \"<prefix>/<len> <label>\", IPv4 and IPv6)")
+
+				("scan-detect", "Report port scans, host sweeps and SYN floods (constant memory, TCP only)")
+
+				("scan-window", po::value<int>()->default_value(10),
+				 "Scan detection window (in seconds of packet time)")
+
+				("scan-ports", po::value<uint32_t>()->default_value(100),
+				 "Distinct destination ports of one source per window that count as a port scan")
+
+				("scan-hosts", po::value<uint32_t>()->default_value(50),
+				 "Distinct destination hosts of one source per window that count as a host sweep")
+
+				("syn-flood", po::value<uint32_t>()->default_value(5000),
+				 "Mostly half-open SYNs to one host per window that count as a SYN flood")
+
+				("ring-mb", po::value<size_t>()->default_value(0),
+				 "Keep the most recent frames in an in-memory ring of this size for on-demand dumps (0 = off)")
+
+				("ring-sec", po::value<int>()->default_value(30), "Seconds of packet time the ring holds at most")
+
+				("ring-prefix", po::value<std::string>()->default_value("nta-ring"),
+				 "Ring dumps are written to <prefix>-<UTC time>-<n>.pcap")
+
+				("ring-trigger-mbps", po::value<double>()->default_value(0),
+				 "Dump the ring when bandwidth reaches this many Mbit/s (0 = off); also dumped on 'd', SIGUSR1 and "
+				 "--anomaly / --scan-detect alerts")
 
-						("order,o", po::value<std::string>()->default_value("desc"), "Sort order: asc | desc")
+				("checkpoint", po::value<std::string>(),
+				 "Restore statistics from FILE at startup and save them back periodically and on exit")
 
-							("limit,n", po::value<int>()->default_value(43), "Limit number of displayed entries")
+				("checkpoint-interval", po::value<int>()->default_value(300),
+				 "Checkpoint interval (in seconds, 0 = only on exit)")
 
-								("csv", po::value<std::string>(), "Export analysis results to CSV file")
+				("csv", po::value<std::string>(), "Export analysis results to CSV file")
 
 									("json", po::value<std::string>(), "Export analysis results to JSON file");
 
@@ -48,7 +194,25 @@ void argsParser::print_help() const {
 	std::cout << "Examples:\n"
 				 "  ./network-traffic-analyzer -i wlan0 --count 100 --time 10\n"
 				 "  ./network-traffic-analyzer -i any --filter port:54\n"
-				 "  ./network-traffic-analyzer --offline traffic.pcap --json result.json\n\n";
+				 "  ./network-traffic-analyzer -i eth0 --display-filter 'udp and (app dns or port 5353)'\n"
+				 "  ./network-traffic-analyzer --offline traffic.pcap --json result.json\n"
+				 "  ./network-traffic-analyzer --offline day.pcap --build-index\n"
+				 "  ./network-traffic-analyzer --offline day.pcap --from +3600 --to +3900\n"
+				 "  ./network-traffic-analyzer --offline 'captures/*.pcap.zst' --jobs 8 --json week.json\n"
+				 "  ./network-traffic-analyzer --merge site-a.ntackpt site-b.ntackpt --json total.json\n"
+				 "  ./network-traffic-analyzer -i eth0 --headless --metrics-port 9108\n"
+				 "  ./network-traffic-analyzer -i eth0 --ndjson stats.ndjson --ndjson-rotate-mb 64\n"
+				 "  ./network-traffic-analyzer -i eth0 --headless --archive today.ntac\n"
+				 "  ./network-traffic-analyzer query today.ntac --by src -n 20 --from +3600 --to +7200\n"
+				 "  ./network-traffic-analyzer -i eth0 --headless --flow-export 10.0.0.5:4739\n"
+				 "  ./network-traffic-analyzer -i eth0 --headless --checkpoint /var/lib/nta/stats.ntackpt\n"
+				 "  ./network-traffic-analyzer -i eth0 -w ring.pcap --write-rotate-mb 256 --write-files 20\n"
+				 "  ./network-traffic-analyzer -i eth0 --ring-mb 512 --ring-sec 30 --ring-trigger-mbps 800\n"
+				 "  ./network-traffic-analyzer -i eth0 --anomaly --anomaly-threshold 5 --ndjson alerts.ndjson\n"
+				 "  ./network-traffic-analyzer -i eth0 --networks sites.txt --csv by-site.csv\n"
+				 "  ./network-traffic-analyzer -i eth0 --scan-detect --scan-ports 200 --ring-mb 256\n\n";
 
-	std::cout << "To end the program, press 'q' or Esc to exit.\n";
+	std::cout << "To end the program, press 'q' or Esc to exit (Ctrl-C in --headless mode).\n"
+				 "Press '/' to edit the display filter, Enter applies it, an empty one shows all packets again.\n"
+				 "With --ring-mb, press 'd' (or send SIGUSR1) to dump the ring to a pcap file.\n";
 }
\ No newline at end of file
@@ -0,0 +1,409 @@
+#include "../../include/cli/displayFilter.hpp"
+#include "../../include/stats/prefixTable.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+
+constexpr uint8_t TCP_FIN = 0x01;
+constexpr uint8_t TCP_SYN = 0x02;
+constexpr uint8_t TCP_RST = 0x04;
+constexpr uint8_t TCP_PSH = 0x08;
+constexpr uint8_t TCP_ACK = 0x10;
+constexpr uint8_t TCP_URG = 0x20;
+
+bool transport_by_name(const std::string &name, TransportProtocol &out) {
+	if (name == "tcp")
+		out = TransportProtocol::TCP;
+	else if (name == "udp")
+		out = TransportProtocol::UDP;
+	else if (name == "icmp")
+		out = TransportProtocol::ICMP;
+	else if (name == "icmp6" || name == "icmpv6")
+		out = TransportProtocol::ICMP6;
+	else if (name == "igmp")
+		out = TransportProtocol::IGMP;
+	else
+		return false;
+	return true;
+}
+
+bool application_by_name(const std::string &name, ApplicationProtocol &out) {
+	if (name == "http")
+		out = ApplicationProtocol::HTTP;
+	else if (name == "https")
+		out = ApplicationProtocol::HTTPS;
+	else if (name == "dns")
+		out = ApplicationProtocol::DNS;
+	else if (name == "ftp")
+		out = ApplicationProtocol::FTP;
+	else if (name == "ssh")
+		out = ApplicationProtocol::SSH;
+	else if (name == "smtp")
+		out = ApplicationProtocol::SMTP;
+	else if (name == "quic")
+		out = ApplicationProtocol::QUIC;
+	else if (name == "ntp")
+		out = ApplicationProtocol::NTP;
+	else
+		return false;
+	return true;
+}
+
+uint8_t flag_by_name(const std::string &name) {
+	if (name == "syn")
+		return TCP_SYN;
+	if (name == "ack")
+		return TCP_ACK;
+	if (name == "fin")
+		return TCP_FIN;
+	if (name == "rst")
+		return TCP_RST;
+	if (name == "psh")
+		return TCP_PSH;
+	if (name == "urg")
+		return TCP_URG;
+	return 0;
+}
+
+/* first len bits of addr equal those of net */
+bool in_prefix(const uint8_t *net, uint8_t len, const uint8_t *addr) {
+	size_t bytes = len / 8;
+	if (memcmp(net, addr, bytes) != 0)
+		return false;
+	unsigned rest = len % 8;
+	if (!rest)
+		return true;
+	uint8_t mask = static_cast<uint8_t>(0xff00u >> rest);
+	return (net[bytes] & mask) == (addr[bytes] & mask);
+}
+
+} // namespace
+
+/**
+ * @brief Recursive descent over the tokens, emitting the postfix program.
+ *
+ * Operands are emitted before their operator, so the program is the
+ * expression in reverse Polish order; the only jumps are the forward
+ * short-circuits of and / or. The stack depth the program will reach is
+ * tracked while emitting.
+ */
+class DisplayFilter::Parser {
+  public:
+	Parser(const std::string &expression, DisplayFilter &out) : filter(out) { tokenize(expression); }
+
+	void parse() {
+		if (tokens.empty())
+			throw std::invalid_argument("Display filter is empty");
+		parse_or();
+		if (pos != tokens.size())
+			fail("unexpected '" + tokens[pos].text + "'");
+	}
+
+  private:
+	struct Token {
+		std::string text;
+		size_t column;
+	};
+
+	DisplayFilter &filter;
+	std::vector<Token> tokens;
+	size_t pos = 0;
+	size_t depth = 0;
+	size_t end_column = 0;
+
+	void tokenize(const std::string &s) {
+		end_column = s.size() + 1;
+		size_t i = 0;
+		while (i < s.size()) {
+			char c = s[i];
+			if (std::isspace(static_cast<unsigned char>(c))) {
+				++i;
+				continue;
+			}
+			size_t start = i;
+			if (c == '(' || c == ')') {
+				++i;
+			} else if (std::strchr("<>=!&|", c)) {
+				/* "!=", "<=", ">=", "==", "&&", "||"; a lone '!' is not */
+				++i;
+				if (i < s.size() && (s[i] == '=' || ((c == '&' || c == '|') && s[i] == c)))
+					++i;
+			} else {
+				while (i < s.size() && !std::isspace(static_cast<unsigned char>(s[i])) &&
+					   !std::strchr("()<>=!&|", s[i]))
+					++i;
+			}
+			std::string text = s.substr(start, i - start);
+			std::transform(text.begin(), text.end(), text.begin(),
+						   [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+			tokens.push_back({std::move(text), start + 1});
+		}
+	}
+
+	/* reports the token at index token, by default the next unread one */
+	[[noreturn]] void fail(const std::string &what, size_t token = SIZE_MAX) const {
+		if (token == SIZE_MAX)
+			token = pos;
+		size_t column = token < tokens.size() ? tokens[token].column : end_column;
+		throw std::invalid_argument("Display filter: " + what + " at column " + std::to_string(column));
+	}
+
+	bool peek(std::string_view text) const { return pos < tokens.size() && tokens[pos].text == text; }
+
+	bool accept(std::string_view a, std::string_view b = {}) {
+		if (peek(a) || (!b.empty() && peek(b))) {
+			++pos;
+			return true;
+		}
+		return false;
+	}
+
+	const std::string &next(const char *expected) {
+		if (pos == tokens.size())
+			fail(std::string("expected ") + expected);
+		return tokens[pos++].text;
+	}
+
+	void emit(Op op, uint32_t a = 0, uint32_t b = 0) {
+		if (op == Op::AND || op == Op::OR)
+			--depth;
+		else if (op != Op::NOT && ++depth > MAX_DEPTH)
+			fail("expression too deeply nested");
+		filter.program.push_back({op, a, b});
+	}
+
+	/* the jump skips the right operand and the operator once the left one decides the result */
+	void binary(Op jump, Op op, void (Parser::*operand)()) {
+		size_t at = filter.program.size();
+		filter.program.push_back({jump});
+		(this->*operand)();
+		emit(op);
+		filter.program[at].a = static_cast<uint32_t>(filter.program.size());
+	}
+
+	void parse_or() {
+		parse_and();
+		while (accept("or", "||"))
+			binary(Op::JUMP_IF_TRUE, Op::OR, &Parser::parse_and);
+	}
+
+	void parse_and() {
+		parse_unary();
+		while (accept("and", "&&"))
+			binary(Op::JUMP_IF_FALSE, Op::AND, &Parser::parse_unary);
+	}
+
+	void parse_unary() {
+		if (accept("not", "!")) {
+			parse_unary();
+			emit(Op::NOT);
+		} else if (accept("(")) {
+			parse_or();
+			if (!accept(")"))
+				fail("expected ')'");
+		} else {
+			parse_term();
+		}
+	}
+
+	/* text is (part of) the token just read */
+	uint32_t number(const std::string &text, uint32_t max) {
+		uint32_t v = 0;
+		auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), v);
+		if (ec != std::errc() || end != text.data() + text.size() || text.empty() || v > max)
+			fail("invalid number '" + text + "'", pos - 1);
+		return v;
+	}
+
+	void port_range(Op op) {
+		const std::string &text = next("a port");
+		size_t dash = text.find('-');
+		uint32_t lo = number(text.substr(0, dash), UINT16_MAX);
+		uint32_t hi = dash == std::string::npos ? lo : number(text.substr(dash + 1), UINT16_MAX);
+		if (lo > hi)
+			fail("empty port range '" + text + "'", pos - 1);
+		emit(op, lo, hi);
+	}
+
+	void network(Op op) {
+		const std::string &text = next("an address");
+		Net net{};
+		try {
+			PrefixTable::parse_prefix(text, net.addr.data(), net.len, net.v6);
+		} catch (const std::invalid_argument &e) {
+			fail(e.what(), pos - 1);
+		}
+		filter.nets.push_back(net);
+		emit(op, static_cast<uint32_t>(filter.nets.size() - 1));
+	}
+
+	void comparison() {
+		static constexpr std::pair<std::string_view, Op> ops[] = {
+			{"<", Op::LEN_LT},	{"<=", Op::LEN_LE}, {">", Op::LEN_GT},
+			{">=", Op::LEN_GE}, {"==", Op::LEN_EQ}, {"=", Op::LEN_EQ},
+			{"!=", Op::LEN_NE},
+		};
+		const std::string &text = next("a comparison");
+		for (const auto &[name, op] : ops) {
+			if (text == name) {
+				emit(op, number(next("a length"), UINT32_MAX));
+				return;
+			}
+		}
+		fail("expected a comparison instead of '" + text + "'", pos - 1);
+	}
+
+	void parse_term() {
+		const std::string &word = next("a filter term");
+		TransportProtocol transport;
+		ApplicationProtocol application;
+
+		if (word == "ip" || word == "ipv4" || word == "ip4") {
+			emit(Op::VERSION, v4);
+		} else if (word == "ip6" || word == "ipv6") {
+			emit(Op::VERSION, v6);
+		} else if (transport_by_name(word, transport)) {
+			emit(Op::TRANSPORT, static_cast<uint32_t>(transport));
+		} else if (application_by_name(word, application)) {
+			emit(Op::APPLICATION, static_cast<uint32_t>(application));
+		} else if (word == "proto" || word == "app") {
+			const std::string &name = next("a protocol");
+			if (word == "proto" && transport_by_name(name, transport))
+				emit(Op::TRANSPORT, static_cast<uint32_t>(transport));
+			else if (application_by_name(name, application))
+				emit(Op::APPLICATION, static_cast<uint32_t>(application));
+			else
+				fail("unknown protocol '" + name + "'", pos - 1);
+		} else if (uint8_t flag = flag_by_name(word)) {
+			emit(Op::FLAGS, flag);
+		} else if (word == "len") {
+			comparison();
+		} else if (word == "host" || word == "net") {
+			network(Op::ANY_NET);
+		} else if (word == "port") {
+			port_range(Op::ANY_PORT);
+		} else if (word == "sport" || word == "dport") {
+			port_range(word == "sport" ? Op::SRC_PORT : Op::DST_PORT);
+		} else if (word == "src" || word == "dst") {
+			bool src = word == "src";
+			if (accept("port"))
+				port_range(src ? Op::SRC_PORT : Op::DST_PORT);
+			else {
+				accept("host", "net");
+				network(src ? Op::SRC_NET : Op::DST_NET);
+			}
+		} else {
+			fail("unknown term '" + word + "'", pos - 1);
+		}
+	}
+};
+
+DisplayFilter DisplayFilter::compile(const std::string &expression) {
+	DisplayFilter filter;
+	filter.text = expression;
+	Parser(expression, filter).parse();
+	return filter;
+}
+
+/**
+ * @brief Runs the program over one packet.
+ *
+ * Bit 0 of stack is the top of the result stack: a test shifts its
+ * result in, and / or fold the two top bits into one, not flips it.
+ * The jumps in front of a right operand short-circuit, so e.g. the
+ * address of a UDP packet is never compared for "tcp and host ...".
+ */
+bool DisplayFilter::match(const Packet &packet) const {
+	uint64_t stack = 0;
+	bool ipv6 = packet.ip_version == v6;
+	bool has_ports =
+		packet.transport_protocol == TransportProtocol::TCP || packet.transport_protocol == TransportProtocol::UDP;
+
+	for (size_t pc = 0; pc < program.size();) {
+		const Insn &i = program[pc++];
+		bool r;
+		switch (i.op) {
+		case Op::AND:
+			stack = (stack >> 1) & (stack | ~uint64_t(1));
+			continue;
+		case Op::OR:
+			stack = (stack >> 1) | (stack & 1);
+			continue;
+		case Op::NOT:
+			stack ^= 1;
+			continue;
+		case Op::JUMP_IF_FALSE:
+			if (!(stack & 1))
+				pc = i.a;
+			continue;
+		case Op::JUMP_IF_TRUE:
+			if (stack & 1)
+				pc = i.a;
+			continue;
+		case Op::VERSION:
+			r = static_cast<uint32_t>(packet.ip_version) == i.a;
+			break;
+		case Op::TRANSPORT:
+			r = static_cast<uint32_t>(packet.transport_protocol) == i.a;
+			break;
+		case Op::APPLICATION:
+			r = static_cast<uint32_t>(packet.application_protocol) == i.a;
+			break;
+		case Op::SRC_NET:
+		case Op::DST_NET:
+		case Op::ANY_NET: {
+			const Net &n = nets[i.a];
+			r = false;
+			if (n.v6 != ipv6)
+				break;
+			if (i.op != Op::DST_NET)
+				r = in_prefix(n.addr.data(), n.len, packet.src_addr.data());
+			if (!r && i.op != Op::SRC_NET)
+				r = in_prefix(n.addr.data(), n.len, packet.dst_addr.data());
+			break;
+		}
+		case Op::SRC_PORT:
+			r = has_ports && packet.src_port >= i.a && packet.src_port <= i.b;
+			break;
+		case Op::DST_PORT:
+			r = has_ports && packet.dst_port >= i.a && packet.dst_port <= i.b;
+			break;
+		case Op::ANY_PORT:
+			r = has_ports && ((packet.src_port >= i.a && packet.src_port <= i.b) ||
+							  (packet.dst_port >= i.a && packet.dst_port <= i.b));
+			break;
+		case Op::LEN_LT:
+			r = packet.total_len < i.a;
+			break;
+		case Op::LEN_LE:
+			r = packet.total_len <= i.a;
+			break;
+		case Op::LEN_GT:
+			r = packet.total_len > i.a;
+			break;
+		case Op::LEN_GE:
+			r = packet.total_len >= i.a;
+			break;
+		case Op::LEN_EQ:
+			r = packet.total_len == i.a;
+			break;
+		case Op::LEN_NE:
+			r = packet.total_len != i.a;
+			break;
+		case Op::FLAGS:
+			r = (packet.tcp_flags & i.a) != 0;
+			break;
+		default:
+			r = false;
+			break;
+		}
+		stack = (stack << 1) | r;
+	}
+	return stack & 1;
+}
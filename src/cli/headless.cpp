@@ -0,0 +1,71 @@
+#include "../../include/cli/headless.hpp"
+
+#include <csignal>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+namespace {
+
+std::atomic<bool> stop_requested{false};
+
+void on_signal(int) { stop_requested = true; }
+
+void install_signal_handlers() {
+	struct sigaction sa {};
+	sa.sa_handler = on_signal;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, nullptr);
+	sigaction(SIGTERM, &sa, nullptr);
+}
+
+} // namespace
+
+int run_headless(PcapCapture &capture, Stats &stats, const HeadlessOptions &opts) {
+	using namespace std::chrono;
+
+	std::unique_ptr<FILE, decltype(&fclose)> file(nullptr, &fclose);
+	FILE *out = stdout;
+	if (!opts.output.empty() && opts.output != "-") {
+		file.reset(fopen(opts.output.c_str(), "a"));
+		if (!file) {
+			fprintf(stderr, "Couldn't open %s for writing\n", opts.output.c_str());
+			return 1;
+		}
+		out = file.get();
+	}
+
+	install_signal_handlers();
+	/* this loop is the aggregation thread of a headless run */
+	PerfMonitor::Scope perf(PerfRole::AGGREGATION);
+
+	auto begin = steady_clock::now();
+	auto next = begin + opts.interval;
+	/* sleep in short steps so signals and the end of capture are noticed quickly */
+	const auto step = std::min<milliseconds>(opts.interval, milliseconds(100));
+
+	while (!stop_requested && capture.isRunning() && steady_clock::now() - begin < opts.time_limit) {
+		std::this_thread::sleep_for(step);
+		if (steady_clock::now() < next)
+			continue;
+		next += opts.interval;
+
+		capture.collect();
+		stats.update_bandwidth();
+		if (opts.on_tick)
+			opts.on_tick();
+		std::string line = stats.summary_json(opts.top);
+		fwrite(line.data(), 1, line.size(), out);
+		fflush(out);
+	}
+
+	capture.setRunning(false);
+	capture.collect(true);
+	stats.update_bandwidth();
+	if (opts.on_tick)
+		opts.on_tick();
+	std::string line = stats.summary_json(opts.top);
+	fwrite(line.data(), 1, line.size(), out);
+	fflush(out);
+	return 0;
+}
@@ -0,0 +1,234 @@
+#include "../../include/cli/query.hpp"
+#include "../../include/capture/timeIndex.hpp"
+#include "../../include/export/flowArchive.hpp"
+
+#include <algorithm>
+#include <boost/program_options.hpp>
+#include <ctime>
+#include <iostream>
+#include <memory>
+
+namespace po = boost::program_options;
+
+namespace {
+
+enum class GroupBy { SRC, DST, PAIR };
+
+struct QueryRow {
+	std::string src;
+	std::string dst;
+	uint64_t value;
+};
+
+GroupBy parse_group(const std::string &str) {
+	if (str == "src")
+		return GroupBy::SRC;
+	if (str == "dst")
+		return GroupBy::DST;
+	if (str == "pair")
+		return GroupBy::PAIR;
+	throw std::invalid_argument("Invalid --by '" + str + "' (expected src | dst | pair)");
+}
+
+std::string format_ts(int64_t ts_ns) {
+	time_t sec = static_cast<time_t>(ts_ns / 1000000000);
+	std::tm tm{};
+	gmtime_r(&sec, &tm);
+	char buf[32];
+	strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+	return buf;
+}
+
+/* true if the block can hold rows inside range, sets whole if every row does */
+bool overlaps(const ArchiveBlockHeader &h, const TimeRange &range, bool &whole) {
+	uint64_t lo = static_cast<uint64_t>(std::max<int64_t>(h.min_ts, 0));
+	uint64_t hi = static_cast<uint64_t>(std::max<int64_t>(h.max_ts, 0));
+	whole = range.contains(lo) && range.contains(hi);
+	return hi >= range.from_ns && lo < range.to_ns;
+}
+
+/*
+ * Sums one metric per key over the flow blocks of an archive. Only the
+ * key column(s), the metric column and, for blocks straddling a range
+ * bound, the ts column are touched. Single addresses accumulate into a
+ * dense array indexed by dictionary id.
+ */
+void scan_flows(const ArchiveReader &archive, const TimeRange &range, GroupBy by, bool packets,
+				std::vector<uint64_t> &dense, std::unordered_map<uint64_t, uint64_t> &pairs) {
+	if (by != GroupBy::PAIR)
+		dense.assign(archive.addresses(), 0);
+
+	for (const auto &block : archive.blocks()) {
+		const ArchiveBlockHeader &h = *block.header;
+		bool whole;
+		if (static_cast<ArchiveBlockKind>(h.kind) != ArchiveBlockKind::FLOWS || !overlaps(h, range, whole))
+			continue;
+		FlowColumns c = ArchiveReader::flows(block);
+		const uint32_t *key = by == GroupBy::DST ? c.dst : c.src;
+
+		for (uint32_t i = 0; i < h.rows; ++i) {
+			if (!whole && !range.contains(static_cast<uint64_t>(c.ts[i])))
+				continue;
+			uint64_t v = packets ? c.packets[i] : c.bytes[i];
+			if (by == GroupBy::PAIR)
+				pairs[(uint64_t{c.src[i]} << 32) | c.dst[i]] += v;
+			else if (key[i] < dense.size())
+				dense[key[i]] += v;
+		}
+	}
+}
+
+/* runs the flow query over every archive and returns the top rows */
+std::vector<QueryRow> top_flows(const std::vector<std::unique_ptr<ArchiveReader>> &archives,
+								const std::vector<TimeRange> &ranges, GroupBy by, bool packets, size_t limit) {
+	auto by_value = [](const QueryRow &a, const QueryRow &b) { return a.value > b.value; };
+	std::vector<QueryRow> rows;
+	std::unordered_map<std::string, size_t> merged;
+
+	for (size_t f = 0; f < archives.size(); ++f) {
+		const ArchiveReader &archive = *archives[f];
+		std::vector<uint64_t> dense;
+		std::unordered_map<uint64_t, uint64_t> pairs;
+		scan_flows(archive, ranges[f], by, packets, dense, pairs);
+
+		std::vector<std::pair<uint64_t, uint64_t>> totals;
+		if (by == GroupBy::PAIR) {
+			totals.assign(pairs.begin(), pairs.end());
+		} else {
+			for (uint32_t id = 0; id < dense.size(); ++id)
+				if (dense[id])
+					totals.emplace_back(id, dense[id]);
+		}
+
+		/* one archive: only the winners need their addresses decoded */
+		if (archives.size() == 1 && totals.size() > limit) {
+			std::nth_element(totals.begin(), totals.begin() + static_cast<std::ptrdiff_t>(limit), totals.end(),
+							 [](auto &a, auto &b) { return a.second > b.second; });
+			totals.resize(limit);
+		}
+
+		for (const auto &[key, value] : totals) {
+			QueryRow row;
+			if (by == GroupBy::PAIR) {
+				row.src = archive.address(static_cast<uint32_t>(key >> 32));
+				row.dst = archive.address(static_cast<uint32_t>(key));
+			} else {
+				row.src = archive.address(static_cast<uint32_t>(key));
+			}
+			/* ids differ between archives, merge by address */
+			auto [it, inserted] = merged.try_emplace(row.src + '\0' + row.dst, rows.size());
+			if (inserted) {
+				row.value = value;
+				rows.push_back(std::move(row));
+			} else {
+				rows[it->second].value += value;
+			}
+		}
+	}
+
+	size_t n = std::min(limit, rows.size());
+	std::partial_sort(rows.begin(), rows.begin() + static_cast<std::ptrdiff_t>(n), rows.end(), by_value);
+	rows.resize(n);
+	return rows;
+}
+
+int print_intervals(const std::vector<std::unique_ptr<ArchiveReader>> &archives,
+					const std::vector<TimeRange> &ranges) {
+	struct Row {
+		int64_t ts;
+		uint64_t duration, packets, bytes;
+	};
+	std::vector<Row> rows;
+	for (size_t f = 0; f < archives.size(); ++f) {
+		for (const auto &block : archives[f]->blocks()) {
+			const ArchiveBlockHeader &h = *block.header;
+			bool whole;
+			if (static_cast<ArchiveBlockKind>(h.kind) != ArchiveBlockKind::INTERVALS || !overlaps(h, ranges[f], whole))
+				continue;
+			IntervalColumns c = ArchiveReader::intervals(block);
+			for (uint32_t i = 0; i < h.rows; ++i)
+				if (whole || ranges[f].contains(static_cast<uint64_t>(c.ts[i])))
+					rows.push_back({c.ts[i], c.duration[i], c.packets[i], c.bytes[i]});
+		}
+	}
+	std::sort(rows.begin(), rows.end(), [](const Row &a, const Row &b) { return a.ts < b.ts; });
+
+	printf("%-20s %10s %14s %16s %14s\n", "time (UTC)", "seconds", "packets", "bytes", "bytes/s");
+	for (const auto &r : rows) {
+		double sec = static_cast<double>(r.duration) / 1e9;
+		printf("%-20s %10.3f %14lu %16lu %14.1f\n", format_ts(r.ts).c_str(), sec, static_cast<unsigned long>(r.packets),
+			   static_cast<unsigned long>(r.bytes), sec > 0 ? static_cast<double>(r.bytes) / sec : 0.0);
+	}
+	return 0;
+}
+
+} // namespace
+
+int run_query(int argc, char **argv) {
+	po::options_description desc("Query options");
+	desc.add_options()("help,h", "Display this help message and exit")(
+		"archive", po::value<std::vector<std::string>>()->composing(), "Archive file(s) written with --archive")(
+		"by", po::value<std::string>()->default_value("src"), "Group flows by: src | dst | pair")(
+		"metric", po::value<std::string>()->default_value("bytes"), "Rank by: bytes | packets")(
+		"limit,n", po::value<size_t>()->default_value(10), "Number of rows")(
+		"from", po::value<std::string>(), "Start time (epoch seconds, YYYY-MM-DDTHH:MM:SS UTC or +seconds)")(
+		"to", po::value<std::string>(), "End time, exclusive (same forms as --from)")(
+		"intervals", "List the recorded per-interval totals instead of flows");
+
+	po::positional_options_description positional;
+	positional.add("archive", -1);
+
+	try {
+		po::variables_map vm;
+		po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+		po::notify(vm);
+
+		if (vm.contains("help") || !vm.contains("archive")) {
+			std::cout << "Usage:\n  ./network-traffic-analyzer query [options] ARCHIVE...\n\n"
+					  << desc << "\nExamples:\n"
+					  << "  ./network-traffic-analyzer query week.ntac --by src -n 20 --from 2024-05-01T00:00:00 "
+						 "--to 2024-05-02T00:00:00\n"
+					  << "  ./network-traffic-analyzer query run1.ntac run2.ntac --by pair --metric packets\n"
+					  << "  ./network-traffic-analyzer query week.ntac --intervals --from +3600\n";
+			return vm.contains("help") ? 0 : 1;
+		}
+
+		std::string metric = vm["metric"].as<std::string>();
+		if (metric != "bytes" && metric != "packets")
+			throw std::invalid_argument("Invalid --metric '" + metric + "' (expected bytes | packets)");
+		GroupBy by = parse_group(vm["by"].as<std::string>());
+
+		std::vector<std::unique_ptr<ArchiveReader>> archives;
+		std::vector<TimeRange> ranges;
+		for (const auto &path : vm["archive"].as<std::vector<std::string>>()) {
+			archives.push_back(std::make_unique<ArchiveReader>(path));
+			/* "+N" bounds are relative to the start of each archive */
+			uint64_t start = static_cast<uint64_t>(std::max<int64_t>(archives.back()->first_ts(), 0));
+			TimeRange range;
+			if (vm.contains("from"))
+				range.from_ns = parse_time_bound(vm["from"].as<std::string>(), start);
+			if (vm.contains("to"))
+				range.to_ns = parse_time_bound(vm["to"].as<std::string>(), start);
+			ranges.push_back(range);
+		}
+
+		if (vm.contains("intervals"))
+			return print_intervals(archives, ranges);
+
+		auto rows = top_flows(archives, ranges, by, metric == "packets", vm["limit"].as<size_t>());
+		if (by == GroupBy::PAIR)
+			printf("%-40s %-40s %16s\n", "source", "destination", metric.c_str());
+		else
+			printf("%-40s %16s\n", by == GroupBy::SRC ? "source" : "destination", metric.c_str());
+		for (const auto &r : rows) {
+			if (by == GroupBy::PAIR)
+				printf("%-40s %-40s %16lu\n", r.src.c_str(), r.dst.c_str(), static_cast<unsigned long>(r.value));
+			else
+				printf("%-40s %16lu\n", r.src.c_str(), static_cast<unsigned long>(r.value));
+		}
+	} catch (const std::exception &e) {
+		std::cerr << "query: " << e.what() << "\n";
+		return 1;
+	}
+	return 0;
+}
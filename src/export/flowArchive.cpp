@@ -0,0 +1,328 @@
+#include "../../include/export/flowArchive.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+constexpr char ARCHIVE_MAGIC[8] = {'N', 'T', 'A', 'C', 'O', 'L', '\r', '\n'};
+constexpr uint32_t ARCHIVE_VERSION = 1;
+/* samples queued for the writer thread before new ones are dropped */
+constexpr size_t QUEUE_DEPTH = 4;
+/* buffered rows are written out at least this often (in samples) */
+constexpr size_t FLUSH_SAMPLES = 30;
+
+size_t padded(size_t n) { return (n + 7) & ~size_t{7}; }
+
+template <class T> void append_column(std::string &payload, const std::vector<T> &column) {
+	payload.append(reinterpret_cast<const char *>(column.data()), column.size() * sizeof(T));
+	payload.resize(padded(payload.size()), '\0');
+}
+
+/* checks that the ids continue the previous block and every entry lies inside the payload */
+bool valid_dictionary(const ArchiveReader::Block &block, uint32_t next_id) {
+	const uint8_t *p = block.payload;
+	const uint8_t *end = p + block.header->payload_bytes;
+	uint32_t first, count;
+	if (end - p < 8)
+		return false;
+	memcpy(&first, p, sizeof(first));
+	memcpy(&count, p + sizeof(first), sizeof(count));
+	if (first != next_id || count != block.header->rows)
+		return false;
+	p += 2 * sizeof(uint32_t);
+	for (uint32_t i = 0; i < count; ++i) {
+		uint16_t len;
+		if (end - p < static_cast<std::ptrdiff_t>(sizeof(len)))
+			return false;
+		memcpy(&len, p, sizeof(len));
+		p += sizeof(len);
+		if (end - p < len)
+			return false;
+		p += len;
+	}
+	return true;
+}
+
+int64_t wall_clock_ns() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch())
+		.count();
+}
+
+} // namespace
+
+ArchiveWriter::ArchiveWriter(Stats &stats, ArchiveOptions options)
+	: stats(stats), opts(std::move(options)), ready(QUEUE_DEPTH), spare(QUEUE_DEPTH + 2) {
+	if (opts.block_rows == 0)
+		throw std::invalid_argument("Archive block size must be positive");
+	file = fopen(opts.path.c_str(), "wb");
+	if (!file)
+		throw std::runtime_error("Couldn't create " + opts.path + ": " + strerror(errno));
+
+	ArchiveFileHeader h{};
+	memcpy(h.magic, ARCHIVE_MAGIC, sizeof(h.magic));
+	h.version = ARCHIVE_VERSION;
+	h.block_rows = opts.block_rows;
+	h.created_ns = wall_clock_ns();
+	last_ts = h.created_ns;
+	if (fwrite(&h, sizeof(h), 1, file) != 1) {
+		fclose(file);
+		throw std::runtime_error("Write error on " + opts.path);
+	}
+	fflush(file);
+
+	next_record = std::chrono::steady_clock::now() + opts.interval;
+	writer = std::thread([this] { run(); });
+}
+
+ArchiveWriter::~ArchiveWriter() { close(); }
+
+void ArchiveWriter::close() {
+	ready.close();
+	if (writer.joinable())
+		writer.join();
+	if (file) {
+		flush();
+		fclose(file);
+		file = nullptr;
+	}
+}
+
+void ArchiveWriter::tick() {
+	auto now = std::chrono::steady_clock::now();
+	if (now < next_record)
+		return;
+	next_record += opts.interval;
+	if (next_record < now)
+		next_record = now + opts.interval;
+	record();
+}
+
+void ArchiveWriter::record() {
+	Sample sample = spare.try_pop().value_or(Sample{});
+	sample.ts = wall_clock_ns();
+	sample.totals = stats.copy_pairs(sample.pairs);
+	if (!ready.try_push(std::move(sample)))
+		++dropped_samples;
+}
+
+void ArchiveWriter::run() {
+	while (auto sample = ready.pop()) {
+		consume(*sample);
+		spare.try_push(std::move(*sample));
+	}
+}
+
+uint32_t ArchiveWriter::id_of(const std::string &address) {
+	auto [it, inserted] = ids.try_emplace(address, static_cast<uint32_t>(ids.size()));
+	if (inserted)
+		new_entries.push_back(&it->first);
+	return it->second;
+}
+
+/* turns one sample of cumulative counters into an interval row and flow deltas */
+void ArchiveWriter::consume(const Sample &sample) {
+	/* counters are 32-bit in Stats, unsigned subtraction survives one wrap per interval */
+	uint32_t packets = sample.totals.total_packets - last_totals.total_packets;
+	uint32_t bytes = sample.totals.total_bytes - last_totals.total_bytes;
+	iv_ts.push_back(sample.ts);
+	iv_duration.push_back(static_cast<uint64_t>(std::max<int64_t>(0, sample.ts - last_ts)));
+	iv_packets.push_back(packets);
+	iv_bytes.push_back(bytes);
+	last_ts = sample.ts;
+	last_totals = sample.totals;
+
+	for (const auto &p : sample.pairs) {
+		uint32_t src = id_of(p.src);
+		uint32_t dst = id_of(p.dst);
+		auto &last = last_pairs[(uint64_t{src} << 32) | dst];
+		uint32_t dp = p.stats.packets - last.packets;
+		uint32_t db = p.stats.bytes - last.bytes;
+		last = p.stats;
+		if (dp == 0 && db == 0)
+			continue;
+
+		fl_ts.push_back(sample.ts);
+		fl_src.push_back(src);
+		fl_dst.push_back(dst);
+		fl_packets.push_back(dp);
+		fl_bytes.push_back(db);
+		if (fl_ts.size() >= opts.block_rows)
+			flush();
+	}
+
+	if (iv_ts.size() >= opts.block_rows || ++unflushed_samples >= FLUSH_SAMPLES)
+		flush();
+}
+
+void ArchiveWriter::write_block(ArchiveBlockKind kind, uint32_t rows, const std::string &payload, int64_t min_ts,
+								int64_t max_ts, uint64_t min_bytes, uint64_t max_bytes) {
+	ArchiveBlockHeader h{};
+	h.kind = static_cast<uint16_t>(kind);
+	h.rows = rows;
+	h.payload_bytes = payload.size();
+	h.min_ts = min_ts;
+	h.max_ts = max_ts;
+	h.min_bytes = min_bytes;
+	h.max_bytes = max_bytes;
+	if (fwrite(&h, sizeof(h), 1, file) != 1 || fwrite(payload.data(), 1, payload.size(), file) != payload.size())
+		fprintf(stderr, "Write error on %s: %s\n", opts.path.c_str(), strerror(errno));
+}
+
+/* writes the pending dictionary entries first, then the buffered rows */
+void ArchiveWriter::flush() {
+	std::string payload;
+	if (!new_entries.empty()) {
+		uint32_t first = static_cast<uint32_t>(ids.size() - new_entries.size());
+		uint32_t count = static_cast<uint32_t>(new_entries.size());
+		payload.append(reinterpret_cast<const char *>(&first), sizeof(first));
+		payload.append(reinterpret_cast<const char *>(&count), sizeof(count));
+		for (const std::string *entry : new_entries) {
+			uint16_t len = static_cast<uint16_t>(std::min<size_t>(entry->size(), UINT16_MAX));
+			payload.append(reinterpret_cast<const char *>(&len), sizeof(len));
+			payload.append(entry->data(), len);
+		}
+		payload.resize(padded(payload.size()), '\0');
+		write_block(ArchiveBlockKind::DICTIONARY, count, payload, 0, 0, 0, 0);
+		new_entries.clear();
+	}
+
+	if (!iv_ts.empty()) {
+		payload.clear();
+		append_column(payload, iv_ts);
+		append_column(payload, iv_duration);
+		append_column(payload, iv_packets);
+		append_column(payload, iv_bytes);
+		auto [lo, hi] = std::minmax_element(iv_bytes.begin(), iv_bytes.end());
+		write_block(ArchiveBlockKind::INTERVALS, static_cast<uint32_t>(iv_ts.size()), payload, iv_ts.front(),
+					iv_ts.back(), *lo, *hi);
+		iv_ts.clear();
+		iv_duration.clear();
+		iv_packets.clear();
+		iv_bytes.clear();
+	}
+
+	if (!fl_ts.empty()) {
+		payload.clear();
+		append_column(payload, fl_ts);
+		append_column(payload, fl_src);
+		append_column(payload, fl_dst);
+		append_column(payload, fl_packets);
+		append_column(payload, fl_bytes);
+		auto [lo, hi] = std::minmax_element(fl_bytes.begin(), fl_bytes.end());
+		write_block(ArchiveBlockKind::FLOWS, static_cast<uint32_t>(fl_ts.size()), payload, fl_ts.front(),
+					fl_ts.back(), *lo, *hi);
+		fl_ts.clear();
+		fl_src.clear();
+		fl_dst.clear();
+		fl_packets.clear();
+		fl_bytes.clear();
+	}
+
+	fflush(file);
+	unflushed_samples = 0;
+}
+
+ArchiveReader::ArchiveReader(const std::string &path) : file(path) {
+	const uint8_t *data = file.data();
+	size_t size = file.size();
+
+	ArchiveFileHeader h{};
+	if (size < sizeof(h))
+		throw std::runtime_error(path + " is not an archive");
+	memcpy(&h, data, sizeof(h));
+	if (memcmp(h.magic, ARCHIVE_MAGIC, sizeof(h.magic)) != 0)
+		throw std::runtime_error(path + " is not an archive");
+	if (h.version != ARCHIVE_VERSION)
+		throw std::runtime_error(path + ": unsupported archive version " + std::to_string(h.version));
+
+	size_t off = sizeof(h);
+	while (off + sizeof(ArchiveBlockHeader) <= size) {
+		const auto *bh = reinterpret_cast<const ArchiveBlockHeader *>(data + off);
+		if (bh->payload_bytes > size - off - sizeof(ArchiveBlockHeader))
+			break;
+		Block block{bh, data + off + sizeof(ArchiveBlockHeader)};
+		off += sizeof(ArchiveBlockHeader) + bh->payload_bytes;
+
+		/* a block whose columns don't fit its payload ends the readable part of the file */
+		auto kind = static_cast<ArchiveBlockKind>(bh->kind);
+		size_t rows = bh->rows;
+		if (kind == ArchiveBlockKind::DICTIONARY) {
+			if (!valid_dictionary(block, address_count))
+				break;
+			address_count += bh->rows;
+			dictionaries.push_back(block);
+		} else if (kind == ArchiveBlockKind::INTERVALS) {
+			if (4 * rows * sizeof(uint64_t) > bh->payload_bytes)
+				break;
+			block_list.push_back(block);
+		} else if (kind == ArchiveBlockKind::FLOWS) {
+			if (padded(rows * sizeof(int64_t)) + 3 * padded(rows * sizeof(uint32_t)) + rows * sizeof(uint64_t) >
+				bh->payload_bytes)
+				break;
+			block_list.push_back(block);
+		}
+	}
+}
+
+std::string ArchiveReader::address(uint32_t id) const {
+	/* dictionary blocks are sorted by first id */
+	auto it = std::upper_bound(dictionaries.begin(), dictionaries.end(), id, [](uint32_t v, const Block &b) {
+		uint32_t first;
+		memcpy(&first, b.payload, sizeof(first));
+		return v < first;
+	});
+	if (it == dictionaries.begin() || id >= address_count)
+		return {};
+	const Block &b = *std::prev(it);
+
+	uint32_t first;
+	memcpy(&first, b.payload, sizeof(first));
+	const uint8_t *p = b.payload + 2 * sizeof(uint32_t);
+	for (uint32_t i = first;; ++i) {
+		uint16_t len;
+		memcpy(&len, p, sizeof(len));
+		if (i == id)
+			return std::string(reinterpret_cast<const char *>(p + sizeof(len)), len);
+		p += sizeof(len) + len;
+	}
+}
+
+int64_t ArchiveReader::first_ts() const {
+	int64_t ts = INT64_MAX;
+	for (const auto &b : block_list)
+		ts = std::min(ts, b.header->min_ts);
+	return block_list.empty() ? 0 : ts;
+}
+
+FlowColumns ArchiveReader::flows(const Block &block) {
+	size_t rows = block.header->rows;
+	const uint8_t *p = block.payload;
+	FlowColumns c{};
+	c.ts = reinterpret_cast<const int64_t *>(p);
+	p += padded(rows * sizeof(int64_t));
+	c.src = reinterpret_cast<const uint32_t *>(p);
+	p += padded(rows * sizeof(uint32_t));
+	c.dst = reinterpret_cast<const uint32_t *>(p);
+	p += padded(rows * sizeof(uint32_t));
+	c.packets = reinterpret_cast<const uint32_t *>(p);
+	p += padded(rows * sizeof(uint32_t));
+	c.bytes = reinterpret_cast<const uint64_t *>(p);
+	return c;
+}
+
+IntervalColumns ArchiveReader::intervals(const Block &block) {
+	size_t rows = block.header->rows;
+	const uint8_t *p = block.payload;
+	IntervalColumns c{};
+	c.ts = reinterpret_cast<const int64_t *>(p);
+	p += rows * sizeof(int64_t);
+	c.duration = reinterpret_cast<const uint64_t *>(p);
+	p += rows * sizeof(uint64_t);
+	c.packets = reinterpret_cast<const uint64_t *>(p);
+	p += rows * sizeof(uint64_t);
+	c.bytes = reinterpret_cast<const uint64_t *>(p);
+	return c;
+}
@@ -0,0 +1,415 @@
+#include "../../include/export/flowExporter.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint16_t TEMPLATE_V4 = 256;
+constexpr uint16_t TEMPLATE_V6 = 257;
+
+/* information element id / NetFlow v9 field type and length */
+struct Field {
+	uint16_t type;
+	uint16_t length;
+};
+
+/* sourceIPv4Address, destinationIPv4Address, ports, protocolIdentifier,
+ * octetDeltaCount, packetDeltaCount, flowStart/EndMilliseconds, flowEndReason */
+constexpr Field IPFIX_V4[] = {{8, 4}, {12, 4}, {7, 2}, {11, 2}, {4, 1}, {1, 8}, {2, 8}, {152, 8}, {153, 8}, {136, 1}};
+constexpr Field IPFIX_V6[] = {{27, 16}, {28, 16}, {7, 2}, {11, 2}, {4, 1}, {1, 8}, {2, 8}, {152, 8}, {153, 8}, {136, 1}};
+/* same fields in NetFlow v9 terms, FIRST/LAST_SWITCHED are uptime milliseconds */
+constexpr Field V9_V4[] = {{8, 4}, {12, 4}, {7, 2}, {11, 2}, {4, 1}, {1, 8}, {2, 8}, {22, 4}, {21, 4}};
+constexpr Field V9_V6[] = {{27, 16}, {28, 16}, {7, 2}, {11, 2}, {4, 1}, {1, 8}, {2, 8}, {22, 4}, {21, 4}};
+
+template <size_t N> constexpr size_t record_length(const Field (&fields)[N]) {
+	size_t len = 0;
+	for (const auto &f : fields)
+		len += f.length;
+	return len;
+}
+
+void put8(std::vector<uint8_t> &out, uint8_t v) { out.push_back(v); }
+void put16(std::vector<uint8_t> &out, uint16_t v) {
+	out.push_back(static_cast<uint8_t>(v >> 8));
+	out.push_back(static_cast<uint8_t>(v));
+}
+void put32(std::vector<uint8_t> &out, uint32_t v) {
+	put16(out, static_cast<uint16_t>(v >> 16));
+	put16(out, static_cast<uint16_t>(v));
+}
+void put64(std::vector<uint8_t> &out, uint64_t v) {
+	put32(out, static_cast<uint32_t>(v >> 32));
+	put32(out, static_cast<uint32_t>(v));
+}
+void patch16(std::vector<uint8_t> &out, size_t at, uint16_t v) {
+	out[at] = static_cast<uint8_t>(v >> 8);
+	out[at + 1] = static_cast<uint8_t>(v);
+}
+void patch32(std::vector<uint8_t> &out, size_t at, uint32_t v) {
+	patch16(out, at, static_cast<uint16_t>(v >> 16));
+	patch16(out, at + 2, static_cast<uint16_t>(v));
+}
+
+void put_template(std::vector<uint8_t> &out, uint16_t id, const Field *fields, size_t count) {
+	put16(out, id);
+	put16(out, static_cast<uint16_t>(count));
+	for (size_t i = 0; i < count; ++i) {
+		put16(out, fields[i].type);
+		put16(out, fields[i].length);
+	}
+}
+
+/* splits "host:port" / "[v6]:port" */
+std::pair<std::string, std::string> split_collector(const std::string &collector) {
+	std::string host, port;
+	if (!collector.empty() && collector.front() == '[') {
+		auto close = collector.find("]:");
+		if (close == std::string::npos)
+			throw std::invalid_argument("Invalid collector '" + collector + "' (expected [address]:port)");
+		host = collector.substr(1, close - 1);
+		port = collector.substr(close + 2);
+	} else {
+		auto colon = collector.rfind(':');
+		if (colon == std::string::npos)
+			throw std::invalid_argument("Invalid collector '" + collector + "' (expected host:port)");
+		host = collector.substr(0, colon);
+		port = collector.substr(colon + 1);
+	}
+	if (host.empty() || port.empty())
+		throw std::invalid_argument("Invalid collector '" + collector + "'");
+	return {host, port};
+}
+
+} // namespace
+
+FlowProtocol parse_flow_protocol(const std::string &name) {
+	if (name == "ipfix")
+		return FlowProtocol::IPFIX;
+	if (name == "v9" || name == "netflow9")
+		return FlowProtocol::NETFLOW_V9;
+	throw std::invalid_argument("Unknown flow protocol: '" + name + "' (expected ipfix | v9)");
+}
+
+uint8_t iana_protocol(TransportProtocol protocol) {
+	switch (protocol) {
+	case TransportProtocol::TCP:
+		return 6;
+	case TransportProtocol::UDP:
+		return 17;
+	case TransportProtocol::ICMP:
+		return 1;
+	case TransportProtocol::ICMP6:
+		return 58;
+	case TransportProtocol::IGMP:
+		return 2;
+	default:
+		return 255;
+	}
+}
+
+size_t FlowKeyHash::operator()(const FlowKey &key) const {
+	static_assert(sizeof(FlowKey) == 40);
+	uint64_t words[5];
+	memcpy(words, &key, sizeof(words));
+	uint64_t h = 0x9e3779b97f4a7c15ull;
+	for (uint64_t w : words) {
+		h ^= w;
+		h *= 0xff51afd7ed558ccdull;
+		h ^= h >> 32;
+	}
+	return static_cast<size_t>(h);
+}
+
+FlowExporter::FlowExporter(FlowExportOptions options) : opts(std::move(options)) {
+	auto [host, port] = split_collector(opts.collector);
+
+	addrinfo hints{};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	addrinfo *res = nullptr;
+	if (int rc = getaddrinfo(host.c_str(), port.c_str(), &hints, &res); rc != 0)
+		throw std::runtime_error("Couldn't resolve collector " + opts.collector + ": " + gai_strerror(rc));
+
+	for (addrinfo *ai = res; ai; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+		if (fd < 0)
+			continue;
+		if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+			/* IP + UDP header overhead */
+			size_t overhead = ai->ai_family == AF_INET6 ? 48 : 28;
+			max_message = opts.mtu > overhead ? opts.mtu - overhead : 0;
+			break;
+		}
+		::close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+	if (fd < 0)
+		throw std::runtime_error("Couldn't reach collector " + opts.collector + ": " + strerror(errno));
+
+	/* a message must hold the header, the templates and at least one record */
+	if (max_message < template_size() + 128) {
+		::close(fd);
+		throw std::invalid_argument("Flow export MTU " + std::to_string(opts.mtu) + " is too small");
+	}
+
+	thread = std::thread([this] { run(); });
+}
+
+FlowExporter::~FlowExporter() { close(); }
+
+void FlowExporter::close() {
+	{
+		std::lock_guard<std::mutex> lock(wake_mtx);
+		if (stopping)
+			return;
+		stopping = true;
+	}
+	wake.notify_all();
+	if (thread.joinable())
+		thread.join();
+	expire(true);
+	::close(fd);
+	fd = -1;
+}
+
+FlowExporter::Source *FlowExporter::open_source() {
+	std::lock_guard<std::mutex> lock(sources_mtx);
+	sources.push_back(std::unique_ptr<Source>(new Source(*this)));
+	return sources.back().get();
+}
+
+void FlowExporter::release(Source *source) {
+	std::lock_guard<std::mutex> lock(sources_mtx);
+	source->finished = true;
+}
+
+/* counts one packet towards its flow */
+void FlowExporter::Source::add(const FlowKey &key, uint64_t ts_ns, uint32_t bytes) {
+	std::lock_guard<std::mutex> lock(mtx);
+	if (boot_ns == 0 || ts_ns < boot_ns)
+		boot_ns = ts_ns;
+	now_ns = std::max(now_ns, ts_ns);
+
+	auto it = flows.find(key);
+	if (it == flows.end()) {
+		/* the sources check and count without a common lock, the limit may be passed by a few flows */
+		if (owner.tracked_flows.load(std::memory_order_relaxed) >= owner.opts.max_flows) {
+			++owner.untracked_packets;
+			return;
+		}
+		owner.tracked_flows.fetch_add(1, std::memory_order_relaxed);
+		it = flows.emplace(key, FlowCounters{ts_ns, ts_ns, 0, 0}).first;
+	}
+	FlowCounters &f = it->second;
+	/* counters restart after an active timeout export */
+	if (f.packets == 0)
+		f.first_ns = f.last_ns = ts_ns;
+	f.first_ns = std::min(f.first_ns, ts_ns);
+	f.last_ns = std::max(f.last_ns, ts_ns);
+	++f.packets;
+	f.bytes += bytes;
+}
+
+void FlowExporter::run() {
+	std::unique_lock<std::mutex> lock(wake_mtx);
+	while (!stopping) {
+		wake.wait_for(lock, std::chrono::seconds(1), [this] { return stopping; });
+		if (stopping)
+			break;
+		lock.unlock();
+		expire(false);
+		lock.lock();
+	}
+}
+
+/*
+ * moves timed out flows out of every table under its lock, encodes and sends them outside it;
+ * released sources are emptied and freed
+ */
+void FlowExporter::expire(bool all) {
+	uint64_t clock = 0;
+	expired.clear();
+	{
+		std::lock_guard<std::mutex> lock(sources_mtx);
+		/* messages carry the newest packet time of all sources */
+		for (auto &source : sources)
+			clock = std::max(clock, expire_source(*source, all || source->finished));
+		std::erase_if(sources, [](const std::unique_ptr<Source> &s) { return s->finished; });
+	}
+	if (!expired.empty() || !templates_sent)
+		send_records(expired, clock);
+}
+
+uint64_t FlowExporter::expire_source(Source &source, bool all) {
+	std::lock_guard<std::mutex> lock(source.mtx);
+	uint64_t clock = source.now_ns;
+	if (source.boot_ns && (uptime_base_ns == 0 || source.boot_ns < uptime_base_ns))
+		uptime_base_ns = source.boot_ns;
+	uint64_t idle = static_cast<uint64_t>(std::chrono::nanoseconds(opts.idle_timeout).count());
+	uint64_t active = static_cast<uint64_t>(std::chrono::nanoseconds(opts.active_timeout).count());
+
+	for (auto it = source.flows.begin(); it != source.flows.end();) {
+		FlowCounters &f = it->second;
+		bool is_idle = clock - f.last_ns >= idle;
+		if (all || is_idle) {
+			uint8_t reason = all ? 4 : 1;
+			if (f.packets)
+				expired.push_back({it->first, f.first_ns, f.last_ns, f.packets, f.bytes, reason});
+			it = source.flows.erase(it);
+			tracked_flows.fetch_sub(1, std::memory_order_relaxed);
+			continue;
+		}
+		if (f.packets && clock - f.first_ns >= active) {
+			expired.push_back({it->first, f.first_ns, f.last_ns, f.packets, f.bytes, 2});
+			f.packets = 0;
+			f.bytes = 0;
+		}
+		++it;
+	}
+	return clock;
+}
+
+size_t FlowExporter::template_size() const {
+	if (opts.protocol == FlowProtocol::IPFIX)
+		return 16 + 4 + 2 * 4 + 4 * (std::size(IPFIX_V4) + std::size(IPFIX_V6));
+	return 20 + 4 + 2 * 4 + 4 * (std::size(V9_V4) + std::size(V9_V6));
+}
+
+void FlowExporter::begin_message() {
+	message.clear();
+	/* header, patched in finish_message() */
+	message.resize(opts.protocol == FlowProtocol::IPFIX ? 16 : 20);
+
+	message_has_templates =
+		!templates_sent || std::chrono::steady_clock::now() - last_templates >= opts.template_refresh;
+	if (message_has_templates)
+		append_templates();
+}
+
+void FlowExporter::append_templates() {
+	size_t set = message.size();
+	if (opts.protocol == FlowProtocol::IPFIX) {
+		put16(message, 2);
+		put16(message, 0);
+		put_template(message, TEMPLATE_V4, IPFIX_V4, std::size(IPFIX_V4));
+		put_template(message, TEMPLATE_V6, IPFIX_V6, std::size(IPFIX_V6));
+	} else {
+		put16(message, 0);
+		put16(message, 0);
+		put_template(message, TEMPLATE_V4, V9_V4, std::size(V9_V4));
+		put_template(message, TEMPLATE_V6, V9_V6, std::size(V9_V6));
+	}
+	patch16(message, set + 2, static_cast<uint16_t>(message.size() - set));
+	templates_sent = true;
+	last_templates = std::chrono::steady_clock::now();
+}
+
+void FlowExporter::finish_message(uint16_t records, uint64_t clock_ns) {
+	if (opts.protocol == FlowProtocol::IPFIX) {
+		uint32_t export_time =
+			static_cast<uint32_t>(std::chrono::system_clock::to_time_t(std::chrono::system_clock::now()));
+		patch16(message, 0, 10);
+		patch16(message, 2, static_cast<uint16_t>(message.size()));
+		patch32(message, 4, export_time);
+		/* IPFIX counts data records sent before this message */
+		patch32(message, 8, sequence);
+		patch32(message, 12, opts.observation_domain);
+		sequence += records;
+	} else {
+		patch16(message, 0, 9);
+		/* the templates count as records too */
+		patch16(message, 2, static_cast<uint16_t>(records + (message_has_templates ? 2 : 0)));
+		/* uptime and unix time both run on the packet clock so collectors can rebuild absolute times */
+		patch32(message, 4, static_cast<uint32_t>((clock_ns - uptime_base_ns) / 1000000));
+		patch32(message, 8, static_cast<uint32_t>(clock_ns / 1000000000));
+		/* NetFlow v9 counts export packets */
+		patch32(message, 12, sequence++);
+		patch32(message, 16, opts.observation_domain);
+	}
+
+	if (send(fd, message.data(), message.size(), 0) < 0 && errno != ECONNREFUSED)
+		fprintf(stderr, "Flow export to %s failed: %s\n", opts.collector.c_str(), strerror(errno));
+}
+
+/**
+ * @brief Packs records into as few MTU-sized messages as possible.
+ *
+ * IPv4 and IPv6 records go into separate data sets of their template;
+ * NetFlow v9 sets are padded to 4 bytes. A message is sent once the
+ * next record would not fit.
+ */
+void FlowExporter::send_records(const std::vector<FlowRecord> &records, uint64_t clock_ns) {
+	bool ipfix = opts.protocol == FlowProtocol::IPFIX;
+	size_t len_v4 = ipfix ? record_length(IPFIX_V4) : record_length(V9_V4);
+	size_t len_v6 = ipfix ? record_length(IPFIX_V6) : record_length(V9_V6);
+
+	/* v4 records first so each message holds at most two data sets */
+	std::vector<const FlowRecord *> order;
+	order.reserve(records.size());
+	for (const auto &r : records)
+		order.push_back(&r);
+	std::stable_partition(order.begin(), order.end(), [](const FlowRecord *r) { return r->key.version == 4; });
+
+	begin_message();
+	uint16_t in_message = 0;
+	uint16_t open_set = 0;
+	size_t set_start = 0;
+
+	auto close_set = [&] {
+		if (!open_set)
+			return;
+		if (!ipfix)
+			while ((message.size() - set_start) % 4)
+				message.push_back(0);
+		patch16(message, set_start + 2, static_cast<uint16_t>(message.size() - set_start));
+		open_set = 0;
+	};
+
+	for (const FlowRecord *r : order) {
+		bool v6 = r->key.version == 6;
+		uint16_t tid = v6 ? TEMPLATE_V6 : TEMPLATE_V4;
+		size_t need = (v6 ? len_v6 : len_v4) + (open_set != tid ? 4 : 0) + (ipfix ? 0 : 3);
+		if (message.size() + need > max_message) {
+			close_set();
+			finish_message(in_message, clock_ns);
+			begin_message();
+			in_message = 0;
+		}
+		if (open_set != tid) {
+			close_set();
+			set_start = message.size();
+			put16(message, tid);
+			put16(message, 0);
+			open_set = tid;
+		}
+
+		size_t addr_len = v6 ? 16 : 4;
+		message.insert(message.end(), r->key.src.begin(), r->key.src.begin() + addr_len);
+		message.insert(message.end(), r->key.dst.begin(), r->key.dst.begin() + addr_len);
+		put16(message, r->key.src_port);
+		put16(message, r->key.dst_port);
+		put8(message, r->key.protocol);
+		put64(message, r->bytes);
+		put64(message, r->packets);
+		if (ipfix) {
+			put64(message, r->first_ns / 1000000);
+			put64(message, r->last_ns / 1000000);
+			put8(message, r->end_reason);
+		} else {
+			put32(message, static_cast<uint32_t>((r->first_ns - uptime_base_ns) / 1000000));
+			put32(message, static_cast<uint32_t>((r->last_ns - uptime_base_ns) / 1000000));
+		}
+		++in_message;
+	}
+	close_set();
+	if (in_message || message_has_templates)
+		finish_message(in_message, clock_ns);
+	exported_records += records.size();
+}
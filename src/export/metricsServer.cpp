@@ -0,0 +1,229 @@
+#include "../../include/export/metricsServer.hpp"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdexcept>
+#include <string_view>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr const char *CONTENT_TYPE = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+
+void family(std::string &out, const char *name, const char *type, const char *help) {
+	out += std::format("# TYPE {} {}\n# HELP {} {}\n", name, type, name, help);
+}
+
+/* label values may not contain raw quotes, backslashes or newlines */
+std::string escape_label(const std::string &v) {
+	std::string out;
+	out.reserve(v.size());
+	for (char c : v) {
+		if (c == '\\' || c == '"')
+			out += '\\';
+		if (c == '\n') {
+			out += "\\n";
+			continue;
+		}
+		out += c;
+	}
+	return out;
+}
+
+void send_all(int fd, const std::string &data) {
+	size_t sent = 0;
+	while (sent < data.size()) {
+		ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+		if (n <= 0) {
+			if (n < 0 && errno == EINTR)
+				continue;
+			return;
+		}
+		sent += static_cast<size_t>(n);
+	}
+}
+
+/* request line is "<method> /metrics" followed by the query or the HTTP version, not "/metricsfoo" */
+bool is_metrics_request(const std::string &request, std::string_view method) {
+	constexpr std::string_view path = " /metrics";
+	if (!request.starts_with(method) || request.compare(method.size(), path.size(), path) != 0)
+		return false;
+	size_t end = method.size() + path.size();
+	return end < request.size() && (request[end] == ' ' || request[end] == '?');
+}
+
+} // namespace
+
+std::string format_openmetrics(const MetricsSnapshot &m) {
+	std::string out;
+	out.reserve(4096);
+
+	family(out, "nta_packets", "counter", "Packets captured.");
+	out += std::format("nta_packets_total {}\n", m.total_packets);
+	family(out, "nta_bytes", "counter", "Bytes captured (frame length).");
+	out += std::format("nta_bytes_total {}\n", m.total_bytes);
+
+	family(out, "nta_transport_packets", "counter", "Packets per transport protocol.");
+	for (const auto &c : m.transport)
+		out += std::format("nta_transport_packets_total{{protocol=\"{}\"}} {}\n", c.name, c.packets);
+	family(out, "nta_transport_bytes", "counter", "Bytes per transport protocol.");
+	for (const auto &c : m.transport)
+		out += std::format("nta_transport_bytes_total{{protocol=\"{}\"}} {}\n", c.name, c.bytes);
+
+	family(out, "nta_application_packets", "counter", "Packets per application protocol.");
+	for (const auto &c : m.application)
+		out += std::format("nta_application_packets_total{{protocol=\"{}\"}} {}\n", c.name, c.packets);
+	family(out, "nta_application_bytes", "counter", "Payload bytes per application protocol.");
+	for (const auto &c : m.application)
+		out += std::format("nta_application_bytes_total{{protocol=\"{}\"}} {}\n", c.name, c.bytes);
+
+	/* only when several interfaces are captured at once */
+	if (!m.interfaces.empty()) {
+		family(out, "nta_interface_packets", "counter", "Packets captured per interface.");
+		for (const auto &i : m.interfaces)
+			out += std::format("nta_interface_packets_total{{interface=\"{}\"}} {}\n", escape_label(i.name), i.packets);
+		family(out, "nta_interface_bytes", "counter", "Bytes captured per interface.");
+		for (const auto &i : m.interfaces)
+			out += std::format("nta_interface_bytes_total{{interface=\"{}\"}} {}\n", escape_label(i.name), i.bytes);
+		family(out, "nta_interface_dropped", "counter", "Packets dropped by the kernel per interface.");
+		for (const auto &i : m.interfaces)
+			out += std::format("nta_interface_dropped_total{{interface=\"{}\"}} {}\n", escape_label(i.name), i.dropped);
+		family(out, "nta_interface_bandwidth_bytes_per_second", "gauge", "Current bandwidth per interface.");
+		for (const auto &i : m.interfaces)
+			out += std::format("nta_interface_bandwidth_bytes_per_second{{interface=\"{}\"}} {:.3f}\n",
+							   escape_label(i.name), i.bandwidth);
+	}
+
+	/* only while latency recording is on */
+	if (!m.latency.empty()) {
+		family(out, "nta_stage_latency_seconds", "summary", "Time spent per pipeline stage.");
+		for (const auto &l : m.latency) {
+			for (auto [q, v] : {std::pair{"0.5", l.p50}, std::pair{"0.99", l.p99}, std::pair{"0.999", l.p999}})
+				out += std::format("nta_stage_latency_seconds{{stage=\"{}\",quantile=\"{}\"}} {:.9f}\n", l.stage, q,
+								   v / 1e9);
+			out += std::format("nta_stage_latency_seconds_count{{stage=\"{}\"}} {}\n", l.stage, l.count);
+		}
+	}
+
+	family(out, "nta_bandwidth_bytes_per_second", "gauge", "Bandwidth of the last complete second of traffic.");
+	out += std::format("nta_bandwidth_bytes_per_second {:.3f}\n", m.bandwidth);
+	family(out, "nta_bandwidth_max_bytes_per_second", "gauge", "Highest bandwidth seen.");
+	out += std::format("nta_bandwidth_max_bytes_per_second {:.3f}\n", m.max_bandwidth);
+
+	family(out, "nta_alerts", "counter", "Anomaly alerts raised.");
+	out += std::format("nta_alerts_total {}\n", m.alerts);
+	family(out, "nta_scan_alerts", "counter", "Port scans, host sweeps and SYN floods detected.");
+	out += std::format("nta_scan_alerts_total {}\n", m.scan_alerts);
+
+	/* top-K membership changes between scrapes, so these are gauges */
+	family(out, "nta_top_talker_sent_bytes", "gauge", "Bytes sent by the top talkers.");
+	for (size_t i = 0; i < m.top_talkers.size(); ++i)
+		out += std::format("nta_top_talker_sent_bytes{{ip=\"{}\",rank=\"{}\"}} {}\n",
+						   escape_label(m.top_talkers[i].ip), i + 1, m.top_talkers[i].stats.bytes_sent);
+	family(out, "nta_top_talker_received_bytes", "gauge", "Bytes received by the top talkers.");
+	for (size_t i = 0; i < m.top_talkers.size(); ++i)
+		out += std::format("nta_top_talker_received_bytes{{ip=\"{}\",rank=\"{}\"}} {}\n",
+						   escape_label(m.top_talkers[i].ip), i + 1, m.top_talkers[i].stats.bytes_received);
+	family(out, "nta_top_talker_sent_packets", "gauge", "Packets sent by the top talkers.");
+	for (size_t i = 0; i < m.top_talkers.size(); ++i)
+		out += std::format("nta_top_talker_sent_packets{{ip=\"{}\",rank=\"{}\"}} {}\n",
+						   escape_label(m.top_talkers[i].ip), i + 1, m.top_talkers[i].stats.packets_sent);
+	family(out, "nta_top_talker_received_packets", "gauge", "Packets received by the top talkers.");
+	for (size_t i = 0; i < m.top_talkers.size(); ++i)
+		out += std::format("nta_top_talker_received_packets{{ip=\"{}\",rank=\"{}\"}} {}\n",
+						   escape_label(m.top_talkers[i].ip), i + 1, m.top_talkers[i].stats.packets_received);
+
+	family(out, "nta_snapshot_timestamp_seconds", "gauge", "Time the served counters were published.");
+	out += std::format("nta_snapshot_timestamp_seconds {:.3f}\n", m.timestamp);
+
+	out += "# EOF\n";
+	return out;
+}
+
+MetricsServer::MetricsServer(Stats &stats, const std::string &address, uint16_t port) : stats(stats) {
+	sockaddr_in addr{};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1)
+		throw std::runtime_error("Invalid metrics bind address " + address);
+
+	listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (listen_fd < 0)
+		throw std::runtime_error(std::string("metrics socket: ") + strerror(errno));
+	int one = 1;
+	setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || listen(listen_fd, 16) < 0) {
+		int err = errno;
+		close(listen_fd);
+		throw std::runtime_error("Couldn't listen on " + address + ":" + std::to_string(port) + ": " + strerror(err));
+	}
+
+	running = true;
+	thread = std::thread([this] { serve(); });
+}
+
+MetricsServer::~MetricsServer() { stop(); }
+
+void MetricsServer::stop() {
+	running = false;
+	if (thread.joinable())
+		thread.join();
+	if (listen_fd >= 0) {
+		close(listen_fd);
+		listen_fd = -1;
+	}
+}
+
+uint16_t MetricsServer::port() const {
+	sockaddr_in addr{};
+	socklen_t len = sizeof(addr);
+	getsockname(listen_fd, reinterpret_cast<sockaddr *>(&addr), &len);
+	return ntohs(addr.sin_port);
+}
+
+void MetricsServer::serve() {
+	while (running) {
+		pollfd pfd{listen_fd, POLLIN, 0};
+		/* wake up regularly to notice stop() */
+		if (poll(&pfd, 1, 200) <= 0)
+			continue;
+		int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+		if (fd < 0)
+			continue;
+		timeval tv{1, 0};
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+		handle(fd);
+		close(fd);
+	}
+}
+
+void MetricsServer::handle(int fd) {
+	std::string request;
+	char buf[2048];
+	while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+		ssize_t n = recv(fd, buf, sizeof(buf), 0);
+		if (n <= 0)
+			return;
+		request.append(buf, static_cast<size_t>(n));
+	}
+
+	bool head = is_metrics_request(request, "HEAD");
+	if (!head && !is_metrics_request(request, "GET")) {
+		send_all(fd, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+		return;
+	}
+
+	auto m = stats.metrics();
+	std::string body = m ? format_openmetrics(*m) : std::string("# EOF\n");
+	std::string response = std::format("HTTP/1.1 200 OK\r\nContent-Type: {}\r\nContent-Length: {}\r\n"
+									   "Connection: close\r\n\r\n",
+									   CONTENT_TYPE, body.size());
+	if (!head)
+		response += body;
+	send_all(fd, response);
+}
@@ -0,0 +1,104 @@
+#include "../../include/export/ndjsonExporter.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+namespace {
+
+/* records waiting for the I/O thread before new ones are dropped */
+constexpr size_t QUEUE_DEPTH = 16;
+
+} // namespace
+
+NdjsonExporter::NdjsonExporter(Stats &stats, NdjsonOptions options)
+	: opts(std::move(options)), stats(stats), ready(QUEUE_DEPTH), spare(QUEUE_DEPTH + 2) {
+	open_file();
+	next_record = std::chrono::steady_clock::now() + opts.interval;
+	writer = std::thread([this] { run(); });
+}
+
+NdjsonExporter::~NdjsonExporter() { close(); }
+
+void NdjsonExporter::close() {
+	ready.close();
+	if (writer.joinable())
+		writer.join();
+	if (file) {
+		fclose(file);
+		file = nullptr;
+	}
+}
+
+void NdjsonExporter::tick() {
+	auto now = std::chrono::steady_clock::now();
+	if (now < next_record)
+		return;
+	next_record += opts.interval;
+	/* don't burst to catch up after a stall */
+	if (next_record < now)
+		next_record = now + opts.interval;
+	record();
+}
+
+void NdjsonExporter::record() {
+	NdjsonRecord rec = spare.try_pop().value_or(NdjsonRecord{});
+	stats.copy_ndjson(rec, seq++);
+	/* the cursors move only once the record is sure to be written */
+	uint64_t alerts = rec.alert_total, scans = rec.scan_total;
+	if (ready.try_push(std::move(rec)))
+		stats.ndjson_queued(alerts, scans);
+	else
+		++dropped_records;
+}
+
+void NdjsonExporter::open_file() {
+	file = fopen(opts.path.c_str(), "a");
+	if (!file)
+		throw std::runtime_error("Couldn't open " + opts.path + " for writing: " + strerror(errno));
+	std::error_code ec;
+	auto size = std::filesystem::file_size(opts.path, ec);
+	file_bytes = ec ? 0 : size;
+	file_opened = std::chrono::steady_clock::now();
+}
+
+void NdjsonExporter::rotate() {
+	fclose(file);
+	file = nullptr;
+
+	/* skip names left over from previous runs */
+	std::string target;
+	do
+		target = opts.path + "." + std::to_string(++rotations);
+	while (std::filesystem::exists(target));
+
+	std::error_code ec;
+	std::filesystem::rename(opts.path, target, ec);
+	if (ec)
+		fprintf(stderr, "Couldn't rotate %s: %s\n", opts.path.c_str(), ec.message().c_str());
+
+	try {
+		open_file();
+	} catch (const std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+	}
+}
+
+void NdjsonExporter::run() {
+	while (auto rec = ready.pop()) {
+		line.clear();
+		format_ndjson(*rec, line);
+		bool too_big = opts.rotate_bytes && file_bytes > 0 && file_bytes + line.size() > opts.rotate_bytes;
+		bool too_old = opts.rotate_age.count() && std::chrono::steady_clock::now() - file_opened >= opts.rotate_age;
+		if (file && (too_big || too_old))
+			rotate();
+
+		if (file) {
+			if (fwrite(line.data(), 1, line.size(), file) != line.size() || fflush(file) != 0)
+				fprintf(stderr, "Write to %s failed: %s\n", opts.path.c_str(), strerror(errno));
+			file_bytes += line.size();
+		}
+		spare.try_push(std::move(*rec));
+	}
+}
@@ -3,11 +3,11 @@
 #include <arpa/inet.h>
 #include <array>
 #include <cstdio>
+#include <cstring>
 #include <netinet/icmp6.h>
 #include <netinet/ip_icmp.h>
 #include <netinet/tcp.h>
 #include <netinet/udp.h>
-#include <stdexcept>
 uint16_t IP_class::get_payload_len() const { return payload_len; }
 
 TransportProtocol IP_class::get_protocol() const { return protocol; }
@@ -15,16 +15,21 @@ std::string IP_class::get_source() { return src; }
 std::string IP_class::get_dest() { return dst; }
 
 /*** Ipv4 ***/
-IPv4::IPv4(const u_char *data) {
+IPv4::IPv4(const u_char *data, size_t caplen) {
 	ip_hdr = reinterpret_cast<const ip *>(data);
+	end = data + caplen;
+	if (!captured(data, sizeof(ip)))
+		return;
+	ip_hdr_len = ip_hdr->ip_hl * 4;
+	if (ip_hdr_len < static_cast<int>(sizeof(ip)) || !captured(data, static_cast<size_t>(ip_hdr_len)))
+		return;
+	header_ok = true;
 
 	src = inet_ntoa(ip_hdr->ip_src);
 	dst = inet_ntoa(ip_hdr->ip_dst);
+	memcpy(src_addr.data(), &ip_hdr->ip_src, 4);
+	memcpy(dst_addr.data(), &ip_hdr->ip_dst, 4);
 
-	ip_hdr_len = ip_hdr->ip_hl * 4;
-	if (ip_hdr_len < 20) {
-		throw std::runtime_error("Failed to initial IPv4 ");
-	}
 	switch (ip_hdr->ip_p) {
 	case IPPROTO_TCP:
 		IPv4::handle_tcp();
@@ -49,26 +54,35 @@ IPv4::IPv4(const u_char *data) {
 	}
 }
 
+/* a TCP / UDP header that wasn't captured leaves the ports at 0 and the packet without payload */
 void IPv4::handle_tcp() {
+	protocol = TransportProtocol::TCP;
 	const auto *tcp = reinterpret_cast<const tcphdr *>(reinterpret_cast<const u_char *>(ip_hdr) + ip_hdr_len);
+	if (!captured(reinterpret_cast<const uint8_t *>(tcp), sizeof(tcphdr)))
+		return;
 
 	src_port = ntohs(tcp->source);
 	dest_port = ntohs(tcp->dest);
+	tcp_flags = reinterpret_cast<const uint8_t *>(tcp)[13];
 
-	payload_ptr = reinterpret_cast<const u_char *>(tcp) + tcp->doff * 4;
-	payload_len = ntohs(ip_hdr->ip_len) - (ip_hdr_len + tcp->doff * 4);
-
-	protocol = TransportProtocol::TCP;
+	int headers = ip_hdr_len + tcp->doff * 4;
+	if (tcp->doff * 4 < static_cast<int>(sizeof(tcphdr)) || headers > ntohs(ip_hdr->ip_len))
+		return;
+	set_payload(reinterpret_cast<const u_char *>(tcp) + tcp->doff * 4);
+	payload_len = static_cast<uint16_t>(ntohs(ip_hdr->ip_len) - headers);
 }
 void IPv4::handle_udp() {
+	protocol = TransportProtocol::UDP;
 	const auto *udp = reinterpret_cast<const udphdr *>(reinterpret_cast<const u_char *>(ip_hdr) + ip_hdr_len);
+	if (!captured(reinterpret_cast<const uint8_t *>(udp), sizeof(udphdr)))
+		return;
 	dest_port = ntohs(udp->dest);
 	src_port = ntohs(udp->source);
 
-	payload_ptr = reinterpret_cast<const u_char *>(udp) + sizeof(udphdr);
-	payload_len = ntohs(udp->len) - sizeof(udphdr);
-
-	protocol = TransportProtocol::UDP;
+	if (ntohs(udp->len) < sizeof(udphdr))
+		return;
+	set_payload(reinterpret_cast<const u_char *>(udp) + sizeof(udphdr));
+	payload_len = static_cast<uint16_t>(ntohs(udp->len) - sizeof(udphdr));
 }
 void IPv4::handle_icmp() { protocol = TransportProtocol::ICMP; }
 void IPv4::handle_icmpv6() { protocol = TransportProtocol::ICMP6; }
@@ -79,8 +93,12 @@ uint16_t IPv4::get_dest_port() { return dest_port; }
 
 /*** Ipv6 ***/
 
-IPv6::IPv6(const u_char *data) {
+IPv6::IPv6(const u_char *data, size_t caplen) {
 	ip_hdr = reinterpret_cast<const ip6_hdr *>(data);
+	end = data + caplen;
+	if (!captured(data, sizeof(ip6_hdr)))
+		return;
+	header_ok = true;
 	uint8_t hdr = ip_hdr->ip6_nxt;
 	std::array<char, INET6_ADDRSTRLEN> src{};
 	inet_ntop(AF_INET6, &ip_hdr->ip6_src, src.data(), sizeof(src));
@@ -89,9 +107,12 @@ IPv6::IPv6(const u_char *data) {
 	std::array<char, INET6_ADDRSTRLEN> dst{};
 	inet_ntop(AF_INET6, &ip_hdr->ip6_dst, dst.data(), sizeof(dst));
 	this->dst = dst.data();
+	memcpy(src_addr.data(), &ip_hdr->ip6_src, 16);
+	memcpy(dst_addr.data(), &ip_hdr->ip6_dst, 16);
 
 	ptr = reinterpret_cast<const uint8_t *>(ip_hdr + 1);
 	while (true) {
+		/* an extension header chain running past the capture ends the walk, the protocol stays unknown */
 		switch (hdr) {
 		case IPPROTO_TCP:
 			IPv6::handle_tcp();
@@ -115,13 +136,16 @@ IPv6::IPv6(const u_char *data) {
 		case IPPROTO_HOPOPTS:
 		case IPPROTO_ROUTING:
 		case IPPROTO_DSTOPTS: {
+			if (!captured(ptr, sizeof(ip6_ext)))
+				return;
 			const auto *ext = reinterpret_cast<const ip6_ext *>(ptr);
 			hdr = ext->ip6e_nxt;
 			ptr += (ext->ip6e_len + 1) * 8;
 			break;
 		}
 		case IPPROTO_FRAGMENT: {
-
+			if (!captured(ptr, sizeof(ip6_frag)))
+				return;
 			const auto *frag = reinterpret_cast<const ip6_frag *>(ptr);
 			hdr = frag->ip6f_nxt;
 			ptr += sizeof(ip6_frag);
@@ -136,26 +160,33 @@ IPv6::IPv6(const u_char *data) {
 }
 
 void IPv6::handle_tcp() {
+	protocol = TransportProtocol::TCP;
 	const auto tcp = reinterpret_cast<const tcphdr *>(ptr);
+	ptr = nullptr;
+	if (!captured(reinterpret_cast<const uint8_t *>(tcp), sizeof(tcphdr)))
+		return;
 	dest_port = ntohs(tcp->dest);
 	src_port = ntohs(tcp->source);
+	tcp_flags = reinterpret_cast<const uint8_t *>(tcp)[13];
 
-	payload_ptr = reinterpret_cast<const uint8_t *>(tcp) + tcp->doff * 4;
-	payload_len = ntohs(ip_hdr->ip6_plen) - tcp->doff * 4;
-
-	protocol = TransportProtocol::TCP;
-	ptr = nullptr;
+	if (tcp->doff * 4 < static_cast<int>(sizeof(tcphdr)) || tcp->doff * 4 > ntohs(ip_hdr->ip6_plen))
+		return;
+	set_payload(reinterpret_cast<const uint8_t *>(tcp) + tcp->doff * 4);
+	payload_len = static_cast<uint16_t>(ntohs(ip_hdr->ip6_plen) - tcp->doff * 4);
 }
 void IPv6::handle_udp() {
+	protocol = TransportProtocol::UDP;
 	const auto udp = reinterpret_cast<const udphdr *>(ptr);
+	ptr = nullptr;
+	if (!captured(reinterpret_cast<const uint8_t *>(udp), sizeof(udphdr)))
+		return;
 	dest_port = ntohs(udp->dest);
 	src_port = ntohs(udp->source);
 
-	payload_ptr = reinterpret_cast<const uint8_t *>(udp) + sizeof(udphdr);
-	payload_len = ntohs(udp->len) - sizeof(udphdr);
-
-	protocol = TransportProtocol::UDP;
-	ptr = nullptr;
+	if (ntohs(udp->len) < sizeof(udphdr))
+		return;
+	set_payload(reinterpret_cast<const uint8_t *>(udp) + sizeof(udphdr));
+	payload_len = static_cast<uint16_t>(ntohs(udp->len) - sizeof(udphdr));
 }
 void IPv6::handle_icmp() {
 	protocol = TransportProtocol::ICMP;
@@ -163,7 +194,8 @@ void IPv6::handle_icmp() {
 }
 void IPv6::handle_icmpv6() {
 	protocol = TransportProtocol::ICMP6;
-	payload_len = ntohs(ip_hdr->ip6_plen) - sizeof(icmp6_hdr);
+	if (ntohs(ip_hdr->ip6_plen) >= sizeof(icmp6_hdr))
+		payload_len = static_cast<uint16_t>(ntohs(ip_hdr->ip6_plen) - sizeof(icmp6_hdr));
 	ptr = nullptr;
 }
 void IPv6::handle_igmp() {
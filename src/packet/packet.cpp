@@ -1,7 +1,7 @@
 #include "../../include/packet/packet.hpp"
 #include <cstring>
 
-ApplicationProtocol Packet::get_application_protocol() {
+ApplicationProtocol Packet::get_application_protocol() const {
 	if (!payload_ptr || payload_len < 4)
 		goto check_port;
 
@@ -0,0 +1,281 @@
+#include "../../include/stats/anomaly.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <functional>
+#include <iterator>
+
+namespace {
+
+/* the Bloom filter generations rotate after this many intervals, so a peer counts as new after 5-10 minutes */
+constexpr uint32_t PEER_EPOCH_INTERVALS = 300;
+/* intervals of an idle gap that are folded in as empty, longer gaps only realign the clock */
+constexpr uint32_t MAX_GAP_INTERVALS = 16;
+
+constexpr uint64_t ROW_SEEDS[] = {0x9e3779b97f4a7c15ull, 0xc2b2ae3d27d4eb4full, 0x165667b19e3779f9ull,
+								  0xd6e8feb86659fd93ull};
+
+uint64_t mix(uint64_t x) {
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ull;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebull;
+	x ^= x >> 31;
+	return x;
+}
+
+uint64_t hash_str(const std::string &s) { return mix(std::hash<std::string>{}(s)); }
+
+} // namespace
+
+std::string anomaly_scope_to_str(AnomalyScope scope) {
+	switch (scope) {
+	case AnomalyScope::GLOBAL:
+		return "global";
+	case AnomalyScope::HOST:
+		return "host";
+	case AnomalyScope::PORT:
+		return "port";
+	}
+	return "unknown";
+}
+
+std::string anomaly_metric_to_str(AnomalyMetric metric) {
+	switch (metric) {
+	case AnomalyMetric::BYTES:
+		return "bytes";
+	case AnomalyMetric::PACKETS:
+		return "packets";
+	case AnomalyMetric::NEW_PEERS:
+		return "new_peers";
+	case AnomalyMetric::SYN:
+		return "syn";
+	}
+	return "unknown";
+}
+
+void AnomalyDetector::Ewma::fold(double x, double alpha) {
+	double diff = x - mean;
+	mean += alpha * diff;
+	var = (1 - alpha) * (var + alpha * diff * diff);
+}
+
+/* multiply-shift: the top WIDTH_BITS of hash * seed pick the column of each row */
+size_t AnomalyDetector::RateSketch::cell(size_t row, uint64_t hash) {
+	return row * WIDTH + ((hash * ROW_SEEDS[row]) >> (64 - WIDTH_BITS));
+}
+
+uint32_t AnomalyDetector::RateSketch::add(uint64_t hash, uint32_t amount) {
+	uint32_t est = UINT32_MAX;
+	for (size_t r = 0; r < DEPTH; ++r) {
+		uint32_t &c = counts[cell(r, hash)];
+		c += amount;
+		est = std::min(est, c);
+	}
+	return est;
+}
+
+uint32_t AnomalyDetector::RateSketch::estimate(uint64_t hash) const {
+	uint32_t est = UINT32_MAX;
+	for (size_t r = 0; r < DEPTH; ++r)
+		est = std::min(est, counts[cell(r, hash)]);
+	return est;
+}
+
+const AnomalyDetector::Ewma &AnomalyDetector::RateSketch::baseline_of(uint64_t hash) const {
+	const Ewma *best = nullptr;
+	for (size_t r = 0; r < DEPTH; ++r) {
+		const Ewma &e = baseline[cell(r, hash)];
+		if (!best || e.mean < best->mean)
+			best = &e;
+	}
+	return *best;
+}
+
+void AnomalyDetector::RateSketch::close_interval(double alpha) {
+	for (size_t i = 0; i < counts.size(); ++i) {
+		baseline[i].fold(counts[i], alpha);
+		counts[i] = 0;
+	}
+}
+
+void AnomalyDetector::TopKeys::offer(uint64_t hash, uint32_t estimate, std::string_view key, size_t k) {
+	/* the common case: not among the largest, nothing to do */
+	if (slots.size() >= k && estimate <= min_estimate)
+		return;
+	auto it = index.find(hash);
+	if (it != index.end()) {
+		slots[it->second].estimate = estimate;
+		return;
+	}
+
+	if (slots.size() < k) {
+		index.emplace(hash, static_cast<uint32_t>(slots.size()));
+		slots.push_back({hash, estimate, std::string(key)});
+	} else {
+		auto victim = std::min_element(slots.begin(), slots.end(),
+									   [](const Slot &a, const Slot &b) { return a.estimate < b.estimate; });
+		index.erase(victim->hash);
+		index.emplace(hash, static_cast<uint32_t>(victim - slots.begin()));
+		victim->hash = hash;
+		victim->estimate = estimate;
+		victim->key.assign(key);
+	}
+	if (slots.size() >= k)
+		min_estimate = std::min_element(slots.begin(), slots.end(), [](const Slot &a, const Slot &b) {
+						   return a.estimate < b.estimate;
+					   })->estimate;
+}
+
+void AnomalyDetector::TopKeys::clear() {
+	slots.clear();
+	index.clear();
+	min_estimate = 0;
+}
+
+bool AnomalyDetector::PeerFilter::insert(uint64_t hash) {
+	size_t a = hash & (FILTER_BITS - 1);
+	size_t b = (hash >> 32) & (FILTER_BITS - 1);
+	bool seen = ((current[a / 64] >> (a % 64)) & 1 && (current[b / 64] >> (b % 64)) & 1) ||
+				((previous[a / 64] >> (a % 64)) & 1 && (previous[b / 64] >> (b % 64)) & 1);
+	current[a / 64] |= uint64_t(1) << (a % 64);
+	current[b / 64] |= uint64_t(1) << (b % 64);
+	return !seen;
+}
+
+void AnomalyDetector::PeerFilter::rotate() {
+	previous.swap(current);
+	std::fill(current.begin(), current.end(), 0);
+}
+
+AnomalyDetector::AnomalyDetector(AnomalyOptions options) : opts(options) {
+	interval_ns = static_cast<uint64_t>(std::max<int64_t>(1, opts.interval.count())) * 1000000ull;
+	for (AnomalyMetric m : {AnomalyMetric::BYTES, AnomalyMetric::PACKETS, AnomalyMetric::NEW_PEERS, AnomalyMetric::SYN})
+		tracks.push_back({AnomalyScope::HOST, m, {}, {}});
+	for (AnomalyMetric m : {AnomalyMetric::BYTES, AnomalyMetric::PACKETS, AnomalyMetric::SYN})
+		tracks.push_back({AnomalyScope::PORT, m, {}, {}});
+	for (auto &t : tracks)
+		t.top.index.reserve(opts.top_k * 2);
+}
+
+void AnomalyDetector::count(Track &track, uint64_t hash, uint32_t amount, std::string_view key) {
+	track.top.offer(hash, track.sketch.add(hash, amount), key, opts.top_k);
+}
+
+/**
+ * @brief Accounts one packet, closing the interval first if its timestamp is past the end.
+ *
+ * Hosts are keyed by source address. Ports use the destination port of
+ * a SYN and otherwise the lower of both ports, the usual guess for the
+ * service side of a connection.
+ */
+void AnomalyDetector::add(const Packet &packet) {
+	if (!packet.ts_ns)
+		return;
+	if (!interval_end)
+		interval_end = (packet.ts_ns / interval_ns + 1) * interval_ns;
+	for (uint32_t gap = 0; packet.ts_ns >= interval_end; ++gap) {
+		if (gap == MAX_GAP_INTERVALS) {
+			interval_end = (packet.ts_ns / interval_ns + 1) * interval_ns;
+			break;
+		}
+		close_interval();
+		interval_end += interval_ns;
+	}
+
+	bool syn = packet.transport_protocol == TransportProtocol::TCP && (packet.tcp_flags & 0x12) == 0x02;
+	uint64_t src = hash_str(packet.src);
+	bool new_peer = peers.insert(mix(src ^ (hash_str(packet.dst) * 31)));
+
+	global_counts[static_cast<size_t>(AnomalyMetric::BYTES)] += packet.total_len;
+	global_counts[static_cast<size_t>(AnomalyMetric::PACKETS)]++;
+	count(tracks[0], src, packet.total_len, packet.src);
+	count(tracks[1], src, 1, packet.src);
+	if (new_peer) {
+		global_counts[static_cast<size_t>(AnomalyMetric::NEW_PEERS)]++;
+		count(tracks[2], src, 1, packet.src);
+	}
+	if (syn) {
+		global_counts[static_cast<size_t>(AnomalyMetric::SYN)]++;
+		count(tracks[3], src, 1, packet.src);
+	}
+
+	if (packet.transport_protocol != TransportProtocol::TCP && packet.transport_protocol != TransportProtocol::UDP)
+		return;
+	uint16_t port = syn ? packet.dst_port : std::min(packet.src_port, packet.dst_port);
+	char buf[8];
+	auto end = std::to_chars(buf, buf + sizeof(buf), port).ptr;
+	std::string_view key(buf, static_cast<size_t>(end - buf));
+	uint64_t hash = mix(port + 0x10000ull);
+	count(tracks[4], hash, packet.total_len, key);
+	count(tracks[5], hash, 1, key);
+	if (syn)
+		count(tracks[6], hash, 1, key);
+}
+
+void AnomalyDetector::test(AnomalyScope scope, AnomalyMetric metric, const std::string &key, double value,
+						   const Ewma &baseline) {
+	double seconds = static_cast<double>(interval_ns) / 1e9;
+	if (value < opts.min_rate[static_cast<size_t>(metric)] * seconds)
+		return;
+	/* a perfectly steady baseline would flag any wiggle, assume at least 10% noise */
+	double stddev = std::sqrt(std::max({baseline.var, 0.01 * baseline.mean * baseline.mean, 1.0}));
+	if ((value - baseline.mean) / stddev < opts.threshold)
+		return;
+
+	/* looked up here rather than in recent, which a Stats shard empties on every drain */
+	uint64_t id = mix(hash_str(key) ^ (static_cast<uint64_t>(scope) << 56 | static_cast<uint64_t>(metric) << 48));
+	auto [it, first] = flagged.try_emplace(id, interval_end);
+	if (!first) {
+		if (it->second + static_cast<uint64_t>(opts.cooldown) * interval_ns >= interval_end)
+			return;
+		it->second = interval_end;
+	}
+
+	recent.push_back({interval_end, scope, metric, key, value, baseline.mean, std::sqrt(baseline.var)});
+	++total_alerts;
+	while (recent.size() > opts.history)
+		recent.pop_front();
+}
+
+void AnomalyDetector::merge_alerts(const AnomalyDetector &other) {
+	merge_alerts(other.recent, other.total_alerts);
+}
+
+void AnomalyDetector::merge_alerts(const std::deque<AnomalyAlert> &alerts, uint64_t count) {
+	std::deque<AnomalyAlert> merged;
+	std::merge(recent.begin(), recent.end(), alerts.begin(), alerts.end(), std::back_inserter(merged),
+			   [](const AnomalyAlert &a, const AnomalyAlert &b) { return a.ts_ns < b.ts_ns; });
+	while (merged.size() > opts.history)
+		merged.pop_front();
+	recent = std::move(merged);
+	total_alerts += count;
+}
+
+void AnomalyDetector::close_interval() {
+	/* every baseline starts at zero, give them time to settle */
+	if (++intervals > opts.warmup) {
+		static const std::string global_key = "*";
+		for (size_t m = 0; m < global_counts.size(); ++m)
+			test(AnomalyScope::GLOBAL, static_cast<AnomalyMetric>(m), global_key,
+				 static_cast<double>(global_counts[m]), global_baseline[m]);
+		for (auto &t : tracks) {
+			for (const auto &slot : t.top.slots)
+				test(t.scope, t.metric, slot.key, t.sketch.estimate(slot.hash), t.sketch.baseline_of(slot.hash));
+		}
+	}
+
+	for (size_t m = 0; m < global_counts.size(); ++m) {
+		global_baseline[m].fold(static_cast<double>(global_counts[m]), opts.alpha);
+		global_counts[m] = 0;
+	}
+	for (auto &t : tracks) {
+		t.sketch.close_interval(opts.alpha);
+		t.top.clear();
+	}
+	uint64_t cooldown_ns = static_cast<uint64_t>(opts.cooldown) * interval_ns;
+	std::erase_if(flagged, [&](const auto &f) { return f.second + cooldown_ns < interval_end; });
+	if (intervals % PEER_EPOCH_INTERVALS == 0)
+		peers.rotate();
+}
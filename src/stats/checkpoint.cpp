@@ -0,0 +1,453 @@
+#include "../../include/stats/checkpoint.hpp"
+#include "../../include/capture/captureFile.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <stdexcept>
+#include <string_view>
+#include <unistd.h>
+
+namespace {
+
+constexpr char CHECKPOINT_MAGIC[8] = {'N', 'T', 'A', 'C', 'K', 'P', '\r', '\n'};
+/* 2: packet-time timeline, 3: per-port counters, 4: per-network counters, 5: no smoothed bandwidth */
+constexpr uint32_t CHECKPOINT_VERSION = 5;
+
+constexpr std::string_view UNMATCHED_NETWORK = "(other)";
+
+struct ProtocolEntry {
+	uint32_t protocol;
+	uint32_t packets;
+	uint32_t bytes;
+};
+
+struct TimelineEntry {
+	uint64_t second;
+	uint32_t packets;
+	uint32_t bytes;
+};
+
+struct PortEntry {
+	uint8_t protocol;
+	uint8_t pad;
+	uint16_t port;
+	uint32_t pad2;
+	uint64_t packets_to;
+	uint64_t bytes_to;
+	uint64_t packets_from;
+	uint64_t bytes_from;
+};
+
+struct NetworkEntry {
+	uint32_t label;
+	uint32_t pad;
+	IPStats stats;
+};
+
+struct PairEntry {
+	uint32_t src;
+	uint32_t dst;
+	uint32_t packets;
+	uint32_t bytes;
+};
+
+void append(std::string &out, const void *data, size_t len) {
+	out.append(static_cast<const char *>(data), len);
+	out.resize((out.size() + 7) & ~size_t{7}, '\0');
+}
+
+/* bounds-checked cursor over a serialized checkpoint */
+class Cursor {
+	const uint8_t *pos;
+	const uint8_t *end;
+
+  public:
+	Cursor(const uint8_t *data, size_t len) : pos(data), end(data + len) {}
+
+	template <class T> const T *take(uint64_t count) {
+		if (count > static_cast<uint64_t>(end - pos) / sizeof(T))
+			throw std::runtime_error("checkpoint is truncated");
+		const T *p = reinterpret_cast<const T *>(pos);
+		size_t len = (count * sizeof(T) + 7) & ~size_t{7};
+		pos += std::min<size_t>(len, static_cast<size_t>(end - pos));
+		return p;
+	}
+};
+
+} // namespace
+
+/**
+ * @brief Copies every counter for a checkpoint.
+ *
+ * Plain copies into the storage state already has, nothing is indexed
+ * or formatted while the lock is held; serialize_checkpoint() does that
+ * on the writer thread.
+ */
+void Stats::copy_checkpoint(CheckpointState &state) {
+	std::lock_guard<std::mutex> lock(mtx);
+	state.totals.total_packets = snapshot.total_p;
+	state.totals.total_bytes = snapshot.total_b;
+	state.totals.bandwidth = snapshot.bandwidth;
+	state.totals.max_bandwidth = snapshot.max_bandwidth;
+
+	state.transport.clear();
+	for (const auto &[proto, s] : transport_map)
+		state.transport.emplace_back(static_cast<uint32_t>(proto), s);
+	state.application.clear();
+	for (const auto &[proto, s] : application_map)
+		state.application.emplace_back(static_cast<uint32_t>(proto), s);
+
+	state.ips.resize(ip_map.size());
+	size_t i = 0;
+	for (const auto &[ip, s] : ip_map) {
+		state.ips[i].first = ip;
+		state.ips[i].second = s;
+		++i;
+	}
+	state.pairs.resize(pairs.size());
+	i = 0;
+	for (const auto &[pair, s] : pairs) {
+		state.pairs[i].src = pair.first;
+		state.pairs[i].dst = pair.second;
+		state.pairs[i].stats = s;
+		++i;
+	}
+
+	state.bandwidth = snapshot.bandwidth_history;
+	state.timeline.assign(timeline.begin(), timeline.end());
+	if (ports)
+		state.ports = ports->entries();
+	else
+		state.ports.clear();
+	state.networks = networks;
+	state.network_stats = network_stats;
+}
+
+void Stats::save_checkpoint(std::string &out) {
+	CheckpointState state;
+	copy_checkpoint(state);
+	serialize_checkpoint(state, out);
+}
+
+/**
+ * @brief Serializes copied counters into a checkpoint buffer.
+ *
+ * Addresses are stored once in a string table (ip_map keys first) and
+ * pairs refer to them by index. Only touches memory; writing the buffer
+ * is left to the caller.
+ */
+void serialize_checkpoint(const CheckpointState &state, std::string &out) {
+	std::vector<const std::string *> strings;
+	std::unordered_map<std::string_view, uint32_t> index;
+	strings.reserve(state.ips.size());
+	index.reserve(state.ips.size());
+	for (const auto &[ip, s] : state.ips) {
+		index.emplace(ip, static_cast<uint32_t>(strings.size()));
+		strings.push_back(&ip);
+	}
+	size_t n_ips = strings.size();
+
+	std::vector<PairEntry> pair_entries;
+	pair_entries.reserve(state.pairs.size());
+	auto id_of = [&](const std::string &s) {
+		auto [it, inserted] = index.try_emplace(s, static_cast<uint32_t>(strings.size()));
+		if (inserted)
+			strings.push_back(&s);
+		return it->second;
+	};
+	for (const auto &p : state.pairs)
+		pair_entries.push_back({id_of(p.src), id_of(p.dst), p.stats.packets, p.stats.bytes});
+
+	/* network labels share the string table with the addresses */
+	std::vector<std::string> network_names;
+	std::vector<NetworkEntry> network_entries;
+	network_names.reserve(state.network_stats.size());
+	for (size_t i = 0; i < state.network_stats.size(); ++i) {
+		const IPStats &s = state.network_stats[i];
+		if (!s.packets_sent && !s.packets_received)
+			continue;
+		network_names.emplace_back(i ? state.networks->label(static_cast<uint32_t>(i - 1)) : UNMATCHED_NETWORK);
+		network_entries.push_back({0, 0, s});
+	}
+	for (size_t i = 0; i < network_entries.size(); ++i)
+		network_entries[i].label = id_of(network_names[i]);
+
+	std::vector<uint32_t> offsets;
+	offsets.reserve(strings.size() + 1);
+	uint64_t string_bytes = 0;
+	for (const std::string *s : strings) {
+		offsets.push_back(static_cast<uint32_t>(string_bytes));
+		string_bytes += s->size();
+	}
+	offsets.push_back(static_cast<uint32_t>(string_bytes));
+	if (string_bytes > UINT32_MAX)
+		throw std::runtime_error("Too many addresses for a checkpoint");
+
+	std::vector<ProtocolEntry> transport, application;
+	for (const auto &[proto, s] : state.transport)
+		transport.push_back({proto, s.packets, s.bytes});
+	for (const auto &[proto, s] : state.application)
+		application.push_back({proto, s.packets, s.bytes});
+
+	std::vector<PortEntry> port_entries;
+	for (const auto &e : state.ports)
+		port_entries.push_back({static_cast<uint8_t>(e.protocol), 0, e.port, 0, e.packets_to, e.bytes_to,
+								e.packets_from, e.bytes_from});
+
+	CheckpointHeader h{};
+	memcpy(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic));
+	h.version = CHECKPOINT_VERSION;
+	h.created_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+					   std::chrono::system_clock::now().time_since_epoch())
+					   .count();
+	h.n_transport = transport.size();
+	h.n_application = application.size();
+	h.n_strings = strings.size();
+	h.string_bytes = string_bytes;
+	h.n_ips = n_ips;
+	h.n_pairs = pair_entries.size();
+	h.n_bandwidth = state.bandwidth.size();
+	h.n_timeline = state.timeline.size();
+	h.n_ports = static_cast<uint32_t>(port_entries.size());
+	h.n_networks = network_entries.size();
+
+	out.clear();
+	out.reserve(sizeof(h) + sizeof(state.totals) + string_bytes + offsets.size() * 4 + n_ips * sizeof(IPStats) +
+				pair_entries.size() * sizeof(PairEntry) + h.n_bandwidth * sizeof(BandwidthPoint) +
+				h.n_timeline * sizeof(TimelineEntry) + port_entries.size() * sizeof(PortEntry) +
+				network_entries.size() * sizeof(NetworkEntry) + 64);
+	append(out, &h, sizeof(h));
+	append(out, &state.totals, sizeof(state.totals));
+	append(out, transport.data(), transport.size() * sizeof(ProtocolEntry));
+	append(out, application.data(), application.size() * sizeof(ProtocolEntry));
+	append(out, offsets.data(), offsets.size() * sizeof(uint32_t));
+	size_t chars = out.size();
+	out.resize(chars + string_bytes);
+	for (const std::string *s : strings) {
+		memcpy(out.data() + chars, s->data(), s->size());
+		chars += s->size();
+	}
+	out.resize((out.size() + 7) & ~size_t{7}, '\0');
+	for (const auto &[ip, s] : state.ips)
+		out.append(reinterpret_cast<const char *>(&s), sizeof(IPStats));
+	append(out, pair_entries.data(), pair_entries.size() * sizeof(PairEntry));
+	append(out, state.bandwidth.data(), state.bandwidth.size() * sizeof(BandwidthPoint));
+	for (const auto &[sec, s] : state.timeline) {
+		TimelineEntry e{sec, s.packets, s.bytes};
+		out.append(reinterpret_cast<const char *>(&e), sizeof(e));
+	}
+	append(out, port_entries.data(), port_entries.size() * sizeof(PortEntry));
+	append(out, network_entries.data(), network_entries.size() * sizeof(NetworkEntry));
+
+	uint64_t payload = out.size() - sizeof(h);
+	memcpy(out.data() + offsetof(CheckpointHeader, payload_bytes), &payload, sizeof(payload));
+}
+
+/**
+ * @brief Replaces the counters with a serialized checkpoint.
+ *
+ * The tables are rebuilt off-lock, ip_map with its final size reserved
+ * up front and the pairs in parallel on a second thread; pairs are
+ * stored in key order, so every std::map insert is an O(1) hinted
+ * append. The lock is only taken to swap them in.
+ */
+void Stats::load_checkpoint(const uint8_t *data, size_t len) {
+	Cursor cur(data, len);
+	const CheckpointHeader &h = *cur.take<CheckpointHeader>(1);
+	if (memcmp(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic)) != 0)
+		throw std::runtime_error("not a checkpoint");
+	if (h.version != CHECKPOINT_VERSION)
+		throw std::runtime_error("unsupported checkpoint version " + std::to_string(h.version));
+	if (h.payload_bytes > len - sizeof(h))
+		throw std::runtime_error("checkpoint is truncated");
+
+	const CheckpointTotals &t = *cur.take<CheckpointTotals>(1);
+	const ProtocolEntry *transport = cur.take<ProtocolEntry>(h.n_transport);
+	const ProtocolEntry *application = cur.take<ProtocolEntry>(h.n_application);
+	const uint32_t *offsets = cur.take<uint32_t>(h.n_strings + 1);
+	const char *chars = cur.take<char>(h.string_bytes);
+	if (h.n_ips > h.n_strings)
+		throw std::runtime_error("checkpoint is corrupt");
+	const IPStats *ips = cur.take<IPStats>(h.n_ips);
+	const PairEntry *pair_entries = cur.take<PairEntry>(h.n_pairs);
+	const BandwidthPoint *bandwidth = cur.take<BandwidthPoint>(h.n_bandwidth);
+	const TimelineEntry *timeline_entries = cur.take<TimelineEntry>(h.n_timeline);
+	const PortEntry *port_entries = cur.take<PortEntry>(h.n_ports);
+	const NetworkEntry *network_entries = cur.take<NetworkEntry>(h.n_networks);
+
+	std::vector<std::string_view> strings(h.n_strings);
+	for (uint64_t i = 0; i < h.n_strings; ++i) {
+		if (offsets[i] > offsets[i + 1] || offsets[i + 1] > h.string_bytes)
+			throw std::runtime_error("checkpoint is corrupt");
+		strings[i] = std::string_view(chars + offsets[i], offsets[i + 1] - offsets[i]);
+	}
+
+	std::unordered_map<TransportProtocol, protocolStats> new_transport;
+	for (uint64_t i = 0; i < h.n_transport; ++i)
+		new_transport[static_cast<TransportProtocol>(transport[i].protocol)] = {transport[i].packets,
+																				transport[i].bytes};
+	std::unordered_map<ApplicationProtocol, protocolStats> new_application;
+	for (uint64_t i = 0; i < h.n_application; ++i)
+		new_application[static_cast<ApplicationProtocol>(application[i].protocol)] = {application[i].packets,
+																					  application[i].bytes};
+
+	for (uint64_t i = 0; i < h.n_pairs; ++i)
+		if (pair_entries[i].src >= h.n_strings || pair_entries[i].dst >= h.n_strings)
+			throw std::runtime_error("checkpoint is corrupt");
+	for (uint64_t i = 0; i < h.n_networks; ++i)
+		if (network_entries[i].label >= h.n_strings)
+			throw std::runtime_error("checkpoint is corrupt");
+
+	/* the two big tables are independent, build the pairs on a second thread */
+	std::map<std::pair<std::string, std::string>, protocolStats> new_pairs;
+	std::thread pairs_builder([&] {
+		for (uint64_t i = 0; i < h.n_pairs; ++i) {
+			const PairEntry &p = pair_entries[i];
+			new_pairs.emplace_hint(new_pairs.end(), std::piecewise_construct,
+								   std::forward_as_tuple(strings[p.src], strings[p.dst]),
+								   std::forward_as_tuple(protocolStats{p.packets, p.bytes}));
+		}
+	});
+
+	std::unordered_map<std::string, IPStats> new_ips;
+	new_ips.reserve(h.n_ips);
+	for (uint64_t i = 0; i < h.n_ips; ++i)
+		new_ips.emplace(strings[i], ips[i]);
+	pairs_builder.join();
+
+	std::vector<BandwidthPoint> history(bandwidth, bandwidth + h.n_bandwidth);
+	std::map<uint64_t, protocolStats> new_timeline;
+	for (uint64_t i = 0; i < h.n_timeline; ++i)
+		new_timeline.emplace_hint(new_timeline.end(), timeline_entries[i].second,
+								  protocolStats{timeline_entries[i].packets, timeline_entries[i].bytes});
+	std::unique_ptr<PortTable> new_ports;
+	if (h.n_ports) {
+		new_ports = std::make_unique<PortTable>();
+		for (uint64_t i = 0; i < h.n_ports; ++i) {
+			const PortEntry &p = port_entries[i];
+			new_ports->add_entry({static_cast<TransportProtocol>(p.protocol), p.port, p.packets_to, p.bytes_to,
+								  p.packets_from, p.bytes_from});
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(mtx);
+	transport_map.swap(new_transport);
+	application_map.swap(new_application);
+	ip_map.swap(new_ips);
+	pairs.swap(new_pairs);
+	snapshot.bandwidth_history.swap(history);
+	timeline.swap(new_timeline);
+	ports.swap(new_ports);
+	/* networks are matched by label, those the current prefix file doesn't have are dropped */
+	std::fill(network_stats.begin(), network_stats.end(), IPStats{});
+	for (uint64_t i = 0; networks && i < h.n_networks; ++i) {
+		std::string_view name = strings[network_entries[i].label];
+		if (name == UNMATCHED_NETWORK)
+			network_stats[0] = network_entries[i].stats;
+		else if (uint32_t id = networks->find_label(name); id != PrefixTable::NONE)
+			network_stats[id + 1] = network_entries[i].stats;
+	}
+	timeline_sec = UINT64_MAX;
+	timeline_slot = nullptr;
+	snapshot.total_p = static_cast<uint32_t>(t.total_packets);
+	snapshot.total_b = static_cast<uint32_t>(t.total_bytes);
+	snapshot.bandwidth = t.bandwidth;
+	snapshot.max_bandwidth = t.max_bandwidth;
+}
+
+bool restore_checkpoint(Stats &stats, const std::string &path) {
+	if (!std::filesystem::exists(path))
+		return false;
+	MappedFile file(path);
+	try {
+		stats.load_checkpoint(file.data(), file.size());
+	} catch (const std::runtime_error &e) {
+		throw std::runtime_error("Couldn't restore " + path + ": " + e.what());
+	}
+	return true;
+}
+
+void write_checkpoint_file(const std::string &path, const std::string &data) {
+	std::string tmp = path + ".tmp";
+	int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		throw std::runtime_error("Couldn't create " + tmp + ": " + strerror(errno));
+
+	size_t done = 0;
+	while (done < data.size()) {
+		ssize_t n = write(fd, data.data() + done, data.size() - done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			int err = errno;
+			close(fd);
+			throw std::runtime_error("Write error on " + tmp + ": " + strerror(err));
+		}
+		done += static_cast<size_t>(n);
+	}
+	/* the rename must never expose a half-written checkpoint */
+	if (fsync(fd) != 0 || close(fd) != 0)
+		throw std::runtime_error("Couldn't sync " + tmp + ": " + strerror(errno));
+	if (rename(tmp.c_str(), path.c_str()) != 0)
+		throw std::runtime_error("Couldn't replace " + path + ": " + strerror(errno));
+}
+
+Checkpointer::Checkpointer(Stats &stats, std::string path, std::chrono::seconds interval)
+	: stats(stats), path(std::move(path)), interval(interval), ready(1), spare(1) {
+	next_save = std::chrono::steady_clock::now() + interval;
+	writer = std::thread([this] { run(); });
+}
+
+Checkpointer::~Checkpointer() { close(); }
+
+void Checkpointer::run() {
+	std::string buf;
+	while (auto state = ready.pop()) {
+		try {
+			serialize_checkpoint(*state, buf);
+			write_checkpoint_file(path, buf);
+		} catch (const std::exception &e) {
+			fprintf(stderr, "%s\n", e.what());
+		}
+		spare.try_push(std::move(*state));
+		writing = false;
+	}
+}
+
+void Checkpointer::tick() {
+	if (interval.count() == 0 || closed)
+		return;
+	auto now = std::chrono::steady_clock::now();
+	if (now < next_save)
+		return;
+	next_save = now + interval;
+	/* the previous checkpoint is still being written */
+	if (writing.exchange(true))
+		return;
+
+	CheckpointState state = spare.try_pop().value_or(CheckpointState{});
+	stats.copy_checkpoint(state);
+	if (!ready.try_push(std::move(state)))
+		writing = false;
+}
+
+void Checkpointer::close() {
+	if (closed)
+		return;
+	closed = true;
+	ready.close();
+	if (writer.joinable())
+		writer.join();
+
+	std::string buf;
+	stats.save_checkpoint(buf);
+	try {
+		write_checkpoint_file(path, buf);
+	} catch (const std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+	}
+}
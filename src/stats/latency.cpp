@@ -0,0 +1,175 @@
+#include "../../include/stats/latency.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+/* histograms of one thread; written by that thread only, relaxed loads and stores are enough */
+struct ThreadHistograms {
+	std::array<std::array<std::atomic<uint64_t>, Latency::BUCKETS>, LATENCY_STAGES> counts{};
+	std::array<std::atomic<uint64_t>, LATENCY_STAGES> max{};
+};
+
+struct Registry {
+	std::mutex mtx;
+	std::vector<ThreadHistograms *> threads;
+	/* threads that ended */
+	ThreadHistograms retired;
+};
+
+Registry &registry() {
+	static Registry r;
+	return r;
+}
+
+/* folds the histograms of an ending thread into the retired total */
+struct Local {
+	std::unique_ptr<ThreadHistograms> h;
+	~Local() {
+		if (!h)
+			return;
+		Registry &r = registry();
+		std::lock_guard<std::mutex> lock(r.mtx);
+		for (size_t s = 0; s < LATENCY_STAGES; ++s) {
+			for (size_t b = 0; b < Latency::BUCKETS; ++b)
+				r.retired.counts[s][b].fetch_add(h->counts[s][b].load(std::memory_order_relaxed),
+												 std::memory_order_relaxed);
+			uint64_t m = h->max[s].load(std::memory_order_relaxed);
+			if (m > r.retired.max[s].load(std::memory_order_relaxed))
+				r.retired.max[s].store(m, std::memory_order_relaxed);
+		}
+		std::erase(r.threads, h.get());
+	}
+};
+
+thread_local Local local;
+
+ThreadHistograms &attach() {
+	local.h = std::make_unique<ThreadHistograms>();
+	Registry &r = registry();
+	std::lock_guard<std::mutex> lock(r.mtx);
+	r.threads.push_back(local.h.get());
+	return *local.h;
+}
+
+/* nanoseconds per tick, measured over a millisecond by the first caller; it sleeps, never call it with r.mtx held */
+double ns_per_tick() {
+	static const double scale = [] {
+		auto base_time = std::chrono::steady_clock::now();
+		uint64_t base_ticks = Latency::ticks();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		auto elapsed = std::chrono::steady_clock::now() - base_time;
+		uint64_t ticks = Latency::ticks() - base_ticks;
+		return ticks ? std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(ticks) : 1.0;
+	}();
+	return scale;
+}
+
+} // namespace
+
+const char *latency_stage_name(LatencyStage stage) {
+	switch (stage) {
+	case LatencyStage::PARSE:
+		return "parse";
+	case LatencyStage::LOCK_WAIT:
+		return "lock_wait";
+	case LatencyStage::UPDATE:
+		return "update";
+	case LatencyStage::SNAPSHOT:
+		return "snapshot";
+	case LatencyStage::RENDER:
+		return "render";
+	}
+	return "unknown";
+}
+
+void Latency::set_enabled(bool on) {
+	/* calibrates when recording starts, so report() doesn't wait for it */
+	if (on)
+		ns_per_tick();
+	active.store(on, std::memory_order_relaxed);
+}
+
+size_t Latency::bucket(uint64_t v) {
+	if (v < SUB)
+		return static_cast<size_t>(v);
+	unsigned e = static_cast<unsigned>(std::bit_width(v)) - 1;
+	return (e - SUB_BITS + 1) * SUB + ((v >> (e - SUB_BITS)) & (SUB - 1));
+}
+
+uint64_t Latency::bucket_floor(size_t b) {
+	if (b < SUB)
+		return b;
+	unsigned e = static_cast<unsigned>(b / SUB) + SUB_BITS - 1;
+	return (SUB + b % SUB) << (e - SUB_BITS);
+}
+
+void Latency::record(LatencyStage stage, uint64_t elapsed_ticks) {
+	ThreadHistograms &h = local.h ? *local.h : attach();
+	size_t s = static_cast<size_t>(stage);
+	std::atomic<uint64_t> &c = h.counts[s][bucket(elapsed_ticks)];
+	c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	if (elapsed_ticks > h.max[s].load(std::memory_order_relaxed))
+		h.max[s].store(elapsed_ticks, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Sums the histograms of every thread and reads off the percentiles.
+ *
+ * A percentile is reported as the middle of the bucket it falls in,
+ * never above the largest value recorded.
+ */
+std::vector<StageLatency> Latency::report() {
+	std::vector<uint64_t> sum(LATENCY_STAGES * BUCKETS);
+	std::array<uint64_t, LATENCY_STAGES> max{};
+	double scale = ns_per_tick();
+	{
+		Registry &r = registry();
+		std::lock_guard<std::mutex> lock(r.mtx);
+		auto add = [&](const ThreadHistograms &h) {
+			for (size_t s = 0; s < LATENCY_STAGES; ++s) {
+				for (size_t b = 0; b < BUCKETS; ++b)
+					sum[s * BUCKETS + b] += h.counts[s][b].load(std::memory_order_relaxed);
+				max[s] = std::max(max[s], h.max[s].load(std::memory_order_relaxed));
+			}
+		};
+		add(r.retired);
+		for (const ThreadHistograms *h : r.threads)
+			add(*h);
+	}
+
+	std::vector<StageLatency> out;
+	for (size_t s = 0; s < LATENCY_STAGES; ++s) {
+		StageLatency l;
+		l.stage = latency_stage_name(static_cast<LatencyStage>(s));
+		const uint64_t *counts = &sum[s * BUCKETS];
+		for (size_t b = 0; b < BUCKETS; ++b)
+			l.count += counts[b];
+		l.max = static_cast<double>(max[s]) * scale;
+		if (l.count) {
+			auto percentile = [&](double q) {
+				uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * static_cast<double>(l.count) + 0.5));
+				uint64_t seen = 0;
+				for (size_t b = 0; b < BUCKETS; ++b) {
+					seen += counts[b];
+					if (seen >= rank) {
+						uint64_t lo = bucket_floor(b);
+						uint64_t hi = b + 1 < BUCKETS ? bucket_floor(b + 1) : lo;
+						double mid = static_cast<double>(lo) + static_cast<double>(hi - lo) / 2;
+						return std::min(mid, static_cast<double>(max[s])) * scale;
+					}
+				}
+				return l.max;
+			};
+			l.p50 = percentile(0.50);
+			l.p99 = percentile(0.99);
+			l.p999 = percentile(0.999);
+		}
+		out.push_back(std::move(l));
+	}
+	return out;
+}
@@ -0,0 +1,208 @@
+#include "../../include/stats/perfCounters.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <mutex>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+int open_event(uint32_t type, uint64_t config, int group) {
+	perf_event_attr attr{};
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	/* user space only, allowed up to perf_event_paranoid 2 without privileges */
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, PERF_FLAG_FD_CLOEXEC));
+}
+
+std::string open_error(int err) {
+	switch (err) {
+	case EACCES:
+	case EPERM:
+		return "not permitted (perf_event_paranoid, CAP_PERFMON or the container's seccomp profile)";
+	case ENOENT:
+	case EOPNOTSUPP:
+	case ENODEV:
+		return "no hardware counters on this CPU / VM";
+	case ENOSYS:
+		return "perf_event_open not supported by the kernel";
+	default:
+		return strerror(err);
+	}
+}
+
+struct Registry {
+	std::mutex mtx;
+	struct Live {
+		PerfRole role;
+		const PerfCounters *counters;
+	};
+	std::vector<Live> live;
+	/* scopes that ended */
+	std::array<PerfValues, PERF_ROLES> retired;
+	std::array<unsigned, PERF_ROLES> threads{};
+	std::string error;
+};
+
+Registry &registry() {
+	static Registry r;
+	return r;
+}
+
+} // namespace
+
+const char *perf_event_name(PerfEvent event) {
+	switch (event) {
+	case PerfEvent::CYCLES:
+		return "cycles";
+	case PerfEvent::INSTRUCTIONS:
+		return "instructions";
+	case PerfEvent::LLC_MISSES:
+		return "llc_misses";
+	case PerfEvent::BRANCH_MISSES:
+		return "branch_misses";
+	}
+	return "unknown";
+}
+
+const char *perf_role_name(PerfRole role) {
+	switch (role) {
+	case PerfRole::CAPTURE:
+		return "capture";
+	case PerfRole::AGGREGATION:
+		return "aggregation";
+	}
+	return "unknown";
+}
+
+PerfValues &PerfValues::operator+=(const PerfValues &other) {
+	for (size_t i = 0; i < PERF_EVENTS; ++i) {
+		count[i] += other.count[i];
+		available[i] = available[i] || other.available[i];
+	}
+	return *this;
+}
+
+PerfValues PerfValues::operator-(const PerfValues &earlier) const {
+	PerfValues out = *this;
+	for (size_t i = 0; i < PERF_EVENTS; ++i)
+		out.count[i] = count[i] > earlier.count[i] ? count[i] - earlier.count[i] : 0;
+	return out;
+}
+
+/**
+ * @brief Opens the event group for the calling thread.
+ *
+ * Without the cycle counter there is nothing to report per packet, so
+ * its failure disables the group; any other event the CPU lacks is just
+ * left out of it.
+ */
+PerfCounters::PerfCounters() {
+	fds.fill(-1);
+	leader = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+	if (leader < 0) {
+		failure = open_error(errno);
+		return;
+	}
+	fds[static_cast<size_t>(PerfEvent::CYCLES)] = leader;
+	order[opened++] = PerfEvent::CYCLES;
+
+	auto add = [&](PerfEvent event, uint32_t type, uint64_t config) {
+		int fd = open_event(type, config, leader);
+		if (fd < 0)
+			return false;
+		fds[static_cast<size_t>(event)] = fd;
+		order[opened++] = event;
+		return true;
+	};
+	add(PerfEvent::INSTRUCTIONS, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+	if (!add(PerfEvent::LLC_MISSES, PERF_TYPE_HW_CACHE,
+			 PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)))
+		add(PerfEvent::LLC_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	add(PerfEvent::BRANCH_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+}
+
+PerfCounters::~PerfCounters() {
+	for (int fd : fds) {
+		if (fd >= 0)
+			close(fd);
+	}
+}
+
+PerfValues PerfCounters::read() const {
+	PerfValues out;
+	if (leader < 0)
+		return out;
+	/* nr, time_enabled, time_running, then one value per event */
+	uint64_t buf[3 + PERF_EVENTS] = {};
+	if (::read(leader, buf, sizeof(buf)) < static_cast<ssize_t>(3 * sizeof(uint64_t)))
+		return out;
+	uint64_t enabled = buf[1];
+	uint64_t running = buf[2];
+	size_t n = std::min<size_t>(buf[0], opened);
+	for (size_t i = 0; i < n; ++i) {
+		size_t e = static_cast<size_t>(order[i]);
+		out.available[e] = true;
+		/* the group shared the PMU with others: extrapolate to the whole time it was enabled */
+		if (running && running < enabled)
+			out.count[e] = static_cast<uint64_t>(static_cast<double>(buf[3 + i]) * enabled / running);
+		else
+			out.count[e] = buf[3 + i];
+	}
+	return out;
+}
+
+PerfMonitor::Scope::Scope(PerfRole role) : role(role) {
+	if (!enabled())
+		return;
+	counters = std::make_unique<PerfCounters>();
+	Registry &r = registry();
+	std::lock_guard<std::mutex> lock(r.mtx);
+	if (!counters->available()) {
+		if (r.error.empty())
+			r.error = counters->error();
+		counters.reset();
+		return;
+	}
+	r.live.push_back({role, counters.get()});
+	++r.threads[static_cast<size_t>(role)];
+}
+
+PerfMonitor::Scope::~Scope() {
+	if (!counters)
+		return;
+	PerfValues final_values = counters->read();
+	Registry &r = registry();
+	std::lock_guard<std::mutex> lock(r.mtx);
+	r.retired[static_cast<size_t>(role)] += final_values;
+	std::erase_if(r.live, [this](const Registry::Live &l) { return l.counters == counters.get(); });
+}
+
+std::vector<PerfTotals> PerfMonitor::report() {
+	Registry &r = registry();
+	std::lock_guard<std::mutex> lock(r.mtx);
+	std::array<PerfValues, PERF_ROLES> sums = r.retired;
+	for (const auto &l : r.live)
+		sums[static_cast<size_t>(l.role)] += l.counters->read();
+
+	std::vector<PerfTotals> out;
+	for (size_t i = 0; i < PERF_ROLES; ++i) {
+		if (!r.threads[i])
+			continue;
+		out.push_back({perf_role_name(static_cast<PerfRole>(i)), r.threads[i], sums[i]});
+	}
+	return out;
+}
+
+std::string PerfMonitor::error() {
+	Registry &r = registry();
+	std::lock_guard<std::mutex> lock(r.mtx);
+	return r.error;
+}
@@ -0,0 +1,98 @@
+#include "../../include/stats/portTable.hpp"
+
+#include <algorithm>
+
+int PortTable::base_of(TransportProtocol protocol) {
+	switch (protocol) {
+	case TransportProtocol::TCP:
+		return 0;
+	case TransportProtocol::UDP:
+		return 2;
+	default:
+		return -1;
+	}
+}
+
+void PortTable::add(TransportProtocol protocol, uint16_t src_port, uint16_t dst_port, uint32_t len) {
+	int base = base_of(protocol);
+	if (base < 0)
+		return;
+	Counters &to = counters[base];
+	Counters &from = counters[base + 1];
+	to.packets[dst_port]++;
+	to.bytes[dst_port] += len;
+	from.packets[src_port]++;
+	from.bytes[src_port] += len;
+}
+
+void PortTable::merge(const PortTable &other) {
+	/* the counters are one contiguous block of uint64_t */
+	static_assert(sizeof(counters) == ARRAYS * 2 * PORTS * sizeof(uint64_t));
+	uint64_t *__restrict dst = counters[0].packets.data();
+	const uint64_t *__restrict src = other.counters[0].packets.data();
+	for (size_t i = 0; i < ARRAYS * 2 * PORTS; ++i)
+		dst[i] += src[i];
+}
+
+void PortTable::clear() {
+	for (auto &c : counters) {
+		c.packets.fill(0);
+		c.bytes.fill(0);
+	}
+}
+
+PortTable::Entry PortTable::entry(size_t base, uint16_t port) const {
+	return {base == 0 ? TransportProtocol::TCP : TransportProtocol::UDP,
+			port,
+			counters[base].packets[port],
+			counters[base].bytes[port],
+			counters[base + 1].packets[port],
+			counters[base + 1].bytes[port]};
+}
+
+std::vector<PortTable::Entry> PortTable::top(size_t k) const {
+	std::vector<Entry> heap;
+	if (!k)
+		return heap;
+	heap.reserve(k + 1);
+	/* min-heap on bytes: the root is the smallest of the current top k */
+	auto greater = [](const Entry &a, const Entry &b) { return a.bytes() > b.bytes(); };
+	for (size_t base = 0; base < ARRAYS; base += 2) {
+		const auto &to = counters[base].bytes;
+		const auto &from = counters[base + 1].bytes;
+		for (size_t port = 0; port < PORTS; ++port) {
+			uint64_t bytes = to[port] + from[port];
+			if (!bytes || (heap.size() == k && bytes <= heap.front().bytes()))
+				continue;
+			heap.push_back(entry(base, static_cast<uint16_t>(port)));
+			std::push_heap(heap.begin(), heap.end(), greater);
+			if (heap.size() > k) {
+				std::pop_heap(heap.begin(), heap.end(), greater);
+				heap.pop_back();
+			}
+		}
+	}
+	std::sort_heap(heap.begin(), heap.end(), greater);
+	return heap;
+}
+
+std::vector<PortTable::Entry> PortTable::entries() const {
+	std::vector<Entry> out;
+	for (size_t base = 0; base < ARRAYS; base += 2) {
+		for (size_t port = 0; port < PORTS; ++port) {
+			if (counters[base].packets[port] || counters[base + 1].packets[port])
+				out.push_back(entry(base, static_cast<uint16_t>(port)));
+		}
+	}
+	return out;
+}
+
+void PortTable::add_entry(const Entry &e) {
+	int base = base_of(e.protocol);
+	if (base < 0)
+		return;
+	counters[base].packets[e.port] += e.packets_to;
+	counters[base].bytes[e.port] += e.bytes_to;
+	counters[base + 1].packets[e.port] += e.packets_from;
+	counters[base + 1].bytes[e.port] += e.bytes_from;
+}
@@ -0,0 +1,281 @@
+#include "../../include/stats/prefixTable.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+/* dotted quad of a lookup without inet_pton, addresses here come from the packet parser */
+bool parse_v4(std::string_view s, uint8_t *out) {
+	const char *p = s.data();
+	const char *end = p + s.size();
+	for (int i = 0; i < 4; ++i) {
+		unsigned v = 0;
+		const char *start = p;
+		while (p != end && p - start < 3 && static_cast<unsigned>(*p - '0') < 10)
+			v = v * 10 + static_cast<unsigned>(*p++ - '0');
+		if (p == start || v > 255)
+			return false;
+		out[i] = static_cast<uint8_t>(v);
+		if (i < 3) {
+			if (p == end || *p != '.')
+				return false;
+			++p;
+		}
+	}
+	return p == end;
+}
+
+/* prefix file entries go through inet_pton, which rejects anything odd */
+bool parse_prefix_v4(const std::string &s, uint8_t *out) { return inet_pton(AF_INET, s.c_str(), out) == 1; }
+
+bool parse_v6(const std::string &s, uint8_t *out) { return inet_pton(AF_INET6, s.c_str(), out) == 1; }
+
+std::string_view trim(std::string_view s) {
+	size_t b = s.find_first_not_of(" \t\r");
+	if (b == std::string_view::npos)
+		return {};
+	return s.substr(b, s.find_last_not_of(" \t\r") - b + 1);
+}
+
+} // namespace
+
+void PrefixTable::Expanded::fill(uint32_t chunk, uint32_t value) {
+	for (size_t i = 0; i < CHUNK; ++i) {
+		uint32_t &e = chunks[chunk * CHUNK + i];
+		if (e & CHILD)
+			fill(e & ~CHILD, value);
+		else
+			e = value;
+	}
+}
+
+/**
+ * @brief Expands one prefix into the trie.
+ *
+ * Walks (creating) the chunks down to the stride the prefix ends in and
+ * sets the 2^(stride end - len) entries it covers. A new chunk starts as
+ * copies of the entry it replaces, so shorter prefixes stay visible
+ * below longer ones.
+ */
+void PrefixTable::Expanded::insert(const uint8_t *addr, unsigned len, uint32_t value) {
+	size_t idx = (size_t(addr[0]) << 8) | addr[1];
+	if (len <= ROOT_BITS) {
+		size_t span = size_t(1) << (ROOT_BITS - len);
+		idx &= ~(span - 1);
+		for (size_t i = idx; i < idx + span; ++i) {
+			if (root[i] & CHILD)
+				fill(root[i] & ~CHILD, value);
+			else
+				root[i] = value;
+		}
+		return;
+	}
+
+	auto child_of = [this](uint32_t entry) {
+		if (entry & CHILD)
+			return entry & ~CHILD;
+		uint32_t chunk = static_cast<uint32_t>(chunks.size() / CHUNK);
+		if (chunk & CHILD)
+			throw std::runtime_error("Too many prefixes");
+		chunks.resize(chunks.size() + CHUNK, entry);
+		return chunk;
+	};
+
+	uint32_t chunk = child_of(root[idx]);
+	root[idx] = CHILD | chunk;
+	unsigned bits = ROOT_BITS;
+	for (size_t byte = 2;; ++byte) {
+		bits += 8;
+		size_t pos = addr[byte];
+		if (len <= bits) {
+			size_t span = size_t(1) << (bits - len);
+			pos &= ~(span - 1);
+			for (size_t i = pos; i < pos + span; ++i) {
+				uint32_t &e = chunks[chunk * CHUNK + i];
+				if (e & CHILD)
+					fill(e & ~CHILD, value);
+				else
+					e = value;
+			}
+			return;
+		}
+		uint32_t next = child_of(chunks[chunk * CHUNK + pos]);
+		chunks[chunk * CHUNK + pos] = CHILD | next;
+		chunk = next;
+	}
+}
+
+void PrefixTable::Trie::compile(const Expanded &expanded) {
+	for (size_t i = 0; i < root.size(); ++i) {
+		uint32_t e = expanded.root[i];
+		if (!(e & CHILD)) {
+			root[i] = e;
+			continue;
+		}
+		uint32_t index = static_cast<uint32_t>(nodes.size());
+		nodes.emplace_back();
+		compile_node(expanded, e & ~CHILD, index);
+		root[i] = CHILD | index;
+	}
+}
+
+void PrefixTable::Trie::compile_node(const Expanded &expanded, uint32_t chunk, uint32_t index) {
+	const uint32_t *entries = &expanded.chunks[size_t(chunk) * CHUNK];
+	Node n{};
+	std::vector<uint32_t> kids;
+	n.leaf_base = static_cast<uint32_t>(leaves.size());
+	for (size_t pos = 0; pos < CHUNK; ++pos) {
+		uint64_t bit = uint64_t(1) << (pos % 64);
+		uint32_t e = entries[pos];
+		if (e & CHILD) {
+			n.child[pos / 64] |= bit;
+			kids.push_back(e & ~CHILD);
+		} else if (leaves.size() == n.leaf_base || leaves.back() != e) {
+			n.run[pos / 64] |= bit;
+			leaves.push_back(e);
+		}
+	}
+	for (size_t w = 1; w < 4; ++w) {
+		n.children_before[w] = static_cast<uint16_t>(n.children_before[w - 1] + std::popcount(n.child[w - 1]));
+		n.runs_before[w] = static_cast<uint16_t>(n.runs_before[w - 1] + std::popcount(n.run[w - 1]));
+	}
+
+	/* siblings are packed, a node only needs the index of its first child */
+	n.child_base = static_cast<uint32_t>(nodes.size());
+	nodes.resize(nodes.size() + kids.size());
+	nodes[index] = n;
+	for (size_t i = 0; i < kids.size(); ++i)
+		compile_node(expanded, kids[i], n.child_base + static_cast<uint32_t>(i));
+}
+
+uint32_t PrefixTable::Trie::lookup(const uint8_t *addr) const {
+	uint32_t e = root[(size_t(addr[0]) << 8) | addr[1]];
+	if (e & CHILD) {
+		const Node *n = &nodes[e & ~CHILD];
+		for (size_t byte = 2;; ++byte) {
+			size_t w = addr[byte] / 64;
+			uint64_t bit = uint64_t(1) << (addr[byte] % 64);
+			if (n->child[w] & bit) {
+				n = &nodes[n->child_base + n->children_before[w] + std::popcount(n->child[w] & (bit - 1))];
+				continue;
+			}
+			/* the run this leaf belongs to is the last one starting at or before it */
+			e = leaves[n->leaf_base + n->runs_before[w] + std::popcount(n->run[w] & (bit | (bit - 1))) - 1];
+			break;
+		}
+	}
+	return e ? e - 1 : NONE;
+}
+
+void PrefixTable::parse_prefix(std::string_view prefix, uint8_t *out, uint8_t &len, bool &v6) {
+	std::string_view addr = prefix;
+	size_t slash = prefix.find('/');
+	if (slash != std::string_view::npos)
+		addr = prefix.substr(0, slash);
+
+	std::string text(addr);
+	if (parse_prefix_v4(text, out)) {
+		v6 = false;
+		len = 32;
+	} else if (parse_v6(text, out)) {
+		v6 = true;
+		len = 128;
+	} else {
+		throw std::invalid_argument("invalid address '" + std::string(addr) + "'");
+	}
+	if (slash != std::string_view::npos) {
+		unsigned bits_len = 0;
+		std::string_view bits = prefix.substr(slash + 1);
+		auto [end, ec] = std::from_chars(bits.data(), bits.data() + bits.size(), bits_len);
+		if (ec != std::errc() || end != bits.data() + bits.size() || bits.empty() || bits_len > len)
+			throw std::invalid_argument("invalid prefix length '" + std::string(bits) + "'");
+		len = static_cast<uint8_t>(bits_len);
+	}
+}
+
+void PrefixTable::insert(std::string_view prefix, std::string_view label) {
+	Pending p{};
+	parse_prefix(prefix, p.addr.data(), p.len, p.v6);
+
+	auto [it, inserted] = label_ids.try_emplace(std::string(label), static_cast<uint32_t>(labels.size()));
+	if (inserted)
+		labels.emplace_back(label);
+	p.label = it->second;
+	pending.push_back(p);
+	++prefixes;
+}
+
+void PrefixTable::build() {
+	/* shortest first, so every prefix only has to overwrite what it covers */
+	std::stable_sort(pending.begin(), pending.end(), [](const Pending &a, const Pending &b) { return a.len < b.len; });
+	for (bool family_v6 : {false, true}) {
+		Expanded expanded;
+		for (const auto &p : pending)
+			if (p.v6 == family_v6)
+				expanded.insert(p.addr.data(), p.len, p.label + 1);
+		Trie &trie = family_v6 ? v6 : v4;
+		trie = Trie{};
+		trie.compile(expanded);
+		trie.nodes.shrink_to_fit();
+		trie.leaves.shrink_to_fit();
+	}
+	pending.clear();
+	pending.shrink_to_fit();
+}
+
+PrefixTable PrefixTable::load(const std::string &path) {
+	std::ifstream in(path);
+	if (!in)
+		throw std::runtime_error("Couldn't open prefix file " + path);
+
+	PrefixTable table;
+	std::string line;
+	for (size_t n = 1; std::getline(in, line); ++n) {
+		std::string_view s = line;
+		s = trim(s.substr(0, s.find('#')));
+		if (s.empty())
+			continue;
+		size_t space = s.find_first_of(" \t");
+		std::string_view label = space == std::string_view::npos ? std::string_view{} : trim(s.substr(space));
+		if (label.empty())
+			throw std::runtime_error(path + ":" + std::to_string(n) + ": missing label");
+		try {
+			table.insert(s.substr(0, space), label);
+		} catch (const std::invalid_argument &e) {
+			throw std::runtime_error(path + ":" + std::to_string(n) + ": " + e.what());
+		}
+	}
+	table.build();
+	return table;
+}
+
+int PrefixTable::parse_address(const std::string &address, uint8_t *out) {
+	if (parse_v4(address, out))
+		return 4;
+	if (address.find(':') != std::string::npos && parse_v6(address, out))
+		return 6;
+	return 0;
+}
+
+uint32_t PrefixTable::lookup(const std::string &address) const {
+	uint8_t addr[16];
+	switch (parse_address(address, addr)) {
+	case 4:
+		return v4.lookup(addr);
+	case 6:
+		return v6.lookup(addr);
+	default:
+		return NONE;
+	}
+}
+
+uint32_t PrefixTable::find_label(std::string_view name) const {
+	auto it = label_ids.find(std::string(name));
+	return it == label_ids.end() ? NONE : it->second;
+}
@@ -1,8 +1,16 @@
 #include "../../include/stats/protocolStats.hpp"
 #include "ftxui/dom/table.hpp"
+#include <algorithm>
+#include <ctime>
 #include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
 
-Stats::Stats() { last_tick = std::chrono::steady_clock::now(); }
+/* ports listed by the file exports and NDJSON records */
+static constexpr size_t EXPORT_PORTS = 100;
+
+Stats::Stats() = default;
 /**
  * @brief Aggregates a newly captured packet.
  *
@@ -12,12 +20,16 @@ Stats::Stats() { last_tick = std::chrono::steady_clock::now(); }
  *  - Application protocol stats
  *  - IP-level statistics
  *  - Communication pairs
+ *  - Per-port counters
+ *  - Per-network counters (with a prefix table)
  *
  * Must be called only from capture thread.
  * Protected by mutex.
  */
 void Stats::add_packet(const Packet &packet) {
+	uint64_t wait_begin = Latency::start();
 	std::lock_guard<std::mutex> lock(mtx);
+	Latency::stop(LatencyStage::LOCK_WAIT, wait_begin);
 
 	++snapshot.total_p;
 	snapshot.total_b += packet.total_len;
@@ -39,6 +51,216 @@ void Stats::add_packet(const Packet &packet) {
 	auto key = std::make_pair(packet.src, packet.dst);
 	pairs[key].packets++;
 	pairs[key].bytes += packet.total_len;
+
+	if (packet.ts_ns) {
+		uint64_t sec = packet.ts_ns / 1000000000ull;
+		if (sec != timeline_sec) {
+			timeline_slot = &timeline[sec];
+			timeline_sec = sec;
+		}
+		timeline_slot->packets++;
+		timeline_slot->bytes += packet.total_len;
+	}
+
+	if (packet.transport_protocol == TransportProtocol::TCP || packet.transport_protocol == TransportProtocol::UDP) {
+		if (!ports)
+			ports = std::make_unique<PortTable>();
+		ports->add(packet.transport_protocol, packet.src_port, packet.dst_port, packet.total_len);
+	}
+
+	if (networks) {
+		/* NONE + 1 wraps to the unmatched slot 0 */
+		bool ipv6 = packet.ip_version == v6;
+		IPStats &src = network_stats[networks->lookup(packet.src_addr.data(), ipv6) + 1];
+		src.packets_sent++;
+		src.bytes_sent += packet.total_len;
+		IPStats &dst = network_stats[networks->lookup(packet.dst_addr.data(), ipv6) + 1];
+		dst.packets_received++;
+		dst.bytes_received += packet.total_len;
+	}
+
+	if (anomaly)
+		anomaly->add(packet);
+	if (scans)
+		scans->add(packet);
+}
+
+/**
+ * @brief Folds the counters of another engine into this one.
+ *
+ * Bandwidth points of both engines are merged in timestamp order and
+ * the packet-time timelines are summed per second; the recent packets
+ * list keeps the newest entries up to the limit.
+ */
+void Stats::merge(Stats &other) {
+	if (&other == this)
+		return;
+	std::scoped_lock lock(mtx, other.mtx);
+	merge_locked(other);
+}
+
+void Stats::merge_locked(Stats &other) {
+	snapshot.total_p += other.snapshot.total_p;
+	snapshot.total_b += other.snapshot.total_b;
+
+	for (const auto &[proto, s] : other.transport_map) {
+		auto &t = transport_map[proto];
+		t.packets += s.packets;
+		t.bytes += s.bytes;
+	}
+	for (const auto &[proto, s] : other.application_map) {
+		auto &a = application_map[proto];
+		a.packets += s.packets;
+		a.bytes += s.bytes;
+	}
+	for (const auto &[ip, s] : other.ip_map) {
+		auto &i = ip_map[ip];
+		i.bytes_sent += s.bytes_sent;
+		i.bytes_received += s.bytes_received;
+		i.packets_sent += s.packets_sent;
+		i.packets_received += s.packets_received;
+	}
+	for (const auto &[key, s] : other.pairs) {
+		auto &p = pairs[key];
+		p.packets += s.packets;
+		p.bytes += s.bytes;
+	}
+	/* per-second buckets line up by packet time, whatever the order the inputs were read in */
+	for (const auto &[sec, s] : other.timeline) {
+		auto &t = timeline[sec];
+		t.packets += s.packets;
+		t.bytes += s.bytes;
+	}
+
+	if (other.ports) {
+		if (!ports)
+			ports = std::make_unique<PortTable>();
+		ports->merge(*other.ports);
+	}
+
+	/* only counters of the same table line up */
+	if (networks && other.networks == networks) {
+		for (size_t i = 0; i < network_stats.size(); ++i) {
+			network_stats[i].bytes_sent += other.network_stats[i].bytes_sent;
+			network_stats[i].bytes_received += other.network_stats[i].bytes_received;
+			network_stats[i].packets_sent += other.network_stats[i].packets_sent;
+			network_stats[i].packets_received += other.network_stats[i].packets_received;
+		}
+	}
+
+	packets.insert(packets.end(), other.packets.begin(), other.packets.end());
+	while (packets.size() > static_cast<size_t>(limit_packets))
+		packets.pop_front();
+
+	std::vector<BandwidthPoint> history;
+	history.reserve(snapshot.bandwidth_history.size() + other.snapshot.bandwidth_history.size());
+	std::merge(snapshot.bandwidth_history.begin(), snapshot.bandwidth_history.end(),
+			   other.snapshot.bandwidth_history.begin(), other.snapshot.bandwidth_history.end(),
+			   std::back_inserter(history), [](auto &a, auto &b) { return a.timestamp < b.timestamp; });
+	snapshot.bandwidth_history = std::move(history);
+	snapshot.max_bandwidth = std::max(snapshot.max_bandwidth, other.snapshot.max_bandwidth);
+
+	if (anomaly && other.anomaly)
+		anomaly->merge_alerts(*other.anomaly);
+	if (scans && other.scans)
+		scans->merge_alerts(*other.scans);
+}
+
+void Stats::clear_locked() {
+	snapshot.total_p = 0;
+	snapshot.total_b = 0;
+	transport_map.clear();
+	application_map.clear();
+	ip_map.clear();
+	pairs.clear();
+	timeline.clear();
+	timeline_sec = UINT64_MAX;
+	timeline_slot = nullptr;
+	if (ports)
+		ports->clear();
+	std::fill(network_stats.begin(), network_stats.end(), IPStats{});
+	packets.clear();
+	if (anomaly)
+		anomaly->clear_alerts();
+	if (scans)
+		scans->clear_alerts();
+}
+
+void Stats::set_interfaces(const std::vector<std::string> &names) {
+	std::lock_guard<std::mutex> lock(mtx);
+	interfaces.assign(names.size(), InterfaceStats{});
+	interface_timelines.assign(names.size(), {});
+	for (size_t i = 0; i < names.size(); ++i)
+		interfaces[i].name = names[i];
+}
+
+void Stats::take_locked(Drained &out) {
+	Stats &into = *out.counters;
+	std::swap(snapshot.total_p, into.snapshot.total_p);
+	std::swap(snapshot.total_b, into.snapshot.total_b);
+	transport_map.swap(into.transport_map);
+	application_map.swap(into.application_map);
+	ip_map.swap(into.ip_map);
+	pairs.swap(into.pairs);
+	timeline.swap(into.timeline);
+	timeline_sec = UINT64_MAX;
+	timeline_slot = nullptr;
+	ports.swap(into.ports);
+	/* only the first drain after set_networks() allocates */
+	into.networks = networks;
+	if (into.network_stats.size() != network_stats.size())
+		into.network_stats.assign(network_stats.size(), IPStats{});
+	network_stats.swap(into.network_stats);
+	packets.swap(into.packets);
+
+	out.alerts.clear();
+	out.alert_total = 0;
+	if (anomaly)
+		anomaly->take_alerts(out.alerts, out.alert_total);
+	out.scans.clear();
+	out.scan_total = 0;
+	if (scans)
+		scans->take_alerts(out.scans, out.scan_total);
+}
+
+/**
+ * @brief Moves the counters of one interface's shard into this engine.
+ *
+ * The shard is only locked by its own capture thread otherwise, so this
+ * is the one place the two meet. The capture thread only waits while
+ * the shard's containers are swapped with the empty ones of the last
+ * drain; the merge runs under this engine's lock alone and the swapped
+ * out containers, the port table included, are zeroed after it, off
+ * both locks, for the next drain to hand back to the shard. The
+ * detectors keep their baselines, only their alerts move over.
+ */
+void Stats::drain(Stats &shard, size_t link, uint64_t dropped) {
+	if (&shard == this)
+		return;
+	std::lock_guard<std::mutex> drain_lock(shard.drain_mtx);
+	Drained &d = shard.drained;
+	if (!d.counters)
+		d.counters = std::make_unique<Stats>();
+	Stats &taken = *d.counters;
+	{
+		std::lock_guard<std::mutex> lock(shard.mtx);
+		shard.take_locked(d);
+	}
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		InterfaceStats &i = interfaces.at(link);
+		i.packets += taken.snapshot.total_p;
+		i.bytes += taken.snapshot.total_b;
+		i.dropped = dropped;
+		for (const auto &[sec, s] : taken.timeline)
+			interface_timelines[link][sec] += s.bytes;
+		merge_locked(taken);
+		if (anomaly)
+			anomaly->merge_alerts(d.alerts, d.alert_total);
+		if (scans)
+			scans->merge_alerts(d.scans, d.scan_total);
+	}
+	taken.clear_locked();
 }
 
 const char *transport_to_str(TransportProtocol p) {
@@ -81,24 +303,232 @@ const char *app_to_str(ApplicationProtocol p) {
 	}
 }
 
+/* v escaped for a JSON string literal: quotes, backslashes and control characters */
+static std::string json_escape(std::string_view v) {
+	std::string out;
+	out.reserve(v.size());
+	for (char c : v) {
+		switch (c) {
+		case '"':
+			out += "\\\"";
+			break;
+		case '\\':
+			out += "\\\\";
+			break;
+		case '\n':
+			out += "\\n";
+			break;
+		case '\r':
+			out += "\\r";
+			break;
+		case '\t':
+			out += "\\t";
+			break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20)
+				out += std::format("\\u{:04x}", static_cast<unsigned>(c));
+			else
+				out += c;
+		}
+	}
+	return out;
+}
+
+/* HH:MM:SS (UTC) of a packet timestamp */
+static std::string alert_time(uint64_t ts_ns) {
+	time_t sec = static_cast<time_t>(ts_ns / 1000000000ull);
+	struct tm utc {};
+	gmtime_r(&sec, &utc);
+	char buf[16];
+	strftime(buf, sizeof(buf), "%H:%M:%S", &utc);
+	return buf;
+}
+
+/* one alert as a JSON object */
+static std::string alert_json(const AnomalyAlert &a) {
+	return std::format("{{\"ts\":{:.3f},\"scope\":\"{}\",\"key\":\"{}\",\"metric\":\"{}\",\"value\":{:.0f},"
+					   "\"mean\":{:.1f},\"stddev\":{:.1f}}}",
+					   static_cast<double>(a.ts_ns) / 1e9, anomaly_scope_to_str(a.scope), json_escape(a.key),
+					   anomaly_metric_to_str(a.metric), a.value, a.mean, a.stddev);
+}
+
+/* one port counter as a JSON object */
+static std::string port_json(const PortTable::Entry &e) {
+	return std::format("{{\"protocol\":\"{}\",\"port\":{},\"packets_to\":{},\"bytes_to\":{},"
+					   "\"packets_from\":{},\"bytes_from\":{}}}",
+					   transport_to_str(e.protocol), e.port, e.packets_to, e.bytes_to, e.packets_from, e.bytes_from);
+}
+
+/* one network counter as a JSON object */
+static std::string network_json(const std::string &name, const IPStats &s) {
+	return std::format("{{\"network\":\"{}\",\"packets_sent\":{},\"packets_received\":{},\"bytes_sent\":{},"
+					   "\"bytes_received\":{}}}",
+					   json_escape(name), s.packets_sent, s.packets_received, s.bytes_sent, s.bytes_received);
+}
+
+static std::string interface_json(const InterfaceStats &i) {
+	return std::format("{{\"interface\":\"{}\",\"packets\":{},\"bytes\":{},\"bandwidth\":{:.1f},\"dropped\":{}}}",
+					   json_escape(i.name), i.packets, i.bytes, i.bandwidth, i.dropped);
+}
+
+/* percentiles of one pipeline stage as a JSON object, nanoseconds */
+static std::string latency_json(const StageLatency &l) {
+	return std::format("{{\"stage\":\"{}\",\"count\":{},\"p50_ns\":{:.0f},\"p99_ns\":{:.0f},\"p999_ns\":{:.0f},"
+					   "\"max_ns\":{:.0f}}}",
+					   json_escape(l.stage), l.count, l.p50, l.p99, l.p999, l.max);
+}
+
+/* taken before Stats::mtx, summing the histograms needs no engine state */
+static std::vector<StageLatency> latency_report() {
+	return Latency::enabled() ? Latency::report() : std::vector<StageLatency>{};
+}
+
+/* counters of one role per captured packet as a JSON object, null where the event is missing */
+static std::string perf_json(const PerfTotals &t, uint64_t packets) {
+	std::string out = std::format("{{\"thread\":\"{}\",\"threads\":{}", json_escape(t.role), t.threads);
+	for (size_t e = 0; e < PERF_EVENTS; ++e) {
+		out += std::format(",\"{}_per_packet\":", perf_event_name(static_cast<PerfEvent>(e)));
+		if (t.values.available[e])
+			out += std::format("{:.2f}", packets ? static_cast<double>(t.values.count[e]) / packets : 0.0);
+		else
+			out += "null";
+	}
+	return out + "}";
+}
+
+static std::string format_ns(double ns) {
+	if (ns < 1e3)
+		return std::format("{:.0f} ns", ns);
+	if (ns < 1e6)
+		return std::format("{:.1f} us", ns / 1e3);
+	return std::format("{:.2f} ms", ns / 1e6);
+}
+
+/* one scan finding as a JSON object */
+
+static std::string scan_json(const ScanAlert &a) {
+	return std::format("{{\"ts\":{:.3f},\"kind\":\"{}\",\"key\":\"{}\",\"syns\":{},\"distinct\":{},"
+					   "\"half_open\":{:.2f}}}",
+					   static_cast<double>(a.ts_ns) / 1e9, scan_kind_to_str(a.kind), json_escape(a.key), a.syns,
+					   a.distinct, a.half_open);
+}
+
+size_t sort_column(SnapshotTable table, const std::string &key) {
+	if (key == "ip")
+		return 0;
+	bool bytes = key == "bytes";
+	if (!bytes && key != "packets")
+		throw std::invalid_argument("Unknown sort field: '" + key + "' (expected bytes | packets | ip)");
+	switch (table) {
+	case SnapshotTable::TRANSPORT:
+	case SnapshotTable::APPLICATION:
+	case SnapshotTable::PORTS:
+		return bytes ? 2 : 1;
+	case SnapshotTable::IPS:
+	case SnapshotTable::NETWORKS:
+		return bytes ? 3 : 1;
+	case SnapshotTable::PAIRS:
+		return bytes ? 3 : 2;
+	}
+	return 0;
+}
+
+/* a table entry with the value of its sort column, so comparisons don't chase pointers */
+template <class T> struct Ranked {
+	uint64_t key;
+	const T *item;
+};
+
+/**
+ * @brief Keeps only the visible window of a table, in view order.
+ *
+ * Rows are ranked by key (descending or ascending), ties and the name
+ * column (key 0) by name_less. nth_element moves every row before the
+ * window out of the way and partial_sort orders the window itself, so a
+ * frame costs O(n + n log page) instead of a full sort, and only the
+ * window gets formatted afterwards. The offset is clamped to the last
+ * full window; page records it with the total row count.
+ */
+template <class T, class NameLess>
+static void select_page(std::vector<Ranked<T>> &items, const TableView &view, size_t columns, TablePage &page,
+						NameLess name_less) {
+	page.view = view;
+	page.view.page = std::max<size_t>(view.page, 1);
+	page.view.offset = std::min(view.offset, items.size() > page.view.page ? items.size() - page.view.page : 0);
+	page.total = items.size();
+	page.columns = columns;
+
+	bool desc = view.descending;
+	bool by_name = view.column == 0;
+	auto less = [&](const Ranked<T> &a, const Ranked<T> &b) {
+		if (a.key != b.key)
+			return desc ? a.key > b.key : a.key < b.key;
+		return desc && by_name ? name_less(*b.item, *a.item) : name_less(*a.item, *b.item);
+	};
+	auto first = items.begin() + static_cast<std::ptrdiff_t>(page.view.offset);
+	auto last = items.begin() + static_cast<std::ptrdiff_t>(std::min(items.size(), page.view.offset + page.view.page));
+	if (first != items.begin())
+		std::nth_element(items.begin(), first, items.end(), less);
+	std::partial_sort(first, last, items.end(), less);
+	items.erase(last, items.end());
+	items.erase(items.begin(), first);
+}
+
+/* sort value of a protocolStats row: Proto, Packets, Bytes, % */
+static uint64_t protocol_key(const protocolStats &s, size_t column) {
+	switch (column) {
+	case 1:
+		return s.packets;
+	case 2:
+	case 3:
+		return s.bytes;
+	default:
+		return 0;
+	}
+}
+
+/* sort value of an IPStats row: name, Packets TX, Packets RX, Bytes TX, Bytes RX */
+static uint64_t ip_key(const IPStats &s, size_t column) {
+	switch (column) {
+	case 1:
+		return s.packets_sent;
+	case 2:
+		return s.packets_received;
+	case 3:
+		return s.bytes_sent;
+	case 4:
+		return s.bytes_received;
+	default:
+		return 0;
+	}
+}
+
 /**
  * @brief Rebuilds transport protocol snapshot table.
  *
- * Sorts protocols by packet count (descending).
+ * Sorted by the view's column.
  * Calculates percentage relative to total traffic.
  *
  * Called periodically by UI update thread.
  */
 
-void Stats::update_transport_stats() {
+void Stats::update_transport_stats(const TableView &view) {
 	std::lock_guard<std::mutex> lock(mtx);
 	snapshot.transport_rows.clear();
 	snapshot.transport_rows.push_back({"Proto", "Packets", "Bytes", "%"});
 
-	std::vector<std::pair<TransportProtocol, protocolStats>> tps(transport_map.begin(), transport_map.end());
-	std::sort(tps.begin(), tps.end(), [](auto &a, auto &b) { return a.second.packets > b.second.packets; });
+	using Entry = std::pair<const TransportProtocol, protocolStats>;
+	std::vector<Ranked<Entry>> tps;
+	for (const auto &e : transport_map)
+		tps.push_back({protocol_key(e.second, view.column), &e});
+	select_page(tps, view, snapshot.transport_rows[0].size(),
+				snapshot.pages[static_cast<size_t>(SnapshotTable::TRANSPORT)],
+				[](const Entry &a, const Entry &b) {
+					return std::string_view(transport_to_str(a.first)) < std::string_view(transport_to_str(b.first));
+				});
 
-	for (const auto &[proto, stats] : tps) {
+	for (const auto &r : tps) {
+		const auto &[proto, stats] = *r.item;
 		double percent = snapshot.total_b ? stats.bytes * 100.0 / snapshot.total_b : 0.0;
 		snapshot.transport_rows.push_back({transport_to_str(proto), std::to_string(stats.packets),
 										   std::format("{:.2f}", stats.bytes / (1024.0 * 1024.0)),
@@ -109,19 +539,26 @@ void Stats::update_transport_stats() {
 /**
  * @brief Rebuilds application protocol snapshot.
  *
- * Sorted by packet count.
+ * Sorted by the view's column.
  * Percent calculated relative to total bytes.
  */
-void Stats::update_application_stats() {
+void Stats::update_application_stats(const TableView &view) {
 	std::lock_guard<std::mutex> lock(mtx);
-	std::vector<std::pair<ApplicationProtocol, protocolStats>> apps(application_map.begin(), application_map.end());
-
-	std::sort(apps.begin(), apps.end(), [](auto &a, auto &b) { return a.second.packets > b.second.packets; });
-
 	snapshot.app_rows.clear();
 	snapshot.app_rows.push_back({"Proto", "Packets", "Bytes (MB)", "%"});
 
-	for (const auto &[proto, s] : apps) {
+	using Entry = std::pair<const ApplicationProtocol, protocolStats>;
+	std::vector<Ranked<Entry>> apps;
+	for (const auto &e : application_map)
+		apps.push_back({protocol_key(e.second, view.column), &e});
+	select_page(apps, view, snapshot.app_rows[0].size(),
+				snapshot.pages[static_cast<size_t>(SnapshotTable::APPLICATION)],
+				[](const Entry &a, const Entry &b) {
+					return std::string_view(app_to_str(a.first)) < std::string_view(app_to_str(b.first));
+				});
+
+	for (const auto &r : apps) {
+		const auto &[proto, s] = *r.item;
 		double percent = snapshot.total_b ? s.bytes * 100.0 / snapshot.total_b : 0.0;
 
 		snapshot.app_rows.push_back({app_to_str(proto), std::to_string(s.packets),
@@ -131,61 +568,155 @@ void Stats::update_application_stats() {
 }
 
 /**
- * @brief Generates snapshot for top IP addresses.
- *
- * @param limit Maximum number of IPs to display.
+ * @brief Generates snapshot of one window of the IP addresses.
  *
- * Sorted by transmitted packets (descending).
+ * @param view Sort column, direction and window.
  */
-void Stats::update_ip_stats(size_t limit) {
+void Stats::update_ip_stats(const TableView &view) {
 	std::lock_guard<std::mutex> lock(mtx);
 	snapshot.rows.clear();
+	snapshot.rows.push_back({"IP Address", "Packets TX", "Packets RX", "Bytes TX", "Bytes RX"});
 
-	snapshot.rows.push_back({"IP Address", "Packets TX", "Packets RX"});
-	std::vector<std::pair<std::string, IPStats>> ips(ip_map.begin(), ip_map.end());
+	using Entry = std::pair<const std::string, IPStats>;
+	std::vector<Ranked<Entry>> ips;
+	ips.reserve(ip_map.size());
+	for (const auto &e : ip_map)
+		ips.push_back({ip_key(e.second, view.column), &e});
+	select_page(ips, view, snapshot.rows[0].size(), snapshot.pages[static_cast<size_t>(SnapshotTable::IPS)],
+				[](const Entry &a, const Entry &b) { return a.first < b.first; });
 
-	std::sort(ips.begin(), ips.end(), [](auto &a, auto &b) { return a.second.packets_sent > b.second.packets_sent; });
-
-	size_t count = 0;
-	for (const auto &[ip, s] : ips) {
-		if (count++ >= limit)
-			break;
-		snapshot.rows.push_back(
-			{ip, "TX: " + std::to_string(s.packets_sent), "RX: " + std::to_string(s.packets_received)});
+	for (const auto &r : ips) {
+		const auto &[ip, s] = *r.item;
+		snapshot.rows.push_back({ip, std::to_string(s.packets_sent), std::to_string(s.packets_received),
+								 std::to_string(s.bytes_sent), std::to_string(s.bytes_received)});
 	}
 }
 
 /**
- * @brief Builds snapshot of top communication pairs.
+ * @brief Builds snapshot of one window of the communication pairs.
  *
- * @param limit Maximum number of pairs to include.
- *
- * Sorted by total bytes transferred.
+ * @param view Sort column, direction and window.
  */
 
-void Stats::update_pairs(size_t limit) {
+void Stats::update_pairs(const TableView &view) {
 	std::lock_guard<std::mutex> lock(mtx);
-	std::vector<std::pair<std::pair<std::string, std::string>, protocolStats>> vec(pairs.begin(), pairs.end());
-	std::sort(vec.begin(), vec.end(), [](auto &a, auto &b) { return a.second.bytes > b.second.bytes; });
-
 	snapshot.pairs_rows.clear();
-	snapshot.pairs_rows.push_back({"Source", "Destination", "bytes received", "%"});
-	size_t count = 0;
-	for (const auto &[pair, s] : vec) {
+	snapshot.pairs_rows.push_back({"Source", "Destination", "Packets", "Bytes", "%"});
 
-		if (count++ >= limit)
-			break;
+	using Entry = std::pair<const std::pair<std::string, std::string>, protocolStats>;
+	std::vector<Ranked<Entry>> vec;
+	vec.reserve(pairs.size());
+	/* Source, Destination, Packets, Bytes, % */
+	for (const auto &e : pairs)
+		vec.push_back({view.column < 2 ? 0 : protocol_key(e.second, view.column - 1), &e});
+	select_page(vec, view, snapshot.pairs_rows[0].size(), snapshot.pages[static_cast<size_t>(SnapshotTable::PAIRS)],
+				[&view](const Entry &a, const Entry &b) {
+					if (view.column == 1 && a.first.second != b.first.second)
+						return a.first.second < b.first.second;
+					return a.first < b.first;
+				});
+
+	for (const auto &r : vec) {
+		const auto &[pair, s] = *r.item;
 		double percent = snapshot.total_b ? (s.bytes * 100.0 / snapshot.total_b) : 0.0;
 		snapshot.pairs_rows.push_back({
 			pair.first,
 			pair.second,
-			std::format("{:.0f}", s.bytes * 1.0),
+			std::to_string(s.packets),
+			std::to_string(s.bytes),
 			std::format("{:.2f}", percent),
+		});
+	}
+}
+
+/**
+ * @brief Builds snapshot of one window of the TCP / UDP ports.
+ *
+ * @param view Sort column, direction and window; the Port column sorts by
+ *             number, TCP before UDP.
+ */
+void Stats::update_ports(const TableView &view) {
+	std::lock_guard<std::mutex> lock(mtx);
+	snapshot.port_rows.clear();
+	snapshot.port_rows.push_back({"Port", "Packets to", "Bytes to", "Packets from", "Bytes from"});
+	TablePage &page = snapshot.pages[static_cast<size_t>(SnapshotTable::PORTS)];
+	if (!ports) {
+		page = {view, 0, snapshot.port_rows[0].size()};
+		return;
+	}
 
+	std::vector<PortTable::Entry> entries = ports->entries();
+	std::vector<Ranked<PortTable::Entry>> ranked;
+	ranked.reserve(entries.size());
+	for (const auto &e : entries) {
+		uint64_t values[] = {(uint64_t(e.protocol == TransportProtocol::UDP) << 16) | e.port, e.packets_to, e.bytes_to,
+							 e.packets_from, e.bytes_from};
+		ranked.push_back({values[std::min<size_t>(view.column, 4)], &e});
+	}
+	/* keys are unique in the Port column, ties elsewhere go by port */
+	select_page(ranked, view, snapshot.port_rows[0].size(), page,
+				[](const PortTable::Entry &a, const PortTable::Entry &b) {
+					return std::pair(a.protocol == TransportProtocol::UDP, a.port) <
+						   std::pair(b.protocol == TransportProtocol::UDP, b.port);
+				});
+
+	for (const auto &r : ranked) {
+		const PortTable::Entry &e = *r.item;
+		snapshot.port_rows.push_back({
+			std::format("{}/{}", e.port, e.protocol == TransportProtocol::TCP ? "tcp" : "udp"),
+			std::to_string(e.packets_to),
+			std::to_string(e.bytes_to),
+			std::to_string(e.packets_from),
+			std::to_string(e.bytes_from),
 		});
 	}
 }
 
+void Stats::set_networks(std::shared_ptr<const PrefixTable> table) {
+	std::lock_guard<std::mutex> lock(mtx);
+	networks = std::move(table);
+	network_stats.assign(networks ? networks->label_count() + 1 : 0, IPStats{});
+}
+
+/* name of a network_stats slot */
+static std::string network_name(const PrefixTable &table, size_t slot) {
+	return slot ? table.label(static_cast<uint32_t>(slot - 1)) : "(other)";
+}
+
+/**
+ * @brief Builds snapshot of one window of the networks of the prefix table.
+ *
+ * @param view Sort column, direction and window.
+ *
+ * "(other)" collects unmatched addresses.
+ */
+void Stats::update_networks(const TableView &view) {
+	std::lock_guard<std::mutex> lock(mtx);
+	snapshot.network_rows.clear();
+	TablePage &page = snapshot.pages[static_cast<size_t>(SnapshotTable::NETWORKS)];
+	if (!networks) {
+		page = {view, 0, 0};
+		return;
+	}
+	snapshot.network_rows.push_back({"Network", "Packets TX", "Packets RX", "Bytes TX", "Bytes RX"});
+
+	std::vector<Ranked<IPStats>> slots;
+	for (const auto &s : network_stats)
+		if (s.packets_sent || s.packets_received)
+			slots.push_back({ip_key(s, view.column), &s});
+	auto name = [this](const IPStats &s) {
+		return network_name(*networks, static_cast<size_t>(&s - network_stats.data()));
+	};
+	select_page(slots, view, snapshot.network_rows[0].size(), page,
+				[&name](const IPStats &a, const IPStats &b) { return name(a) < name(b); });
+
+	for (const auto &r : slots) {
+		const IPStats &s = *r.item;
+		snapshot.network_rows.push_back({name(s), std::to_string(s.packets_sent), std::to_string(s.packets_received),
+										 std::to_string(s.bytes_sent), std::to_string(s.bytes_received)});
+	}
+}
+
 void Stats::update_packets() {
 	std::lock_guard lock(mtx);
 	snapshot.packets_rows.clear();
@@ -203,6 +734,425 @@ void Stats::update_packets() {
 	}
 }
 
+void Stats::enable_anomaly_detection(const AnomalyOptions &options) {
+	std::lock_guard<std::mutex> lock(mtx);
+	anomaly = std::make_unique<AnomalyDetector>(options);
+}
+
+void Stats::update_alerts(size_t limit) {
+	std::lock_guard lock(mtx);
+	snapshot.alert_rows.clear();
+	if (!anomaly)
+		return;
+	snapshot.alert_rows.push_back({"Time (UTC)", "Scope", "Key", "Metric", "Value", "Baseline"});
+
+	const auto &alerts = anomaly->alerts();
+	for (auto it = alerts.rbegin(); it != alerts.rend() && snapshot.alert_rows.size() <= limit; ++it) {
+		snapshot.alert_rows.push_back({
+			alert_time(it->ts_ns),
+			anomaly_scope_to_str(it->scope),
+			it->key,
+			anomaly_metric_to_str(it->metric),
+			std::format("{:.0f}", it->value),
+			std::format("{:.0f} ± {:.0f}", it->mean, it->stddev),
+		});
+	}
+}
+
+void Stats::enable_scan_detection(const ScanOptions &options) {
+	std::lock_guard<std::mutex> lock(mtx);
+	scans = std::make_unique<ScanDetector>(options);
+}
+
+void Stats::update_scans(size_t limit) {
+	std::lock_guard lock(mtx);
+	snapshot.scan_rows.clear();
+	if (!scans)
+		return;
+	snapshot.scan_rows.push_back({"Time (UTC)", "Finding", "Key", "SYNs", "Distinct", "Half-open"});
+
+	const auto &alerts = scans->alerts();
+	for (auto it = alerts.rbegin(); it != alerts.rend() && snapshot.scan_rows.size() <= limit; ++it) {
+		snapshot.scan_rows.push_back({
+			alert_time(it->ts_ns),
+			scan_kind_to_str(it->kind),
+			it->key,
+			std::to_string(it->syns),
+			std::to_string(it->distinct),
+			std::format("{:.0f}%", it->half_open * 100),
+		});
+	}
+}
+
+/**
+ * @brief Builds snapshot of the per-interface totals.
+ *
+ * Fixed order (as given to -i), there are only a handful of rows.
+ */
+void Stats::update_interfaces() {
+	std::lock_guard lock(mtx);
+	snapshot.interface_rows.clear();
+	if (interfaces.empty())
+		return;
+	snapshot.interface_rows.push_back({"Interface", "Packets", "Bytes", "Bandwidth", "Dropped"});
+	for (const auto &i : interfaces) {
+		snapshot.interface_rows.push_back({i.name, std::to_string(i.packets), std::to_string(i.bytes),
+										   std::format("{:.2f} KB/s", i.bandwidth / 1024), std::to_string(i.dropped)});
+	}
+}
+
+/**
+ * @brief Builds the hardware counter rows, per packet this engine counted.
+ *
+ * IPC is instructions per cycle; below ~1 the thread mostly waits on
+ * memory, which the LLC misses per packet usually confirm.
+ */
+void Stats::update_perf() {
+	if (!PerfMonitor::enabled())
+		return;
+	std::vector<PerfTotals> totals = PerfMonitor::report();
+	std::string error = PerfMonitor::error();
+	std::lock_guard lock(mtx);
+	snapshot.perf_rows.clear();
+	snapshot.perf_error = totals.empty() ? error : std::string();
+	if (totals.empty())
+		return;
+	double packets = std::max<double>(1, snapshot.total_p);
+	auto per_packet = [&](const PerfValues &v, PerfEvent e) {
+		return v.has(e) ? std::format("{:.1f}", static_cast<double>(v[e]) / packets) : std::string("n/a");
+	};
+	snapshot.perf_rows.push_back(
+		{"Thread", "Threads", "Cycles/pkt", "Instr/pkt", "IPC", "LLC miss/pkt", "Br miss/pkt"});
+	for (const auto &t : totals) {
+		const PerfValues &v = t.values;
+		std::string ipc = v.has(PerfEvent::INSTRUCTIONS) && v[PerfEvent::CYCLES]
+							  ? std::format("{:.2f}", static_cast<double>(v[PerfEvent::INSTRUCTIONS]) /
+															static_cast<double>(v[PerfEvent::CYCLES]))
+							  : std::string("n/a");
+		snapshot.perf_rows.push_back({t.role, std::to_string(t.threads), per_packet(v, PerfEvent::CYCLES),
+									  per_packet(v, PerfEvent::INSTRUCTIONS), ipc, per_packet(v, PerfEvent::LLC_MISSES),
+									  per_packet(v, PerfEvent::BRANCH_MISSES)});
+	}
+}
+
+void Stats::update_latency() {
+	std::vector<StageLatency> latency = latency_report();
+	std::lock_guard lock(mtx);
+	snapshot.latency_rows.clear();
+	if (latency.empty())
+		return;
+	snapshot.latency_rows.push_back({"Stage", "Samples", "p50", "p99", "p99.9", "Max"});
+	for (const auto &l : latency) {
+		if (!l.count)
+			snapshot.latency_rows.push_back({l.stage, "0", "-", "-", "-", "-"});
+		else
+			snapshot.latency_rows.push_back({l.stage, std::to_string(l.count), format_ns(l.p50), format_ns(l.p99),
+											 format_ns(l.p999), format_ns(l.max)});
+	}
+}
+
+/**
+ * @brief Builds a compact one-line JSON summary for headless mode.
+ *
+ * Reads the counters directly, only the top talkers (by bytes sent)
+ * are selected with a partial sort; no snapshot rows are formatted.
+ */
+std::string Stats::summary_json(size_t top) {
+	std::vector<StageLatency> latency = latency_report();
+	std::vector<PerfTotals> perf = PerfMonitor::enabled() ? PerfMonitor::report() : std::vector<PerfTotals>{};
+	std::string perf_error = perf.empty() && PerfMonitor::enabled() ? PerfMonitor::error() : std::string();
+	std::lock_guard<std::mutex> lock(mtx);
+	double now = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+	std::string out = std::format("{{\"ts\":{:.3f},\"packets\":{},\"bytes\":{},\"bandwidth\":{:.1f},", now,
+								  snapshot.total_p, snapshot.total_b, snapshot.bandwidth);
+	if (anomaly)
+		out += std::format("\"alerts\":{},", anomaly->alert_count());
+	if (scans)
+		out += std::format("\"scans\":{},", scans->alert_count());
+	if (!interfaces.empty()) {
+		out += "\"interfaces\":[";
+		for (size_t i = 0; i < interfaces.size(); ++i)
+			out += (i ? "," : "") + interface_json(interfaces[i]);
+		out += "],";
+	}
+	if (!latency.empty()) {
+		out += "\"latency\":[";
+		for (size_t i = 0; i < latency.size(); ++i)
+			out += (i ? "," : "") + latency_json(latency[i]);
+		out += "],";
+	}
+	if (!perf.empty()) {
+		out += "\"perf\":[";
+		for (size_t i = 0; i < perf.size(); ++i)
+			out += (i ? "," : "") + perf_json(perf[i], snapshot.total_p);
+		out += "],";
+	} else if (!perf_error.empty()) {
+		out += std::format("\"perf_error\":\"{}\",", json_escape(perf_error));
+	}
+	out += "\"transport\":{";
+	bool first = true;
+	for (const auto &[proto, s] : transport_map) {
+		out += std::format("{}\"{}\":[{},{}]", first ? "" : ",", transport_to_str(proto), s.packets, s.bytes);
+		first = false;
+	}
+
+	out += "},\"application\":{";
+	first = true;
+	for (const auto &[proto, s] : application_map) {
+		out += std::format("{}\"{}\":[{},{}]", first ? "" : ",", app_to_str(proto), s.packets, s.bytes);
+		first = false;
+	}
+
+	std::vector<std::pair<const std::string *, const IPStats *>> ips;
+	ips.reserve(ip_map.size());
+	for (const auto &[ip, s] : ip_map)
+		ips.emplace_back(&ip, &s);
+	size_t n = std::min(top, ips.size());
+	std::partial_sort(ips.begin(), ips.begin() + static_cast<std::ptrdiff_t>(n), ips.end(),
+					  [](auto &a, auto &b) { return a.second->bytes_sent > b.second->bytes_sent; });
+
+	out += "},\"top_talkers\":[";
+	for (size_t i = 0; i < n; ++i) {
+		out += std::format("{}{{\"ip\":\"{}\",\"tx_bytes\":{},\"rx_bytes\":{}}}", i ? "," : "",
+						   json_escape(*ips[i].first), ips[i].second->bytes_sent, ips[i].second->bytes_received);
+	}
+	out += "],\"top_ports\":[";
+	if (ports) {
+		first = true;
+		for (const auto &e : ports->top(top)) {
+			out += (first ? "" : ",") + port_json(e);
+			first = false;
+		}
+	}
+	out += "]}\n";
+	return out;
+}
+
+/**
+ * @brief Copies the counters of one NDJSON record.
+ *
+ * Only plain copies happen under the lock (into the record's existing
+ * storage); the text is built later by format_ndjson() on the exporter's
+ * I/O thread. Alerts are taken from the last queued record on, so a
+ * record the writer dropped doesn't lose them.
+ */
+void Stats::copy_ndjson(NdjsonRecord &rec, uint64_t seq) {
+	rec.latency = latency_report();
+	std::lock_guard<std::mutex> lock(mtx);
+	rec.seq = seq;
+	rec.timestamp = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+	rec.total_p = snapshot.total_p;
+	rec.total_b = snapshot.total_b;
+	rec.bandwidth = snapshot.bandwidth;
+	rec.max_bandwidth = snapshot.max_bandwidth;
+	rec.interfaces = interfaces;
+	rec.transport.assign(transport_map.begin(), transport_map.end());
+	rec.application.assign(application_map.begin(), application_map.end());
+
+	rec.ips.resize(ip_map.size());
+	size_t i = 0;
+	for (const auto &[ip, s] : ip_map) {
+		rec.ips[i].first = ip;
+		rec.ips[i].second = s;
+		++i;
+	}
+	rec.pairs.resize(pairs.size());
+	i = 0;
+	for (const auto &[pair, s] : pairs) {
+		rec.pairs[i].src = pair.first;
+		rec.pairs[i].dst = pair.second;
+		rec.pairs[i].stats = s;
+		++i;
+	}
+
+	rec.has_ports = ports != nullptr;
+	if (ports)
+		rec.ports = ports->top(EXPORT_PORTS);
+	else
+		rec.ports.clear();
+	rec.networks = networks;
+	rec.network_stats = network_stats;
+
+	rec.alerts.clear();
+	rec.alert_total = anomaly ? anomaly->alert_count() : 0;
+	if (rec.alert_total > ndjson_alerts) {
+		const auto &alerts = anomaly->alerts();
+		size_t fresh = static_cast<size_t>(std::min<uint64_t>(rec.alert_total - ndjson_alerts, alerts.size()));
+		rec.alerts.assign(alerts.end() - static_cast<std::ptrdiff_t>(fresh), alerts.end());
+	}
+	rec.scans.clear();
+	rec.scan_total = scans ? scans->alert_count() : 0;
+	if (rec.scan_total > ndjson_scans) {
+		const auto &alerts = scans->alerts();
+		size_t fresh = static_cast<size_t>(std::min<uint64_t>(rec.scan_total - ndjson_scans, alerts.size()));
+		rec.scans.assign(alerts.end() - static_cast<std::ptrdiff_t>(fresh), alerts.end());
+	}
+}
+
+void Stats::ndjson_queued(uint64_t alert_total, uint64_t scan_total) {
+	std::lock_guard<std::mutex> lock(mtx);
+	ndjson_alerts = std::max(ndjson_alerts, alert_total);
+	ndjson_scans = std::max(ndjson_scans, scan_total);
+}
+
+/**
+ * @brief Formats a record as newline-delimited JSON.
+ *
+ * Every section becomes its own line tagged with "type", "ts" and "seq"
+ * so consumers can pick the records they need. Formats straight into
+ * out (the caller reuses its capacity) and needs no lock.
+ */
+void format_ndjson(const NdjsonRecord &rec, std::string &out) {
+	double now = rec.timestamp;
+	uint64_t seq = rec.seq;
+	auto it = std::back_inserter(out);
+
+	std::format_to(it,
+				   "{{\"type\":\"summary\",\"ts\":{:.3f},\"seq\":{},\"packets\":{},\"bytes\":{},\"bandwidth\":{:.1f},"
+				   "\"max_bandwidth\":{:.1f}}}\n",
+				   now, seq, rec.total_p, rec.total_b, rec.bandwidth, rec.max_bandwidth);
+
+	if (!rec.interfaces.empty()) {
+		std::format_to(it, "{{\"type\":\"interfaces\",\"ts\":{:.3f},\"seq\":{},\"interfaces\":[", now, seq);
+		for (size_t i = 0; i < rec.interfaces.size(); ++i)
+			out += (i ? "," : "") + interface_json(rec.interfaces[i]);
+		out += "]}\n";
+	}
+
+	if (!rec.latency.empty()) {
+		std::format_to(it, "{{\"type\":\"latency\",\"ts\":{:.3f},\"seq\":{},\"stages\":[", now, seq);
+		for (size_t i = 0; i < rec.latency.size(); ++i)
+			out += (i ? "," : "") + latency_json(rec.latency[i]);
+		out += "]}\n";
+	}
+
+	std::format_to(it, "{{\"type\":\"transport\",\"ts\":{:.3f},\"seq\":{},\"protocols\":[", now, seq);
+	bool first = true;
+	for (const auto &[proto, s] : rec.transport) {
+		std::format_to(it, "{}{{\"protocol\":\"{}\",\"packets\":{},\"bytes\":{}}}", first ? "" : ",",
+					   transport_to_str(proto), s.packets, s.bytes);
+		first = false;
+	}
+	out += "]}\n";
+
+	std::format_to(it, "{{\"type\":\"application\",\"ts\":{:.3f},\"seq\":{},\"protocols\":[", now, seq);
+	first = true;
+	for (const auto &[proto, s] : rec.application) {
+		std::format_to(it, "{}{{\"protocol\":\"{}\",\"packets\":{},\"bytes\":{}}}", first ? "" : ",",
+					   app_to_str(proto), s.packets, s.bytes);
+		first = false;
+	}
+	out += "]}\n";
+
+	std::format_to(it, "{{\"type\":\"ips\",\"ts\":{:.3f},\"seq\":{},\"ips\":[", now, seq);
+	first = true;
+	for (const auto &[ip, s] : rec.ips) {
+		std::format_to(it,
+					   "{}{{\"ip\":\"{}\",\"packets_sent\":{},\"packets_received\":{},\"bytes_sent\":{},"
+					   "\"bytes_received\":{}}}",
+					   first ? "" : ",", json_escape(ip), s.packets_sent, s.packets_received, s.bytes_sent,
+					   s.bytes_received);
+		first = false;
+	}
+	out += "]}\n";
+
+	std::format_to(it, "{{\"type\":\"pairs\",\"ts\":{:.3f},\"seq\":{},\"pairs\":[", now, seq);
+	first = true;
+	for (const auto &p : rec.pairs) {
+		std::format_to(it, "{}{{\"src\":\"{}\",\"dst\":\"{}\",\"packets\":{},\"bytes\":{}}}", first ? "" : ",",
+					   json_escape(p.src), json_escape(p.dst), p.stats.packets, p.stats.bytes);
+		first = false;
+	}
+	out += "]}\n";
+
+	if (rec.has_ports) {
+		std::format_to(it, "{{\"type\":\"ports\",\"ts\":{:.3f},\"seq\":{},\"ports\":[", now, seq);
+		first = true;
+		for (const auto &e : rec.ports) {
+			out += (first ? "" : ",") + port_json(e);
+			first = false;
+		}
+		out += "]}\n";
+	}
+
+	if (rec.networks) {
+		std::format_to(it, "{{\"type\":\"networks\",\"ts\":{:.3f},\"seq\":{},\"networks\":[", now, seq);
+		first = true;
+		for (size_t i = 0; i < rec.network_stats.size(); ++i) {
+			if (!rec.network_stats[i].packets_sent && !rec.network_stats[i].packets_received)
+				continue;
+			out += (first ? "" : ",") + network_json(network_name(*rec.networks, i), rec.network_stats[i]);
+			first = false;
+		}
+		out += "]}\n";
+	}
+
+	if (!rec.alerts.empty()) {
+		std::format_to(it, "{{\"type\":\"alerts\",\"ts\":{:.3f},\"seq\":{},\"alerts\":[", now, seq);
+		for (size_t i = 0; i < rec.alerts.size(); ++i)
+			out += (i ? "," : "") + alert_json(rec.alerts[i]);
+		out += "]}\n";
+	}
+	if (!rec.scans.empty()) {
+		std::format_to(it, "{{\"type\":\"scans\",\"ts\":{:.3f},\"seq\":{},\"scans\":[", now, seq);
+		for (size_t i = 0; i < rec.scans.size(); ++i)
+			out += (i ? "," : "") + scan_json(rec.scans[i]);
+		out += "]}\n";
+	}
+}
+
+trafficStats Stats::copy_pairs(std::vector<PairCounter> &out) {
+	std::lock_guard<std::mutex> lock(mtx);
+	out.resize(pairs.size());
+	size_t i = 0;
+	for (const auto &[pair, s] : pairs) {
+		out[i].src = pair.first;
+		out[i].dst = pair.second;
+		out[i].stats = s;
+		++i;
+	}
+	return {snapshot.total_p, snapshot.total_b};
+}
+
+/**
+ * @brief Publishes the current counters for the metrics endpoint.
+ *
+ * Called from the update thread. Copies only numbers and the top
+ * talkers while holding the lock; the snapshot is swapped in with an
+ * atomic store so scrapes never wait on the capture path.
+ */
+void Stats::publish_metrics(size_t top) {
+	auto m = std::make_shared<MetricsSnapshot>();
+	m->latency = latency_report();
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		m->timestamp = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+		m->total_packets = snapshot.total_p;
+		m->total_bytes = snapshot.total_b;
+		m->bandwidth = snapshot.bandwidth;
+		m->max_bandwidth = snapshot.max_bandwidth;
+		m->alerts = anomaly ? anomaly->alert_count() : 0;
+		m->scan_alerts = scans ? scans->alert_count() : 0;
+		for (const auto &[proto, s] : transport_map)
+			m->transport.push_back({transport_to_str(proto), s.packets, s.bytes});
+		for (const auto &[proto, s] : application_map)
+			m->application.push_back({app_to_str(proto), s.packets, s.bytes});
+
+		std::vector<std::pair<const std::string *, const IPStats *>> ips;
+		ips.reserve(ip_map.size());
+		for (const auto &[ip, s] : ip_map)
+			ips.emplace_back(&ip, &s);
+		size_t n = std::min(top, ips.size());
+		std::partial_sort(ips.begin(), ips.begin() + static_cast<std::ptrdiff_t>(n), ips.end(),
+						  [](auto &a, auto &b) { return a.second->bytes_sent > b.second->bytes_sent; });
+		for (size_t i = 0; i < n; ++i)
+			m->top_talkers.push_back({*ips[i].first, *ips[i].second});
+		m->interfaces = interfaces;
+	}
+	published_metrics.store(std::move(m));
+}
+
 double Stats::smooth_value(size_t i, size_t start) {
 	const int window = 3;
 	double sum = 0.0;
@@ -218,37 +1168,80 @@ double Stats::smooth_value(size_t i, size_t start) {
 	return count ? sum / count : 0.0;
 }
 /**
- * @brief Calculates current bandwidth (bytes/sec).
+ * @brief Calculates current bandwidth (bytes/sec) from packet time.
  *
- * Uses:
- *   - Delta bytes since last tick
- *   - Time elapsed
- *   - Exponential smoothing to reduce noise
+ * The bytes of every second come from the timeline, which is keyed by
+ * the capture timestamps, so the rate doesn't depend on how often this
+ * is called or on how late the packets were counted (pcap buffers,
+ * interface shards). Live timestamps are system time: a second is final
+ * once the system clock is a full second past its end, frames can wait
+ * for the pcap read timeout before they are delivered.
  *
- * Stores history for graph rendering.
+ * Appends one history point per final second, idle seconds as zeros;
+ * the current bandwidth is the last of them.
  */
 void Stats::update_bandwidth() {
 	std::lock_guard<std::mutex> lock(mtx);
 	using namespace std::chrono;
+	if (packet_time_bandwidth)
+		return;
 
-	auto now = steady_clock::now();
-	double ts = duration_cast<duration<double>>(now.time_since_epoch()).count();
-	double elapsed = duration_cast<duration<double>>(now - last_tick).count();
-
-	if (elapsed >= 1.0) {
+	uint64_t now = static_cast<uint64_t>(duration_cast<seconds>(system_clock::now().time_since_epoch()).count());
+	uint64_t complete = now - 1;
+	/* starts with the current second (a restored history already covers the past), no endless fill after a clock jump */
+	if (!history_sec || history_sec + 3600 < complete)
+		history_sec = complete;
+	if (history_sec >= complete)
+		return;
 
-		uint32_t delta_bytes = snapshot.total_b - last_b;
+	auto it = timeline.lower_bound(history_sec);
+	for (; history_sec < complete; ++history_sec) {
+		double bytes = 0;
+		if (it != timeline.end() && it->first == history_sec) {
+			bytes = static_cast<double>(it->second.bytes);
+			++it;
+		}
+		snapshot.bandwidth_history.push_back({static_cast<double>(history_sec), bytes});
+		snapshot.bandwidth = bytes;
+		snapshot.max_bandwidth = std::max(snapshot.max_bandwidth, bytes);
+	}
 
-		snapshot.bandwidth = delta_bytes / elapsed; // bytes per second
+	for (size_t i = 0; i < interfaces.size(); ++i) {
+		auto &seconds = interface_timelines[i];
+		auto last = seconds.find(complete - 1);
+		interfaces[i].bandwidth = last == seconds.end() ? 0.0 : static_cast<double>(last->second);
+		seconds.erase(seconds.begin(), seconds.lower_bound(complete));
+	}
+}
 
-		last_b = snapshot.total_b;
-		last_tick = now;
-		const double alpha = 0.2;
-		smooth_bandwidth = alpha * snapshot.bandwidth + (1.0 - alpha) * smooth_bandwidth;
+/**
+ * @brief Derives the bandwidth history from the packet-time timeline.
+ *
+ * Used for offline and merged results, whose seconds are all final and
+ * unrelated to the system clock update_bandwidth() waits for. A gap of
+ * more than a second is marked with a single zero point instead of being
+ * filled. Later update_bandwidth() calls leave the result alone.
+ */
+void Stats::bandwidth_from_timeline() {
+	std::lock_guard<std::mutex> lock(mtx);
+	if (timeline.empty())
+		return;
 
-		snapshot.bandwidth_history.push_back({ts, smooth_bandwidth});
+	std::vector<BandwidthPoint> history;
+	history.reserve(timeline.size());
+	uint64_t prev = timeline.begin()->first;
+	double max_bw = 0;
+	for (const auto &[sec, s] : timeline) {
+		if (sec > prev + 1)
+			history.push_back({static_cast<double>(prev + 1), 0.0});
+		history.push_back({static_cast<double>(sec), static_cast<double>(s.bytes)});
+		max_bw = std::max(max_bw, static_cast<double>(s.bytes));
+		prev = sec;
 	}
-	snapshot.max_bandwidth = std::max(snapshot.max_bandwidth, snapshot.bandwidth);
+	snapshot.bandwidth_history = std::move(history);
+	snapshot.bandwidth = snapshot.bandwidth_history.back().bytes_per_sec;
+	snapshot.max_bandwidth = max_bw;
+	packet_time_bandwidth = true;
 }
 
 /**
@@ -263,6 +1256,7 @@ void Stats::update_bandwidth() {
  */
 
 void Stats::export_csv(const std::string &filename) {
+	std::vector<StageLatency> latency = latency_report();
 	std::lock_guard<std::mutex> lock(mtx);
 	std::ofstream file(filename);
 	if (!file.is_open())
@@ -272,6 +1266,24 @@ void Stats::export_csv(const std::string &filename) {
 	file << "total_packets,total_bytes,bandwidth\n";
 	file << snapshot.total_p << "," << snapshot.total_b << "," << snapshot.bandwidth << "\n\n";
 
+	// ===== Interfaces =====
+	if (!interfaces.empty()) {
+		file << "interfaces\n";
+		file << "interface,packets,bytes,bandwidth,dropped\n";
+		for (const auto &i : interfaces)
+			file << i.name << "," << i.packets << "," << i.bytes << "," << i.bandwidth << "," << i.dropped << "\n";
+		file << "\n";
+	}
+
+	// ===== Pipeline latency =====
+	if (!latency.empty()) {
+		file << "latency\n";
+		file << "stage,count,p50_ns,p99_ns,p999_ns,max_ns\n";
+		for (const auto &l : latency)
+			file << l.stage << "," << l.count << "," << l.p50 << "," << l.p99 << "," << l.p999 << "," << l.max << "\n";
+		file << "\n";
+	}
+
 	// ===== Transport protocols =====
 	file << "transport_protocols\n";
 	file << "protocol,packets,bytes,percent\n";
@@ -300,6 +1312,49 @@ void Stats::export_csv(const std::string &filename) {
 			 << s.bytes_received << "\n";
 	}
 
+	// ===== Networks =====
+	if (networks) {
+		file << "\nnetworks\n";
+		file << "network,packets_sent,packets_received,bytes_sent,bytes_received\n";
+		for (size_t i = 0; i < network_stats.size(); ++i) {
+			const IPStats &s = network_stats[i];
+			if (!s.packets_sent && !s.packets_received)
+				continue;
+			file << network_name(*networks, i) << "," << s.packets_sent << "," << s.packets_received << ","
+				 << s.bytes_sent << "," << s.bytes_received << "\n";
+		}
+	}
+
+	// ===== Top ports =====
+	if (ports) {
+		file << "\nports\n";
+		file << "protocol,port,packets_to,bytes_to,packets_from,bytes_from\n";
+		for (const auto &e : ports->top(EXPORT_PORTS)) {
+			file << transport_to_str(e.protocol) << "," << e.port << "," << e.packets_to << "," << e.bytes_to << ","
+				 << e.packets_from << "," << e.bytes_from << "\n";
+		}
+	}
+
+	if (anomaly) {
+		file << "\nalerts\n";
+		file << "ts,scope,key,metric,value,mean,stddev\n";
+		for (const auto &a : anomaly->alerts()) {
+			file << std::format("{:.3f}", static_cast<double>(a.ts_ns) / 1e9) << "," << anomaly_scope_to_str(a.scope)
+				 << "," << a.key << "," << anomaly_metric_to_str(a.metric) << "," << a.value << "," << a.mean << ","
+				 << a.stddev << "\n";
+		}
+		file << "\n";
+	}
+	if (scans) {
+		file << "\nscans\n";
+		file << "ts,kind,key,syns,distinct,half_open\n";
+		for (const auto &a : scans->alerts()) {
+			file << std::format("{:.3f}", static_cast<double>(a.ts_ns) / 1e9) << "," << scan_kind_to_str(a.kind) << ","
+				 << a.key << "," << a.syns << "," << a.distinct << "," << std::format("{:.2f}", a.half_open) << "\n";
+		}
+		file << "\n";
+	}
+
 	// bandwidth
 	file << "time,bandwidth\n";
 
@@ -318,6 +1373,7 @@ void Stats::export_csv(const std::string &filename) {
  *  - Data pipelines
  */
 void Stats::export_json(const std::string &filename) {
+	std::vector<StageLatency> latency = latency_report();
 	std::lock_guard<std::mutex> lock(mtx);
 	std::ofstream file(filename);
 	if (!file.is_open())
@@ -332,6 +1388,22 @@ void Stats::export_json(const std::string &filename) {
 	file << "    \"bandwidth\": " << snapshot.bandwidth << "\n";
 	file << "  },\n";
 
+	// ===== Interfaces =====
+	if (!interfaces.empty()) {
+		file << "  \"interfaces\": [\n";
+		for (size_t i = 0; i < interfaces.size(); ++i)
+			file << (i ? ",\n" : "") << "    " << interface_json(interfaces[i]);
+		file << "\n  ],\n";
+	}
+
+	// ===== Pipeline latency =====
+	if (!latency.empty()) {
+		file << "  \"latency\": [\n";
+		for (size_t i = 0; i < latency.size(); ++i)
+			file << (i ? ",\n" : "") << "    " << latency_json(latency[i]);
+		file << "\n  ],\n";
+	}
+
 	// ===== Transport =====
 	file << "  \"transport\": [\n";
 	bool first = true;
@@ -360,7 +1432,7 @@ void Stats::export_json(const std::string &filename) {
 		first = false;
 
 		file << "    {\n";
-		file << "      \"ip\": \"" << ip << "\",\n";
+		file << "      \"ip\": \"" << json_escape(ip) << "\",\n";
 		file << "      \"packets_sent\": " << s.packets_sent << ",\n";
 		file << "      \"packets_received\": " << s.packets_received << ",\n";
 		file << "      \"bytes_sent\": " << s.bytes_sent << ",\n";
@@ -378,8 +1450,8 @@ void Stats::export_json(const std::string &filename) {
 		first = false;
 
 		file << "    {\n";
-		file << "      \"src\": \"" << pair.first << "\",\n";
-		file << "      \"dst\": \"" << pair.second << "\",\n";
+		file << "      \"src\": \"" << json_escape(pair.first) << "\",\n";
+		file << "      \"dst\": \"" << json_escape(pair.second) << "\",\n";
 		file << "      \"packets\": " << s.packets << ",\n";
 		file << "      \"bytes\": " << s.bytes << "\n";
 		file << "    }";
@@ -387,6 +1459,55 @@ void Stats::export_json(const std::string &filename) {
 
 	file << "\n  ]";
 
+	if (ports) {
+		file << ",\n  \"ports\": [\n";
+		first = true;
+		for (const auto &e : ports->top(EXPORT_PORTS)) {
+			if (!first)
+				file << ",\n";
+			first = false;
+			file << "    " << port_json(e);
+		}
+		file << "\n  ]";
+	}
+
+	if (networks) {
+		file << ",\n  \"networks\": [\n";
+		first = true;
+		for (size_t i = 0; i < network_stats.size(); ++i) {
+			if (!network_stats[i].packets_sent && !network_stats[i].packets_received)
+				continue;
+			if (!first)
+				file << ",\n";
+			first = false;
+			file << "    " << network_json(network_name(*networks, i), network_stats[i]);
+		}
+		file << "\n  ]";
+	}
+
+	if (anomaly) {
+		file << ",\n  \"alerts\": [\n";
+		first = true;
+		for (const auto &a : anomaly->alerts()) {
+			if (!first)
+				file << ",\n";
+			first = false;
+			file << "    " << alert_json(a);
+		}
+		file << "\n  ]";
+	}
+	if (scans) {
+		file << ",\n  \"scans\": [\n";
+		first = true;
+		for (const auto &a : scans->alerts()) {
+			if (!first)
+				file << ",\n";
+			first = false;
+			file << "    " << scan_json(a);
+		}
+		file << "\n  ]";
+	}
+
 	file << "}\n";
 	file.close();
 }
@@ -0,0 +1,187 @@
+#include "../../include/stats/scanDetector.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iterator>
+
+namespace {
+
+constexpr uint8_t TCP_SYN = 0x02;
+constexpr uint8_t TCP_ACK = 0x10;
+
+uint64_t mix(uint64_t x) {
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ull;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebull;
+	x ^= x >> 31;
+	return x;
+}
+
+uint64_t hash_str(const std::string &s) { return mix(std::hash<std::string>{}(s)); }
+
+double half_open_share(uint32_t syns, uint32_t answered) {
+	return syns ? 1.0 - std::min(1.0, static_cast<double>(answered) / syns) : 0.0;
+}
+
+} // namespace
+
+std::string scan_kind_to_str(ScanKind kind) {
+	switch (kind) {
+	case ScanKind::PORT_SCAN:
+		return "port_scan";
+	case ScanKind::HOST_SWEEP:
+		return "host_sweep";
+	case ScanKind::SYN_FLOOD:
+		return "syn_flood";
+	}
+	return "unknown";
+}
+
+/* the low 6 bits pick the register, the rank of the first set bit above them is stored */
+void ScanDetector::Hll::add(uint64_t hash) {
+	uint8_t &reg = registers[hash & 63];
+	uint8_t rank = static_cast<uint8_t>(std::countr_zero((hash >> 6) | (uint64_t(1) << 58)) + 1);
+	reg = std::max(reg, rank);
+}
+
+uint32_t ScanDetector::Hll::estimate() const {
+	constexpr double m = 64;
+	double sum = 0;
+	uint32_t zeros = 0;
+	for (uint8_t r : registers) {
+		sum += std::ldexp(1.0, -r);
+		zeros += r == 0;
+	}
+	double est = 0.709 * m * m / sum;
+	/* linear counting is much better while registers are still empty */
+	if (est <= 2.5 * m && zeros)
+		est = m * std::log(m / zeros);
+	return static_cast<uint32_t>(est + 0.5);
+}
+
+ScanDetector::ScanDetector(ScanOptions options) : opts(options), sources(SLOTS), destinations(SLOTS) {
+	window_ns = static_cast<uint64_t>(std::max<int64_t>(1, opts.window.count())) * 1000000000ull;
+}
+
+template <class Entry>
+Entry *ScanDetector::lookup(std::vector<Entry> &table, uint64_t hash, const std::string &key, bool admit) {
+	/* a zero hash marks a free slot */
+	hash |= 1;
+	size_t set = (hash >> 32) & (SLOTS / 2 - 1);
+	Entry *a = &table[set * 2];
+	Entry *b = a + 1;
+	if (a->hash == hash)
+		return a;
+	if (b->hash == hash)
+		return b;
+	if (!admit)
+		return nullptr;
+
+	Entry *victim = a->syns <= b->syns ? a : b;
+	*victim = Entry{};
+	victim->hash = hash;
+	size_t len = std::min(key.size(), KEY_LEN - 1);
+	memcpy(victim->key, key.data(), len);
+	return victim;
+}
+
+/**
+ * @brief Accounts one packet, closing the window first if its timestamp is past the end.
+ *
+ * Only TCP matters: a SYN counts for its source (ports, hosts) and its
+ * destination (sources); a SYN-ACK answers the source it is sent to
+ * (RSTs don't: probing closed ports is what a scan looks like); a bare
+ * ACK without payload completes a handshake at its destination. Only
+ * SYNs can claim a table slot.
+ */
+void ScanDetector::add(const Packet &packet) {
+	if (packet.transport_protocol != TransportProtocol::TCP || !packet.ts_ns)
+		return;
+	if (!window_end)
+		window_end = (packet.ts_ns / window_ns + 1) * window_ns;
+	if (packet.ts_ns >= window_end) {
+		close_window();
+		window_end = (packet.ts_ns / window_ns + 1) * window_ns;
+	}
+
+	uint8_t flags = packet.tcp_flags;
+	if ((flags & (TCP_SYN | TCP_ACK)) == TCP_SYN) {
+		uint64_t src = hash_str(packet.src);
+		uint64_t dst = hash_str(packet.dst);
+		SourceEntry *s = lookup(sources, src, packet.src, true);
+		s->syns++;
+		s->ports.add(mix(packet.dst_port + 0x10000ull));
+		s->hosts.add(dst);
+		DestEntry *d = lookup(destinations, dst, packet.dst, true);
+		d->syns++;
+		d->sources.add(src);
+	} else if ((flags & (TCP_SYN | TCP_ACK)) == (TCP_SYN | TCP_ACK)) {
+		/* answers go back to the scanner, so the packet's destination is the source entry */
+		if (SourceEntry *s = lookup(sources, hash_str(packet.dst), packet.dst, false))
+			s->synacks++;
+	} else if (flags == TCP_ACK && packet.payload_len == 0) {
+		if (DestEntry *d = lookup(destinations, hash_str(packet.dst), packet.dst, false))
+			d->acks++;
+	}
+}
+
+void ScanDetector::report(ScanKind kind, const char *key, uint32_t syns, uint32_t distinct, double half_open) {
+	recent.push_back({window_end, kind, key, syns, distinct, half_open});
+	++total_alerts;
+	while (recent.size() > opts.history)
+		recent.pop_front();
+}
+
+void ScanDetector::merge_alerts(const ScanDetector &other) {
+	merge_alerts(other.recent, other.total_alerts);
+}
+
+void ScanDetector::merge_alerts(const std::deque<ScanAlert> &alerts, uint64_t count) {
+	std::deque<ScanAlert> merged;
+	std::merge(recent.begin(), recent.end(), alerts.begin(), alerts.end(), std::back_inserter(merged),
+			   [](const ScanAlert &a, const ScanAlert &b) { return a.ts_ns < b.ts_ns; });
+	while (merged.size() > opts.history)
+		merged.pop_front();
+	recent = std::move(merged);
+	total_alerts += count;
+}
+
+/* tests every active entry, then clears the counters; keys and report windows stay for the cooldown */
+void ScanDetector::close_window() {
+	auto cooled = [this](uint32_t reported) { return !reported || window - reported >= opts.cooldown; };
+
+	for (auto &s : sources) {
+		if (!s.syns)
+			continue;
+		double half_open = half_open_share(s.syns, s.synacks);
+		uint32_t ports = s.ports.estimate();
+		uint32_t hosts = s.hosts.estimate();
+		if (ports >= opts.port_threshold && cooled(s.reported[0])) {
+			report(ScanKind::PORT_SCAN, s.key, s.syns, ports, half_open);
+			s.reported[0] = window;
+		}
+		if (hosts >= opts.host_threshold && cooled(s.reported[1])) {
+			report(ScanKind::HOST_SWEEP, s.key, s.syns, hosts, half_open);
+			s.reported[1] = window;
+		}
+		s.syns = s.synacks = 0;
+		s.ports = {};
+		s.hosts = {};
+	}
+	for (auto &d : destinations) {
+		if (!d.syns)
+			continue;
+		double half_open = half_open_share(d.syns, d.acks);
+		if (d.syns >= opts.flood_syns && half_open >= opts.flood_half_open && cooled(d.reported)) {
+			report(ScanKind::SYN_FLOOD, d.key, d.syns, d.sources.estimate(), half_open);
+			d.reported = window;
+		}
+		d.syns = d.acks = 0;
+		d.sources = {};
+	}
+	++window;
+}